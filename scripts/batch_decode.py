@@ -0,0 +1,177 @@
+"""Batch-decode a set of Logic 2 captures with the USB Power Delivery (CC) analyzer.
+
+The analyzer itself only runs inside the Logic 2 software, so this script drives Logic 2 through
+its automation API. Install it with `pip install logic2-automation` and enable the automation
+server in Logic 2's preferences before running the script.
+
+Captures are taken from a directory (every *.sal file in it) or a manifest (one capture path per
+line, '#' starts a comment). Each capture gets its own export in the output directory, named
+after its path relative to the directory or the manifest with the separators replaced by "__", and
+summary.csv aggregates the results of the whole run.
+
+    python scripts/batch_decode.py captures/ -o results/ --channel 0 --bit-rate 300000 -j 4
+"""
+
+import argparse
+import concurrent.futures
+import csv
+import glob
+import os
+import sys
+import threading
+import time
+
+ANALYZER_NAME = "USB Power Delivery (CC)"
+
+
+def find_captures(source):
+    """Return the capture paths and the directory their export names are relative to."""
+    if os.path.isdir(source):
+        return sorted(glob.glob(os.path.join(source, "*.sal"))), os.path.abspath(source)
+
+    captures = []
+    base = os.path.dirname(os.path.abspath(source))
+    with open(source, "r") as manifest:
+        for line in manifest:
+            line = line.split("#", 1)[0].strip()
+            if line:
+                captures.append(line if os.path.isabs(line) else os.path.join(base, line))
+    return captures, base
+
+
+def export_name(capture_path, base):
+    """Name the export of a capture after its path relative to base, or its absolute path when it
+    is outside base, so that captures with the same file name in different directories do not
+    overwrite each other's export."""
+    path = os.path.abspath(capture_path)
+    try:
+        relative = os.path.relpath(path, base)
+    except ValueError:
+        # Another drive on Windows
+        relative = os.pardir
+    if relative == os.pardir or relative.startswith(os.pardir + os.sep):
+        relative = os.path.splitdrive(path)[1].lstrip(os.sep + (os.altsep or ""))
+
+    relative = os.path.splitext(relative)[0]
+    if os.altsep:
+        relative = relative.replace(os.altsep, os.sep)
+    return relative.replace(os.sep, "__")
+
+
+def find_name_collisions(names):
+    """Return the groups of captures whose exports would share a file. Names are compared without
+    case, as the output directory may be on a case-insensitive file system."""
+    groups = {}
+    for path, name in names.items():
+        groups.setdefault(name.lower(), []).append(path)
+    return [sorted(paths) for paths in groups.values() if len(paths) > 1]
+
+
+def decode_capture(manager, capture_path, name, output_dir, settings):
+    export_path = os.path.join(output_dir, name + ".csv")
+
+    start = time.time()
+    with manager.load_capture(filepath=os.path.abspath(capture_path)) as capture:
+        analyzer = capture.add_analyzer(ANALYZER_NAME, label=name, settings=settings)
+        capture.legacy_export_analyzer(filepath=os.path.abspath(export_path), analyzer=analyzer)
+
+    with open(export_path, "r") as export:
+        # First line is the column header
+        frames = max(sum(1 for _ in export) - 1, 0)
+
+    return {
+        "capture": capture_path,
+        "status": "ok",
+        "frames": frames,
+        "seconds": "%.2f" % (time.time() - start),
+        "export": export_path,
+        "error": "",
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Batch-decode Logic 2 captures of USB-PD traffic")
+    parser.add_argument("source", help="directory of .sal captures, or a manifest file")
+    parser.add_argument("-o", "--output", default="batch_output", help="output directory")
+    parser.add_argument("--channel", type=int, default=0, help="CC input channel index")
+    parser.add_argument("--bit-rate", type=int, default=300000, help="bit rate in bits/s")
+    parser.add_argument("-j", "--jobs", type=int, default=os.cpu_count() or 1,
+                        help="number of captures decoded concurrently")
+    parser.add_argument("--port", type=int, default=10430, help="Logic 2 automation port")
+    args = parser.parse_args()
+
+    try:
+        from saleae import automation
+    except ImportError:
+        print("The logic2-automation package is required: pip install logic2-automation")
+        return 1
+
+    captures, base = find_captures(args.source)
+    if not captures:
+        print("No captures found in " + args.source)
+        return 1
+
+    names = {path: export_name(path, base) for path in captures}
+    if len(names) != len(captures):
+        print("Captures are listed more than once in " + args.source)
+        return 1
+
+    collisions = find_name_collisions(names)
+    for paths in collisions:
+        print("Captures would share the export %s.csv: %s"
+              % (names[paths[0]], ", ".join(paths)))
+    summary_captures = sorted(path for path, name in names.items() if name.lower() == "summary")
+    if summary_captures:
+        print("Captures would overwrite summary.csv: " + ", ".join(summary_captures))
+    if collisions or summary_captures:
+        return 1
+
+    if not os.path.isdir(args.output):
+        os.makedirs(args.output)
+
+    settings = {"Serial": args.channel, "Bit Rate (Bits/S)": args.bit_rate}
+
+    # Largest captures are queued first so a long decode does not end up as the last task while
+    # the other workers sit idle.
+    captures.sort(key=lambda path: os.path.getsize(path) if os.path.exists(path) else 0,
+                  reverse=True)
+
+    results = []
+    lock = threading.Lock()
+
+    with automation.Manager.connect(port=args.port) as manager:
+        with concurrent.futures.ThreadPoolExecutor(max_workers=max(args.jobs, 1)) as pool:
+            futures = {
+                pool.submit(decode_capture, manager, path, names[path], args.output, settings): path
+                for path in captures
+            }
+
+            for future in concurrent.futures.as_completed(futures):
+                path = futures[future]
+                try:
+                    result = future.result()
+                except Exception as error:
+                    result = {"capture": path, "status": "failed", "frames": 0, "seconds": "",
+                              "export": "", "error": str(error)}
+
+                with lock:
+                    results.append(result)
+                    print("[%d/%d] %s: %s" % (len(results), len(captures), result["status"], path))
+
+    results.sort(key=lambda result: result["capture"])
+
+    summary_path = os.path.join(args.output, "summary.csv")
+    with open(summary_path, "w", newline="") as summary:
+        writer = csv.DictWriter(
+            summary, fieldnames=["capture", "status", "frames", "seconds", "export", "error"])
+        writer.writeheader()
+        writer.writerows(results)
+
+    failed = sum(1 for result in results if result["status"] != "ok")
+    print("Decoded %d captures, %d failed. Summary: %s" % (len(results), failed, summary_path))
+
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
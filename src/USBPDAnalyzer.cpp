@@ -2,22 +2,81 @@
 
 #include <AnalyzerChannelData.h>
 
-#include <iostream>
+#include <algorithm>
+#include <cstring>
 
 #include "USBPDAnalyzerSettings.h"
+#include "USBPDProfiler.h"
 #include "crc32.h"
 
 using namespace std;
 
+// Edges hashed to name a decode cache entry. The rest of the capture is only read ahead, to check
+// that it matches, if there is an entry for them.
+static const U64 decodeCachePrefixEdges = 64 * 1024;
+
+// Largest capture (in edges, about one byte each in the read-ahead buffer) that the decode cache
+// will hash
+static const U64 decodeCacheMaxEdges = 256 * 1024 * 1024;
+
+// mDecodeCacheEdges until the edges that were available at the start have been counted
+static const U64 decodeCacheEdgesUnknown = UINT64_MAX;
+
+// Decode cache section ids, fixed as they identify the sections in cache entries
+enum DecodeCacheSection {
+  DecodeCacheSection_Statistics = USBPDDecodeCache::firstSectionId,
+  DecodeCacheSection_Contracts,
+  DecodeCacheSection_Extended,
+  DecodeCacheSection_Identities,
+  DecodeCacheSection_Roles,
+  DecodeCacheSection_Filter,
+  DecodeCacheSection_Decoder,
+};
+
+// Values written by Save(): version, edges consumed, whether the transaction is ending, packet,
+// GoodCRC, BIST Carrier and filter match state, end of the last message, the number of Source
+// Capabilities, then the Source Capabilities
+static const U64 decoderVersion = 1;
+static const size_t decoderHeaderValues = 13;
+
 USBPDAnalyzer::USBPDAnalyzer()
     : Analyzer2(),
+      USBPDCacheSection(decoderVersion),
       mSettings(new USBPDAnalyzerSettings()),
-      mSimulationInitilized(false) {
+      mSimulationInitilized(false),
+      mEprRequestPdo(0),
+      mMessageDataObjects(0),
+      mFilterMatched(false),
+      mFilterMatchedMessage(0),
+      mIdleEdges(UINT64_MAX),
+      mPacketHasFrames(false),
+      mAwaitingGoodCrc(false),
+      mAwaitingGoodCrcSop(NUM_SOP_TYPE),
+      mAcknowledged(false),
+      mSaveDecodeCache(false),
+      mDecodeCacheEdges(0),
+      mDecodeCachePrefixKey(0),
+      mDecodeCacheStart(),
+      mOrderedSet(NUM_ORDERED_SET),
+      mBistCarrierRequested(false),
+      mBistCarrierNext(false),
+      mExtendedHeader(0),
+      mExtendedDataBytes(0),
+      mIdentityVdoCount(0) {
   // Generate the LUT for converting 5 bit code into 4 bit code
+  memset(fiveToFourBitLUT, fiveToFourBitInvalid, sizeof(fiveToFourBitLUT));
   for (int i = 0; i < 16; i++) {
-    fiveToFourBitLUT.insert(std::make_pair(fourBitToFiveBitLUT[i], i));
+    fiveToFourBitLUT[fourBitToFiveBitLUT[i]] = i;
   }
 
+  mCache.AddSection(DecodeCacheSection_Statistics, &mStatistics);
+  mCache.AddSection(DecodeCacheSection_Contracts, &mContractTracker);
+  mCache.AddSection(DecodeCacheSection_Extended, &mExtendedMessages);
+  mCache.AddSection(DecodeCacheSection_Identities, &mIdentities);
+  mCache.AddSection(DecodeCacheSection_Roles, &mRoleTracker);
+  mCache.AddSection(DecodeCacheSection_Filter, &mFilter);
+  mCache.AddSection(DecodeCacheSection_Decoder, this);
+
   SetAnalyzerSettings(mSettings.get());
 }
 
@@ -38,20 +97,15 @@ bool USBPDAnalyzer::ReadBiphaseMarkCodeBit() {
   U8 data = 0;
 
   // Sample number for the first edge
-  U64 firstEdgeSampleNumber = mSerial->GetSampleNumber();
+  U64 firstEdgeSampleNumber = mSerial.GetSampleNumber();
 
-  mSerial->AdvanceToNextEdge();
+  mSerial.AdvanceToNextEdge();
 
   // Sample number for the second edge
-  U64 secondEdgeSampleNumber = mSerial->GetSampleNumber();
+  U64 secondEdgeSampleNumber = mSerial.GetSampleNumber();
 
   U64 edgeDelta = (secondEdgeSampleNumber - firstEdgeSampleNumber);
 
-  // Detect glitches: if edgeDelta is <10% of samples_per_bit then this is probably a glitch
-  if (edgeDelta <= (samples_per_bit * 0.1)) {
-    cout << "Suspected glitch at sample " << samples_per_bit << endl;
-  }
-
   // If this edge is within range to be the central edge in a 1...
   // TODO: make tollerance a setting
   if ((edgeDelta >= (samples_per_transition * 0.75)) &&
@@ -59,8 +113,18 @@ bool USBPDAnalyzer::ReadBiphaseMarkCodeBit() {
     data = 1;
 
     // Need to advance to next edge to get to the end of the digit
-    mSerial->AdvanceToNextEdge();
-    secondEdgeSampleNumber = mSerial->GetSampleNumber();
+    mSerial.AdvanceToNextEdge();
+    U64 endOfBit = mSerial.GetSampleNumber();
+
+    mMessageEdges.Add(USBPDStatistics::EdgeHistogram::Interval_HalfBit, edgeDelta, samples_per_bit);
+    mMessageEdges.Add(USBPDStatistics::EdgeHistogram::Interval_HalfBit,
+                      endOfBit - secondEdgeSampleNumber,
+                      samples_per_bit);
+
+    secondEdgeSampleNumber = endOfBit;
+  } else {
+    // Glitches (up to 10% of samples_per_bit) and idle time are counted apart from the full bits
+    mMessageEdges.Add(USBPDStatistics::EdgeHistogram::Interval_FullBit, edgeDelta, samples_per_bit);
   }
 
   U64 midpoint = ((secondEdgeSampleNumber - firstEdgeSampleNumber) / 2) + firstEdgeSampleNumber;
@@ -72,6 +136,8 @@ bool USBPDAnalyzer::ReadBiphaseMarkCodeBit() {
 }
 
 void USBPDAnalyzer::DetectPreamble() {
+  USBPD_PROFILE_SCOPE(ProfileStage_DetectPreamble);
+
   // USB-PD specification says that we need to be tollerant to losing the first edge of the
   // preamble. Since the first bit of the preamble is always 0, if we lost that edge, then the next
   // edge we see would be the starting edge for the 1 Therefore, we could see two possible
@@ -83,7 +149,10 @@ void USBPDAnalyzer::DetectPreamble() {
   const int expectedPreambleBits = 63;
   int preambleBits = 0;
 
-  U64 startOfPreamble = mSerial->GetSampleNumber();
+  U64 startOfPreamble = mSerial.GetSampleNumber();
+
+  // Edges from here on belong to the next message
+  mMessageEdges.Clear();
 
   while (preambleBits < expectedPreambleBits) {
     bool bit = ReadBiphaseMarkCodeBit();
@@ -93,7 +162,7 @@ void USBPDAnalyzer::DetectPreamble() {
       expected = true;   // Always looking to start the preamble on a '1' bit
       preambleBits = 0;  // reset number of bits found
       startOfPreamble =
-          mSerial->GetSampleNumber();  // Reset where we think the preamble could start
+          mSerial.GetSampleNumber();  // Reset where we think the preamble could start
     } else {
       preambleBits++;
       expected = !expected;
@@ -101,7 +170,7 @@ void USBPDAnalyzer::DetectPreamble() {
   }
 
   // We found a preamble!
-  U64 endOfPreamble = mSerial->GetSampleNumber();
+  U64 endOfPreamble = mSerial.GetSampleNumber();
 
   // we have a byte to save.
   Frame frame;
@@ -110,7 +179,17 @@ void USBPDAnalyzer::DetectPreamble() {
   frame.mType = FRAME_TYPE_PREAMBLE;
   frame.mStartingSampleInclusive = startOfPreamble;
   frame.mEndingSampleInclusive = endOfPreamble;
-  mResults->AddFrame(frame);
+
+  // Held back until the header shows which packet the message belongs to
+  mPendingFrames.clear();
+  mPendingFrames.push_back(frame);
+
+  // Every preamble starts a new message
+  mMessage = USBPDMessageRecord();
+  mMessage.startingSample = startOfPreamble;
+  mMessage.sop = NUM_SOP_TYPE;
+  mMessageDataObjects = 0;
+  mIdentityVdoCount = 0;
 }
 
 uint8_t USBPDAnalyzer::ReadFiveBit() {
@@ -139,12 +218,13 @@ uint8_t USBPDAnalyzer::ReadFiveBit() {
  * @return uint8_t
  */
 uint8_t USBPDAnalyzer::ConvertFiveBitToFourBit(uint8_t fiveBit) {
-  if (fiveToFourBitLUT.count(fiveBit & 0x1F) == 0) {
-    cout << "Unexpceted 5-bit pattern: 0x" << std::hex << (int)fiveBit << endl;
-    return 0xFF;
+  uint8_t fourBit = fiveToFourBitLUT[fiveBit & 0x1F];
+
+  if (fourBit == fiveToFourBitInvalid) {
+    mMessage.flags |= MessageFlag_InvalidSymbol;
   }
 
-  return fiveToFourBitLUT[fiveBit & 0x1F];
+  return fourBit;
 }
 
 /**
@@ -154,7 +234,7 @@ uint8_t USBPDAnalyzer::ConvertFiveBitToFourBit(uint8_t fiveBit) {
  * @return uint8_t
  */
 uint8_t USBPDAnalyzer::ReadDecodedByte(bool addFrame) {
-  U64 startOfByte = mSerial->GetSampleNumber();
+  U64 startOfByte = mSerial.GetSampleNumber();
 
   uint8_t fiveBit = ReadFiveBit();
   uint8_t lsbNibble = ConvertFiveBitToFourBit(fiveBit);
@@ -164,7 +244,7 @@ uint8_t USBPDAnalyzer::ReadDecodedByte(bool addFrame) {
 
   uint8_t data = (((msbNibble << 4) & 0xF0) | (lsbNibble & 0xF));
 
-  U64 endOfByte = mSerial->GetSampleNumber();
+  U64 endOfByte = mSerial.GetSampleNumber();
 
   if (addFrame) {
     // we have a byte to save.
@@ -189,14 +269,14 @@ uint8_t USBPDAnalyzer::ReadDecodedByte(bool addFrame) {
  * @return uint8_t
  */
 uint32_t USBPDAnalyzer::ReadDataObject(uint32_t* currentCrc, bool addFrame) {
-  U64 startOfDataObject = mSerial->GetSampleNumber();
+  U64 startOfDataObject = mSerial.GetSampleNumber();
 
   uint8_t byte0 = ReadDecodedByte(false);
   uint8_t byte1 = ReadDecodedByte(false);
   uint8_t byte2 = ReadDecodedByte(false);
   uint8_t byte3 = ReadDecodedByte(false);
 
-  U64 endOfDataObject = mSerial->GetSampleNumber();
+  U64 endOfDataObject = mSerial.GetSampleNumber();
 
   uint32_t dataObject = (byte3 << 24) | (byte2 << 16) | (byte1 << 8) | byte0;
 
@@ -204,6 +284,10 @@ uint32_t USBPDAnalyzer::ReadDataObject(uint32_t* currentCrc, bool addFrame) {
       crc32(*currentCrc, (const uint8_t*)&dataObject, sizeof(uint32_t), usbCrcPolynomial);
   *currentCrc = remainder;
 
+  if (mMessageDataObjects++ == 0) {
+    mMessage.firstDataObject = dataObject;
+  }
+
   if (addFrame) {
     // we have a byte to save.
     // TODO: support detecting errors in the 5-bit pattern (ConvertFiveBitToFourBit() returns 255)
@@ -220,123 +304,174 @@ uint32_t USBPDAnalyzer::ReadDataObject(uint32_t* currentCrc, bool addFrame) {
   return dataObject;
 }
 
-bool USBPDAnalyzer::DetectSOP(SOPType* sop) {
-  uint8_t kcode[numKcodeInSOP] = {0};
-
-  U64 startOfSop = mSerial->GetSampleNumber();
-
-  // cout << "Reading bitstream: ";
-  for (int i = 0; i < numKcodeInSOP; i++) {
-    kcode[i] = ReadFiveBit();
-    // cout << (int)kcode[i] << ", ";
+/**
+ * @brief The 20 bits of an ordered set as read off the wire, the first K-code in the low 5 bits
+ */
+static U32 GetOrderedSetBits(int set) {
+  U32 bits = 0;
+  for (int k = 0; k < numKcodeInSOP; k++) {
+    bits |= (U32)kcode_map[ordered_set_map[set][k]] << (k * numKcodeBits);
   }
-  // cout << endl;
 
-  U64 endOfSop = mSerial->GetSampleNumber();
+  return bits;
+}
 
-  SOPType detectedSop = NUM_SOP_TYPE;
+/**
+ * @brief Build the table of the ordered set for every 20-bit sequence of four K-codes.
+ *
+ * The specification accepts an ordered set when 3 of its 4 K-codes are correct, so each ordered set
+ * claims every sequence with at most one K-code changed. Exact matches are claimed first. Ordered
+ * sets that differ in only two K-codes both match some sequences with one K-code changed; the
+ * first in ordered_set_map claims those.
+ */
+static std::vector<uint8_t> BuildOrderedSetLUT() {
+  std::vector<uint8_t> lut((size_t)1 << (numKcodeInSOP * numKcodeBits), NUM_ORDERED_SET);
 
-  for (int i = 0; i < NUM_SOP_TYPE; i++) {
-    // Which KCode should we detect for this SOP type?
-    const KCODEType* kcodesForSop = sop_map[i];
+  for (int set = 0; set < NUM_ORDERED_SET; set++) {
+    lut[GetOrderedSetBits(set)] = set;
+  }
 
-    // cout << "Looking for KCODE sequence: ";
-    // for (int k = 0; k < numKcodeInSOP; k++) {
-    //   cout << kcodesForSop[k] << ", ";
-    // }
-    // cout << endl;
+  for (int set = 0; set < NUM_ORDERED_SET; set++) {
+    U32 exact = GetOrderedSetBits(set);
 
-    // How many KCodes matched? If we find 3, we can proceed
-    int kcodesFound = 0;
     for (int k = 0; k < numKcodeInSOP; k++) {
-      // Which KCode are we currently looking for in this SOP sequence?
-      KCODEType currentKcode = kcodesForSop[k];
+      U32 shift = k * numKcodeBits;
 
-      // What is the actual 5-bit value for that KCode?
-      uint8_t kcodeValue = kcode_map[currentKcode];
+      for (U32 code = 0; code < (1u << numKcodeBits); code++) {
+        U32 bits = (exact & ~(0x1Fu << shift)) | (code << shift);
 
-      if (kcode[k] == kcodeValue) {
-        kcodesFound++;
+        if (lut[bits] == NUM_ORDERED_SET) {
+          lut[bits] = set;
+        }
       }
     }
+  }
 
-    // Gottem
-    if (kcodesFound >= 3) {
-      detectedSop = (SOPType)i;
-      break;
-    }
+  return lut;
+}
+
+/**
+ * @brief Read the ordered set following a preamble
+ *
+ * @param sop set to the SOP starting a message, NUM_SOP_TYPE if the ordered set is not a SOP
+ * @return true if a message follows (the ordered set is a SOP). mOrderedSet is set in any case.
+ */
+bool USBPDAnalyzer::DetectSOP(SOPType* sop) {
+  USBPD_PROFILE_SCOPE(ProfileStage_DetectSOP);
+
+  // Shared by every instance, built the first time a SOP is read
+  static const std::vector<uint8_t> orderedSetLUT = BuildOrderedSetLUT();
+
+  U64 startOfSop = mSerial.GetSampleNumber();
+
+  U32 kcodes = 0;
+  for (int i = 0; i < numKcodeInSOP; i++) {
+    kcodes |= (U32)ReadFiveBit() << (i * numKcodeBits);
   }
 
+  U64 endOfSop = mSerial.GetSampleNumber();
+
+  mOrderedSet = (OrderedSetType)orderedSetLUT[kcodes];
+
   // we have a byte to save.
   Frame frame;
   frame.mData1 = 1;
   frame.mFlags = 0;
 
-  switch (detectedSop) {
-    case SOPType_SOP:
+  switch (mOrderedSet) {
+    case OrderedSet_SOP:
       frame.mType = FRAME_TYPE_SOP;
       break;
 
-    case SOPType_SOP_PRIME:
+    case OrderedSet_SOP_PRIME:
       frame.mType = FRAME_TYPE_SOP_PRIME;
       break;
 
-    case SOPType_SOP_DOUBLE_PRIME:
+    case OrderedSet_SOP_DOUBLE_PRIME:
       frame.mType = FRAME_TYPE_SOP_DOUBLE_PRIME;
       break;
 
-    case SOPType_SOP_PRIME_DEBUG:
+    case OrderedSet_SOP_PRIME_DEBUG:
       frame.mType = FRAME_TYPE_SOP_PRIME_DEBUG;
       break;
 
-    case SOPType_SOP_DOUBLE_PRIME_DEBUG:
+    case OrderedSet_SOP_DOUBLE_PRIME_DEBUG:
       frame.mType = FRAME_TYPE_SOP_DOUBLE_PRIME_DEBUG;
       break;
 
+    case OrderedSet_HardReset:
+      frame.mType = FRAME_TYPE_HARD_RESET;
+      break;
+
+    case OrderedSet_CableReset:
+      frame.mType = FRAME_TYPE_CABLE_RESET;
+      break;
+
     default:
       frame.mType = FRAME_TYPE_SOP_ERROR;
       break;
   }
 
-  *sop = detectedSop;
+  // SOPType shares its values with the SOP ordered sets
+  *sop = (mOrderedSet < (OrderedSetType)NUM_SOP_TYPE) ? (SOPType)mOrderedSet : NUM_SOP_TYPE;
 
   frame.mStartingSampleInclusive = startOfSop;
   frame.mEndingSampleInclusive = endOfSop;
-  mResults->AddFrame(frame);
+  mPendingFrames.push_back(frame);
 
-  return (detectedSop != NUM_SOP_TYPE);
+  return (*sop != NUM_SOP_TYPE);
 }
 
 bool USBPDAnalyzer::DetectHeader(SOPType sop,
                                  uint32_t* currentCrc,
                                  uint8_t* dataObjects,
                                  DataMessageTypes* dataMsgType) {
-  U64 startOfHeader = mSerial->GetSampleNumber();
+  USBPD_PROFILE_SCOPE(ProfileStage_DetectHeader);
+
+  U64 startOfHeader = mSerial.GetSampleNumber();
 
   uint8_t lsb = ReadDecodedByte();
   uint8_t msb = ReadDecodedByte();
 
-  U64 endOfHeader = mSerial->GetSampleNumber();
+  U64 endOfHeader = mSerial.GetSampleNumber();
 
   uint16_t header = (msb << 8) | (lsb);
 
   *dataObjects = ((header & 0x7000) >> 12);  // Bits 14..12 == Number of Data Objects
+  bool extended = CHECK_BIT(header, 15);     // Bit 15 == Extended
 
-  if (*dataObjects > 0) {
-    *dataMsgType = (DataMessageTypes)((header & 0xF));  // Bits 3..0 == Message Type
+  if (*dataObjects > 0 && !extended && (header & 0x1F) < NUM_DATA_MESSAGE) {
+    *dataMsgType = (DataMessageTypes)((header & 0x1F));  // Bits 4..0 == Message Type
   } else {
     *dataMsgType = NUM_DATA_MESSAGE;
   }
 
+  // A GoodCRC joins the packet of the message it acknowledges, anything else starts a new packet
+  bool goodCrc =
+      !extended && (*dataObjects == 0) && ((header & 0x1F) == ControlMessage_GoodCRC);
+  bool acknowledges = goodCrc && mAwaitingGoodCrc && (mAwaitingGoodCrcSop == sop);
+  AddPendingFrames(!acknowledges);
+
+  mAwaitingGoodCrc = !goodCrc;
+  mAwaitingGoodCrcSop = sop;
+  mAcknowledged = acknowledges;
+
+  // Tag the message with its sender before the message changes the roles
+  uint8_t sender = mRoleTracker.GetSender(sop, header);
+
   Frame frame;
   frame.mData1 = header;
-  frame.mData2 = sop;
+  frame.mData2 = sop | ((U64)sender << 8);
   frame.mFlags = 0;
   frame.mType = FRAME_TYPE_HEADER;
   frame.mStartingSampleInclusive = startOfHeader;
   frame.mEndingSampleInclusive = endOfHeader;
   mResults->AddFrame(frame);
 
+  mMessage.header = header;
+  mMessage.sop = sop;
+  mMessage.sender = sender;
+
   uint32_t remainder =
       crc32(*currentCrc, (const uint8_t*)&header, sizeof(uint16_t), usbCrcPolynomial);
 
@@ -346,14 +481,16 @@ bool USBPDAnalyzer::DetectHeader(SOPType sop,
 }
 
 bool USBPDAnalyzer::DetectCRC32(uint32_t* currentCrc) {
-  U64 startOfCrc = mSerial->GetSampleNumber();
+  USBPD_PROFILE_SCOPE(ProfileStage_DetectCRC32);
+
+  U64 startOfCrc = mSerial.GetSampleNumber();
 
   uint32_t byte0 = ReadDecodedByte();
   uint32_t byte1 = ReadDecodedByte();
   uint32_t byte2 = ReadDecodedByte();
   uint32_t byte3 = ReadDecodedByte();
 
-  U64 endOfCrc = mSerial->GetSampleNumber();
+  U64 endOfCrc = mSerial.GetSampleNumber();
 
   uint32_t crcVal = (byte3 << 24) | (byte2 << 16) | (byte1 << 8) | (byte0);
 
@@ -366,15 +503,22 @@ bool USBPDAnalyzer::DetectCRC32(uint32_t* currentCrc) {
   frame.mEndingSampleInclusive = endOfCrc;
   mResults->AddFrame(frame);
 
+  mMessage.crc = crcVal;
+  if (crcVal != *currentCrc) {
+    mMessage.flags |= MessageFlag_CrcError;
+  }
+
   return true;
 }
 
 bool USBPDAnalyzer::DetectEOP() {
-  U64 startOfEop = mSerial->GetSampleNumber();
+  USBPD_PROFILE_SCOPE(ProfileStage_DetectEOP);
+
+  U64 startOfEop = mSerial.GetSampleNumber();
 
   uint8_t kcode = ReadFiveBit();
 
-  U64 endOfEop = mSerial->GetSampleNumber();
+  U64 endOfEop = mSerial.GetSampleNumber();
 
   Frame frame;
   frame.mData1 = (kcode == kcode_map[KCODEType_EOP]);
@@ -385,16 +529,69 @@ bool USBPDAnalyzer::DetectEOP() {
   frame.mEndingSampleInclusive = endOfEop;
   mResults->AddFrame(frame);
 
+  mMessage.endingSample = endOfEop;
+  if (!frame.mData1) {
+    mMessage.flags |= MessageFlag_EopError;
+  }
+
   return true;
 }
 
+// Indexed by DataMessageTypes. Messages without a reader of their own get a frame per data object,
+// described from the message type by the results.
+const USBPDAnalyzer::DataMessageReader USBPDAnalyzer::dataMessageReaders[NUM_DATA_MESSAGE] = {
+    &USBPDAnalyzer::ReadDataObjects,           // Reserved
+    &USBPDAnalyzer::ReadSourceCapabilities,    // Source_Capabilities
+    &USBPDAnalyzer::ReadRequest,               // Request
+    &USBPDAnalyzer::ReadBist,                  // BIST
+    &USBPDAnalyzer::ReadDataObjects,           // Sink_Capabilities
+    &USBPDAnalyzer::ReadDataObjects,           // Battery_Status
+    &USBPDAnalyzer::ReadDataObjects,           // Alert
+    &USBPDAnalyzer::ReadDataObjects,           // Get_Country_Info
+    &USBPDAnalyzer::ReadDataObjects,           // Enter_USB
+    &USBPDAnalyzer::ReadEprRequest,            // EPR_Request
+    &USBPDAnalyzer::ReadEprMode,               // EPR_Mode
+    &USBPDAnalyzer::ReadDataObjects,           // Source_Info
+    &USBPDAnalyzer::ReadDataObjects,           // Revision
+    &USBPDAnalyzer::ReadDataObjects,           // Reserved13
+    &USBPDAnalyzer::ReadDataObjects,           // Reserved14
+    &USBPDAnalyzer::ReadVendorDefinedMessage,  // Vendor_Defined
+};
+
+/**
+ * @brief Read the data objects of a data message without a reader of its own. Each data object
+ * gets a frame carrying the message type and its object position.
+ */
+void USBPDAnalyzer::ReadDataObjects(uint32_t* currentCrc, uint8_t numDataObjects) {
+  USBPD_PROFILE_SCOPE(ProfileStage_ReadDataObjects);
+
+  uint8_t messageType = EXTRACT_BIT_RANGE(mMessage.header, 4, 0);
+
+  for (int i = 0; i < numDataObjects; i++) {
+    U64 startOfDataObject = mSerial.GetSampleNumber();
+    uint32_t dataObject = ReadDataObject(currentCrc, false /* don't add a frame */);
+    U64 endOfDataObject = mSerial.GetSampleNumber();
+
+    Frame frame;
+    frame.mData1 = dataObject;
+    frame.mData2 = messageType | ((U64)(i + 1) << 8);
+    frame.mFlags = 0;
+    frame.mType = FRAME_TYPE_DATA_OBJECT;
+    frame.mStartingSampleInclusive = startOfDataObject;
+    frame.mEndingSampleInclusive = endOfDataObject;
+    mResults->AddFrame(frame);
+  }
+}
+
 void USBPDAnalyzer::ReadSourceCapabilities(uint32_t* currentCrc, uint8_t numDataObjects) {
+  USBPD_PROFILE_SCOPE(ProfileStage_ReadSourceCapabilities);
+
   latestSourceCapabilities.clear();
 
   for (int i = 0; i < numDataObjects; i++) {
-    U64 startOfSourceCapability = mSerial->GetSampleNumber();
+    U64 startOfSourceCapability = mSerial.GetSampleNumber();
     uint32_t pdo = ReadDataObject(currentCrc, false /* don't add a frame */);
-    U64 endOfSourceCapability = mSerial->GetSampleNumber();
+    U64 endOfSourceCapability = mSerial.GetSampleNumber();
 
     Frame frame;
     frame.mData1 = pdo;
@@ -409,22 +606,36 @@ void USBPDAnalyzer::ReadSourceCapabilities(uint32_t* currentCrc, uint8_t numData
   }
 }
 
-void USBPDAnalyzer::ReadRequest(uint32_t* currentCrc) {
-  U64 startOfRequest = mSerial->GetSampleNumber();
+/**
+ * @brief The PDO an RDO refers to in the latest capabilities read, or NULL if there is none
+ */
+const USBPDMessages::SourcePDO* USBPDAnalyzer::FindSourcePdo(uint32_t request) const {
+  // Which PDO are we referring to from the latestPdo vector?
+  // Note: this value starts at 1!! 0 is invalid per the USB-PD spec,
+  // so a value of 1 indicates the first entry in the latestPdo vector
+  uint8_t objectPosition = EXTRACT_BIT_RANGE(request, 31, 28);
+
+  if (objectPosition >= 1 && objectPosition <= latestSourceCapabilities.size()) {
+    return &latestSourceCapabilities[objectPosition - 1];
+  }
+
+  return NULL;
+}
+
+void USBPDAnalyzer::ReadRequest(uint32_t* currentCrc, uint8_t numDataObjects) {
+  USBPD_PROFILE_SCOPE(ProfileStage_ReadRequest);
+
+  U64 startOfRequest = mSerial.GetSampleNumber();
   uint32_t request = ReadDataObject(currentCrc, false /* don't add a frame */);
-  U64 endOfRequest = mSerial->GetSampleNumber();
+  U64 endOfRequest = mSerial.GetSampleNumber();
 
   Frame frame;
   frame.mData1 = request;
 
-  // Which PDO are we referring to from the latestPdo vector?
-  // Note: this value starts at 1!! 0 is invalid per the USB-PD spec,
-  // so a value of 1 indicates the first entry in the latestPdo vector
-  uint8_t objectPosition = EXTRACT_BIT_RANGE(request, 31, 28);
+  const USBPDMessages::SourcePDO* referencedPdo = FindSourcePdo(request);
 
-  if (latestSourceCapabilities.size() > (objectPosition - 1)) {
-    USBPDMessages::SourcePDO& referencedPdo = latestSourceCapabilities[objectPosition - 1];
-    frame.mData2 = referencedPdo.raw;
+  if (referencedPdo != NULL) {
+    frame.mData2 = referencedPdo->raw;
   } else {
     // Don't have a SourcePDO to reference...
     frame.mData2 = 0xFFFFFFFFFFFFFFFF;
@@ -435,33 +646,167 @@ void USBPDAnalyzer::ReadRequest(uint32_t* currentCrc) {
   frame.mStartingSampleInclusive = startOfRequest;
   frame.mEndingSampleInclusive = endOfRequest;
   mResults->AddFrame(frame);
+
+  // A Request has a single RDO, anything after it still has to be read before the CRC
+  for (int i = 1; i < numDataObjects; i++) {
+    ReadDataObject(currentCrc, true /* add a frame */);
+  }
+}
+
+/**
+ * @brief Read an EPR_Request: the RDO, then a copy of the PDO it requests. The RDO is decoded
+ * against the copy, kept in mEprRequestPdo, so it does not depend on the capabilities having been
+ * captured.
+ *
+ * @param currentCrc the current payload CRC. this will be updated ad more Data Objects are read
+ * from the bus.
+ * @param numDataObjects the number of Data Objects identified in the PD Message header
+ */
+void USBPDAnalyzer::ReadEprRequest(uint32_t* currentCrc, uint8_t numDataObjects) {
+  if (numDataObjects < 2) {
+    // No copy of the PDO, decode it as a Request
+    ReadRequest(currentCrc, numDataObjects);
+    return;
+  }
+
+  USBPD_PROFILE_SCOPE(ProfileStage_ReadRequest);
+
+  U64 startOfRequest = mSerial.GetSampleNumber();
+  uint32_t request = ReadDataObject(currentCrc, false /* don't add a frame */);
+  U64 endOfRequest = mSerial.GetSampleNumber();
+
+  U64 startOfPdo = mSerial.GetSampleNumber();
+  mEprRequestPdo = ReadDataObject(currentCrc, false /* don't add a frame */);
+  U64 endOfPdo = mSerial.GetSampleNumber();
+
+  Frame frame;
+  frame.mData1 = request;
+  frame.mData2 = mEprRequestPdo;
+  frame.mFlags = 0;
+  frame.mType = FRAME_TYPE_REQUEST_DATA_OBJECT;
+  frame.mStartingSampleInclusive = startOfRequest;
+  frame.mEndingSampleInclusive = endOfRequest;
+  mResults->AddFrame(frame);
+
+  frame.mData1 = mEprRequestPdo;
+  frame.mData2 = 0;
+  frame.mType = FRAME_TYPE_SOURCE_POWER_DATA_OBJECT;
+  frame.mStartingSampleInclusive = startOfPdo;
+  frame.mEndingSampleInclusive = endOfPdo;
+  mResults->AddFrame(frame);
+
+  for (int i = 2; i < numDataObjects; i++) {
+    ReadDataObject(currentCrc, true /* add a frame */);
+  }
+}
+
+/**
+ * @brief Read the EPR Mode Data Object of an EPR_Mode message
+ *
+ * @param currentCrc the current payload CRC. this will be updated ad more Data Objects are read
+ * from the bus.
+ * @param numDataObjects the number of Data Objects identified in the PD Message header
+ */
+void USBPDAnalyzer::ReadEprMode(uint32_t* currentCrc, uint8_t numDataObjects) {
+  USBPD_PROFILE_SCOPE(ProfileStage_ReadDataObjects);
+
+  U64 startOfEprmdo = mSerial.GetSampleNumber();
+  uint32_t eprmdo = ReadDataObject(currentCrc, false /* don't add a frame */);
+  U64 endOfEprmdo = mSerial.GetSampleNumber();
+
+  Frame frame;
+  frame.mData1 = eprmdo;
+  frame.mData2 = 0;
+  frame.mFlags = 0;
+  frame.mType = FRAME_TYPE_EPR_MODE_DATA_OBJECT;
+  frame.mStartingSampleInclusive = startOfEprmdo;
+  frame.mEndingSampleInclusive = endOfEprmdo;
+  mResults->AddFrame(frame);
+
+  for (int i = 1; i < numDataObjects; i++) {
+    ReadDataObject(currentCrc, true /* add a frame */);
+  }
 }
 
 /**
  * @brief Read the VDO payloads for an ACK'd "DiscoverIdentity" message.
  *
+ * Each VDO gets a frame carrying its kind, so that it can be described on its own. The VDOs are
+ * kept in mIdentityVdos, and added to mIdentities once the message is complete.
+ *
  * @param currentCrc the current payload CRC. this will be updated ad more Data Objects are read
  * from the bus.
  * @param numDataObjects the number of data objects _remaining_ to be read from the DiscoverIdentity
  * message, without including the VDM Header
  * @return uint8_t the number of data objects remaining to be read from the bus. 0 on success,
- * positive values indicate that the DiscoverIdentify payload could not be processed
+ * positive values indicate that the DiscoverIdentify payload could not be processed, or data
+ * objects beyond the Product Type VDOs
  */
 uint8_t USBPDAnalyzer::ReadDiscoverIdentity(uint32_t* currentCrc, uint8_t numDataObjects) {
+  // Every ACK has an ID Header, Cert Stat and Product VDO. The data objects of a shorter one are
+  // read as generic data objects.
   if (numDataObjects < 3) {
-    cout << "Invalid DiscoverIdentity command, must have at least 3 data objects, got " << std::dec << numDataObjects << endl;
+    mMessage.flags |= MessageFlag_ShortIdentity;
     return numDataObjects;
   }
 
-  // Read ID Header VDO
+  // ID Header, Cert Stat and Product VDOs, then 0-3 Product Type VDOs
+  uint8_t numVdos = std::min<uint8_t>(numDataObjects, maxIdentityVdos);
+
+  for (uint8_t i = 0; i < numVdos; i++) {
+    U64 startOfVdo = mSerial.GetSampleNumber();
+    uint32_t vdo = ReadDataObject(currentCrc, false /* don't add a frame */);
+    U64 endOfVdo = mSerial.GetSampleNumber();
 
-  // Read Cert Stat VDO
+    // The kinds of the Product Type VDOs follow from the ID Header, read first
+    mIdentityVdos[i] = vdo;
+    IdentityVdoType type = USBPDIdentities::GetVdoType(mMessage.sop, mIdentityVdos[0], i);
 
-  // Read Product VDO
+    Frame frame;
+    frame.mData1 = vdo | ((U64)type << 32);
+    frame.mData2 = mMessage.sop;
+    frame.mFlags = 0;
+    frame.mType = FRAME_TYPE_IDENTITY_VDO;
+    frame.mStartingSampleInclusive = startOfVdo;
+    frame.mEndingSampleInclusive = endOfVdo;
+    mResults->AddFrame(frame);
+  }
 
-  // Read 0-3 Product Type VDOs
+  mIdentityVdoCount = numVdos;
 
-  return 0;
+  return numDataObjects - numVdos;
+}
+
+/**
+ * @brief Read the VDOs following a structured VDM Header, of the kind given by the decoder for the
+ * SVID and command. Each VDO gets a frame carrying its kind and object position.
+ *
+ * @param numDataObjects the number of data objects remaining, without the VDM Header
+ * @return uint8_t the number of data objects beyond those the decoder knows of, to be read as
+ * generic data objects
+ */
+uint8_t USBPDAnalyzer::ReadVdmDataObjects(uint32_t* currentCrc,
+                                          uint8_t numDataObjects,
+                                          uint16_t svid,
+                                          const USBPDVdm::Decoder& decoder) {
+  uint8_t numVdos = std::min(numDataObjects, decoder.maxVdos);
+
+  for (uint8_t i = 0; i < numVdos; i++) {
+    U64 startOfVdo = mSerial.GetSampleNumber();
+    uint32_t vdo = ReadDataObject(currentCrc, false /* don't add a frame */);
+    U64 endOfVdo = mSerial.GetSampleNumber();
+
+    Frame frame;
+    frame.mData1 = vdo | ((U64)decoder.vdoType << 32) | ((U64)(i + 1) << 40);
+    frame.mData2 = svid;
+    frame.mFlags = 0;
+    frame.mType = FRAME_TYPE_VDM_DATA_OBJECT;
+    frame.mStartingSampleInclusive = startOfVdo;
+    frame.mEndingSampleInclusive = endOfVdo;
+    mResults->AddFrame(frame);
+  }
+
+  return numDataObjects - numVdos;
 }
 
 /**
@@ -472,9 +817,11 @@ uint8_t USBPDAnalyzer::ReadDiscoverIdentity(uint32_t* currentCrc, uint8_t numDat
  * @param numDataObjects the number of Data Objects identified in the PD Message header
  */
 void USBPDAnalyzer::ReadVendorDefinedMessage(uint32_t* currentCrc, uint8_t numDataObjects) {
-  U64 startOfVdmHeader = mSerial->GetSampleNumber();
+  USBPD_PROFILE_SCOPE(ProfileStage_ReadVendorDefinedMessage);
+
+  U64 startOfVdmHeader = mSerial.GetSampleNumber();
   uint32_t vdmHeaderData = ReadDataObject(currentCrc, false /* don't add a frame */);
-  U64 endOfVdmHeader = mSerial->GetSampleNumber();
+  U64 endOfVdmHeader = mSerial.GetSampleNumber();
 
   Frame frame;
   frame.mData1 = vdmHeaderData;
@@ -486,13 +833,415 @@ void USBPDAnalyzer::ReadVendorDefinedMessage(uint32_t* currentCrc, uint8_t numDa
   mResults->AddFrame(frame);
 
   USBPDMessages::VDMHeader vdmHeader(vdmHeaderData);
+  uint8_t remainingDataObjects = numDataObjects - 1;
+  const USBPDVdm::Decoder* decoder = NULL;
+
+  // The VDOs of a structured VDM are decoded by SVID and command, see USBPDVdm
+  if (vdmHeader.type == VDMType_Structured) {
+    const USBPDMessages::StructuredVDM& structured = vdmHeader.structuredData;
+    decoder = USBPDVdm::FindDecoder(vdmHeader.vid, structured.command);
+
+    if (decoder != NULL && !CHECK_BIT(decoder->commandTypes, structured.commandType)) {
+      decoder = NULL;
+    }
+  }
+
+  if (decoder != NULL && decoder->vdoType == VdmVdo_Identity) {
+    remainingDataObjects = ReadDiscoverIdentity(currentCrc, remainingDataObjects);
+  } else if (decoder != NULL) {
+    remainingDataObjects =
+        ReadVdmDataObjects(currentCrc, remainingDataObjects, vdmHeader.vid, *decoder);
+  }
+
+  for (int i = 0; i < remainingDataObjects; i++) {
+    ReadDataObject(currentCrc, true /* add a frame */);
+  }
+}
+
+/**
+ * @brief Read the BIST Data Object of a BIST message. The test data following a BIST Test Data
+ * object only loads the link, so it is read (for the CRC) into a single frame rather than a frame
+ * per data object.
+ *
+ * @param currentCrc the current payload CRC. this will be updated ad more Data Objects are read
+ * from the bus.
+ * @param numDataObjects the number of Data Objects identified in the PD Message header
+ */
+void USBPDAnalyzer::ReadBist(uint32_t* currentCrc, uint8_t numDataObjects) {
+  USBPD_PROFILE_SCOPE(ProfileStage_ReadBist);
+
+  U64 startOfBdo = mSerial.GetSampleNumber();
+  uint32_t bdo = ReadDataObject(currentCrc, false /* don't add a frame */);
+  U64 endOfBdo = mSerial.GetSampleNumber();
+
+  Frame frame;
+  frame.mData1 = bdo;
+  frame.mData2 = 0;
+  frame.mFlags = 0;
+  frame.mType = FRAME_TYPE_BIST_DATA_OBJECT;
+  frame.mStartingSampleInclusive = startOfBdo;
+  frame.mEndingSampleInclusive = endOfBdo;
+  mResults->AddFrame(frame);
+
+  if (numDataObjects < 2) {
+    return;
+  }
+
+  if (EXTRACT_BIT_RANGE(bdo, 31, 28) != BISTMode_TestData) {
+    for (int i = 1; i < numDataObjects; i++) {
+      ReadDataObject(currentCrc, true /* add a frame */);
+    }
+    return;
+  }
+
+  U64 startOfTestData = mSerial.GetSampleNumber();
+  for (int i = 1; i < numDataObjects; i++) {
+    ReadDataObject(currentCrc, false /* don't add a frame */);
+  }
+  U64 endOfTestData = mSerial.GetSampleNumber();
+
+  frame.mData1 = numDataObjects - 1;
+  frame.mType = FRAME_TYPE_BIST_TEST_DATA;
+  frame.mStartingSampleInclusive = startOfTestData;
+  frame.mEndingSampleInclusive = endOfTestData;
+  mResults->AddFrame(frame);
+}
+
+/**
+ * @brief Consume the carrier sent after a BIST Carrier Mode message as a single frame, up to the
+ * first edge after it. Must be called on the first edge of the carrier.
+ *
+ * The carrier is a continuous run of alternating 1s and 0s, which would otherwise be read bit by
+ * bit as one preamble after another, each followed by a SOP error. The edges are only checked for
+ * the idle time ending the carrier: no markers, frames or edge statistics per bit.
+ */
+void USBPDAnalyzer::SkipBistCarrier() {
+  USBPD_PROFILE_SCOPE(ProfileStage_SkipBistCarrier);
 
-  for (int i = 0; i < (numDataObjects - 1); i++) {
-    uint32_t vdo = ReadDataObject(currentCrc, true /* add a frame */);
+  // A full bit is the longest interval in the carrier, the idle time after it is much longer
+  U64 maxInterval = 2 * (mSampleRateHz / mSettings->mBitRate);
+
+  U64 startOfCarrier = mSerial.GetSampleNumber();
+  U64 endOfCarrier = startOfCarrier;
+  U64 edges = 1;
+
+  for (;;) {
+    mSerial.AdvanceToNextEdge();
+    U64 edge = mSerial.GetSampleNumber();
+
+    if (edge - endOfCarrier > maxInterval) {
+      break;
+    }
+
+    endOfCarrier = edge;
+    edges++;
+  }
+
+  // The carrier is a packet of its own
+  CommitPacket();
+
+  Frame frame;
+  frame.mData1 = edges;
+  frame.mData2 = 0;
+  frame.mFlags = 0;
+  frame.mType = FRAME_TYPE_BIST_CARRIER;
+  frame.mStartingSampleInclusive = startOfCarrier;
+  frame.mEndingSampleInclusive = endOfCarrier;
+  mResults->AddFrame(frame);
+
+  mPacketHasFrames = true;
+  CommitPacket();
+
+  mAwaitingGoodCrc = false;
+  mAcknowledged = false;
+
+  mDecodeCacheStart.valid = false;
+
+  mStatistics.SetFilteredPulses(mSerial.GetFilteredPulses());
+  mStatistics.AddBistCarrier(startOfCarrier, endOfCarrier);
+}
+
+/**
+ * @brief Read the extended header and data bytes of an extended message. The bytes are kept in
+ * mExtendedData and passed to mExtendedMessages once the message is complete, to be reassembled.
+ *
+ * A chunk carries up to maxExtendedMsgChunkLen bytes, padded to a whole number of data objects. An
+ * unchunked message carries all of its bytes with no padding.
+ *
+ * @param currentCrc the current payload CRC. this will be updated ad more bytes are read from the
+ * bus.
+ * @param numDataObjects the number of Data Objects identified in the PD Message header
+ */
+void USBPDAnalyzer::ReadExtendedMessage(uint32_t* currentCrc, uint8_t numDataObjects) {
+  USBPD_PROFILE_SCOPE(ProfileStage_ReadExtendedMessage);
+
+  U64 startOfExtendedHeader = mSerial.GetSampleNumber();
+  uint8_t lsb = ReadDecodedByte();
+  uint8_t msb = ReadDecodedByte();
+  U64 endOfExtendedHeader = mSerial.GetSampleNumber();
+
+  mExtendedHeader = (msb << 8) | lsb;
+  *currentCrc = crc32(
+      *currentCrc, (const uint8_t*)&mExtendedHeader, sizeof(uint16_t), usbCrcPolynomial);
+
+  Frame frame;
+  frame.mData1 = mExtendedHeader;
+  frame.mData2 = 0;
+  frame.mFlags = 0;
+  frame.mType = FRAME_TYPE_EXTENDED_HEADER;
+  frame.mStartingSampleInclusive = startOfExtendedHeader;
+  frame.mEndingSampleInclusive = endOfExtendedHeader;
+  mResults->AddFrame(frame);
+
+  bool chunked = CHECK_BIT(mExtendedHeader, 15);
+  uint32_t chunk = EXTRACT_BIT_RANGE(mExtendedHeader, 14, 11);
+  bool requestChunk = CHECK_BIT(mExtendedHeader, 10);
+  uint32_t dataSize = EXTRACT_BIT_RANGE(mExtendedHeader, 8, 0);
+
+  // Bytes following the extended header, and how many of them are data rather than padding
+  uint32_t numBytes;
+  if (chunked) {
+    numBytes = (numDataObjects > 0) ? numDataObjects * 4 - 2 : 0;
+
+    uint32_t chunkOffset = chunk * maxExtendedMsgChunkLen;
+    mExtendedDataBytes =
+        (requestChunk || chunkOffset >= dataSize)
+            ? 0
+            : std::min(std::min(dataSize - chunkOffset, maxExtendedMsgChunkLen), numBytes);
+  } else {
+    numBytes = std::min(dataSize, maxExtendedMsgLen);
+    mExtendedDataBytes = numBytes;
+  }
+
+  U64 startOfData = mSerial.GetSampleNumber();
+  U64 endOfData = startOfData;
+
+  for (uint32_t i = 0; i < numBytes; i++) {
+    uint8_t byte = ReadDecodedByte();
+    *currentCrc = crc32(*currentCrc, &byte, 1, usbCrcPolynomial);
+
+    if (i < mExtendedDataBytes) {
+      mExtendedData[i] = byte;
+      endOfData = mSerial.GetSampleNumber();
+    }
+  }
+
+  // The first 4 bytes, as for the first data object of other messages
+  mMessage.firstDataObject = mExtendedHeader;
+  for (uint32_t i = 0; i < 2 && i < mExtendedDataBytes; i++) {
+    mMessage.firstDataObject |= (uint32_t)mExtendedData[i] << (16 + 8 * i);
+  }
+
+  if (mExtendedDataBytes == 0) {
+    return;
+  }
+
+  // Results look up the reassembled payload by the index this message is about to be added at
+  frame.mData1 = mExtendedHeader | ((U64)mExtendedDataBytes << 16) | ((U64)mMessage.header << 32);
+  frame.mData2 = mMessageIndex.GetNumMessages();
+  frame.mType = FRAME_TYPE_EXTENDED_DATA;
+  frame.mStartingSampleInclusive = startOfData;
+  frame.mEndingSampleInclusive = endOfData;
+  mResults->AddFrame(frame);
+}
+
+/**
+ * @brief Add the frames held back for the current message
+ *
+ * @param newPacket commit the frames of the previous message(s) as a packet first
+ */
+void USBPDAnalyzer::AddPendingFrames(bool newPacket) {
+  if (newPacket) {
+    CommitPacket();
+  }
+
+  for (const Frame& frame : mPendingFrames) {
+    mResults->AddFrame(frame);
+  }
+
+  mPacketHasFrames |= !mPendingFrames.empty();
+  mPendingFrames.clear();
+}
+
+void USBPDAnalyzer::CommitPacket() {
+  if (mPacketHasFrames) {
+    mResults->CommitPacketAndStartNewPacket();
+    mPacketHasFrames = false;
+  }
+}
+
+/**
+ * @brief Called once the current message has been fully decoded (or abandoned after an invalid
+ * SOP)
+ */
+void USBPDAnalyzer::CompleteMessage() {
+  mDecodeCacheStart.valid = false;
+
+  U64 messageIndex = mMessageIndex.GetNumMessages();
+  mMessageIndex.Add(mMessage);
+
+  mStatistics.SetFilteredPulses(mSerial.GetFilteredPulses());
+
+  mStatistics.AddMessage(mMessage, mMessageEdges);
+
+  // The PDO a Request refers to is looked up as in ReadRequest(), an EPR_Request carries a copy
+  const USBPDMessages::SourcePDO* referencedPdo = NULL;
+  USBPDMessages::SourcePDO eprRequestPdo(mEprRequestPdo);
+  uint8_t numDataObjects = EXTRACT_BIT_RANGE(mMessage.header, 14, 12);
+  uint8_t messageType = EXTRACT_BIT_RANGE(mMessage.header, 4, 0);
+  bool extended = CHECK_BIT(mMessage.header, 15);
+
+  if (!extended && numDataObjects > 0) {
+    if (messageType == DataMessage_EPR_Request && numDataObjects >= 2) {
+      referencedPdo = &eprRequestPdo;
+    } else if (messageType == DataMessage_Request || messageType == DataMessage_EPR_Request) {
+      referencedPdo = FindSourcePdo(mMessage.firstDataObject);
+    }
+  }
+
+  mContractTracker.AddMessage(mMessage, referencedPdo);
+  mRoleTracker.AddMessage(mMessage);
+
+  if (mMessage.sop < NUM_SOP_TYPE && extended &&
+      mExtendedMessages.AddMessage(
+          messageIndex, mMessage, mExtendedHeader, mExtendedData, mExtendedDataBytes) &&
+      mMessage.sop == SOPType_SOP && messageType == ExtendedMessage_EPR_Source_Capabilities) {
+    // The EPR capabilities replace the SPR ones. The zero PDOs padding the SPR PDOs are kept, so
+    // that the EPR PDOs stay at their object positions.
+    USBPDExtendedMessages::Payload payload;
+    uint8_t data[maxExtendedMsgLen];
+
+    if (mExtendedMessages.GetPayload(messageIndex, &payload, data)) {
+      USBPDMessages::EPRSourceCapabilities capabilities(data, payload.dataSize);
+      latestSourceCapabilities.assign(capabilities.pdos,
+                                      capabilities.pdos + capabilities.numPdos);
+    }
+  }
+
+  if (mMessage.flags == 0 && mIdentityVdoCount > 0) {
+    mIdentities.AddResponse(mMessage, mIdentityVdos, mIdentityVdoCount);
+  }
+
+  // Messages without a valid SOP have no header to filter on
+  if (mMessage.sop < NUM_SOP_TYPE) {
+    mFilterMatched = mFilter.Evaluate(mMessage, messageIndex, &mFilterMatchedMessage);
+  }
+}
+
+/**
+ * @brief Called once a Hard Reset or Cable Reset has been read in place of a SOP. A reset is not a
+ * message, so it is indexed with the resets of mMessageIndex rather than its messages.
+ */
+void USBPDAnalyzer::CompleteReset() {
+  mDecodeCacheStart.valid = false;
+
+  USBPDResetRecord reset;
+  reset.startingSample = mMessage.startingSample;
+  reset.endingSample = mMessage.endingSample;
+  reset.type = (uint8_t)mOrderedSet;
+  mMessageIndex.AddReset(reset);
+
+  mStatistics.SetFilteredPulses(mSerial.GetFilteredPulses());
+  mStatistics.AddReset(mOrderedSet, mMessage.startingSample, mMessage.endingSample, mMessageEdges);
+
+  // Nothing acknowledges a reset, and nothing else joins its packet
+  mAwaitingGoodCrc = false;
+  mAcknowledged = false;
+  mBistCarrierRequested = false;
+  CommitPacket();
+
+  if (mOrderedSet == OrderedSet_HardReset) {
+    // The contract ends, the Source advertises its capabilities again
+    latestSourceCapabilities.clear();
+    mContractTracker.AddHardReset();
+    mRoleTracker.AddHardReset(mMessage.startingSample);
+  }
+}
+
+/**
+ * @brief Tag a filter match with a frame in the idle time after the message that completed it.
+ * Must be called once the edge ending the message has been consumed.
+ */
+void USBPDAnalyzer::AddFilterMatchFrame() {
+  if (!mFilterMatched) {
+    return;
+  }
+
+  mFilterMatched = false;
+
+  // The next preamble can start on the current edge, so stop one sample before it
+  U64 startOfMatch = mMessage.endingSample + 1;
+  U64 endOfMatch = mSerial.GetSampleNumber() - 1;
+
+  if (endOfMatch < startOfMatch) {
+    return;
   }
+
+  Frame frame;
+  frame.mData1 = mFilter.GetMatchCount();
+  frame.mData2 = mFilterMatchedMessage;
+  frame.mFlags = 0;
+  frame.mType = FRAME_TYPE_FILTER_MATCH;
+  frame.mStartingSampleInclusive = startOfMatch;
+  frame.mEndingSampleInclusive = endOfMatch;
+  mResults->AddFrame(frame);
+}
+
+/**
+ * @brief Match a missing response once its window has passed without an edge, rather than when the
+ * next message shows up. Only while no edge of the next transaction has been consumed, as a
+ * message in progress could still be the response. The match frame is placed at the deadline, or
+ * just after the last edge if that is later.
+ */
+void USBPDAnalyzer::ExpireFilterWindow() {
+  U64 deadline;
+  if (mSerial.GetConsumedEdges() != mIdleEdges || !mFilter.GetResponseDeadline(&deadline)) {
+    return;
+  }
+
+  U64 matchSample = std::max(deadline, mSerial.GetSampleNumber() + 1);
+
+  // Blocks until the capture reaches the deadline, unless an edge arrives before it
+  U64 matchedMessage;
+  if (mSerial.HasEdgeUpTo(matchSample) || !mFilter.Expire(matchSample, &matchedMessage)) {
+    return;
+  }
+
+  // The filter state no longer matches the start of the transaction
+  mDecodeCacheStart.valid = false;
+
+  Frame frame;
+  frame.mData1 = mFilter.GetMatchCount();
+  frame.mData2 = matchedMessage;
+  frame.mFlags = 0;
+  frame.mType = FRAME_TYPE_FILTER_MATCH;
+  frame.mStartingSampleInclusive = matchSample;
+  frame.mEndingSampleInclusive = matchSample;
+  mResults->AddFrame(frame);
+  mResults->CommitResults();
+}
+
+/**
+ * @brief Whether a message asks its receiver to send the BIST carrier
+ */
+static bool IsBistCarrierMode(const USBPDMessageRecord& record) {
+  return (record.flags & messageDamageFlags) == 0 && !CHECK_BIT(record.header, 15) &&
+         EXTRACT_BIT_RANGE(record.header, 14, 12) > 0 &&
+         EXTRACT_BIT_RANGE(record.header, 4, 0) == DataMessage_BIST &&
+         EXTRACT_BIT_RANGE(record.firstDataObject, 31, 28) == BISTMode_CarrierMode;
 }
 
 void USBPDAnalyzer::DetectUSBPDTransaction() {
+  mIdleEdges = mSerial.GetConsumedEdges();
+  MarkDecodeCacheStart(false);
+
+  if (mBistCarrierNext) {
+    // Ends on the first edge after the carrier, as a message would after the edge ending it
+    mBistCarrierNext = false;
+    SkipBistCarrier();
+    return;
+  }
+
   while (true) {
     // This function will consume edges until we find a Preamble
     DetectPreamble();
@@ -500,7 +1249,22 @@ void USBPDAnalyzer::DetectUSBPDTransaction() {
     SOPType sop;
 
     if (!DetectSOP(&sop)) {
+      mMessage.endingSample = mSerial.GetSampleNumber();
+      AddPendingFrames(true);
+
+      if (mOrderedSet == OrderedSet_HardReset || mOrderedSet == OrderedSet_CableReset) {
+        // A reset is sent on its own, the next preamble starts a new message
+        CompleteReset();
+        break;
+      }
+
       // Failed to detect a SOP after the preamble. Return to searching for a preamble
+      mMessage.flags |= MessageFlag_SopError;
+      mAwaitingGoodCrc = false;
+      mBistCarrierRequested = false;
+      CompleteMessage();
+      mIdleEdges = mSerial.GetConsumedEdges();
+      MarkDecodeCacheStart(false);
       continue;
     }
 
@@ -516,24 +1280,13 @@ void USBPDAnalyzer::DetectUSBPDTransaction() {
     // TODO: if numDataObjects is still 0, we can't process a data message (since we need at least
     // one data object)
 
-    switch (dataMessageType) {
-      case DataMessage_Source_Capabilities: {
-        ReadSourceCapabilities(&crc32, numDataObjects);
-      } break;
-
-      case DataMessage_Request: {
-        ReadRequest(&crc32);
-      } break;
-
-      case DataMessage_Vendor_Defined: {
-        ReadVendorDefinedMessage(&crc32, numDataObjects);
-      } break;
-
-      default: {
-        for (int i = 0; i < numDataObjects; i++) {
-          ReadDataObject(&crc32);
-        }
-      } break;
+    if (CHECK_BIT(mMessage.header, 15)) {
+      ReadExtendedMessage(&crc32, numDataObjects);
+    } else if (dataMessageType < NUM_DATA_MESSAGE) {
+      (this->*dataMessageReaders[dataMessageType])(&crc32, numDataObjects);
+    } else {
+      // Control messages have no data objects, reserved data message types beyond the table do
+      ReadDataObjects(&crc32, numDataObjects);
     }
 
     if (!DetectCRC32(&crc32)) {
@@ -546,23 +1299,295 @@ void USBPDAnalyzer::DetectUSBPDTransaction() {
       continue;
     }
 
+    CompleteMessage();
+
+    // The receiver of a BIST Carrier Mode message sends the carrier once it has acknowledged it
+    mBistCarrierNext = mAcknowledged && mBistCarrierRequested;
+    mBistCarrierRequested = !mAcknowledged && IsBistCarrierMode(mMessage);
+
     // Transaciton complete
     break;
   }
 
+  MarkDecodeCacheStart(true);
+  EndTransaction();
+}
+
+/**
+ * @brief Consume the edge ending the transaction, and finish its frames and packet
+ */
+void USBPDAnalyzer::EndTransaction() {
   // PD Spec says that we end each frame with an edge edge... skip past this
   // to cleanup our next set of detections
-  mSerial->AdvanceToNextEdge();
+  mSerial.AdvanceToNextEdge();
+
+  AddFilterMatchFrame();
+
+  // Nothing else joins a message + GoodCRC packet
+  if (mAcknowledged) {
+    CommitPacket();
+  }
+}
+
+/**
+ * @brief Look up the decode cache entry for the capture, and load it if there is one. Otherwise,
+ * arrange for the results to be written to the cache once the decoder has caught up with the
+ * capture.
+ *
+ * @return true if cached results were loaded
+ */
+bool USBPDAnalyzer::LoadOrPrepareDecodeCache() {
+  mSerial.Reset(GetAnalyzerChannelData(mSettings->mInputChannel),
+                GetDecodeCacheSeed(),
+                GetGlitchFilterSamples());
+
+  bool readAll = mSerial.ReadAhead(decodeCachePrefixEdges, &mDecodeCachePrefixKey);
+
+  // Only a capture starting like one in the cache is read ahead in full, to check the rest of it
+  if (mCache.Contains(mDecodeCachePrefixKey)) {
+    U64 key = mDecodeCachePrefixKey;
+    if (!readAll && !mSerial.ReadAhead(decodeCacheMaxEdges, &key)) {
+      // Too large to cache, decode from the read-ahead buffer as usual
+      return false;
+    }
+
+    USBPDDecodeCache::Capture capture;
+    capture.key = key;
+    capture.numEdges = mSerial.GetReadAheadEdges();
+    capture.lastEdge = mSerial.GetReadAheadSampleNumber();
+
+    if (mCache.Load(mDecodeCachePrefixKey,
+                    capture,
+                    mResults.get(),
+                    mSettings->mInputChannel,
+                    &mMessageIndex)) {
+      // Continue from where the cached results end, the edges after that are decoded again
+      mSerial.SkipReadAhead(mDecodeCacheStart.edges);
+      mResults->CommitResults();
+      ReportProgress(mSerial.GetSampleNumber());
+      return true;
+    }
+
+    readAll = true;
+  }
+
+  // Only cache the results once the decoder reaches the end of the edges that are available now,
+  // counted the first time the edges run out if they were not all read ahead. If more data arrives
+  // after that (a capture in progress) the entry no longer matches the capture the next time, so
+  // the capture is cached the next time it is analyzed instead.
+  mSaveDecodeCache = true;
+  mDecodeCacheEdges = readAll ? mSerial.GetReadAheadEdges() : decodeCacheEdgesUnknown;
+
+  return false;
+}
+
+/**
+ * @brief Hash of everything other than the edges that affects the decode: the input channel, bit
+ * rate, glitch filter, filter and sample rate. The simulation settings are left out, so changing
+ * them does not invalidate cached decodes.
+ */
+U64 USBPDAnalyzer::GetDecodeCacheSeed() const {
+  const Channel& channel = mSettings->mInputChannel;
+  const std::string& filter = mSettings->mFilter;
+
+  U64 seed = USBPDDecodeCache::hashSeed;
+  seed = USBPDDecodeCache::HashBytes(seed, &channel.mDeviceId, sizeof(channel.mDeviceId));
+  seed = USBPDDecodeCache::HashBytes(seed, &channel.mChannelIndex, sizeof(channel.mChannelIndex));
+  seed = USBPDDecodeCache::HashBytes(seed, &mSettings->mBitRate, sizeof(mSettings->mBitRate));
+  seed = USBPDDecodeCache::HashBytes(
+      seed, &mSettings->mGlitchFilter_ns, sizeof(mSettings->mGlitchFilter_ns));
+  seed = USBPDDecodeCache::HashBytes(seed, filter.c_str(), filter.size() + 1);
+  seed = USBPDDecodeCache::HashBytes(seed, &mSampleRateHz, sizeof(mSampleRateHz));
+
+  return seed;
+}
+
+/**
+ * @brief Record the decoder state as a transaction, or an attempt at one, starts, or as it ends.
+ * Only needed while the results are to be cached.
+ *
+ * @param ending the transaction is complete, only EndTransaction() is left
+ */
+void USBPDAnalyzer::MarkDecodeCacheStart(bool ending) {
+  if (!mSaveDecodeCache) {
+    return;
+  }
+
+  DecodeCacheStart& start = mDecodeCacheStart;
+  start.edges = mSerial.GetConsumedEdges();
+  start.numFrames = mResults->GetNumFrames();
+  start.numPackets = mResults->GetNumPackets();
+  start.numMarkers = mResults->GetNumMarkers(mSettings->mInputChannel);
+  start.packetHasFrames = mPacketHasFrames;
+  start.awaitingGoodCrc = mAwaitingGoodCrc;
+  start.awaitingGoodCrcSop = mAwaitingGoodCrcSop;
+  start.bistCarrierRequested = mBistCarrierRequested;
+  start.bistCarrierNext = mBistCarrierNext;
+  start.filterMatched = mFilterMatched;
+  start.filterMatchedMessage = mFilterMatchedMessage;
+  start.acknowledged = mAcknowledged;
+  start.messageEnd = mMessage.endingSample;
+  start.ending = ending;
+  start.valid = true;
+}
+
+/**
+ * @brief Narrowest pulse that passes the glitch filter, rounded up to whole samples
+ */
+U64 USBPDAnalyzer::GetGlitchFilterSamples() const {
+  return ((U64)mSettings->mGlitchFilter_ns * mSampleRateHz + 999999999) / 1000000000;
+}
+
+/**
+ * @brief Called when the decoder has caught up with the capture and is about to wait for more data
+ */
+void USBPDAnalyzer::OnDataExhausted() {
+  mStatistics.SetFilteredPulses(mSerial.GetFilteredPulses());
+
+  if (mSaveDecodeCache && mDecodeCacheEdges == decodeCacheEdgesUnknown) {
+    mDecodeCacheEdges = mSerial.GetConsumedEdges();
+
+    // Too large to read ahead when the capture is analyzed again
+    if (mDecodeCacheEdges > decodeCacheMaxEdges) {
+      mSaveDecodeCache = false;
+    }
+  }
+
+  // The results are cached up to the start of the transaction the edges ran out in. They are not
+  // cached if a message has completed since, as the trackers no longer match that point.
+  if (mSaveDecodeCache && mSerial.GetConsumedEdges() == mDecodeCacheEdges &&
+      mDecodeCacheStart.valid) {
+    USBPDDecodeCache::Extent extent;
+    extent.numFrames = mDecodeCacheStart.numFrames;
+    extent.numPackets = mDecodeCacheStart.numPackets;
+    extent.numMarkers = mDecodeCacheStart.numMarkers;
+
+    USBPDDecodeCache::Capture capture;
+    capture.key = mSerial.GetConsumedHash();
+    capture.numEdges = mSerial.GetConsumedEdges();
+    capture.lastEdge = mSerial.GetSampleNumber();
+
+    mResults->CommitResults();
+    mCache.Save(mDecodeCachePrefixKey,
+                capture,
+                mResults.get(),
+                mSettings->mInputChannel,
+                &mMessageIndex,
+                extent);
+  }
+
+#ifdef USBPD_PROFILING
+  // The worker thread never returns, so report whenever it catches up, at most once per second
+  auto time = std::chrono::steady_clock::now();
+  if (time - mLastProfileReport >= std::chrono::seconds(1)) {
+    mLastProfileReport = time;
+    USBPDProfiler::Report();
+  }
+#endif
+
+  // After the results are cached, as it changes the filter state and adds a frame. A cache hit
+  // decodes from the start of the transaction again and gets here the same way.
+  ExpireFilterWindow();
+}
+
+void USBPDAnalyzer::SaveValues(std::vector<U64>* values) {
+  const DecodeCacheStart& start = mDecodeCacheStart;
+
+  values->push_back(start.edges);
+  values->push_back(start.ending);
+  values->push_back(start.packetHasFrames);
+  values->push_back(start.awaitingGoodCrc);
+  values->push_back(start.awaitingGoodCrcSop);
+  values->push_back(start.acknowledged);
+  values->push_back(start.bistCarrierRequested);
+  values->push_back(start.bistCarrierNext);
+  values->push_back(start.filterMatched);
+  values->push_back(start.filterMatchedMessage);
+  values->push_back(start.messageEnd);
+  values->push_back(latestSourceCapabilities.size());
+
+  for (const USBPDMessages::SourcePDO& pdo : latestSourceCapabilities) {
+    values->push_back(pdo.raw);
+  }
+}
+
+bool USBPDAnalyzer::CheckValues(const std::vector<U64>& values) const {
+  return HasRecords(values, decoderHeaderValues, 12, 1) && values[2] <= 1 && values[3] <= 1 &&
+         values[4] <= 1 && values[5] <= NUM_SOP_TYPE && values[6] <= 1 && values[7] <= 1 &&
+         values[8] <= 1 && values[9] <= 1;
+}
+
+void USBPDAnalyzer::LoadValues(const std::vector<U64>& values) {
+  DecodeCacheStart& start = mDecodeCacheStart;
+  start.edges = values[1];
+  start.ending = values[2] != 0;
+
+  mPacketHasFrames = values[3] != 0;
+  mAwaitingGoodCrc = values[4] != 0;
+  mAwaitingGoodCrcSop = (SOPType)values[5];
+  mAcknowledged = values[6] != 0;
+  mBistCarrierRequested = values[7] != 0;
+  mBistCarrierNext = values[8] != 0;
+  mFilterMatched = values[9] != 0;
+  mFilterMatchedMessage = values[10];
+  mMessage.endingSample = values[11];
+
+  latestSourceCapabilities.clear();
+  for (size_t i = decoderHeaderValues; i < values.size(); i++) {
+    latestSourceCapabilities.emplace_back((uint32_t)values[i]);
+  }
 }
 
 void USBPDAnalyzer::WorkerThread() {
   mSampleRateHz = GetSampleRate();
 
-  mSerial = GetAnalyzerChannelData(mSettings->mInputChannel);
+  mMessageIndex.Clear();
+  mStatistics.Clear(mSampleRateHz, mSettings->mBitRate);
+  mContractTracker.Clear(mSampleRateHz);
+  mExtendedMessages.Clear();
+  mIdentities.Clear();
+  mRoleTracker.Clear(mSampleRateHz);
+  mMessageEdges.Clear();
+  latestSourceCapabilities.clear();
+
+  // The filter was validated when the settings were applied
+  std::string filterError;
+  mFilter.Compile(mSettings->mFilter.c_str(), &filterError);
+  mFilter.Reset(mSampleRateHz);
+  mFilterMatched = false;
+  mIdleEdges = UINT64_MAX;  // Until the first transaction starts
+
+  mPendingFrames.clear();
+  mPacketHasFrames = false;
+  mAwaitingGoodCrc = false;
+  mAcknowledged = false;
+  mBistCarrierRequested = false;
+  mBistCarrierNext = false;
+  mSaveDecodeCache = false;
+  mDecodeCacheStart.valid = false;
+
+#ifdef USBPD_PROFILING
+  USBPDProfiler::Reset();
+  mLastProfileReport = std::chrono::steady_clock::time_point();
+#endif
+
+  bool cached = false;
+  if (mSettings->mDecodeCache) {
+    cached = LoadOrPrepareDecodeCache();
+  } else {
+    mSerial.Reset(GetAnalyzerChannelData(mSettings->mInputChannel), 0, GetGlitchFilterSamples());
+  }
+
+  mSerial.SetDataExhaustedCallback([this]() { OnDataExhausted(); });
 
   // Biphase mark coding always starts on a bit-transition
-  // All future functions will expect to start on an edge transition, so go there now
-  mSerial->AdvanceToNextEdge();
+  // All future functions will expect to start on an edge transition, so go there now. Cached
+  // results already end on one, the decoder continues from there.
+  if (!cached) {
+    mSerial.AdvanceToNextEdge();
+  } else if (mDecodeCacheStart.ending) {
+    EndTransaction();
+  }
 
   U32 samples_per_bit = mSampleRateHz / mSettings->mBitRate;
   U32 samples_per_transition =
@@ -579,12 +1604,12 @@ void USBPDAnalyzer::WorkerThread() {
     U8 mask = 1 << 7;
 
     // Sample number for the first edge
-    U64 firstEdgeSampleNumber = mSerial->GetSampleNumber();
+    U64 firstEdgeSampleNumber = mSerial.GetSampleNumber();
 
-    mSerial->AdvanceToNextEdge();
+    mSerial.AdvanceToNextEdge();
 
     // Sample number for the second edge
-    U64 secondEdgeSampleNumber = mSerial->GetSampleNumber();
+    U64 secondEdgeSampleNumber = mSerial.GetSampleNumber();
 
     U64 edgeDelta = (secondEdgeSampleNumber - firstEdgeSampleNumber);
 
@@ -595,8 +1620,8 @@ void USBPDAnalyzer::WorkerThread() {
         data = 1;
 
         // Need to advance to next edge to get to the end of the digit
-        mSerial->AdvanceToNextEdge();
-        secondEdgeSampleNumber = mSerial->GetSampleNumber();
+        mSerial.AdvanceToNextEdge();
+        secondEdgeSampleNumber = mSerial.GetSampleNumber();
     }
 
     // we have a byte to save.
@@ -613,7 +1638,7 @@ void USBPDAnalyzer::WorkerThread() {
     */
 
     mResults->CommitResults();
-    ReportProgress(mSerial->GetSampleNumber());
+    ReportProgress(mSerial.GetSampleNumber());
   }
 }
 
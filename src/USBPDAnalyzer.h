@@ -3,15 +3,26 @@
 
 #include <Analyzer.h>
 
-#include <map>
+#include <chrono>
+#include <vector>
 
 #include "USBPDAnalyzerResults.h"
+#include "USBPDContractTracker.h"
+#include "USBPDDecodeCache.h"
+#include "USBPDEdgeReader.h"
+#include "USBPDExtendedMessages.h"
+#include "USBPDFilter.h"
+#include "USBPDIdentities.h"
+#include "USBPDMessageIndex.h"
+#include "USBPDRoleTracker.h"
 #include "USBPDSimulationDataGenerator.h"
+#include "USBPDStatistics.h"
 #include "USBPDTypes.h"
 #include "USBPDMessages.h"
+#include "USBPDVdm.h"
 
 class USBPDAnalyzerSettings;
-class ANALYZER_EXPORT USBPDAnalyzer : public Analyzer2 {
+class ANALYZER_EXPORT USBPDAnalyzer : public Analyzer2, public USBPDCacheSection {
  public:
   USBPDAnalyzer();
   virtual ~USBPDAnalyzer();
@@ -27,10 +38,27 @@ class ANALYZER_EXPORT USBPDAnalyzer : public Analyzer2 {
   virtual const char* GetAnalyzerName() const;
   virtual bool NeedsRerun();
 
+  USBPDMessageIndex& GetMessageIndex() { return mMessageIndex; }
+  USBPDStatistics& GetStatistics() { return mStatistics; }
+  USBPDContractTracker& GetContractTracker() { return mContractTracker; }
+  USBPDExtendedMessages& GetExtendedMessages() { return mExtendedMessages; }
+  USBPDIdentities& GetIdentities() { return mIdentities; }
+  USBPDRoleTracker& GetRoleTracker() { return mRoleTracker; }
+
+ protected:
+  /**
+   * @brief Save / restore the decoder state at mDecodeCacheStart, for the decode cache
+   */
+  virtual void SaveValues(std::vector<U64>* values);
+  virtual bool CheckValues(const std::vector<U64>& values) const;
+  virtual void LoadValues(const std::vector<U64>& values);
+
  protected:  // vars
   std::auto_ptr<USBPDAnalyzerSettings> mSettings;
   std::auto_ptr<USBPDAnalyzerResults> mResults;
-  AnalyzerChannelData* mSerial;
+  USBPDEdgeReader mSerial;
+
+  USBPDDecodeCache mCache;
 
   USBPDSimulationDataGenerator mSimulationDataGenerator;
   bool mSimulationInitilized;
@@ -40,11 +68,98 @@ class ANALYZER_EXPORT USBPDAnalyzer : public Analyzer2 {
   U32 mStartOfStopBitOffset;
   U32 mEndOfStopBitOffset;
 
-  std::map<uint8_t, uint8_t> fiveToFourBitLUT;
+  // Indexed by the 5-bit code, fiveToFourBitInvalid for codes that are not data symbols
+  uint8_t fiveToFourBitLUT[32];
+  static const uint8_t fiveToFourBitInvalid = 0xFF;
 
+  // Latest Source_Capabilities, or EPR_Source_Capabilities once reassembled, indexed by object
+  // position - 1
   std::vector<USBPDMessages::SourcePDO> latestSourceCapabilities;
+  uint32_t mEprRequestPdo;  // Copy of the PDO carried by the current EPR_Request
+
+  // Message currently being decoded, added to mMessageIndex once complete
+  USBPDMessageRecord mMessage;
+  uint8_t mMessageDataObjects;
+  USBPDMessageIndex mMessageIndex;
+  USBPDStatistics mStatistics;
+  USBPDContractTracker mContractTracker;
+  USBPDExtendedMessages mExtendedMessages;
+  USBPDIdentities mIdentities;
+  USBPDRoleTracker mRoleTracker;
+  USBPDStatistics::EdgeHistogram mMessageEdges;  // Edge intervals of the current message
+
+  USBPDFilter mFilter;
+  bool mFilterMatched;
+  U64 mFilterMatchedMessage;
+
+  // Edges consumed when the decoder last started looking for a transaction. Until more have been
+  // consumed, no message has started since.
+  U64 mIdleEdges;
+
+  // Packets hold a message and the GoodCRC acknowledging it. The preamble and SOP frames are held
+  // back until the header shows whether the message starts a new packet.
+  std::vector<Frame> mPendingFrames;
+  bool mPacketHasFrames;
+  bool mAwaitingGoodCrc;
+  SOPType mAwaitingGoodCrcSop;
+  bool mAcknowledged;  // Current message is the GoodCRC for the previous one
+
+  // Decoded results are saved to the cache once this many edges have been consumed, in the entry
+  // named by the hash of the first edges
+  bool mSaveDecodeCache;
+  U64 mDecodeCacheEdges;
+  U64 mDecodeCachePrefixKey;
+
+  // Decoder state at the start of the latest transaction (or attempt at one), or once it is
+  // complete but for its last edge. The cached results end there, and a cache hit decodes the edges
+  // after it again. Only the state that carries over from one transaction to the next is kept, as
+  // the trackers are only updated once a message is complete.
+  struct DecodeCacheStart {
+    U64 edges;    // Edges consumed
+    bool ending;  // Only EndTransaction() is left
+    U64 numFrames;
+    U64 numPackets;
+    U64 numMarkers;
+    bool packetHasFrames;
+    bool awaitingGoodCrc;
+    SOPType awaitingGoodCrcSop;
+    bool acknowledged;
+    bool bistCarrierRequested;
+    bool bistCarrierNext;
+    bool filterMatched;
+    U64 filterMatchedMessage;
+    U64 messageEnd;  // End of the last message, where a filter match frame starts
+    bool valid;      // No message has completed since
+  };
+  DecodeCacheStart mDecodeCacheStart;
+
+  OrderedSetType mOrderedSet;  // Read after the last preamble
+
+  // A BIST Carrier Mode message is waiting for its GoodCRC, after which the receiver sends the
+  // carrier in place of the next message
+  bool mBistCarrierRequested;
+  bool mBistCarrierNext;
+
+  // Extended header and data bytes of the current message, if it is an extended message
+  uint16_t mExtendedHeader;
+  uint8_t mExtendedData[maxExtendedMsgLen];
+  uint32_t mExtendedDataBytes;
+
+  // VDOs following the VDM Header of the current message, if it is a Discover Identity ACK
+  uint32_t mIdentityVdos[maxIdentityVdos];
+  uint32_t mIdentityVdoCount;
+
+#ifdef USBPD_PROFILING
+  std::chrono::steady_clock::time_point mLastProfileReport;
+#endif
 
  protected:
+  bool LoadOrPrepareDecodeCache();
+  U64 GetDecodeCacheSeed() const;
+  void MarkDecodeCacheStart(bool ending);
+  U64 GetGlitchFilterSamples() const;
+  void OnDataExhausted();
+
   void DetectPreamble();
   bool DetectSOP(SOPType* sop);
   bool DetectHeader(SOPType sop, uint32_t* currentCrc, uint8_t* dataObjects, DataMessageTypes* dataMsgType);
@@ -52,6 +167,14 @@ class ANALYZER_EXPORT USBPDAnalyzer : public Analyzer2 {
   bool DetectEOP();
   bool DetectCRC32(uint32_t* currentCrc);
 
+  void EndTransaction();
+  void AddPendingFrames(bool newPacket);
+  void CommitPacket();
+  void CompleteMessage();
+  void CompleteReset();
+  void AddFilterMatchFrame();
+  void ExpireFilterWindow();
+
   uint8_t ReadFiveBit();
   uint8_t ConvertFiveBitToFourBit(uint8_t fiveBit);
 
@@ -59,13 +182,31 @@ class ANALYZER_EXPORT USBPDAnalyzer : public Analyzer2 {
 
   uint32_t ReadDataObject(uint32_t* currentCrc, bool addFrame = true);
 
+  // Reads the data objects of a data message, see dataMessageReaders
+  typedef void (USBPDAnalyzer::*DataMessageReader)(uint32_t* currentCrc, uint8_t numDataObjects);
+  static const DataMessageReader dataMessageReaders[NUM_DATA_MESSAGE];
+
+  void ReadDataObjects(uint32_t* currentCrc, uint8_t numDataObjects);
+
   void ReadSourceCapabilities(uint32_t* currentCrc, uint8_t numDataObjects);
 
-  void ReadRequest(uint32_t* currentCrc);
+  const USBPDMessages::SourcePDO* FindSourcePdo(uint32_t request) const;
+  void ReadRequest(uint32_t* currentCrc, uint8_t numDataObjects);
+  void ReadEprRequest(uint32_t* currentCrc, uint8_t numDataObjects);
+  void ReadEprMode(uint32_t* currentCrc, uint8_t numDataObjects);
 
   void ReadVendorDefinedMessage(uint32_t* currentCrc, uint8_t numDataObjects);
 
   uint8_t ReadDiscoverIdentity(uint32_t* currentCrc, uint8_t numDataObjects);
+  uint8_t ReadVdmDataObjects(uint32_t* currentCrc,
+                             uint8_t numDataObjects,
+                             uint16_t svid,
+                             const USBPDVdm::Decoder& decoder);
+
+  void ReadBist(uint32_t* currentCrc, uint8_t numDataObjects);
+  void SkipBistCarrier();
+
+  void ReadExtendedMessage(uint32_t* currentCrc, uint8_t numDataObjects);
 
   bool ReadBiphaseMarkCodeBit();
   void DetectUSBPDTransaction();
@@ -2,12 +2,15 @@
 
 #include <AnalyzerHelpers.h>
 
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 
 #include "USBPDAnalyzer.h"
 #include "USBPDAnalyzerSettings.h"
 #include "USBPDMessages.h"
+#include "USBPDProfiler.h"
 
 USBPDAnalyzerResults::USBPDAnalyzerResults(USBPDAnalyzer* analyzer, USBPDAnalyzerSettings* settings)
     : AnalyzerResults(),
@@ -16,9 +19,493 @@ USBPDAnalyzerResults::USBPDAnalyzerResults(USBPDAnalyzer* analyzer, USBPDAnalyze
 
 USBPDAnalyzerResults::~USBPDAnalyzerResults() {}
 
+static const char* ppsTemperatureFlagNames[4] = {
+    "Temp n/a",
+    "Temp normal",
+    "Temp warning",
+    "Over temp",
+};
+
+/**
+ * @brief Describe a source PDO concisely, e.g. "Fixed 5000mV 3000mA"
+ */
+static void DescribeSourcePdo(const USBPDMessages::SourcePDO& pdo, char* text, size_t textSize) {
+  switch (pdo.type) {
+    case PDOType_FixedSupply:
+      snprintf(text,
+               textSize,
+               "Fixed %dmV %dmA",
+               pdo.fixedSupplyPdo.voltage_mV,
+               pdo.fixedSupplyPdo.maxCurrent_mA);
+      break;
+
+    case PDOType_Battery:
+      snprintf(text,
+               textSize,
+               "Battery %d-%dmV %dmW",
+               pdo.batteryPdo.minVoltage_mV,
+               pdo.batteryPdo.maxVoltage_mV,
+               pdo.batteryPdo.maxPower_mW);
+      break;
+
+    case PDOType_VariableSupply:
+      snprintf(text,
+               textSize,
+               "Variable %d-%dmV %dmA",
+               pdo.variableSupplyPdo.minVoltage_mV,
+               pdo.variableSupplyPdo.maxVoltage_mV,
+               pdo.variableSupplyPdo.maxCurrent_mA);
+      break;
+
+    case PDOType_AugmentedPDO:
+      if (pdo.augmentedPdo.type == APDOType_SPRProgrammablePowerSupply) {
+        snprintf(text,
+                 textSize,
+                 "PPS %d-%dmV %dmA",
+                 pdo.augmentedPdo.ppsPdo.minVoltage_mV,
+                 pdo.augmentedPdo.ppsPdo.maxVoltage_mV,
+                 pdo.augmentedPdo.ppsPdo.maxCurrent_mA);
+      } else if (pdo.augmentedPdo.type == APDOType_EPRAdjustableVoltageSupply) {
+        snprintf(text,
+                 textSize,
+                 "AVS %d-%dmV %dmW",
+                 pdo.augmentedPdo.avsPdo.minVoltage_mV,
+                 pdo.augmentedPdo.avsPdo.maxVoltage_mV,
+                 pdo.augmentedPdo.avsPdo.pdpPower_mW);
+      } else {
+        snprintf(text, textSize, "invalid type");
+      }
+      break;
+
+    default:
+      snprintf(text, textSize, "invalid type");
+      break;
+  }
+}
+
+static void DescribeSourceCapabilitiesExtended(const uint8_t* data,
+                                               uint32_t size,
+                                               char* text,
+                                               size_t textSize) {
+  USBPDMessages::SourceCapabilitiesExtended caps(data, size);
+  snprintf(text,
+           textSize,
+           "VID=0x%04X PID=0x%04X XID=0x%08X FW=%u HW=%u PDP=%uW EPR PDP=%uW",
+           caps.vid,
+           caps.pid,
+           caps.xid,
+           caps.fwVersion,
+           caps.hwVersion,
+           caps.sourcePdp_W,
+           caps.eprSourcePdp_W);
+}
+
+static void DescribeStatus(const uint8_t* data, uint32_t size, char* text, size_t textSize) {
+  USBPDMessages::Status status(data, size);
+  snprintf(text,
+           textSize,
+           "Temp=%uC Input=0x%02X Battery Input=0x%02X Events=0x%02X Power=0x%02X",
+           status.internalTemp_C,
+           status.presentInput,
+           status.presentBatteryInput,
+           status.eventFlags,
+           status.powerStatus);
+}
+
+static void DescribePpsStatus(const uint8_t* data, uint32_t size, char* text, size_t textSize) {
+  USBPDMessages::PPSStatus status(data, size);
+  char voltage[32] = "Voltage n/a";
+  char current[32] = "Current n/a";
+
+  if (status.outputVoltageSupported) {
+    snprintf(voltage, sizeof(voltage), "%umV", status.outputVoltage_mV);
+  }
+
+  if (status.outputCurrentSupported) {
+    snprintf(current, sizeof(current), "%umA", status.outputCurrent_mA);
+  }
+
+  snprintf(text,
+           textSize,
+           "%s %s %s%s",
+           voltage,
+           current,
+           ppsTemperatureFlagNames[status.temperatureFlag],
+           status.currentLimitMode ? " Current Limit" : "");
+}
+
+static void DescribeManufacturerInfo(const uint8_t* data,
+                                     uint32_t size,
+                                     char* text,
+                                     size_t textSize) {
+  USBPDMessages::ManufacturerInfo info(data, size);
+  snprintf(text, textSize, "VID=0x%04X PID=0x%04X \"%s\"", info.vid, info.pid, info.string);
+}
+
+static void DescribeEprSourceCapabilities(const uint8_t* data,
+                                          uint32_t size,
+                                          char* text,
+                                          size_t textSize) {
+  // List the PDOs by object position, leaving out the zero PDOs padding the SPR PDOs
+  USBPDMessages::EPRSourceCapabilities capabilities(data, size);
+  uint32_t numPdos = 0;
+
+  for (uint32_t i = 0; i < capabilities.numPdos; i++) {
+    numPdos += (capabilities.pdos[i] != 0) ? 1 : 0;
+  }
+
+  int length = snprintf(text, textSize, "%u PDOs:", numPdos);
+
+  for (uint32_t i = 0; i < capabilities.numPdos && length > 0 && (size_t)length < textSize; i++) {
+    if (capabilities.pdos[i] == 0) {
+      continue;
+    }
+
+    char pdo[64];
+    DescribeSourcePdo(USBPDMessages::SourcePDO(capabilities.pdos[i]), pdo, sizeof(pdo));
+    length += snprintf(text + length,
+                       textSize - length,
+                       "%s #%u %s",
+                       (length > 0 && text[length - 1] != ':') ? "," : "",
+                       i + 1,
+                       pdo);
+  }
+}
+
+static void DescribeFirmwareUpdate(const uint8_t* data,
+                                   uint32_t size,
+                                   char* text,
+                                   size_t textSize) {
+  USBPDMessages::FirmwareUpdateHeader pdfu(data, size);
+  int length = snprintf(text,
+                        textSize,
+                        "PDFU v%u %s %s",
+                        pdfu.protocolVersion,
+                        GetFirmwareUpdateMessageName(pdfu.messageType),
+                        pdfu.request ? "Request" : "Response");
+
+  uint8_t command = pdfu.messageType & ~FirmwareUpdate_Request;
+  if (length > 0 && (size_t)length < textSize &&
+      (command == FirmwareUpdate_PDFU_DATA || command == FirmwareUpdate_PDFU_DATA_NR)) {
+    snprintf(text + length,
+             textSize - length,
+             ", Block %u, %u bytes",
+             pdfu.dataBlockIndex,
+             pdfu.payloadBytes);
+  }
+}
+
+static void DescribePayloadBytes(const uint8_t* data, uint32_t size, char* text, size_t textSize) {
+  // As many bytes as fit
+  int length = snprintf(text, textSize, "%u bytes:", size);
+
+  for (uint32_t i = 0; i < size && length > 0 && (size_t)length + 4 < textSize; i++) {
+    length += snprintf(text + length, textSize - length, " %02X", data[i]);
+  }
+}
+
+typedef void (*ExtendedPayloadFormatter)(const uint8_t* data,
+                                         uint32_t size,
+                                         char* text,
+                                         size_t textSize);
+
+// Indexed by ExtendedMessageTypes, the reserved types beyond the table are described as bytes
+static const ExtendedPayloadFormatter extendedPayloadFormatters[ExtendedMessage_Reserved19] = {
+    DescribePayloadBytes,                // Reserved
+    DescribeSourceCapabilitiesExtended,  // Source_Capabilities_Extended
+    DescribeStatus,                      // Status
+    DescribePayloadBytes,                // Get_Battery_Cap
+    DescribePayloadBytes,                // Get_Battery_Status
+    DescribePayloadBytes,                // Battery_Capabilities
+    DescribePayloadBytes,                // Get_Manufacturer_Info
+    DescribeManufacturerInfo,            // Manufacturer_Info
+    DescribePayloadBytes,                // Security_Request
+    DescribePayloadBytes,                // Security_Response
+    DescribeFirmwareUpdate,              // Firmware_Update_Request
+    DescribeFirmwareUpdate,              // Firmware_Update_Response
+    DescribePpsStatus,                   // PPS_Status
+    DescribePayloadBytes,                // Country_Info
+    DescribePayloadBytes,                // Country_Codes
+    DescribePayloadBytes,                // Sink_Capabilities_Extended
+    DescribePayloadBytes,                // Extended_Control
+    DescribeEprSourceCapabilities,       // EPR_Source_Capabilities
+    DescribePayloadBytes,                // EPR_Sink_Capabilities
+};
+
+/**
+ * @brief Describe a reassembled extended message payload
+ */
+static void DescribeExtendedPayload(uint8_t messageType,
+                                    const uint8_t* data,
+                                    uint32_t size,
+                                    char* text,
+                                    size_t textSize) {
+  ExtendedPayloadFormatter describe = (messageType < ExtendedMessage_Reserved19)
+                                          ? extendedPayloadFormatters[messageType]
+                                          : DescribePayloadBytes;
+  describe(data, size, text, textSize);
+}
+
+static void DescribeSinkPdo(uint32_t dataObject, uint32_t position, char* text, size_t textSize) {
+  // The voltage and current / power fields of a sink PDO are where they are in a source PDO
+  char pdo[64];
+  DescribeSourcePdo(USBPDMessages::SourcePDO(dataObject), pdo, sizeof(pdo));
+  snprintf(text, textSize, "Sink PDO #%u: %s", position, pdo);
+}
+
+static void DescribeBatteryStatus(uint32_t dataObject,
+                                  uint32_t /*position*/,
+                                  char* text,
+                                  size_t textSize) {
+  USBPDMessages::BatteryStatus status(dataObject);
+
+  if (status.invalidReference) {
+    snprintf(text, textSize, "Battery Status: Invalid battery reference");
+  } else if (!status.present) {
+    snprintf(text, textSize, "Battery Status: Not present");
+  } else if (status.presentCapacity_100mWh == 0xFFFF) {
+    snprintf(text,
+             textSize,
+             "Battery Status: Capacity unknown, %s",
+             GetBatteryChargingStatusName(status.chargingStatus));
+  } else {
+    snprintf(text,
+             textSize,
+             "Battery Status: %u.%uWh, %s",
+             status.presentCapacity_100mWh / 10,
+             status.presentCapacity_100mWh % 10,
+             GetBatteryChargingStatusName(status.chargingStatus));
+  }
+}
+
+static void DescribeAlert(uint32_t dataObject, uint32_t /*position*/, char* text, size_t textSize) {
+  // Type of Alert bits 1..7
+  static const char* alertTypeNames[8] = {
+      NULL,
+      "Battery Status Change",
+      "OCP",
+      "OTP",
+      "Operating Condition Change",
+      "Source Input Change",
+      "OVP",
+      "Extended Alert",
+  };
+
+  USBPDMessages::Alert alert(dataObject);
+  int length = snprintf(text, textSize, "Alert:");
+
+  for (int i = 1; i < 8 && length > 0 && (size_t)length < textSize; i++) {
+    if (CHECK_BIT(alert.types, i)) {
+      length += snprintf(text + length,
+                         textSize - length,
+                         "%s %s",
+                         (text[length - 1] != ':') ? "," : "",
+                         alertTypeNames[i]);
+    }
+  }
+
+  if (CHECK_BIT(alert.types, 7) && length > 0 && (size_t)length < textSize) {
+    length += snprintf(text + length,
+                       textSize - length,
+                       " (%s)",
+                       GetExtendedAlertEventName(alert.extendedAlertEvent));
+  }
+
+  if ((alert.fixedBatteries || alert.hotSwappableBatteries) && length > 0 &&
+      (size_t)length < textSize) {
+    snprintf(text + length,
+             textSize - length,
+             ", Fixed Batteries=0x%X, Hot Swappable Batteries=0x%X",
+             alert.fixedBatteries,
+             alert.hotSwappableBatteries);
+  }
+}
+
+static void DescribeCountryCode(uint32_t dataObject,
+                                uint32_t /*position*/,
+                                char* text,
+                                size_t textSize) {
+  USBPDMessages::CountryCode country(dataObject);
+  snprintf(text, textSize, "Country Code: %s", country.code);
+}
+
+static void DescribeEnterUsb(uint32_t dataObject,
+                             uint32_t /*position*/,
+                             char* text,
+                             size_t textSize) {
+  USBPDMessages::EnterUSB enterUsb(dataObject);
+  snprintf(text,
+           textSize,
+           "Enter USB: %s, Cable %s %s %s%s%s%s%s%s%s",
+           GetEnterUSBModeName(enterUsb.usbMode),
+           GetEnterUSBCableSpeedName(enterUsb.cableSpeed),
+           GetEnterUSBCableTypeName(enterUsb.cableType),
+           GetEnterUSBCableCurrentName(enterUsb.cableCurrent),
+           enterUsb.usb4Drd ? ", USB4 DRD" : "",
+           enterUsb.usb3Drd ? ", USB3 DRD" : "",
+           enterUsb.pcieSupport ? ", PCIe" : "",
+           enterUsb.dpSupport ? ", DP" : "",
+           enterUsb.tbtSupport ? ", TBT" : "",
+           enterUsb.hostPresent ? ", Host Present" : "");
+}
+
+static void DescribeSourceInfo(uint32_t dataObject,
+                               uint32_t /*position*/,
+                               char* text,
+                               size_t textSize) {
+  USBPDMessages::SourceInfo info(dataObject);
+  snprintf(text,
+           textSize,
+           "Source Info: %s, Max PDP=%uW, Present PDP=%uW, Reported PDP=%uW",
+           info.guaranteed ? "Guaranteed" : "Managed",
+           info.maximumPdp_W,
+           info.presentPdp_W,
+           info.reportedPdp_W);
+}
+
+static void DescribeRevision(uint32_t dataObject,
+                             uint32_t /*position*/,
+                             char* text,
+                             size_t textSize) {
+  USBPDMessages::Revision revision(dataObject);
+  snprintf(text,
+           textSize,
+           "Revision: PD %u.%u, Version %u.%u",
+           revision.revisionMajor,
+           revision.revisionMinor,
+           revision.versionMajor,
+           revision.versionMinor);
+}
+
+typedef void (*DataObjectFormatter)(uint32_t dataObject,
+                                    uint32_t position,
+                                    char* text,
+                                    size_t textSize);
+
+struct DataObjectFormat {
+  const char* label;  // Short bubble text
+  DataObjectFormatter describe;
+};
+
+// Indexed by DataMessageTypes, for the data objects read by USBPDAnalyzer::ReadDataObjects(). The
+// messages with a reader of their own, and the reserved ones, have no format.
+static const DataObjectFormat dataObjectFormats[NUM_DATA_MESSAGE] = {
+    {NULL, NULL},                            // Reserved
+    {NULL, NULL},                            // Source_Capabilities
+    {NULL, NULL},                            // Request
+    {NULL, NULL},                            // BIST
+    {"Sink PDO", DescribeSinkPdo},           // Sink_Capabilities
+    {"Battery", DescribeBatteryStatus},      // Battery_Status
+    {"Alert", DescribeAlert},                // Alert
+    {"Country", DescribeCountryCode},        // Get_Country_Info
+    {"Enter USB", DescribeEnterUsb},         // Enter_USB
+    {NULL, NULL},                            // EPR_Request
+    {NULL, NULL},                            // EPR_Mode
+    {"Source Info", DescribeSourceInfo},     // Source_Info
+    {"Revision", DescribeRevision},          // Revision
+    {NULL, NULL},                            // Reserved13
+    {NULL, NULL},                            // Reserved14
+    {NULL, NULL},                            // Vendor_Defined
+};
+
+/**
+ * @brief Format of a data object frame, NULL if its message type has none
+ */
+static const DataObjectFormat* GetDataObjectFormat(const Frame& frame) {
+  uint8_t messageType = (uint8_t)frame.mData2;
+
+  if (messageType >= NUM_DATA_MESSAGE || dataObjectFormats[messageType].describe == NULL) {
+    return NULL;
+  }
+
+  return &dataObjectFormats[messageType];
+}
+
+/**
+ * @brief Text of an extended data frame: the reassembled payload if the frame's message completed
+ * one, otherwise where its bytes are in the payload
+ *
+ * @return false if the text may change once the message is added to the index
+ */
+bool USBPDAnalyzerResults::GetExtendedDataText(const Frame& frame, char* text, size_t textSize) {
+  // mData1 holds the extended header, the number of data bytes and the message header, mData2
+  // the message index
+  USBPDMessages::ExtendedHeader extendedHeader((uint16_t)frame.mData1);
+  uint32_t dataBytes = (uint32_t)((frame.mData1 >> 16) & 0xFFFF);
+  uint8_t messageType = (uint8_t)EXTRACT_BIT_RANGE(frame.mData1 >> 32, 4, 0);
+
+  USBPDExtendedMessages::Payload payload;
+  uint8_t data[maxExtendedMsgLen];
+
+  if (mAnalyzer->GetExtendedMessages().GetPayload(frame.mData2, &payload, data)) {
+    DescribeExtendedPayload(messageType, data, payload.dataSize, text, textSize);
+    return true;
+  }
+
+  uint32_t offset = extendedHeader.chunkNumber * maxExtendedMsgChunkLen;
+  snprintf(text,
+           textSize,
+           "Chunk %u, bytes %u..%u of %u",
+           extendedHeader.chunkNumber,
+           offset,
+           offset + dataBytes - 1,
+           extendedHeader.dataSize);
+
+  // Only a message with the last bytes of the payload completes it
+  return extendedHeader.chunked && offset + dataBytes < extendedHeader.dataSize;
+}
+
+/**
+ * @brief Text of an EPR Mode Data Object frame, e.g. "EPR Mode Enter, PDP=140W"
+ */
+static void GetEprModeText(const Frame& frame, char* text, size_t textSize) {
+  USBPDMessages::EPRMode eprMode((uint32_t)frame.mData1);
+  const char* action = GetEPRModeActionName(eprMode.action);
+
+  switch (eprMode.action) {
+    case EPRModeAction_Enter:
+      snprintf(text, textSize, "EPR Mode %s, PDP=%uW", action, eprMode.data);
+      break;
+
+    case EPRModeAction_EnterFailed:
+      snprintf(text, textSize, "EPR Mode %s, %s", action, GetEPRModeFailureName(eprMode.data));
+      break;
+
+    default:
+      snprintf(text, textSize, "EPR Mode %s", action);
+      break;
+  }
+}
+
+/**
+ * @brief Text of a Discover Identity VDO frame, e.g. "Product: PID=0x1234 bcdDevice=0x0100"
+ */
+static void GetIdentityVdoText(const Frame& frame, char* text, size_t textSize) {
+  IdentityVdoType type = (IdentityVdoType)std::min<U64>(frame.mData1 >> 32, IdentityVdo_Unknown);
+  char vdo[160];
+  USBPDIdentities::DescribeVdo(
+      type, (uint8_t)frame.mData2, (uint32_t)frame.mData1, vdo, sizeof(vdo));
+  snprintf(text, textSize, "%s: %s", IdentityVdoTypeNames[type], vdo);
+}
+
+/**
+ * @brief Text of a VDM data object frame, e.g. "DP Status: UFP_D connected, Enabled, HPD High"
+ */
+static void GetVdmDataObjectText(const Frame& frame, char* text, size_t textSize) {
+  VdmVdoType type = (VdmVdoType)std::min<U64>((frame.mData1 >> 32) & 0xFF, NUM_VDM_VDO_TYPE - 1);
+  USBPDVdm::DescribeVdo(type,
+                        (uint16_t)frame.mData2,
+                        (uint32_t)(frame.mData1 >> 40),
+                        (uint32_t)frame.mData1,
+                        text,
+                        textSize);
+}
+
 void USBPDAnalyzerResults::GenerateBubbleText(U64 frame_index,
                                               Channel& channel,
                                               DisplayBase display_base) {
+  USBPD_PROFILE_SCOPE(ProfileStage_GenerateBubbleText);
+
   ClearResultStrings();
   Frame frame = GetFrame(frame_index);
 
@@ -54,11 +541,22 @@ void USBPDAnalyzerResults::GenerateBubbleText(U64 frame_index,
       AddResultString("!!! SOP ERROR !!!");
       break;
 
+    case FRAME_TYPE_HARD_RESET:
+      AddResultString("HR");
+      AddResultString("Hard Reset");
+      break;
+
+    case FRAME_TYPE_CABLE_RESET:
+      AddResultString("CR");
+      AddResultString("Cable Reset");
+      break;
+
     case FRAME_TYPE_HEADER: {
       // Header is a 16 bit number that we will fully store within mData1
-      // Detected SOPType for this transaction is stored in mData2
+      // Detected SOPType for this transaction is stored in mData2, the sender in bits 15..8
 
-      SOPType sop = (SOPType)frame.mData2;
+      SOPType sop = (SOPType)(frame.mData2 & 0xFF);
+      uint8_t sender = (uint8_t)(frame.mData2 >> 8);
       USBPDMessages::Header header(sop, (uint16_t)frame.mData1);
 
       char msgIdString[128];
@@ -71,8 +569,7 @@ void USBPDAnalyzerResults::GenerateBubbleText(U64 frame_index,
             result_str,
             "Header (%s), Msg Source (Port Data Role)=%s, Port Power Role=%s, MsgID=%s, Spec "
             "Rev=%s",
-            header.numberOfDataObjects == 0 ? ControlMessageNames[header.messageType]
-                                            : DataMessageNames[header.messageType],
+            GetMessageTypeName(header.extended, header.numberOfDataObjects, header.messageType),
             (header.portDataRole == PortDataRole_UFP) ? "UFP Port" : "DFP Port",
             (header.portPowerRoleOrCablePlug == PortPowerRole_Source) ? "Source" : "Sink",
             msgIdString,
@@ -86,8 +583,7 @@ void USBPDAnalyzerResults::GenerateBubbleText(U64 frame_index,
         sprintf(
             result_str,
             "Header (%s), Msg Source (Cable Plug)=%s, MsgID=%s, Spec Rev=%s",
-            header.numberOfDataObjects == 0 ? ControlMessageNames[header.messageType]
-                                            : DataMessageNames[header.messageType],
+            GetMessageTypeName(header.extended, header.numberOfDataObjects, header.messageType),
             (header.portPowerRoleOrCablePlug == CablePlug_MsgSrcPort) ? "DFP/UFP Port"
                                                                       : "Cable Plug",
             msgIdString,
@@ -98,6 +594,18 @@ void USBPDAnalyzerResults::GenerateBubbleText(U64 frame_index,
                        : (header.specRev == PDSpecRevision_3P0 ? "PD 3.0" : "Unknown PD Spec")));
       }
 
+      if ((sender & 0x3) != USBPDRoleTracker::Sender_Unknown) {
+        char senderText[64];
+        USBPDRoleTracker::DescribeSender(sender, senderText, sizeof(senderText));
+
+        size_t length = strlen(result_str);
+        snprintf(result_str + length,
+                 sizeof(result_str) - length,
+                 ", Sent by %s%s",
+                 senderText,
+                 (sender & USBPDRoleTracker::SenderFlag_RoleMismatch) ? ", ROLE MISMATCH" : "");
+      }
+
       AddResultString(result_str);
     } break;
 
@@ -307,7 +815,7 @@ void USBPDAnalyzerResults::GenerateBubbleText(U64 frame_index,
 
               case APDOType_EPRAdjustableVoltageSupply: {
                 sprintf(result_str,
-                    "Request - Programmable Power Supply, "
+                    "Request - Adjustable Voltage Supply, "
                     "Capability Mismatch=%s, "
                     "USB Comms Capable=%s, "
                     "No USB Suspend=%s, "
@@ -371,10 +879,10 @@ void USBPDAnalyzerResults::GenerateBubbleText(U64 frame_index,
             "Command Type=%s, "
             "Command=%s",
             header.vid,
-            StructuredVDMVersionNames[header.structuredData.version],
+            GetStructuredVDMVersionName(header.structuredData.version),
             header.structuredData.objectPosition,
             StructuredVDMCommandTypeNames[header.structuredData.commandType],
-            StructuredVDMCommandNames[header.structuredData.command]);
+            USBPDVdm::GetCommandName(header.vid, header.structuredData.command));
 
       } else {
         sprintf(
@@ -396,6 +904,127 @@ void USBPDAnalyzerResults::GenerateBubbleText(U64 frame_index,
       AddResultString("DATA=", dataObject);
     } break;
 
+    case FRAME_TYPE_DATA_OBJECT: {
+      // The data object is stored in mData1, the message type and object position in mData2
+      const DataObjectFormat* format = GetDataObjectFormat(frame);
+      char dataObject[128];
+
+      if (format == NULL) {
+        AnalyzerHelpers::GetNumberString(frame.mData1, display_base, 32, dataObject, 128);
+        AddResultString("DATA=", dataObject);
+      } else {
+        format->describe(
+            (uint32_t)frame.mData1, (uint32_t)(frame.mData2 >> 8), dataObject, sizeof(dataObject));
+        AddResultString(format->label);
+        AddResultString(dataObject);
+      }
+    } break;
+
+    case FRAME_TYPE_BIST_DATA_OBJECT: {
+      // The BIST Data Object is stored in mData1
+      const char* mode = GetBISTModeName(EXTRACT_BIT_RANGE((uint32_t)frame.mData1, 31, 28));
+      AddResultString("BIST");
+      AddResultString("BIST ", mode);
+    } break;
+
+    case FRAME_TYPE_BIST_TEST_DATA: {
+      // Number of test data objects is stored in mData1
+      char count[32];
+      snprintf(count, sizeof(count), "%llu", (unsigned long long)frame.mData1);
+      AddResultString("Test Data");
+      AddResultString("BIST Test Data, ", count, " data objects");
+    } break;
+
+    case FRAME_TYPE_BIST_CARRIER: {
+      // Number of edges in the carrier is stored in mData1
+      char duration[64];
+      snprintf(duration,
+               sizeof(duration),
+               "%.3f ms",
+               1000.0 * (frame.mEndingSampleInclusive - frame.mStartingSampleInclusive) /
+                   mAnalyzer->GetSampleRate());
+      AddResultString("Carrier");
+      AddResultString("BIST Carrier");
+      AddResultString("BIST Carrier, ", duration);
+    } break;
+
+    case FRAME_TYPE_IDENTITY_VDO: {
+      // The VDO is stored in the low 32 bits of mData1 and its kind above it, the SOP in mData2
+      char result_str[256];
+      GetIdentityVdoText(frame, result_str, sizeof(result_str));
+      AddResultString(IdentityVdoTypeNames[std::min<U64>(frame.mData1 >> 32, IdentityVdo_Unknown)]);
+      AddResultString(result_str);
+    } break;
+
+    case FRAME_TYPE_VDM_DATA_OBJECT: {
+      // The VDO is stored in the low 32 bits of mData1, its kind and object position above it, the
+      // SVID in mData2
+      char result_str[256];
+      GetVdmDataObjectText(frame, result_str, sizeof(result_str));
+      AddResultString(VdmVdoTypeNames[std::min<U64>((frame.mData1 >> 32) & 0xFF,
+                                                    NUM_VDM_VDO_TYPE - 1)]);
+      AddResultString(result_str);
+    } break;
+
+    case FRAME_TYPE_EPR_MODE_DATA_OBJECT: {
+      // The EPR Mode Data Object is stored in mData1
+      char result_str[128];
+      GetEprModeText(frame, result_str, sizeof(result_str));
+      AddResultString("EPR");
+      AddResultString("EPR Mode");
+      AddResultString(result_str);
+    } break;
+
+    case FRAME_TYPE_EXTENDED_HEADER: {
+      // Extended header is stored in mData1
+      USBPDMessages::ExtendedHeader header((uint16_t)frame.mData1);
+      char result_str[128];
+
+      if (!header.chunked) {
+        snprintf(result_str, sizeof(result_str), "Unchunked, Data Size=%u", header.dataSize);
+      } else if (header.requestChunk) {
+        snprintf(result_str, sizeof(result_str), "Request Chunk %u", header.chunkNumber);
+      } else {
+        snprintf(result_str,
+                 sizeof(result_str),
+                 "Chunk %u, Data Size=%u",
+                 header.chunkNumber,
+                 header.dataSize);
+      }
+
+      AddResultString("EXT");
+      AddResultString("Ext Header");
+      AddResultString("Ext Header, ", result_str);
+    } break;
+
+    case FRAME_TYPE_EXTENDED_DATA: {
+      char result_str[512];
+      GetExtendedDataText(frame, result_str, sizeof(result_str));
+      AddResultString("Data");
+      AddResultString(result_str);
+    } break;
+
+    case FRAME_TYPE_FILTER_MATCH: {
+      // Running count of matches is stored in mData1, the matched message index in mData2
+      char count[32];
+      snprintf(count, sizeof(count), "%llu", (unsigned long long)frame.mData1);
+
+      // Shortest to longest, the longest string that fits is displayed
+      AddResultString("#", count);
+      AddResultString("Filter match #", count);
+
+      USBPDMessageRecord message;
+      if (mAnalyzer->GetMessageIndex().GetMessage(frame.mData2, &message)) {
+        char time_str[128];
+        AnalyzerHelpers::GetTimeString(message.startingSample,
+                                       mAnalyzer->GetTriggerSample(),
+                                       mAnalyzer->GetSampleRate(),
+                                       time_str,
+                                       128);
+        AddResultString("Filter match #", count, " (message at ", time_str, "s)");
+      }
+    } break;
+
     case FRAME_TYPE_BYTE:
     default:
       AddResultString(number_str);
@@ -403,20 +1032,101 @@ void USBPDAnalyzerResults::GenerateBubbleText(U64 frame_index,
   }
 }
 
+/**
+ * @brief Write the Sender, Power Role and Data Role columns of a USBPDMessageRecord::sender, left
+ * empty when they are not known
+ */
+static void WriteSenderColumns(std::ostream& stream, uint8_t sender) {
+  switch (sender & 0x3) {
+    case USBPDRoleTracker::Sender_PortA:
+    case USBPDRoleTracker::Sender_PortB:
+      stream << (((sender & 0x3) == USBPDRoleTracker::Sender_PortA) ? "Port A," : "Port B,")
+             << ((sender & USBPDRoleTracker::SenderFlag_Source) ? "Source," : "Sink,")
+             << ((sender & USBPDRoleTracker::SenderFlag_DFP) ? "DFP" : "UFP");
+      break;
+
+    case USBPDRoleTracker::Sender_CablePlug:
+      stream << "Cable Plug,,";
+      break;
+
+    default:
+      stream << ",,";
+      break;
+  }
+}
+
 void USBPDAnalyzerResults::GenerateExportFile(const char* file,
                                               DisplayBase display_base,
                                               U32 export_type_user_id) {
+  USBPD_PROFILE_SCOPE(ProfileStage_GenerateExportFile);
+
   std::ofstream file_stream(file, std::ios::out);
 
+  // The statistics, contracts, identities and role timeline exports come from the trackers
+  if (export_type_user_id != 0) {
+    U64 trigger_sample = mAnalyzer->GetTriggerSample();
+
+    switch (export_type_user_id) {
+      case 1:
+        mAnalyzer->GetStatistics().WriteSummary(file_stream);
+        break;
+
+      case 2:
+        mAnalyzer->GetContractTracker().WriteTimeline(file_stream, trigger_sample);
+        break;
+
+      case 3:
+        mAnalyzer->GetIdentities().WriteIdentities(
+            file_stream, trigger_sample, mAnalyzer->GetSampleRate());
+        break;
+
+      case 4:
+        mAnalyzer->GetRoleTracker().WriteTimeline(file_stream, trigger_sample);
+        break;
+
+      default:
+        break;
+    }
+
+    file_stream.close();
+    return;
+  }
+
   U64 trigger_sample = mAnalyzer->GetTriggerSample();
   U32 sample_rate = mAnalyzer->GetSampleRate();
 
-  file_stream << "Time [s],Value" << std::endl;
+  file_stream << "Time [s],Value,Sender,Power Role,Data Role" << std::endl;
+
+  // Sender of the message the frames belong to, from its header frame up to the next SOP or reset
+  uint8_t sender = USBPDRoleTracker::Sender_Unknown;
 
   U64 num_frames = GetNumFrames();
   for (U32 i = 0; i < num_frames; i++) {
     Frame frame = GetFrame(i);
 
+    switch (frame.mType) {
+      case FRAME_TYPE_HEADER:
+        sender = (uint8_t)(frame.mData2 >> 8);
+        break;
+
+      case FRAME_TYPE_PREAMBLE:
+      case FRAME_TYPE_SOP:
+      case FRAME_TYPE_SOP_PRIME:
+      case FRAME_TYPE_SOP_DOUBLE_PRIME:
+      case FRAME_TYPE_SOP_PRIME_DEBUG:
+      case FRAME_TYPE_SOP_DOUBLE_PRIME_DEBUG:
+      case FRAME_TYPE_SOP_ERROR:
+      case FRAME_TYPE_FILTER_MATCH:
+      case FRAME_TYPE_HARD_RESET:
+      case FRAME_TYPE_CABLE_RESET:
+      case FRAME_TYPE_BIST_CARRIER:
+        sender = USBPDRoleTracker::Sender_Unknown;
+        break;
+
+      default:
+        break;
+    }
+
     char time_str[128];
     AnalyzerHelpers::GetTimeString(frame.mStartingSampleInclusive,
                                    trigger_sample,
@@ -427,7 +1137,9 @@ void USBPDAnalyzerResults::GenerateExportFile(const char* file,
     char number_str[128];
     AnalyzerHelpers::GetNumberString(frame.mData1, display_base, 8, number_str, 128);
 
-    file_stream << time_str << "," << number_str << std::endl;
+    file_stream << time_str << "," << number_str << ",";
+    WriteSenderColumns(file_stream, sender);
+    file_stream << std::endl;
 
     if (UpdateExportProgressAndCheckForCancel(i, num_frames) == true) {
       file_stream.close();
@@ -439,21 +1151,414 @@ void USBPDAnalyzerResults::GenerateExportFile(const char* file,
 }
 
 void USBPDAnalyzerResults::GenerateFrameTabularText(U64 frame_index, DisplayBase display_base) {
+  USBPD_PROFILE_SCOPE(ProfileStage_GenerateTabularText);
+
 #ifdef SUPPORTS_PROTOCOL_SEARCH
-  Frame frame = GetFrame(frame_index);
   ClearTabularText();
 
-  char number_str[128];
-  AnalyzerHelpers::GetNumberString(frame.mData1, display_base, 8, number_str, 128);
-  AddTabularText(number_str);
+  std::string text;
+
+  if (!mFrameTextCache.Lookup(frame_index, display_base, &text)) {
+    Frame frame = GetFrame(frame_index);
+
+    if (GetFrameSearchText(frame, display_base, &text)) {
+      mFrameTextCache.Store(frame_index, display_base, text);
+    }
+  }
+
+  AddTabularText(text.c_str());
 #endif
 }
 
 void USBPDAnalyzerResults::GeneratePacketTabularText(U64 packet_id, DisplayBase display_base) {
-  // not supported
+#ifdef SUPPORTS_PROTOCOL_SEARCH
+  ClearTabularText();
+
+  std::string text;
+
+  if (!mPacketTextCache.Lookup(packet_id, display_base, &text)) {
+    U64 firstFrame;
+    U64 lastFrame;
+    GetFramesContainedInPacket(packet_id, &firstFrame, &lastFrame);
+
+    // A packet is a message, optionally followed by the GoodCRC acknowledging it
+    bool cacheable = true;
+    int numHeaders = 0;
+    bool goodCrc = false;
+
+    for (U64 i = firstFrame; i <= lastFrame; i++) {
+      Frame frame = GetFrame(i);
+
+      if (frame.mType == FRAME_TYPE_SOP_ERROR || frame.mType == FRAME_TYPE_HARD_RESET ||
+          frame.mType == FRAME_TYPE_CABLE_RESET || frame.mType == FRAME_TYPE_BIST_CARRIER) {
+        cacheable = GetFrameSearchText(frame, display_base, &text);
+        break;
+      }
+
+      if (frame.mType != FRAME_TYPE_HEADER) {
+        continue;
+      }
+
+      if (numHeaders++ == 0) {
+        cacheable = GetFrameSearchText(frame, display_base, &text);
+        goodCrc = (frame.mData1 & 0xF01F) == ControlMessage_GoodCRC;
+      } else {
+        text += " + GoodCRC";
+      }
+    }
+
+    // A GoodCRC with no message before it is not acknowledged itself
+    if (numHeaders == 1 && !goodCrc) {
+      text += ", no GoodCRC";
+    }
+
+    if (cacheable) {
+      mPacketTextCache.Store(packet_id, display_base, text);
+    }
+  }
+
+  AddTabularText(text.c_str());
+#endif
 }
 
 void USBPDAnalyzerResults::GenerateTransactionTabularText(U64 transaction_id,
                                                           DisplayBase display_base) {
   // not supported
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Concise, searchable text for a frame
+ *
+ * @return true if the text is final and can be cached, false if it depends on a message that has
+ * not been fully decoded yet
+ */
+bool USBPDAnalyzerResults::GetFrameSearchText(const Frame& frame,
+                                              DisplayBase display_base,
+                                              std::string* text) {
+  char result_str[512];
+  bool cacheable = true;
+
+  switch ((FrameType)frame.mType) {
+    case FRAME_TYPE_PREAMBLE:
+      snprintf(result_str, sizeof(result_str), "Preamble");
+      break;
+
+    case FRAME_TYPE_SOP:
+    case FRAME_TYPE_SOP_PRIME:
+    case FRAME_TYPE_SOP_DOUBLE_PRIME:
+    case FRAME_TYPE_SOP_PRIME_DEBUG:
+    case FRAME_TYPE_SOP_DOUBLE_PRIME_DEBUG:
+      snprintf(result_str, sizeof(result_str), "%s", SOPTypeNames[frame.mType - FRAME_TYPE_SOP]);
+      break;
+
+    case FRAME_TYPE_SOP_ERROR: {
+      USBPDMessageIndex& index = mAnalyzer->GetMessageIndex();
+      U64 messageIndex;
+
+      if (!index.FindMessageAt(frame.mStartingSampleInclusive, &messageIndex)) {
+        snprintf(result_str, sizeof(result_str), "SOP ERROR");
+        cacheable = false;
+        break;
+      }
+
+      snprintf(result_str,
+               sizeof(result_str),
+               "SOP ERROR #%llu",
+               (unsigned long long)index.GetOrdinal(
+                   USBPDMessageIndex::Key_Flag, MessageFlag_SopError, messageIndex));
+    } break;
+
+    case FRAME_TYPE_HARD_RESET:
+      snprintf(result_str, sizeof(result_str), "Hard Reset");
+      break;
+
+    case FRAME_TYPE_CABLE_RESET:
+      snprintf(result_str, sizeof(result_str), "Cable Reset");
+      break;
+
+    case FRAME_TYPE_HEADER: {
+      // Number each message among the messages of the same type and SOP, so that the search box
+      // can jump straight to e.g. "DataMessage_Request #500"
+      USBPDMessageIndex& index = mAnalyzer->GetMessageIndex();
+      USBPDMessageRecord message;
+      U64 messageIndex;
+
+      if (!index.FindMessageAt(frame.mStartingSampleInclusive, &messageIndex) ||
+          !index.GetMessage(messageIndex, &message) || message.sop >= NUM_SOP_TYPE) {
+        snprintf(result_str, sizeof(result_str), "Header");
+        cacheable = false;
+        break;
+      }
+
+      USBPDMessages::Header header((SOPType)message.sop, message.header);
+      uint32_t typeValue = USBPDMessageIndex::GetMessageTypeValue(message.header);
+
+      const char* messageName =
+          GetMessageTypeName(header.extended, header.numberOfDataObjects, header.messageType);
+
+      // With the sender, searching for e.g. "Port B (Source" finds what Port B sent as the Source
+      char sender[64] = "";
+      if ((message.sender & 0x3) != USBPDRoleTracker::Sender_Unknown) {
+        sender[0] = ',';
+        sender[1] = ' ';
+        USBPDRoleTracker::DescribeSender(message.sender, sender + 2, sizeof(sender) - 2);
+      }
+
+      snprintf(result_str,
+               sizeof(result_str),
+               "%s %s #%llu, %s #%llu, MsgID=%d%s%s%s%s",
+               SOPTypeNames[message.sop],
+               messageName,
+               (unsigned long long)index.GetOrdinal(
+                   USBPDMessageIndex::Key_MessageType, typeValue, messageIndex),
+               SOPTypeNames[message.sop],
+               (unsigned long long)index.GetOrdinal(
+                   USBPDMessageIndex::Key_SOP, message.sop, messageIndex),
+               header.messageId,
+               sender,
+               (message.sender & USBPDRoleTracker::SenderFlag_RoleMismatch) ? ", ROLE MISMATCH"
+                                                                            : "",
+               (message.flags & MessageFlag_CrcError) ? ", CRC ERROR" : "",
+               (message.flags & MessageFlag_ShortIdentity) ? ", SHORT IDENTITY ACK" : "");
+    } break;
+
+    case FRAME_TYPE_CRC32: {
+      // Received CRC32 is passed in mData1, calculated CRC32 in mData2
+      char received[128];
+      AnalyzerHelpers::GetNumberString(frame.mData1, display_base, 32, received, 128);
+
+      if (frame.mData1 == frame.mData2) {
+        snprintf(result_str, sizeof(result_str), "CRC=%s", received);
+      } else {
+        char calculated[128];
+        AnalyzerHelpers::GetNumberString(frame.mData2, display_base, 32, calculated, 128);
+        snprintf(
+            result_str, sizeof(result_str), "CRC=%s CRC ERROR, expected %s", received, calculated);
+      }
+    } break;
+
+    case FRAME_TYPE_EOP:
+      snprintf(result_str, sizeof(result_str), "%s", frame.mData1 ? "EOP" : "EOP ERROR");
+      break;
+
+    case FRAME_TYPE_SOURCE_POWER_DATA_OBJECT: {
+      USBPDMessages::SourcePDO pdo(frame.mData1);
+      char description[128];
+      DescribeSourcePdo(pdo, description, sizeof(description));
+      snprintf(result_str,
+               sizeof(result_str),
+               "%s %s",
+               pdo.type == PDOType_AugmentedPDO ? "APDO" : "PDO",
+               description);
+    } break;
+
+    case FRAME_TYPE_REQUEST_DATA_OBJECT: {
+      // RDO is passed in via mData1
+      // The referenced PDO is passed in via mData2, or MAX_UINT64 if invalid reference
+      unsigned objectPosition = EXTRACT_BIT_RANGE(frame.mData1, 31, 28);
+
+      if (frame.mData2 == 0xFFFFFFFFFFFFFFFF) {
+        snprintf(result_str, sizeof(result_str), "RDO #%u invalid PDO", objectPosition);
+        break;
+      }
+
+      USBPDMessages::SourcePDO pdo(frame.mData2);
+      USBPDMessages::Request request(pdo, frame.mData1);
+
+      switch (request.type) {
+        case PDOType_FixedSupply:
+          snprintf(result_str,
+                   sizeof(result_str),
+                   "RDO #%u Fixed %dmV %dmA",
+                   objectPosition,
+                   pdo.fixedSupplyPdo.voltage_mV,
+                   request.fixedSupplyRequest.operatingCurrent_mA);
+          break;
+
+        case PDOType_Battery:
+          snprintf(result_str,
+                   sizeof(result_str),
+                   "RDO #%u Battery %dmW",
+                   objectPosition,
+                   request.batterySupplyRequest.operatingPower_mW);
+          break;
+
+        case PDOType_VariableSupply:
+          snprintf(result_str,
+                   sizeof(result_str),
+                   "RDO #%u Variable %dmA",
+                   objectPosition,
+                   request.variableSupplyRequest.operatingCurrent_mA);
+          break;
+
+        case PDOType_AugmentedPDO:
+          if (pdo.augmentedPdo.type == APDOType_SPRProgrammablePowerSupply) {
+            snprintf(result_str,
+                     sizeof(result_str),
+                     "RDO #%u PPS %dmV %dmA",
+                     objectPosition,
+                     request.ppsRequest.outputVoltage_mV,
+                     request.ppsRequest.operatingCurrent_mA);
+          } else if (pdo.augmentedPdo.type == APDOType_EPRAdjustableVoltageSupply) {
+            snprintf(result_str,
+                     sizeof(result_str),
+                     "RDO #%u AVS %dmV %dmA",
+                     objectPosition,
+                     request.avsRequest.outputVoltage_mV,
+                     request.avsRequest.operatingCurrent_mA);
+          } else {
+            snprintf(result_str, sizeof(result_str), "RDO #%u invalid APDO", objectPosition);
+          }
+          break;
+
+        default:
+          snprintf(result_str, sizeof(result_str), "RDO #%u invalid PDO", objectPosition);
+          break;
+      }
+    } break;
+
+    case FRAME_TYPE_VDM_HEADER: {
+      USBPDMessages::VDMHeader header((uint32_t)frame.mData1);
+
+      if (header.type == VDMType_Structured) {
+        // Commands other than the Discover ones address a mode by its object position, 7 being
+        // all modes for Exit Mode
+        const USBPDMessages::StructuredVDM& structured = header.structuredData;
+        char mode[16] = "";
+
+        if (structured.command == StructuredVDMCommand_ExitMode && structured.objectPosition == 7) {
+          snprintf(mode, sizeof(mode), " All Modes");
+        } else if (structured.objectPosition != 0) {
+          snprintf(mode, sizeof(mode), " Mode %u", structured.objectPosition);
+        }
+
+        snprintf(result_str,
+                 sizeof(result_str),
+                 "VDM SVID=0x%04X %s %s%s",
+                 header.vid,
+                 USBPDVdm::GetCommandName(header.vid, structured.command),
+                 StructuredVDMCommandTypeNames[structured.commandType],
+                 mode);
+      } else {
+        snprintf(result_str,
+                 sizeof(result_str),
+                 "VDM VID=0x%04X Unstructured 0x%04X",
+                 header.vid,
+                 header.unstructuredData);
+      }
+    } break;
+
+    case FRAME_TYPE_GENERIC_DATA_OBJECT: {
+      char dataObject[128];
+      AnalyzerHelpers::GetNumberString(frame.mData1, display_base, 32, dataObject, 128);
+      snprintf(result_str, sizeof(result_str), "DATA=%s", dataObject);
+    } break;
+
+    case FRAME_TYPE_DATA_OBJECT: {
+      const DataObjectFormat* format = GetDataObjectFormat(frame);
+
+      if (format == NULL) {
+        char dataObject[128];
+        AnalyzerHelpers::GetNumberString(frame.mData1, display_base, 32, dataObject, 128);
+        snprintf(result_str, sizeof(result_str), "DATA=%s", dataObject);
+      } else {
+        format->describe((uint32_t)frame.mData1,
+                         (uint32_t)(frame.mData2 >> 8),
+                         result_str,
+                         sizeof(result_str));
+      }
+    } break;
+
+    case FRAME_TYPE_BIST_DATA_OBJECT:
+      snprintf(result_str,
+               sizeof(result_str),
+               "BIST %s",
+               GetBISTModeName(EXTRACT_BIT_RANGE((uint32_t)frame.mData1, 31, 28)));
+      break;
+
+    case FRAME_TYPE_BIST_TEST_DATA:
+      snprintf(result_str, sizeof(result_str), "BIST Test Data");
+      break;
+
+    case FRAME_TYPE_BIST_CARRIER:
+      snprintf(result_str,
+               sizeof(result_str),
+               "BIST Carrier %.3f ms",
+               1000.0 * (frame.mEndingSampleInclusive - frame.mStartingSampleInclusive) /
+                   mAnalyzer->GetSampleRate());
+      break;
+
+    case FRAME_TYPE_IDENTITY_VDO:
+      GetIdentityVdoText(frame, result_str, sizeof(result_str));
+      break;
+
+    case FRAME_TYPE_VDM_DATA_OBJECT:
+      GetVdmDataObjectText(frame, result_str, sizeof(result_str));
+      break;
+
+    case FRAME_TYPE_EPR_MODE_DATA_OBJECT:
+      GetEprModeText(frame, result_str, sizeof(result_str));
+      break;
+
+    case FRAME_TYPE_EXTENDED_HEADER: {
+      USBPDMessages::ExtendedHeader header((uint16_t)frame.mData1);
+
+      if (!header.chunked) {
+        snprintf(result_str, sizeof(result_str), "EXT Unchunked %u bytes", header.dataSize);
+      } else if (header.requestChunk) {
+        snprintf(result_str, sizeof(result_str), "EXT Request Chunk %u", header.chunkNumber);
+      } else {
+        snprintf(result_str,
+                 sizeof(result_str),
+                 "EXT Chunk %u of %u bytes",
+                 header.chunkNumber,
+                 header.dataSize);
+      }
+    } break;
+
+    case FRAME_TYPE_EXTENDED_DATA:
+      cacheable = GetExtendedDataText(frame, result_str, sizeof(result_str));
+      break;
+
+    case FRAME_TYPE_FILTER_MATCH:
+      snprintf(
+          result_str, sizeof(result_str), "FILTER MATCH #%llu", (unsigned long long)frame.mData1);
+      break;
+
+    case FRAME_TYPE_BYTE:
+    default:
+      AnalyzerHelpers::GetNumberString(frame.mData1, display_base, 8, result_str, 128);
+      break;
+  }
+
+  *text = result_str;
+  return cacheable;
+}
+
+USBPDAnalyzerResults::SearchTextCache::SearchTextCache() : mEntries(searchTextCacheSize) {}
+
+bool USBPDAnalyzerResults::SearchTextCache::Lookup(U64 index,
+                                                   DisplayBase displayBase,
+                                                   std::string* text) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  const Entry& entry = mEntries[index % mEntries.size()];
+  if (!entry.valid || entry.index != index || entry.displayBase != displayBase) {
+    return false;
+  }
+
+  *text = entry.text;
+  return true;
+}
+
+void USBPDAnalyzerResults::SearchTextCache::Store(U64 index,
+                                                  DisplayBase displayBase,
+                                                  const std::string& text) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  Entry& entry = mEntries[index % mEntries.size()];
+  entry.valid = true;
+  entry.index = index;
+  entry.displayBase = displayBase;
+  entry.text = text;
+}
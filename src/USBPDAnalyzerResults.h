@@ -3,6 +3,10 @@
 
 #include <AnalyzerResults.h>
 
+#include <mutex>
+#include <string>
+#include <vector>
+
 class USBPDAnalyzer;
 class USBPDAnalyzerSettings;
 
@@ -21,9 +25,42 @@ class USBPDAnalyzerResults : public AnalyzerResults {
   virtual void GenerateTransactionTabularText(U64 transaction_id, DisplayBase display_base);
 
  protected:  // functions
+  bool GetFrameSearchText(const Frame& frame, DisplayBase display_base, std::string* text);
+  bool GetExtendedDataText(const Frame& frame, char* text, size_t textSize);
+
  protected:  // vars
+  /**
+   * @brief Direct-mapped cache of generated tabular text, so that repeated searches over a long
+   * capture don't regenerate the text for every frame. Indices are frame or packet indices.
+   */
+  class SearchTextCache {
+   public:
+    SearchTextCache();
+
+    bool Lookup(U64 index, DisplayBase displayBase, std::string* text);
+    void Store(U64 index, DisplayBase displayBase, const std::string& text);
+
+   protected:
+    static const size_t searchTextCacheSize = 4096;
+
+    struct Entry {
+      Entry() : valid(false), index(0), displayBase(Decimal) {}
+
+      bool valid;
+      U64 index;
+      DisplayBase displayBase;
+      std::string text;
+    };
+
+    std::mutex mMutex;
+    std::vector<Entry> mEntries;
+  };
+
   USBPDAnalyzerSettings* mSettings;
   USBPDAnalyzer* mAnalyzer;
+
+  SearchTextCache mFrameTextCache;
+  SearchTextCache mPacketTextCache;
 };
 
 #endif  // USBPD_ANALYZER_RESULTS
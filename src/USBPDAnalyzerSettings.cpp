@@ -2,7 +2,25 @@
 
 #include <AnalyzerHelpers.h>
 
-USBPDAnalyzerSettings::USBPDAnalyzerSettings() : mInputChannel(UNDEFINED_CHANNEL), mBitRate(9600) {
+#include "USBPDFilter.h"
+#include "USBPDScenario.h"
+
+USBPDAnalyzerSettings::USBPDAnalyzerSettings()
+    : mInputChannel(UNDEFINED_CHANNEL),
+      mBitRate(9600),
+      mGlitchFilter_ns(0),
+      mDecodeCache(false),
+      mSimulationTraffic(SimulationTraffic_Ping),
+      mSimulationRate(100),
+      mSimulationSeed(0),
+      mClockOffset_ppm(0),
+      mClockDrift_ppm(0),
+      mRandomJitter_ns(0),
+      mDeterministicJitter_ns(0),
+      mGlitchRate(0),
+      mDroppedEdgeRate(0),
+      mSymbolErrorRate(0),
+      mCrcErrorRate(0) {
   mInputChannelInterface.reset(new AnalyzerSettingInterfaceChannel());
   mInputChannelInterface->SetTitleAndTooltip("Serial", "Standard USB Power Delivery (CC)");
   mInputChannelInterface->SetChannel(mInputChannel);
@@ -14,13 +32,181 @@ USBPDAnalyzerSettings::USBPDAnalyzerSettings() : mInputChannel(UNDEFINED_CHANNEL
   mBitRateInterface->SetMin(1);
   mBitRateInterface->SetInteger(mBitRate);
 
+  mGlitchFilterInterface.reset(new AnalyzerSettingInterfaceInteger());
+  mGlitchFilterInterface->SetTitleAndTooltip(
+      "Glitch Filter (ns)",
+      "Remove pulses narrower than this before decoding, 0 to disable. Must be well below half a "
+      "bit period (1.67 us at 300 kbps).");
+  mGlitchFilterInterface->SetMax(100000);
+  mGlitchFilterInterface->SetMin(0);
+  mGlitchFilterInterface->SetInteger(mGlitchFilter_ns);
+
+  mDecodeCacheInterface.reset(new AnalyzerSettingInterfaceBool());
+  mDecodeCacheInterface->SetTitleAndTooltip(
+      "Decode Cache",
+      "Store decoded results on disk, and load them instead of decoding again when the same "
+      "capture is analyzed with the same decoder settings.");
+  mDecodeCacheInterface->SetCheckBoxText("Cache decoded results");
+  mDecodeCacheInterface->SetValue(mDecodeCache);
+
+  mFilterInterface.reset(new AnalyzerSettingInterfaceText());
+  mFilterInterface->SetTitleAndTooltip(
+      "Filter",
+      "Mark messages matching an expression, e.g. \"sop==SOP' && type==VDM && "
+      "vdm.cmd==DiscoverIdentity\" or \"port==B && PR_Swap\", or a sequence, e.g. \"Request -> "
+      "!Accept within 30ms\". Leave empty to disable.");
+  mFilterInterface->SetText(mFilter.c_str());
+
+  mSimulationTrafficInterface.reset(new AnalyzerSettingInterfaceNumberList());
+  mSimulationTrafficInterface->SetTitleAndTooltip("Simulation Traffic",
+                                                  "Traffic generated in simulation mode.");
+  mSimulationTrafficInterface->AddNumber(
+      SimulationTraffic_Ping, "Ping on every SOP", "Ping + GoodCRC on SOP, SOP' and SOP\".");
+  mSimulationTrafficInterface->AddNumber(
+      SimulationTraffic_Session,
+      "PD session (balanced)",
+      "Contract negotiation and discovery, followed by a mix of Pings, renegotiations, PPS "
+      "requests and VDMs.");
+  mSimulationTrafficInterface->AddNumber(
+      SimulationTraffic_SessionVdm,
+      "PD session (VDM heavy)",
+      "Contract negotiation and discovery, followed by mostly Discover Identity, SVIDs and "
+      "Modes.");
+  mSimulationTrafficInterface->AddNumber(
+      SimulationTraffic_SessionPower,
+      "PD session (power heavy)",
+      "Contract negotiation and discovery, followed by mostly renegotiations and PPS requests.");
+  mSimulationTrafficInterface->AddNumber(
+      SimulationTraffic_Scenario, "Scenario file", "Messages from the scenario file, repeated.");
+  mSimulationTrafficInterface->SetNumber(mSimulationTraffic);
+
+  mSimulationRateInterface.reset(new AnalyzerSettingInterfaceInteger());
+  mSimulationRateInterface->SetTitleAndTooltip(
+      "Simulation Rate (Exchanges/S)",
+      "Average number of message exchanges per second in the simulated PD session. 0 leaves "
+      "only the periodic PPS requests.");
+  mSimulationRateInterface->SetMax(10000);
+  mSimulationRateInterface->SetMin(0);
+  mSimulationRateInterface->SetInteger(mSimulationRate);
+
+  mScenarioFileInterface.reset(new AnalyzerSettingInterfaceText());
+  mScenarioFileInterface->SetTitleAndTooltip(
+      "Simulation Scenario",
+      "Text file with the messages to simulate, one per line: sender (dfp, ufp or cable), SOP, "
+      "message type and data objects, e.g. \"ufp SOP Request 0x2202D12C\", or a delay, e.g. "
+      "\"wait 30ms\". Used when Simulation Traffic is set to Scenario file.");
+  mScenarioFileInterface->SetTextType(AnalyzerSettingInterfaceText::FilePath);
+  mScenarioFileInterface->SetText(mScenarioFile.c_str());
+
+  mSimulationSeedInterface.reset(new AnalyzerSettingInterfaceInteger());
+  mSimulationSeedInterface->SetTitleAndTooltip(
+      "Simulation Seed",
+      "Seed for the simulated traffic mix and impairments. The same seed and settings always "
+      "produce the same capture.");
+  mSimulationSeedInterface->SetMax(0x7FFFFFFF);
+  mSimulationSeedInterface->SetMin(0);
+  mSimulationSeedInterface->SetInteger(mSimulationSeed);
+
+  mClockOffsetInterface.reset(new AnalyzerSettingInterfaceInteger());
+  mClockOffsetInterface->SetTitleAndTooltip(
+      "Simulation Clock Offset (ppm)",
+      "Error of the simulated transmitter's bit clock. PD allows +/-10% (100000 ppm).");
+  mClockOffsetInterface->SetMax(500000);
+  mClockOffsetInterface->SetMin(-500000);
+  mClockOffsetInterface->SetInteger(mClockOffset_ppm);
+
+  mClockDriftInterface.reset(new AnalyzerSettingInterfaceInteger());
+  mClockDriftInterface->SetTitleAndTooltip(
+      "Simulation Clock Drift (ppm/s)",
+      "Change of the simulated clock error over time, added to the clock offset. The total "
+      "error is limited to +/-50%.");
+  mClockDriftInterface->SetMax(500000);
+  mClockDriftInterface->SetMin(-500000);
+  mClockDriftInterface->SetInteger(mClockDrift_ppm);
+
+  mRandomJitterInterface.reset(new AnalyzerSettingInterfaceInteger());
+  mRandomJitterInterface->SetTitleAndTooltip("Simulation Random Jitter (ns RMS)",
+                                             "Gaussian jitter added to every simulated edge.");
+  mRandomJitterInterface->SetMax(1000000);
+  mRandomJitterInterface->SetMin(0);
+  mRandomJitterInterface->SetInteger(mRandomJitter_ns);
+
+  mDeterministicJitterInterface.reset(new AnalyzerSettingInterfaceInteger());
+  mDeterministicJitterInterface->SetTitleAndTooltip(
+      "Simulation Deterministic Jitter (ns)",
+      "Duty cycle distortion of the simulated signal: rising edges are early and falling edges "
+      "late by half this amount.");
+  mDeterministicJitterInterface->SetMax(1000000);
+  mDeterministicJitterInterface->SetMin(0);
+  mDeterministicJitterInterface->SetInteger(mDeterministicJitter_ns);
+
+  mGlitchRateInterface.reset(new AnalyzerSettingInterfaceInteger());
+  mGlitchRateInterface->SetTitleAndTooltip(
+      "Simulation Glitches (per 1000 Msgs)",
+      "Number of simulated messages out of 1000 with a short glitch pulse.");
+  mGlitchRateInterface->SetMax(1000);
+  mGlitchRateInterface->SetMin(0);
+  mGlitchRateInterface->SetInteger(mGlitchRate);
+
+  mDroppedEdgeRateInterface.reset(new AnalyzerSettingInterfaceInteger());
+  mDroppedEdgeRateInterface->SetTitleAndTooltip(
+      "Simulation Dropped First Edge (per 1000 Msgs)",
+      "Number of simulated messages out of 1000 missing the first edge of the preamble.");
+  mDroppedEdgeRateInterface->SetMax(1000);
+  mDroppedEdgeRateInterface->SetMin(0);
+  mDroppedEdgeRateInterface->SetInteger(mDroppedEdgeRate);
+
+  mSymbolErrorRateInterface.reset(new AnalyzerSettingInterfaceInteger());
+  mSymbolErrorRateInterface->SetTitleAndTooltip(
+      "Simulation Corrupted Symbols (per 1000 Msgs)",
+      "Number of simulated messages out of 1000 with an invalid 5b symbol.");
+  mSymbolErrorRateInterface->SetMax(1000);
+  mSymbolErrorRateInterface->SetMin(0);
+  mSymbolErrorRateInterface->SetInteger(mSymbolErrorRate);
+
+  mCrcErrorRateInterface.reset(new AnalyzerSettingInterfaceInteger());
+  mCrcErrorRateInterface->SetTitleAndTooltip(
+      "Simulation CRC Errors (per 1000 Msgs)",
+      "Number of simulated messages out of 1000 with a wrong CRC.");
+  mCrcErrorRateInterface->SetMax(1000);
+  mCrcErrorRateInterface->SetMin(0);
+  mCrcErrorRateInterface->SetInteger(mCrcErrorRate);
+
   AddInterface(mInputChannelInterface.get());
   AddInterface(mBitRateInterface.get());
+  AddInterface(mGlitchFilterInterface.get());
+  AddInterface(mDecodeCacheInterface.get());
+  AddInterface(mFilterInterface.get());
+  AddInterface(mSimulationTrafficInterface.get());
+  AddInterface(mSimulationRateInterface.get());
+  AddInterface(mScenarioFileInterface.get());
+  AddInterface(mSimulationSeedInterface.get());
+  AddInterface(mClockOffsetInterface.get());
+  AddInterface(mClockDriftInterface.get());
+  AddInterface(mRandomJitterInterface.get());
+  AddInterface(mDeterministicJitterInterface.get());
+  AddInterface(mGlitchRateInterface.get());
+  AddInterface(mDroppedEdgeRateInterface.get());
+  AddInterface(mSymbolErrorRateInterface.get());
+  AddInterface(mCrcErrorRateInterface.get());
 
   AddExportOption(0, "Export as text/csv file");
   AddExportExtension(0, "text", "txt");
   AddExportExtension(0, "csv", "csv");
 
+  AddExportOption(1, "Export statistics summary");
+  AddExportExtension(1, "text", "txt");
+  AddExportExtension(1, "csv", "csv");
+
+  AddExportOption(2, "Export contract timeline");
+  AddExportExtension(2, "csv", "csv");
+
+  AddExportOption(3, "Export identities");
+  AddExportExtension(3, "csv", "csv");
+
+  AddExportOption(4, "Export role timeline");
+  AddExportExtension(4, "csv", "csv");
+
   ClearChannels();
   AddChannel(mInputChannel, "Serial", false);
 }
@@ -30,6 +216,43 @@ USBPDAnalyzerSettings::~USBPDAnalyzerSettings() {}
 bool USBPDAnalyzerSettings::SetSettingsFromInterfaces() {
   mInputChannel = mInputChannelInterface->GetChannel();
   mBitRate = mBitRateInterface->GetInteger();
+  mGlitchFilter_ns = mGlitchFilterInterface->GetInteger();
+  mDecodeCache = mDecodeCacheInterface->GetValue();
+
+  // Reject filters that don't compile here, rather than silently ignoring them during the decode
+  USBPDFilter filter;
+  std::string error;
+  if (!filter.Compile(mFilterInterface->GetText(), &error)) {
+    error = "Invalid filter: " + error;
+    SetErrorText(error.c_str());
+    return false;
+  }
+
+  U32 simulationTraffic = (U32)mSimulationTrafficInterface->GetNumber();
+
+  // Same for the scenario, the simulation has no way to report errors
+  if (simulationTraffic == SimulationTraffic_Scenario) {
+    USBPDScenario scenario;
+    if (!scenario.Load(mScenarioFileInterface->GetText(), &error)) {
+      error = "Invalid simulation scenario: " + error;
+      SetErrorText(error.c_str());
+      return false;
+    }
+  }
+
+  mFilter = mFilterInterface->GetText();
+  mSimulationTraffic = simulationTraffic;
+  mSimulationRate = mSimulationRateInterface->GetInteger();
+  mScenarioFile = mScenarioFileInterface->GetText();
+  mSimulationSeed = mSimulationSeedInterface->GetInteger();
+  mClockOffset_ppm = mClockOffsetInterface->GetInteger();
+  mClockDrift_ppm = mClockDriftInterface->GetInteger();
+  mRandomJitter_ns = mRandomJitterInterface->GetInteger();
+  mDeterministicJitter_ns = mDeterministicJitterInterface->GetInteger();
+  mGlitchRate = mGlitchRateInterface->GetInteger();
+  mDroppedEdgeRate = mDroppedEdgeRateInterface->GetInteger();
+  mSymbolErrorRate = mSymbolErrorRateInterface->GetInteger();
+  mCrcErrorRate = mCrcErrorRateInterface->GetInteger();
 
   ClearChannels();
   AddChannel(mInputChannel, "USB Power Delivery (CC)", true);
@@ -40,6 +263,21 @@ bool USBPDAnalyzerSettings::SetSettingsFromInterfaces() {
 void USBPDAnalyzerSettings::UpdateInterfacesFromSettings() {
   mInputChannelInterface->SetChannel(mInputChannel);
   mBitRateInterface->SetInteger(mBitRate);
+  mGlitchFilterInterface->SetInteger(mGlitchFilter_ns);
+  mDecodeCacheInterface->SetValue(mDecodeCache);
+  mFilterInterface->SetText(mFilter.c_str());
+  mSimulationTrafficInterface->SetNumber(mSimulationTraffic);
+  mSimulationRateInterface->SetInteger(mSimulationRate);
+  mScenarioFileInterface->SetText(mScenarioFile.c_str());
+  mSimulationSeedInterface->SetInteger(mSimulationSeed);
+  mClockOffsetInterface->SetInteger(mClockOffset_ppm);
+  mClockDriftInterface->SetInteger(mClockDrift_ppm);
+  mRandomJitterInterface->SetInteger(mRandomJitter_ns);
+  mDeterministicJitterInterface->SetInteger(mDeterministicJitter_ns);
+  mGlitchRateInterface->SetInteger(mGlitchRate);
+  mDroppedEdgeRateInterface->SetInteger(mDroppedEdgeRate);
+  mSymbolErrorRateInterface->SetInteger(mSymbolErrorRate);
+  mCrcErrorRateInterface->SetInteger(mCrcErrorRate);
 }
 
 void USBPDAnalyzerSettings::LoadSettings(const char* settings) {
@@ -48,6 +286,33 @@ void USBPDAnalyzerSettings::LoadSettings(const char* settings) {
 
   text_archive >> mInputChannel;
   text_archive >> mBitRate;
+  text_archive >> mDecodeCache;
+
+  const char* filter = "";
+  text_archive >> &filter;
+  mFilter = filter;
+
+  text_archive >> mSimulationTraffic;
+  text_archive >> mSimulationRate;
+  text_archive >> mSimulationSeed;
+  text_archive >> mClockOffset_ppm;
+  text_archive >> mClockDrift_ppm;
+  text_archive >> mRandomJitter_ns;
+  text_archive >> mDeterministicJitter_ns;
+  text_archive >> mGlitchRate;
+  text_archive >> mDroppedEdgeRate;
+  text_archive >> mSymbolErrorRate;
+  text_archive >> mCrcErrorRate;
+
+  const char* scenarioFile = "";
+  text_archive >> &scenarioFile;
+  mScenarioFile = scenarioFile;
+
+  text_archive >> mGlitchFilter_ns;
+
+  if (mSimulationTraffic >= NUM_SIMULATION_TRAFFIC) {
+    mSimulationTraffic = SimulationTraffic_Ping;
+  }
 
   ClearChannels();
   AddChannel(mInputChannel, "USB Power Delivery (CC)", true);
@@ -60,6 +325,21 @@ const char* USBPDAnalyzerSettings::SaveSettings() {
 
   text_archive << mInputChannel;
   text_archive << mBitRate;
+  text_archive << mDecodeCache;
+  text_archive << mFilter.c_str();
+  text_archive << mSimulationTraffic;
+  text_archive << mSimulationRate;
+  text_archive << mSimulationSeed;
+  text_archive << mClockOffset_ppm;
+  text_archive << mClockDrift_ppm;
+  text_archive << mRandomJitter_ns;
+  text_archive << mDeterministicJitter_ns;
+  text_archive << mGlitchRate;
+  text_archive << mDroppedEdgeRate;
+  text_archive << mSymbolErrorRate;
+  text_archive << mCrcErrorRate;
+  text_archive << mScenarioFile.c_str();
+  text_archive << mGlitchFilter_ns;
 
   return SetReturnString(text_archive.GetString());
 }
@@ -4,6 +4,21 @@
 #include <AnalyzerSettings.h>
 #include <AnalyzerTypes.h>
 
+#include <string>
+
+/**
+ * @brief Traffic generated by the simulation data generator
+ */
+enum SimulationTraffic {
+  SimulationTraffic_Ping,          // Ping + GoodCRC on every SOP type
+  SimulationTraffic_Session,       // PD session, balanced mix of exchanges
+  SimulationTraffic_SessionVdm,    // PD session, mostly discovery VDMs
+  SimulationTraffic_SessionPower,  // PD session, mostly (re)negotiation and PPS requests
+  SimulationTraffic_Scenario,      // Messages from a scenario file, repeated
+
+  NUM_SIMULATION_TRAFFIC
+};
+
 class USBPDAnalyzerSettings : public AnalyzerSettings {
  public:
   USBPDAnalyzerSettings();
@@ -16,10 +31,42 @@ class USBPDAnalyzerSettings : public AnalyzerSettings {
 
   Channel mInputChannel;
   U32 mBitRate;
+  U32 mGlitchFilter_ns;  // Pulses narrower than this are removed before decoding, 0 to disable
+  bool mDecodeCache;
+  std::string mFilter;
+  U32 mSimulationTraffic;
+  U32 mSimulationRate;
+  std::string mScenarioFile;
+
+  // Physical layer impairments injected by the simulator
+  U32 mSimulationSeed;
+  S32 mClockOffset_ppm;
+  S32 mClockDrift_ppm;  // Per second
+  U32 mRandomJitter_ns;
+  U32 mDeterministicJitter_ns;
+  U32 mGlitchRate;  // All rates are per 1000 messages
+  U32 mDroppedEdgeRate;
+  U32 mSymbolErrorRate;
+  U32 mCrcErrorRate;
 
  protected:
   std::auto_ptr<AnalyzerSettingInterfaceChannel> mInputChannelInterface;
   std::auto_ptr<AnalyzerSettingInterfaceInteger> mBitRateInterface;
+  std::auto_ptr<AnalyzerSettingInterfaceInteger> mGlitchFilterInterface;
+  std::auto_ptr<AnalyzerSettingInterfaceBool> mDecodeCacheInterface;
+  std::auto_ptr<AnalyzerSettingInterfaceText> mFilterInterface;
+  std::auto_ptr<AnalyzerSettingInterfaceNumberList> mSimulationTrafficInterface;
+  std::auto_ptr<AnalyzerSettingInterfaceInteger> mSimulationRateInterface;
+  std::auto_ptr<AnalyzerSettingInterfaceText> mScenarioFileInterface;
+  std::auto_ptr<AnalyzerSettingInterfaceInteger> mSimulationSeedInterface;
+  std::auto_ptr<AnalyzerSettingInterfaceInteger> mClockOffsetInterface;
+  std::auto_ptr<AnalyzerSettingInterfaceInteger> mClockDriftInterface;
+  std::auto_ptr<AnalyzerSettingInterfaceInteger> mRandomJitterInterface;
+  std::auto_ptr<AnalyzerSettingInterfaceInteger> mDeterministicJitterInterface;
+  std::auto_ptr<AnalyzerSettingInterfaceInteger> mGlitchRateInterface;
+  std::auto_ptr<AnalyzerSettingInterfaceInteger> mDroppedEdgeRateInterface;
+  std::auto_ptr<AnalyzerSettingInterfaceInteger> mSymbolErrorRateInterface;
+  std::auto_ptr<AnalyzerSettingInterfaceInteger> mCrcErrorRateInterface;
 };
 
 #endif  // USBPD_ANALYZER_SETTINGS
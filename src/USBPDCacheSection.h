@@ -0,0 +1,83 @@
+#ifndef USBPD_CACHE_SECTION_H
+#define USBPD_CACHE_SECTION_H
+
+#include <LogicPublicTypes.h>
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief State kept in a decode cache entry alongside the results, as a section of U64 values.
+ *
+ * Trackers implement this and are registered with USBPDDecodeCache::AddSection(), so that the
+ * cache saves and restores them without knowing about them. The first value of a section is its
+ * version, written and checked here; SaveValues(), CheckValues() and LoadValues() handle the rest,
+ * with the version still at values[0].
+ */
+class USBPDCacheSection {
+ public:
+  virtual ~USBPDCacheSection() {}
+
+  void Save(std::vector<U64>* values) {
+    values->clear();
+    values->push_back(mVersion);
+    SaveValues(values);
+  }
+
+  /**
+   * @brief Check values written by Save() without loading them
+   */
+  bool IsValid(const std::vector<U64>& values) const {
+    return !values.empty() && values[0] == mVersion && CheckValues(values);
+  }
+
+  /**
+   * @brief Restore values written by Save(), leaving the state unchanged if they are not valid
+   */
+  bool Load(const std::vector<U64>& values) {
+    if (!IsValid(values)) {
+      return false;
+    }
+
+    LoadValues(values);
+    return true;
+  }
+
+ protected:
+  /**
+   * @param version of the section's values, to be changed whenever their layout changes
+   */
+  explicit USBPDCacheSection(U64 version) : mVersion(version) {}
+
+  /**
+   * @brief Whether values hold headerValues values followed by as many records of recordValues
+   * values as the count at values[countIndex]
+   */
+  static bool HasRecords(const std::vector<U64>& values,
+                         size_t headerValues,
+                         size_t countIndex,
+                         size_t recordValues) {
+    return values.size() >= headerValues && values[countIndex] <= values.size() &&
+           values.size() == headerValues + (size_t)values[countIndex] * recordValues;
+  }
+
+  /**
+   * @brief Append the values after the version
+   */
+  virtual void SaveValues(std::vector<U64>* values) = 0;
+
+  /**
+   * @brief Check values whose version matches
+   */
+  virtual bool CheckValues(const std::vector<U64>& values) const = 0;
+
+  /**
+   * @brief Restore values that passed CheckValues()
+   */
+  virtual void LoadValues(const std::vector<U64>& values) = 0;
+
+ private:
+  U64 mVersion;
+};
+
+#endif  // USBPD_CACHE_SECTION_H
@@ -0,0 +1,474 @@
+#include "USBPDContractTracker.h"
+
+#include <AnalyzerHelpers.h>
+
+#include <cstdio>
+
+// Timing limits, from the PD 3.1 specification
+static const U64 tSenderResponse_us = 24000;    // Minimum, the sender may time out after this
+static const U64 tPSTransitionSPR_us = 450000;  // Minimum, the sink may time out after this
+static const U64 tPSTransitionEPR_us = 925000;  // Same, for EPR PDOs
+
+// Values written by Save(): version, sample rate, state, GoodCRC step and the number of
+// contracts, then each contract
+static const U64 contractVersion = 1;
+static const size_t contractHeaderValues = 5;
+static const size_t contractValues = 7 + 3;
+
+USBPDContractTracker::USBPDContractTracker() : USBPDCacheSection(contractVersion) { Clear(1); }
+
+void USBPDContractTracker::Clear(U32 sampleRateHz) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  mSampleRateHz = sampleRateHz;
+  mState = State_Idle;
+  mAwaitingGoodCrc = AckStep_None;
+  mContracts.clear();
+}
+
+/**
+ * @brief Add a contract with no steps, and make it the open contract
+ */
+void USBPDContractTracker::StartContract() {
+  EndContract();
+
+  Contract contract;
+  contract.capabilitiesStart = noSample;
+  contract.capabilitiesEnd = noSample;
+  contract.requestStart = noSample;
+  contract.requestEnd = noSample;
+  contract.responseStart = noSample;
+  contract.responseEnd = noSample;
+  contract.psRdyStart = noSample;
+  contract.rdo = 0;
+  contract.pdo = 0;
+  contract.hasPdo = false;
+  contract.response = ControlMessage_Reserved;
+  contract.violations = 0;
+  contract.open = true;
+  mContracts.push_back(contract);
+}
+
+/**
+ * @brief Close the open contract, if there is one. It keeps the steps reached so far.
+ */
+void USBPDContractTracker::EndContract() {
+  if (!mContracts.empty()) {
+    mContracts.back().open = false;
+  }
+
+  mState = State_Idle;
+  mAwaitingGoodCrc = AckStep_None;
+}
+
+bool USBPDContractTracker::IsLate(U64 fromSample, U64 toSample, U64 limit_us) const {
+  if (fromSample == noSample || toSample < fromSample) {
+    return false;
+  }
+
+  return (toSample - fromSample) * 1000000 > limit_us * mSampleRateHz;
+}
+
+double USBPDContractTracker::GetLatency_us(U64 fromSample, U64 toSample) const {
+  return (double)(toSample - fromSample) * 1000000.0 / mSampleRateHz;
+}
+
+void USBPDContractTracker::AddMessage(const USBPDMessageRecord& record,
+                                      const USBPDMessages::SourcePDO* referencedPdo) {
+  // Negotiations only take place on SOP. Damaged messages are retried by the sender.
+  if (record.sop != SOPType_SOP || (record.flags & messageDamageFlags) != 0) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  uint8_t numDataObjects = EXTRACT_BIT_RANGE(record.header, 14, 12);
+  uint8_t messageType = EXTRACT_BIT_RANGE(record.header, 4, 0);
+
+  AckStep awaitingGoodCrc = mAwaitingGoodCrc;
+  mAwaitingGoodCrc = AckStep_None;
+
+  // Of the extended messages, only EPR_Source_Capabilities takes part in the negotiation
+  if (CHECK_BIT(record.header, 15)) {
+    if (messageType == ExtendedMessage_EPR_Source_Capabilities) {
+      AddEprCapabilities(record);
+    }
+    return;
+  }
+
+  if (numDataObjects == 0 && messageType == ControlMessage_GoodCRC) {
+    if (mContracts.empty()) {
+      return;
+    }
+
+    Contract& contract = mContracts.back();
+
+    switch (awaitingGoodCrc) {
+      case AckStep_Capabilities:
+        contract.capabilitiesEnd = record.endingSample;
+        break;
+
+      case AckStep_Request:
+        contract.requestEnd = record.endingSample;
+        break;
+
+      case AckStep_Response:
+        contract.responseEnd = record.endingSample;
+        break;
+
+      default:
+        break;
+    }
+
+    return;
+  }
+
+  if (numDataObjects > 0) {
+    switch (messageType) {
+      case DataMessage_Source_Capabilities: {
+        StartContract();
+
+        Contract& contract = mContracts.back();
+        contract.capabilitiesStart = record.startingSample;
+        contract.capabilitiesEnd = record.endingSample;
+
+        mState = State_CapabilitiesSent;
+        mAwaitingGoodCrc = AckStep_Capabilities;
+      } break;
+
+      case DataMessage_Request:
+      case DataMessage_EPR_Request: {
+        // Only the first Request after the capabilities answers them. Later ones (after a Wait, or
+        // to change the contract) start a contract of their own.
+        if (mState != State_CapabilitiesSent) {
+          StartContract();
+        }
+
+        Contract& contract = mContracts.back();
+        contract.requestStart = record.startingSample;
+        contract.requestEnd = record.endingSample;
+        contract.rdo = record.firstDataObject;
+
+        if (referencedPdo != NULL) {
+          contract.pdo = referencedPdo->raw;
+          contract.hasPdo = true;
+        }
+
+        if (IsLate(contract.capabilitiesEnd, contract.requestStart, tSenderResponse_us)) {
+          contract.violations |= Violation_RequestLate;
+        }
+
+        mState = State_RequestSent;
+        mAwaitingGoodCrc = AckStep_Request;
+      } break;
+
+      default:
+        break;
+    }
+
+    return;
+  }
+
+  switch (messageType) {
+    case ControlMessage_Accept:
+    case ControlMessage_Reject:
+    case ControlMessage_Wait: {
+      if (mState != State_RequestSent) {
+        break;
+      }
+
+      Contract& contract = mContracts.back();
+      contract.responseStart = record.startingSample;
+      contract.responseEnd = record.endingSample;
+      contract.response = messageType;
+
+      if (IsLate(contract.requestEnd, contract.responseStart, tSenderResponse_us)) {
+        contract.violations |= Violation_ResponseLate;
+      }
+
+      if (messageType == ControlMessage_Accept) {
+        mState = State_Accepted;
+        mAwaitingGoodCrc = AckStep_Response;
+      } else {
+        EndContract();
+      }
+    } break;
+
+    case ControlMessage_PS_RDY: {
+      if (mState != State_Accepted) {
+        break;
+      }
+
+      Contract& contract = mContracts.back();
+      contract.psRdyStart = record.startingSample;
+
+      uint8_t objectPosition = EXTRACT_BIT_RANGE(contract.rdo, 31, 28);
+      U64 tPSTransition_us =
+          objectPosition >= firstEPRObjectPosition ? tPSTransitionEPR_us : tPSTransitionSPR_us;
+
+      if (IsLate(contract.responseEnd, contract.psRdyStart, tPSTransition_us)) {
+        contract.violations |= Violation_PsRdyLate;
+      }
+
+      EndContract();
+    } break;
+
+    case ControlMessage_Soft_Reset:
+      EndContract();
+      break;
+
+    default:
+      break;
+  }
+}
+
+/**
+ * @brief Follow a chunk of EPR_Source_Capabilities. The first chunk starts a contract, as
+ * Source_Capabilities does, and each chunk moves the end of the capabilities. The chunk requests
+ * sent back by the Sink are skipped.
+ */
+void USBPDContractTracker::AddEprCapabilities(const USBPDMessageRecord& record) {
+  // The extended header is in the low 16 bits of the first data object
+  USBPDMessages::ExtendedHeader extendedHeader((uint16_t)record.firstDataObject);
+
+  if (extendedHeader.chunked && extendedHeader.requestChunk) {
+    return;
+  }
+
+  if (!extendedHeader.chunked || extendedHeader.chunkNumber == 0) {
+    StartContract();
+    mContracts.back().capabilitiesStart = record.startingSample;
+    mState = State_CapabilitiesSent;
+  } else if (mState != State_CapabilitiesSent) {
+    return;
+  }
+
+  mContracts.back().capabilitiesEnd = record.endingSample;
+  mAwaitingGoodCrc = AckStep_Capabilities;
+}
+
+void USBPDContractTracker::AddHardReset() {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  EndContract();
+}
+
+/**
+ * @brief Describe the power requested by a contract, as the supply type, voltage and current or
+ * power columns of the timeline
+ */
+static void DescribeRequest(const USBPDContractTracker::Contract& contract,
+                            char* supply,
+                            char* voltage,
+                            char* current,
+                            char* power,
+                            size_t length) {
+  supply[0] = voltage[0] = current[0] = power[0] = 0;
+
+  if (contract.requestStart == USBPDContractTracker::noSample) {
+    return;
+  }
+
+  if (!contract.hasPdo) {
+    snprintf(supply, length, "Unknown PDO");
+    return;
+  }
+
+  USBPDMessages::SourcePDO pdo(contract.pdo);
+  USBPDMessages::Request request(pdo, contract.rdo);
+
+  switch (request.type) {
+    case PDOType_FixedSupply:
+      snprintf(supply, length, "Fixed");
+      snprintf(voltage, length, "%u", pdo.fixedSupplyPdo.voltage_mV);
+      snprintf(current, length, "%u", request.fixedSupplyRequest.operatingCurrent_mA);
+      break;
+
+    case PDOType_VariableSupply:
+      snprintf(supply, length, "Variable");
+      snprintf(voltage,
+               length,
+               "%u-%u",
+               pdo.variableSupplyPdo.minVoltage_mV,
+               pdo.variableSupplyPdo.maxVoltage_mV);
+      snprintf(current, length, "%u", request.variableSupplyRequest.operatingCurrent_mA);
+      break;
+
+    case PDOType_Battery:
+      snprintf(supply, length, "Battery");
+      snprintf(voltage,
+               length,
+               "%u-%u",
+               pdo.batteryPdo.minVoltage_mV,
+               pdo.batteryPdo.maxVoltage_mV);
+      snprintf(power, length, "%u", request.batterySupplyRequest.operatingPower_mW);
+      break;
+
+    case PDOType_AugmentedPDO:
+      if (pdo.augmentedPdo.type == APDOType_SPRProgrammablePowerSupply) {
+        snprintf(supply, length, "PPS");
+        snprintf(voltage, length, "%u", request.ppsRequest.outputVoltage_mV);
+        snprintf(current, length, "%u", request.ppsRequest.operatingCurrent_mA);
+      } else {
+        snprintf(supply, length, "AVS");
+        snprintf(voltage, length, "%u", request.avsRequest.outputVoltage_mV);
+        snprintf(current, length, "%u", request.avsRequest.operatingCurrent_mA);
+      }
+      break;
+
+    default:
+      snprintf(supply, length, "Invalid PDO");
+      break;
+  }
+}
+
+static const char* GetContractResult(const USBPDContractTracker::Contract& contract) {
+  switch (contract.response) {
+    case ControlMessage_Accept:
+      if (contract.psRdyStart != USBPDContractTracker::noSample) {
+        return "Established";
+      }
+      return contract.open ? "Pending" : "No PS_RDY";
+
+    case ControlMessage_Reject:
+      return "Rejected";
+
+    case ControlMessage_Wait:
+      return "Wait";
+
+    default:
+      break;
+  }
+
+  if (contract.open) {
+    return "Pending";
+  }
+
+  return contract.requestStart == USBPDContractTracker::noSample ? "No Request" : "No response";
+}
+
+void USBPDContractTracker::WriteTimeline(std::ostream& stream, U64 triggerSample) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  stream << "Source_Capabilities [s],Request [s],Response [s],PS_RDY [s],"
+         << "Request latency [us],Response latency [us],PS_RDY latency [us],"
+         << "Object position,Supply,Voltage [mV],Current [mA],Power [mW],Response,Result,"
+         << "Violations" << std::endl;
+
+  for (const Contract& contract : mContracts) {
+    const U64 starts[4] = {contract.capabilitiesStart,
+                           contract.requestStart,
+                           contract.responseStart,
+                           contract.psRdyStart};
+    const U64 ends[3] = {contract.capabilitiesEnd, contract.requestEnd, contract.responseEnd};
+
+    for (int step = 0; step < 4; step++) {
+      if (starts[step] != noSample) {
+        char time_str[128];
+        AnalyzerHelpers::GetTimeString(starts[step], triggerSample, mSampleRateHz, time_str, 128);
+        stream << time_str;
+      }
+      stream << ",";
+    }
+
+    for (int step = 0; step < 3; step++) {
+      if (ends[step] != noSample && starts[step + 1] != noSample) {
+        char latency_str[32];
+        snprintf(latency_str,
+                 sizeof(latency_str),
+                 "%.1f",
+                 GetLatency_us(ends[step], starts[step + 1]));
+        stream << latency_str;
+      }
+      stream << ",";
+    }
+
+    if (contract.requestStart != noSample) {
+      stream << EXTRACT_BIT_RANGE(contract.rdo, 31, 28);
+    }
+    stream << ",";
+
+    char supply[32];
+    char voltage[32];
+    char current[32];
+    char power[32];
+    DescribeRequest(contract, supply, voltage, current, power, sizeof(supply));
+    stream << supply << "," << voltage << "," << current << "," << power << ",";
+
+    if (contract.response < NUM_CONTROL_MESSAGE && contract.response != ControlMessage_Reserved) {
+      stream << ControlMessageNames[contract.response] + sizeof("ControlMessage_") - 1;
+    }
+    stream << "," << GetContractResult(contract) << ",";
+
+    const char* separator = "";
+    if (contract.violations & Violation_RequestLate) {
+      stream << separator << "tSenderResponse (Request)";
+      separator = " ";
+    }
+    if (contract.violations & Violation_ResponseLate) {
+      stream << separator << "tSenderResponse (Response)";
+      separator = " ";
+    }
+    if (contract.violations & Violation_PsRdyLate) {
+      stream << separator << "tPSTransition";
+    }
+
+    stream << std::endl;
+  }
+}
+
+void USBPDContractTracker::SaveValues(std::vector<U64>* values) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  values->push_back(mSampleRateHz);
+  values->push_back(mState);
+  values->push_back(mAwaitingGoodCrc);
+  values->push_back(mContracts.size());
+
+  for (const Contract& contract : mContracts) {
+    values->push_back(contract.capabilitiesStart);
+    values->push_back(contract.capabilitiesEnd);
+    values->push_back(contract.requestStart);
+    values->push_back(contract.requestEnd);
+    values->push_back(contract.responseStart);
+    values->push_back(contract.responseEnd);
+    values->push_back(contract.psRdyStart);
+    values->push_back(contract.rdo);
+    values->push_back(contract.pdo);
+    values->push_back((U64)contract.hasPdo | ((U64)contract.response << 8) |
+                      ((U64)contract.violations << 16) | ((U64)contract.open << 24));
+  }
+}
+
+bool USBPDContractTracker::CheckValues(const std::vector<U64>& values) const {
+  return HasRecords(values, contractHeaderValues, 4, contractValues) && values[1] != 0 &&
+         values[2] <= State_Accepted && values[3] <= AckStep_Response;
+}
+
+void USBPDContractTracker::LoadValues(const std::vector<U64>& values) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  mSampleRateHz = (U32)values[1];
+  mState = (State)values[2];
+  mAwaitingGoodCrc = (AckStep)values[3];
+  mContracts.resize((size_t)values[4]);
+
+  const U64* value = &values[contractHeaderValues];
+
+  for (Contract& contract : mContracts) {
+    contract.capabilitiesStart = *value++;
+    contract.capabilitiesEnd = *value++;
+    contract.requestStart = *value++;
+    contract.requestEnd = *value++;
+    contract.responseStart = *value++;
+    contract.responseEnd = *value++;
+    contract.psRdyStart = *value++;
+    contract.rdo = (uint32_t)*value++;
+    contract.pdo = (uint32_t)*value++;
+    contract.hasPdo = (*value & 0xFF) != 0;
+    contract.response = (uint8_t)(*value >> 8);
+    contract.violations = (uint8_t)(*value >> 16);
+    contract.open = ((*value >> 24) & 0xFF) != 0;
+    value++;
+  }
+}
@@ -0,0 +1,117 @@
+#ifndef USBPD_CONTRACT_TRACKER_H
+#define USBPD_CONTRACT_TRACKER_H
+
+#include <LogicPublicTypes.h>
+
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "USBPDCacheSection.h"
+#include "USBPDMessageIndex.h"
+#include "USBPDMessages.h"
+
+/**
+ * @brief Follows power negotiations on SOP: Source_Capabilities, Request, Accept / Reject / Wait,
+ * then PS_RDY. Each Request, and each Source_Capabilities that is never answered, is one entry of
+ * the contract timeline. In EPR mode, EPR_Source_Capabilities and EPR_Request take their places.
+ *
+ * Latencies are measured from the end of a message (or of the GoodCRC acknowledging it) to the
+ * start of the message answering it. Responses later than tSenderResponse, and a PS_RDY later than
+ * tPSTransition, are flagged as violations.
+ *
+ * The decoder adds messages from the worker thread while the timeline is exported from the UI
+ * thread, so all methods are synchronized.
+ */
+class USBPDContractTracker : public USBPDCacheSection {
+ public:
+  enum Violation {
+    Violation_RequestLate = (1 << 0),   // Request later than tSenderResponse after the capabilities
+    Violation_ResponseLate = (1 << 1),  // Accept / Reject / Wait later than tSenderResponse
+    Violation_PsRdyLate = (1 << 2),     // PS_RDY later than tPSTransition after the Accept
+  };
+
+  static const U64 noSample = UINT64_MAX;
+
+  struct Contract {
+    // Start of each message, and end of each message or of the GoodCRC acknowledging it.
+    // noSample if the step was not reached.
+    U64 capabilitiesStart;
+    U64 capabilitiesEnd;
+    U64 requestStart;
+    U64 requestEnd;
+    U64 responseStart;
+    U64 responseEnd;
+    U64 psRdyStart;
+
+    uint32_t rdo;
+    uint32_t pdo;  // PDO referenced by the RDO, if hasPdo
+    bool hasPdo;
+    uint8_t response;    // ControlMessageTypes, ControlMessage_Reserved if there was none
+    uint8_t violations;  // Violation bits
+    bool open;           // Still waiting for the next step
+  };
+
+  USBPDContractTracker();
+
+  void Clear(U32 sampleRateHz);
+
+  /**
+   * @brief Follow a decoded message, or a message abandoned after an invalid SOP
+   *
+   * @param referencedPdo for a Request, the source PDO its RDO refers to, or NULL if unknown
+   */
+  void AddMessage(const USBPDMessageRecord& record, const USBPDMessages::SourcePDO* referencedPdo);
+
+  /**
+   * @brief A Hard Reset ends any negotiation in progress
+   */
+  void AddHardReset();
+
+  /**
+   * @brief Write the timeline as CSV, one line per contract
+   *
+   * @param triggerSample sample the times are relative to
+   */
+  void WriteTimeline(std::ostream& stream, U64 triggerSample);
+
+ protected:
+  /**
+   * @brief Save / restore the timeline, for the decode cache
+   */
+  virtual void SaveValues(std::vector<U64>* values);
+  virtual bool CheckValues(const std::vector<U64>& values) const;
+  virtual void LoadValues(const std::vector<U64>& values);
+
+  enum State {
+    State_Idle,
+    State_CapabilitiesSent,
+    State_RequestSent,
+    State_Accepted,
+  };
+
+  // Step of the last contract whose end moves to the end of the GoodCRC that follows it
+  enum AckStep {
+    AckStep_None,
+    AckStep_Capabilities,
+    AckStep_Request,
+    AckStep_Response,
+  };
+
+  void AddEprCapabilities(const USBPDMessageRecord& record);
+  void StartContract();
+  void EndContract();
+  bool IsLate(U64 fromSample, U64 toSample, U64 limit_us) const;
+  double GetLatency_us(U64 fromSample, U64 toSample) const;
+
+  std::mutex mMutex;
+
+  U32 mSampleRateHz;
+  State mState;
+  AckStep mAwaitingGoodCrc;
+
+  std::vector<Contract> mContracts;
+};
+
+#endif  // USBPD_CONTRACT_TRACKER_H
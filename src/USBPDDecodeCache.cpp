@@ -0,0 +1,645 @@
+#include "USBPDDecodeCache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+static const char cacheMagic[8] = {'U', 'S', 'B', 'P', 'D', 'D', 'C', 0};
+static const U32 cacheVersion = 15;
+
+// Entries are named prefix, prefix key in hex, suffix
+static const char cacheFilePrefix[] = "usbpd-analyzer-";
+static const char cacheFileSuffix[] = ".cache";
+
+// Section tags
+static const U32 cacheSectionEnd = 0;
+static const U32 cacheSectionFrames = 1;
+static const U32 cacheSectionMarkers = 2;
+static const U32 cacheSectionMessages = 3;
+static const U32 cacheSectionPackets = 4;  // Written before the frames
+static const U32 cacheSectionResets = 5;
+// Registered sections follow, from USBPDDecodeCache::firstSectionId
+
+// Packed record sizes
+static const size_t frameRecordSize = 8 + 8 + 8 + 8 + 1 + 1;
+static const size_t markerRecordSize = 8 + 1;
+static const size_t messageRecordSize = 8 + 8 + 2 + 1 + 1 + 4 + 4 + 1;
+static const size_t packetRecordSize = 8;
+static const size_t resetRecordSize = 8 + 8 + 1;
+static const size_t sectionRecordSize = 8;
+
+// Records are staged in memory and written / read this many bytes at a time
+static const size_t cacheBlockSize = 64 * 1024;
+
+static void PutU64(std::vector<char>& buffer, U64 value) {
+  char bytes[8];
+  memcpy(bytes, &value, sizeof(bytes));
+  buffer.insert(buffer.end(), bytes, bytes + sizeof(bytes));
+}
+
+static void PutU32(std::vector<char>& buffer, U32 value) {
+  char bytes[4];
+  memcpy(bytes, &value, sizeof(bytes));
+  buffer.insert(buffer.end(), bytes, bytes + sizeof(bytes));
+}
+
+static U64 GetU64(const char* bytes) {
+  U64 value;
+  memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+static U32 GetU32(const char* bytes) {
+  U32 value;
+  memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+static size_t GetRecordSize(U32 tag) {
+  switch (tag) {
+    case cacheSectionFrames:
+      return frameRecordSize;
+
+    case cacheSectionMarkers:
+      return markerRecordSize;
+
+    case cacheSectionMessages:
+      return messageRecordSize;
+
+    case cacheSectionPackets:
+      return packetRecordSize;
+
+    case cacheSectionResets:
+      return resetRecordSize;
+
+    default:
+      return (tag >= USBPDDecodeCache::firstSectionId) ? sectionRecordSize : 0;
+  }
+}
+
+/**
+ * @brief A cache entry found in the cache directory
+ */
+struct CacheFile {
+  std::string path;
+  U64 size;
+  U64 time;  // Last written, in the platform's units
+};
+
+static bool IsCacheFileName(const std::string& name) {
+  size_t prefixLength = strlen(cacheFilePrefix);
+  size_t suffixLength = strlen(cacheFileSuffix);
+
+  return name.size() > prefixLength + suffixLength &&
+         name.compare(0, prefixLength, cacheFilePrefix) == 0 &&
+         name.compare(name.size() - suffixLength, suffixLength, cacheFileSuffix) == 0;
+}
+
+/**
+ * @brief Every cache entry in directory, whoever wrote it
+ */
+static std::vector<CacheFile> ListCacheFiles(const std::string& directory) {
+  std::vector<CacheFile> files;
+
+#ifdef _WIN32
+  std::string pattern = directory + "/" + cacheFilePrefix + "*" + cacheFileSuffix;
+
+  WIN32_FIND_DATAA data;
+  HANDLE find = FindFirstFileA(pattern.c_str(), &data);
+  if (find == INVALID_HANDLE_VALUE) {
+    return files;
+  }
+
+  do {
+    if ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) || !IsCacheFileName(data.cFileName)) {
+      continue;
+    }
+
+    CacheFile file;
+    file.path = directory + "/" + data.cFileName;
+    file.size = ((U64)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+    file.time = ((U64)data.ftLastWriteTime.dwHighDateTime << 32) |
+                data.ftLastWriteTime.dwLowDateTime;
+    files.push_back(file);
+  } while (FindNextFileA(find, &data));
+
+  FindClose(find);
+#else
+  DIR* dir = opendir(directory.c_str());
+  if (dir == NULL) {
+    return files;
+  }
+
+  for (struct dirent* entry = readdir(dir); entry != NULL; entry = readdir(dir)) {
+    if (!IsCacheFileName(entry->d_name)) {
+      continue;
+    }
+
+    CacheFile file;
+    file.path = directory + "/" + entry->d_name;
+
+    struct stat status;
+    if (stat(file.path.c_str(), &status) != 0 || !S_ISREG(status.st_mode)) {
+      continue;
+    }
+
+    file.size = status.st_size;
+    file.time = status.st_mtime;
+    files.push_back(file);
+  }
+
+  closedir(dir);
+#endif
+
+  return files;
+}
+
+/**
+ * @brief Read the header of an entry
+ *
+ * @return true if it is an entry for prefixKey, in this version of the format
+ */
+static bool ReadHeader(std::ifstream& file, U64 prefixKey, USBPDDecodeCache::Capture* capture) {
+  char magic[sizeof(cacheMagic)];
+  U32 version = 0;
+  U64 filePrefixKey = 0;
+
+  file.read(magic, sizeof(magic));
+  file.read((char*)&version, sizeof(version));
+  file.read((char*)&filePrefixKey, sizeof(filePrefixKey));
+  file.read((char*)&capture->key, sizeof(capture->key));
+  file.read((char*)&capture->numEdges, sizeof(capture->numEdges));
+  file.read((char*)&capture->lastEdge, sizeof(capture->lastEdge));
+
+  return file && memcmp(magic, cacheMagic, sizeof(magic)) == 0 && version == cacheVersion &&
+         filePrefixKey == prefixKey;
+}
+
+USBPDDecodeCache::USBPDDecodeCache() {}
+
+void USBPDDecodeCache::AddSection(U32 id, USBPDCacheSection* section) {
+  Section entry;
+  entry.id = id;
+  entry.section = section;
+  mSections.push_back(entry);
+}
+
+int USBPDDecodeCache::FindSection(U32 id) const {
+  for (size_t i = 0; i < mSections.size(); i++) {
+    if (mSections[i].id == id) {
+      return (int)i;
+    }
+  }
+
+  return -1;
+}
+
+U64 USBPDDecodeCache::HashBytes(U64 hash, const void* data, size_t length) {
+  const U8* bytes = (const U8*)data;
+
+  for (size_t i = 0; i < length; i++) {
+    hash ^= bytes[i];
+    hash *= 0x100000001B3ULL;
+  }
+
+  return hash;
+}
+
+std::string USBPDDecodeCache::GetTempDirectory() {
+  const char* directory = getenv("TMPDIR");
+
+  if (directory == NULL) {
+    directory = getenv("TEMP");
+  }
+
+  if (directory == NULL) {
+    directory = getenv("TMP");
+  }
+
+  if (directory == NULL) {
+    directory = "/tmp";
+  }
+
+  return directory;
+}
+
+std::string USBPDDecodeCache::GetPath(U64 prefixKey) const {
+  char name[64];
+  snprintf(name,
+           sizeof(name),
+           "/%s%016llx%s",
+           cacheFilePrefix,
+           (unsigned long long)prefixKey,
+           cacheFileSuffix);
+
+  return GetTempDirectory() + name;
+}
+
+/**
+ * @brief Remove entries, oldest first, until they take no more than maxCacheBytes. The entry at
+ * keptPath, just written, stays.
+ */
+void USBPDDecodeCache::RemoveOldestEntries(const std::string& keptPath) const {
+  std::vector<CacheFile> files = ListCacheFiles(GetTempDirectory());
+
+  U64 totalBytes = 0;
+  for (const CacheFile& file : files) {
+    totalBytes += file.size;
+  }
+
+  std::sort(files.begin(), files.end(), [](const CacheFile& a, const CacheFile& b) {
+    return a.time < b.time;
+  });
+
+  for (const CacheFile& file : files) {
+    if (totalBytes <= maxCacheBytes) {
+      break;
+    }
+
+    if (file.path != keptPath && remove(file.path.c_str()) == 0) {
+      totalBytes -= file.size;
+    }
+  }
+}
+
+bool USBPDDecodeCache::Contains(U64 prefixKey) const {
+  std::ifstream file(GetPath(prefixKey).c_str(), std::ios::in | std::ios::binary);
+
+  Capture capture;
+  return file.is_open() && ReadHeader(file, prefixKey, &capture);
+}
+
+bool USBPDDecodeCache::Load(U64 prefixKey,
+                            const Capture& capture,
+                            AnalyzerResults* results,
+                            Channel& channel,
+                            USBPDMessageIndex* index) {
+  std::ifstream file(GetPath(prefixKey).c_str(), std::ios::in | std::ios::binary);
+
+  if (!file.is_open()) {
+    return false;
+  }
+
+  Capture fileCapture;
+  if (!ReadHeader(file, prefixKey, &fileCapture) || fileCapture.key != capture.key ||
+      fileCapture.numEdges != capture.numEdges || fileCapture.lastEdge != capture.lastEdge) {
+    return false;
+  }
+
+  std::streampos firstSection = file.tellg();
+  file.seekg(0, std::ios::end);
+  std::streampos end = file.tellg();
+  file.seekg(firstSection);
+
+  // Values of each registered section, and whether the entry has it
+  std::vector<std::vector<U64>> sectionValues(mSections.size());
+  std::vector<bool> sectionFound(mSections.size(), false);
+
+  // Walk the section headers first so that a truncated or damaged entry is rejected before any
+  // results are added. The registered sections are small, and read during the walk.
+  for (;;) {
+    U32 tag = cacheSectionEnd;
+    U64 count = 0;
+    file.read((char*)&tag, sizeof(tag));
+    file.read((char*)&count, sizeof(count));
+
+    if (!file) {
+      return false;
+    }
+
+    if (tag == cacheSectionEnd) {
+      break;
+    }
+
+    size_t recordSize = GetRecordSize(tag);
+    if (recordSize == 0) {
+      return false;
+    }
+
+    if (count > (U64)(end - file.tellg()) / recordSize) {
+      return false;
+    }
+
+    if (tag >= firstSectionId) {
+      int section = FindSection(tag);
+      if (section < 0 || sectionFound[section]) {
+        return false;
+      }
+
+      std::vector<U64>& values = sectionValues[section];
+      values.resize((size_t)count);
+      for (U64 i = 0; i < count; i++) {
+        file.read((char*)&values[i], sizeof(U64));
+      }
+
+      sectionFound[section] = true;
+    } else {
+      file.seekg(count * recordSize, std::ios::cur);
+    }
+  }
+
+  if (file.tellg() != end) {
+    return false;
+  }
+
+  for (size_t i = 0; i < mSections.size(); i++) {
+    if (!sectionFound[i] || !mSections[i].section->IsValid(sectionValues[i])) {
+      return false;
+    }
+  }
+
+  for (size_t i = 0; i < mSections.size(); i++) {
+    mSections[i].section->Load(sectionValues[i]);
+  }
+
+  file.seekg(firstSection);
+
+  std::vector<char> block(cacheBlockSize);
+
+  // Last frame of each packet, packets are committed as their last frame is added
+  std::vector<U64> packetEnds;
+  size_t nextPacket = 0;
+  U64 numFrames = 0;
+
+  for (;;) {
+    U32 tag = cacheSectionEnd;
+    U64 count = 0;
+    file.read((char*)&tag, sizeof(tag));
+    file.read((char*)&count, sizeof(count));
+
+    if (tag == cacheSectionEnd) {
+      break;
+    }
+
+    size_t recordSize = GetRecordSize(tag);
+    size_t recordsPerBlock = cacheBlockSize / recordSize;
+
+    if (tag >= firstSectionId) {
+      file.seekg(count * recordSize, std::ios::cur);
+      continue;
+    }
+
+    while (count > 0) {
+      size_t records = (count < recordsPerBlock) ? (size_t)count : recordsPerBlock;
+      file.read(&block[0], records * recordSize);
+
+      const char* record = &block[0];
+
+      for (size_t i = 0; i < records; i++, record += recordSize) {
+        switch (tag) {
+          case cacheSectionFrames: {
+            Frame frame;
+            frame.mStartingSampleInclusive = (S64)GetU64(record);
+            frame.mEndingSampleInclusive = (S64)GetU64(record + 8);
+            frame.mData1 = GetU64(record + 16);
+            frame.mData2 = GetU64(record + 24);
+            frame.mType = record[32];
+            frame.mFlags = record[33];
+            results->AddFrame(frame);
+
+            if (nextPacket < packetEnds.size() && packetEnds[nextPacket] == numFrames) {
+              results->CommitPacketAndStartNewPacket();
+              nextPacket++;
+            }
+
+            numFrames++;
+          } break;
+
+          case cacheSectionMarkers: {
+            results->AddMarker(GetU64(record), (AnalyzerResults::MarkerType)record[8], channel);
+          } break;
+
+          case cacheSectionMessages: {
+            USBPDMessageRecord message;
+            message.startingSample = GetU64(record);
+            message.endingSample = GetU64(record + 8);
+            message.header = (uint16_t)((U8)record[16] | ((U8)record[17] << 8));
+            message.sop = record[18];
+            message.flags = record[19];
+            message.firstDataObject = GetU32(record + 20);
+            message.crc = GetU32(record + 24);
+            message.sender = record[28];
+            index->Add(message);
+          } break;
+
+          case cacheSectionPackets: {
+            packetEnds.push_back(GetU64(record));
+          } break;
+
+          case cacheSectionResets: {
+            USBPDResetRecord reset;
+            reset.startingSample = GetU64(record);
+            reset.endingSample = GetU64(record + 8);
+            reset.type = record[16];
+            index->AddReset(reset);
+          } break;
+        }
+      }
+
+      count -= records;
+    }
+  }
+
+  return true;
+}
+
+bool USBPDDecodeCache::Save(U64 prefixKey,
+                            const Capture& capture,
+                            AnalyzerResults* results,
+                            Channel& channel,
+                            USBPDMessageIndex* index,
+                            const Extent& extent) {
+  std::string path = GetPath(prefixKey);
+  std::string stagingPath = path + ".tmp";
+
+  std::ofstream file(stagingPath.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+
+  if (!file.is_open()) {
+    return false;
+  }
+
+  file.write(cacheMagic, sizeof(cacheMagic));
+  file.write((const char*)&cacheVersion, sizeof(cacheVersion));
+  file.write((const char*)&prefixKey, sizeof(prefixKey));
+  file.write((const char*)&capture.key, sizeof(capture.key));
+  file.write((const char*)&capture.numEdges, sizeof(capture.numEdges));
+  file.write((const char*)&capture.lastEdge, sizeof(capture.lastEdge));
+
+  std::vector<char> block;
+  block.reserve(cacheBlockSize + frameRecordSize);
+
+  U64 numPackets = extent.numPackets;
+  file.write((const char*)&cacheSectionPackets, sizeof(cacheSectionPackets));
+  file.write((const char*)&numPackets, sizeof(numPackets));
+
+  for (U64 i = 0; i < numPackets; i++) {
+    U64 firstFrame;
+    U64 lastFrame;
+    results->GetFramesContainedInPacket(i, &firstFrame, &lastFrame);
+    PutU64(block, lastFrame);
+
+    if (block.size() >= cacheBlockSize) {
+      file.write(&block[0], block.size());
+      block.clear();
+    }
+  }
+
+  if (!block.empty()) {
+    file.write(&block[0], block.size());
+    block.clear();
+  }
+
+  U64 numFrames = extent.numFrames;
+  file.write((const char*)&cacheSectionFrames, sizeof(cacheSectionFrames));
+  file.write((const char*)&numFrames, sizeof(numFrames));
+
+  for (U64 i = 0; i < numFrames; i++) {
+    Frame frame = results->GetFrame(i);
+    PutU64(block, (U64)frame.mStartingSampleInclusive);
+    PutU64(block, (U64)frame.mEndingSampleInclusive);
+    PutU64(block, frame.mData1);
+    PutU64(block, frame.mData2);
+    block.push_back((char)frame.mType);
+    block.push_back((char)frame.mFlags);
+
+    if (block.size() >= cacheBlockSize) {
+      file.write(&block[0], block.size());
+      block.clear();
+    }
+  }
+
+  if (!block.empty()) {
+    file.write(&block[0], block.size());
+    block.clear();
+  }
+
+  U64 numMarkers = extent.numMarkers;
+  file.write((const char*)&cacheSectionMarkers, sizeof(cacheSectionMarkers));
+  file.write((const char*)&numMarkers, sizeof(numMarkers));
+
+  for (U64 i = 0; i < numMarkers; i++) {
+    AnalyzerResults::MarkerType type;
+    U64 sample;
+    results->GetMarker(channel, i, &type, &sample);
+    PutU64(block, sample);
+    block.push_back((char)type);
+
+    if (block.size() >= cacheBlockSize) {
+      file.write(&block[0], block.size());
+      block.clear();
+    }
+  }
+
+  if (!block.empty()) {
+    file.write(&block[0], block.size());
+    block.clear();
+  }
+
+  U64 numMessages = index->GetNumMessages();
+  file.write((const char*)&cacheSectionMessages, sizeof(cacheSectionMessages));
+  file.write((const char*)&numMessages, sizeof(numMessages));
+
+  for (U64 i = 0; i < numMessages; i++) {
+    USBPDMessageRecord message;
+    index->GetMessage(i, &message);
+    PutU64(block, message.startingSample);
+    PutU64(block, message.endingSample);
+    block.push_back((char)(message.header & 0xFF));
+    block.push_back((char)(message.header >> 8));
+    block.push_back((char)message.sop);
+    block.push_back((char)message.flags);
+    PutU32(block, message.firstDataObject);
+    PutU32(block, message.crc);
+    block.push_back((char)message.sender);
+
+    if (block.size() >= cacheBlockSize) {
+      file.write(&block[0], block.size());
+      block.clear();
+    }
+  }
+
+  if (!block.empty()) {
+    file.write(&block[0], block.size());
+    block.clear();
+  }
+
+  U64 numResets = index->GetNumResets();
+  file.write((const char*)&cacheSectionResets, sizeof(cacheSectionResets));
+  file.write((const char*)&numResets, sizeof(numResets));
+
+  for (U64 i = 0; i < numResets; i++) {
+    USBPDResetRecord reset;
+    index->GetReset(i, &reset);
+    PutU64(block, reset.startingSample);
+    PutU64(block, reset.endingSample);
+    block.push_back((char)reset.type);
+
+    if (block.size() >= cacheBlockSize) {
+      file.write(&block[0], block.size());
+      block.clear();
+    }
+  }
+
+  if (!block.empty()) {
+    file.write(&block[0], block.size());
+    block.clear();
+  }
+
+  std::vector<U64> values;
+
+  for (const Section& section : mSections) {
+    values.clear();
+    section.section->Save(&values);
+
+    U64 numValues = values.size();
+    file.write((const char*)&section.id, sizeof(section.id));
+    file.write((const char*)&numValues, sizeof(numValues));
+
+    for (U64 value : values) {
+      PutU64(block, value);
+    }
+
+    if (!block.empty()) {
+      file.write(&block[0], block.size());
+      block.clear();
+    }
+  }
+
+  U64 endCount = 0;
+  file.write((const char*)&cacheSectionEnd, sizeof(cacheSectionEnd));
+  file.write((const char*)&endCount, sizeof(endCount));
+  file.close();
+
+  if (!file) {
+    remove(stagingPath.c_str());
+    return false;
+  }
+
+  remove(path.c_str());
+  if (rename(stagingPath.c_str(), path.c_str()) != 0) {
+    remove(stagingPath.c_str());
+    return false;
+  }
+
+  if (!mSavedPath.empty() && mSavedPath != path) {
+    remove(mSavedPath.c_str());
+  }
+
+  mSavedPath = path;
+
+  RemoveOldestEntries(path);
+
+  return true;
+}
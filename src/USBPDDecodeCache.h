@@ -0,0 +1,114 @@
+#ifndef USBPD_DECODE_CACHE_H
+#define USBPD_DECODE_CACHE_H
+
+#include <AnalyzerResults.h>
+
+#include <string>
+#include <vector>
+
+#include "USBPDCacheSection.h"
+#include "USBPDMessageIndex.h"
+
+/**
+ * @brief On-disk cache of decoded results.
+ *
+ * A cache entry holds every frame, packet, marker, message and reset record produced by a decode,
+ * and a section for each tracker registered with AddSection(). Entries are named by a hash of the
+ * analyzer settings and the first edges of the capture, so that a capture without an entry is
+ * found out before the rest of it is read, and hold the hash, number and last sample of every
+ * edge they were decoded from. Re-analyzing an unchanged capture loads the entry instead of
+ * decoding the capture again.
+ *
+ * Once the entries take more than maxCacheBytes, the oldest ones are removed.
+ */
+class USBPDDecodeCache {
+ public:
+  USBPDDecodeCache();
+
+  /**
+   * @brief 64-bit FNV-1a hash of a block of bytes
+   */
+  static U64 HashBytes(U64 hash, const void* data, size_t length);
+  static const U64 hashSeed = 0xCBF29CE484222325ULL;
+
+  // Section ids below this one are the cache's own
+  static const U32 firstSectionId = 6;
+
+  static const U64 maxCacheBytes = 1024ULL * 1024 * 1024;
+
+  /**
+   * @brief The edges an entry was decoded from. Two captures can share a hash, so the number of
+   * edges and the last of them must match as well.
+   */
+  struct Capture {
+    U64 key;       // Running edge hash after the last edge
+    U64 numEdges;
+    U64 lastEdge;  // Sample number of the last edge
+  };
+
+  /**
+   * @brief Save and restore section with every cache entry
+   *
+   * @param id identifies the section in the entry, unique and at least firstSectionId
+   */
+  void AddSection(U32 id, USBPDCacheSection* section);
+
+  /**
+   * @brief Whether there is an entry for prefixKey, the running edge hash after the first edges
+   */
+  bool Contains(U64 prefixKey) const;
+
+  /**
+   * @brief Add the cached frames, packets and markers for prefixKey and capture to results, and
+   * the cached messages and resets to index, and restore every section. An entry decoded from
+   * other edges, missing a section, or with a section that is not valid, is not loaded.
+   *
+   * @return true if a valid cache entry was found and loaded
+   */
+  bool Load(U64 prefixKey,
+            const Capture& capture,
+            AnalyzerResults* results,
+            Channel& channel,
+            USBPDMessageIndex* index);
+
+  /**
+   * @brief Number of frames, packets and markers at the start of results written to a cache entry
+   */
+  struct Extent {
+    U64 numFrames;
+    U64 numPackets;
+    U64 numMarkers;
+  };
+
+  /**
+   * @brief Write the frames, packets and markers in extent, all messages and resets in index and
+   * every section to the cache entry for prefixKey, decoded from capture. The entry previously
+   * written by this instance is removed, and so are the oldest entries if the cache is full.
+   */
+  bool Save(U64 prefixKey,
+            const Capture& capture,
+            AnalyzerResults* results,
+            Channel& channel,
+            USBPDMessageIndex* index,
+            const Extent& extent);
+
+  /**
+   * @brief Directory for cache entries and other scratch files: TMPDIR, TEMP, TMP or /tmp
+   */
+  static std::string GetTempDirectory();
+
+ protected:
+  struct Section {
+    U32 id;
+    USBPDCacheSection* section;
+  };
+
+  std::string GetPath(U64 prefixKey) const;
+  int FindSection(U32 id) const;
+  void RemoveOldestEntries(const std::string& keptPath) const;
+
+  std::vector<Section> mSections;
+  std::string mSavedPath;
+};
+
+#endif  // USBPD_DECODE_CACHE_H
@@ -0,0 +1,222 @@
+#include "USBPDEdgeReader.h"
+
+#include <utility>
+
+// Number of edges hashed and encoded at a time while reading ahead
+static const size_t readAheadChunkEdges = 4096;
+
+// 64-bit FNV-1a prime, applied per edge delta rather than per byte
+static const U64 edgeHashPrime = 0x100000001B3ULL;
+
+USBPDEdgeReader::USBPDEdgeReader()
+    : mChannel(NULL),
+      mSampleNumber(0),
+      mConsumedHash(0),
+      mConsumedEdges(0),
+      mReadAheadPosition(0),
+      mReadAheadEdges(0),
+      mReadAheadHash(0),
+      mReadAheadSampleNumber(0),
+      mMinimumPulseSamples(0),
+      mHasPendingEdge(false),
+      mPendingEdge(0),
+      mFilteredPulses(0) {}
+
+void USBPDEdgeReader::Reset(AnalyzerChannelData* channel, U64 seed, U64 minimumPulseSamples) {
+  mChannel = channel;
+  mDataExhaustedCallback = nullptr;
+
+  mSampleNumber = mChannel->GetSampleNumber();
+  mConsumedHash = seed;
+  mConsumedEdges = 0;
+
+  mReadAhead.clear();
+  mReadAhead.shrink_to_fit();
+  mReadAheadPosition = 0;
+  mReadAheadEdges = 0;
+  mReadAheadHash = seed;
+  mReadAheadSampleNumber = mSampleNumber;
+
+  mMinimumPulseSamples = minimumPulseSamples;
+  mHasPendingEdge = false;
+  mPendingEdge = 0;
+  mFilteredPulses = 0;
+}
+
+U64 USBPDEdgeReader::HashEdgeDelta(U64 hash, U64 delta) { return (hash ^ delta) * edgeHashPrime; }
+
+void USBPDEdgeReader::AdvanceToNextEdge() {
+  U64 delta;
+
+  if (mReadAheadPosition < mReadAhead.size()) {
+    // Replay an edge that was read ahead
+    delta = 0;
+    int shift = 0;
+    U8 byte;
+    do {
+      byte = mReadAhead[mReadAheadPosition++];
+      delta |= (U64)(byte & 0x7F) << shift;
+      shift += 7;
+    } while (byte & 0x80);
+
+    if (mReadAheadPosition == mReadAhead.size()) {
+      mReadAhead.clear();
+      mReadAhead.shrink_to_fit();
+      mReadAheadPosition = 0;
+    }
+  } else {
+    delta = ReadChannelEdge() - mSampleNumber;
+  }
+
+  mSampleNumber += delta;
+  mConsumedHash = HashEdgeDelta(mConsumedHash, delta);
+  mConsumedEdges++;
+}
+
+bool USBPDEdgeReader::HasEdgeUpTo(U64 sampleNumber) {
+  if (mReadAheadPosition < mReadAhead.size()) {
+    U64 delta = 0;
+    int shift = 0;
+    for (size_t position = mReadAheadPosition; position < mReadAhead.size(); position++) {
+      U8 byte = mReadAhead[position];
+      delta |= (U64)(byte & 0x7F) << shift;
+      shift += 7;
+      if (!(byte & 0x80)) {
+        break;
+      }
+    }
+
+    return mSampleNumber + delta <= sampleNumber;
+  }
+
+  if (mHasPendingEdge) {
+    return mPendingEdge <= sampleNumber;
+  }
+
+  // The channel is past the last edge if the glitch filter removed pulses after it
+  if (mChannel->GetSampleNumber() != mSampleNumber) {
+    return true;
+  }
+
+  return mChannel->WouldAdvancingToAbsPositionCauseTransition(sampleNumber);
+}
+
+/**
+ * @brief Run the callback if the channel has no more edges available, as reading the channel may
+ * then block
+ */
+void USBPDEdgeReader::NotifyIfDataExhausted() {
+  if (mDataExhaustedCallback && !mChannel->DoMoreTransitionsExistInCurrentData()) {
+    mDataExhaustedCallback();
+  }
+}
+
+/**
+ * @brief Read the next edge from the channel, through the glitch filter
+ *
+ * @return sample number of the edge
+ */
+U64 USBPDEdgeReader::ReadChannelEdge() {
+  if (mMinimumPulseSamples == 0) {
+    NotifyIfDataExhausted();
+    mChannel->AdvanceToNextEdge();
+    return mChannel->GetSampleNumber();
+  }
+
+  for (;;) {
+    // The held back edge stands once there is no edge within the minimum width after it
+    if (mHasPendingEdge) {
+      NotifyIfDataExhausted();
+      if (!mChannel->WouldAdvancingToAbsPositionCauseTransition(mPendingEdge +
+                                                                 mMinimumPulseSamples - 1)) {
+        mHasPendingEdge = false;
+        return mPendingEdge;
+      }
+    }
+
+    NotifyIfDataExhausted();
+    mChannel->AdvanceToNextEdge();
+
+    U64 sampleNumber = mChannel->GetSampleNumber();
+    if (FilterEdge(&sampleNumber)) {
+      return sampleNumber;
+    }
+  }
+}
+
+/**
+ * @brief Pass an edge read from the channel through the glitch filter
+ *
+ * @param sampleNumber the edge read from the channel, replaced by the edge that comes out of the
+ * filter
+ * @return true if an edge came out of the filter
+ */
+bool USBPDEdgeReader::FilterEdge(U64* sampleNumber) {
+  if (!mHasPendingEdge) {
+    mPendingEdge = *sampleNumber;
+    mHasPendingEdge = true;
+    return false;
+  }
+
+  if (*sampleNumber - mPendingEdge < mMinimumPulseSamples) {
+    // Drop both edges of the pulse
+    mHasPendingEdge = false;
+    mFilteredPulses++;
+    return false;
+  }
+
+  std::swap(*sampleNumber, mPendingEdge);
+  return true;
+}
+
+bool USBPDEdgeReader::ReadAhead(U64 maxEdges, U64* hash) {
+  U64 chunk[readAheadChunkEdges];
+
+  while (mChannel->DoMoreTransitionsExistInCurrentData()) {
+    size_t numEdges = 0;
+
+    while ((numEdges < readAheadChunkEdges) && (mReadAheadEdges + numEdges < maxEdges) &&
+           mChannel->DoMoreTransitionsExistInCurrentData()) {
+      mChannel->AdvanceToNextEdge();
+      U64 sampleNumber = mChannel->GetSampleNumber();
+
+      if (mMinimumPulseSamples > 0 && !FilterEdge(&sampleNumber)) {
+        continue;
+      }
+
+      chunk[numEdges++] = sampleNumber - mReadAheadSampleNumber;
+      mReadAheadSampleNumber = sampleNumber;
+    }
+
+    for (size_t i = 0; i < numEdges; i++) {
+      U64 delta = chunk[i];
+      mReadAheadHash = HashEdgeDelta(mReadAheadHash, delta);
+
+      do {
+        U8 byte = delta & 0x7F;
+        delta >>= 7;
+        mReadAhead.push_back(delta ? (byte | 0x80) : byte);
+      } while (delta);
+    }
+
+    mReadAheadEdges += numEdges;
+
+    if (mReadAheadEdges >= maxEdges && mChannel->DoMoreTransitionsExistInCurrentData()) {
+      *hash = mReadAheadHash;
+      return false;
+    }
+  }
+
+  *hash = mReadAheadHash;
+  return true;
+}
+
+void USBPDEdgeReader::SkipReadAhead(U64 numEdges) {
+  while (mConsumedEdges < numEdges && mReadAheadPosition < mReadAhead.size()) {
+    AdvanceToNextEdge();
+  }
+}
+
+void USBPDEdgeReader::SetDataExhaustedCallback(std::function<void()> callback) {
+  mDataExhaustedCallback = callback;
+}
@@ -0,0 +1,101 @@
+#ifndef USBPD_EDGE_READER_H
+#define USBPD_EDGE_READER_H
+
+#include <AnalyzerChannelData.h>
+
+#include <functional>
+#include <vector>
+
+/**
+ * @brief Source of edges for the decoder.
+ *
+ * Wraps AnalyzerChannelData so that the edges which are already available can be read (and hashed)
+ * ahead of the decoder, then replayed from memory. Edges that were read ahead are stored as
+ * LEB128-encoded deltas, which is around one byte per edge for USB-PD traffic.
+ *
+ * Edges can be passed through a glitch filter on their way in, which removes both edges of any
+ * pulse narrower than a minimum width. The filter holds back the latest edge until the channel
+ * shows that the next edge is far enough away.
+ */
+class USBPDEdgeReader {
+ public:
+  USBPDEdgeReader();
+
+  /**
+   * @brief Start reading from a new channel
+   *
+   * @param channel the channel the decoder is reading from
+   * @param seed initial value of the running edge hash
+   * @param minimumPulseSamples pulses narrower than this are removed, 0 to disable the filter
+   */
+  void Reset(AnalyzerChannelData* channel, U64 seed, U64 minimumPulseSamples);
+
+  U64 GetSampleNumber() const { return mSampleNumber; }
+  void AdvanceToNextEdge();
+
+  /**
+   * @brief Whether the next edge is at or before sampleNumber, without consuming it. An edge the
+   * glitch filter would remove counts as well. May block until the channel has data up to
+   * sampleNumber.
+   */
+  bool HasEdgeUpTo(U64 sampleNumber);
+
+  /**
+   * @brief Read the edges that are currently available into memory, in chunks, hashing the edges
+   * as they are read. Must be called before the first edge is consumed. Can be called again to read
+   * further ahead, with a larger maxEdges.
+   *
+   * @param maxEdges number of edges read ahead (in total) after which reading stops
+   * @param hash running edge hash after the last edge read ahead
+   * @return true if all available edges were read, false if maxEdges was reached first
+   */
+  bool ReadAhead(U64 maxEdges, U64* hash);
+
+  /**
+   * @brief Consume edges that were read ahead, without the decoder seeing them, until numEdges
+   * edges have been consumed in total. The decoder then continues from the last of them.
+   */
+  void SkipReadAhead(U64 numEdges);
+
+  U64 GetConsumedHash() const { return mConsumedHash; }
+  U64 GetConsumedEdges() const { return mConsumedEdges; }
+  U64 GetReadAheadEdges() const { return mReadAheadEdges; }
+  U64 GetReadAheadSampleNumber() const { return mReadAheadSampleNumber; }
+
+  /**
+   * @brief Number of pulses removed by the glitch filter so far
+   */
+  U64 GetFilteredPulses() const { return mFilteredPulses; }
+
+  /**
+   * @brief Set a callback that runs whenever the decoder is about to block waiting for more data
+   */
+  void SetDataExhaustedCallback(std::function<void()> callback);
+
+  static U64 HashEdgeDelta(U64 hash, U64 delta);
+
+ protected:
+  U64 ReadChannelEdge();
+  bool FilterEdge(U64* sampleNumber);
+  void NotifyIfDataExhausted();
+
+  AnalyzerChannelData* mChannel;
+  std::function<void()> mDataExhaustedCallback;
+
+  U64 mSampleNumber;
+  U64 mConsumedHash;
+  U64 mConsumedEdges;
+
+  std::vector<U8> mReadAhead;
+  size_t mReadAheadPosition;
+  U64 mReadAheadEdges;
+  U64 mReadAheadHash;
+  U64 mReadAheadSampleNumber;
+
+  U64 mMinimumPulseSamples;
+  bool mHasPendingEdge;
+  U64 mPendingEdge;  // Edge held back by the glitch filter
+  U64 mFilteredPulses;
+};
+
+#endif  // USBPD_EDGE_READER_H
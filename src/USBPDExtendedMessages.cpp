@@ -0,0 +1,232 @@
+#include "USBPDExtendedMessages.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Values written by Save(): version, number of payloads and of arena bytes, then each reassembly
+// buffer, each payload and the arena, 8 bytes per value
+static const U64 extendedVersion = 1;
+static const size_t extendedHeaderValues = 3;
+static const size_t extendedAssemblyDataValues = (maxExtendedMsgLen + 7) / 8;
+static const size_t extendedAssemblyValues = 1 + extendedAssemblyDataValues;
+static const size_t extendedPayloadValues = 2;
+
+static void PackBytes(std::vector<U64>* values, const uint8_t* data, size_t size) {
+  for (size_t i = 0; i < size; i += 8) {
+    U64 value = 0;
+    memcpy(&value, data + i, std::min<size_t>(8, size - i));
+    values->push_back(value);
+  }
+}
+
+static void UnpackBytes(const U64* values, uint8_t* data, size_t size) {
+  for (size_t i = 0; i < size; i += 8) {
+    memcpy(data + i, values++, std::min<size_t>(8, size - i));
+  }
+}
+
+USBPDExtendedMessages::USBPDExtendedMessages() : USBPDCacheSection(extendedVersion) { Clear(); }
+
+void USBPDExtendedMessages::Clear() {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  memset(mAssemblies, 0, sizeof(mAssemblies));
+  mPayloads.clear();
+  mData.clear();
+}
+
+void USBPDExtendedMessages::AddPayload(U64 messageIndex,
+                                       const USBPDMessageRecord& record,
+                                       const uint8_t* data,
+                                       uint32_t size) {
+  Payload payload;
+  payload.messageIndex = messageIndex;
+  payload.header = record.header;
+  payload.sop = record.sop;
+  payload.dataSize = (uint16_t)size;
+  payload.offset = mData.size();
+  mPayloads.push_back(payload);
+  mData.insert(mData.end(), data, data + size);
+}
+
+bool USBPDExtendedMessages::AddMessage(U64 messageIndex,
+                                       const USBPDMessageRecord& record,
+                                       uint16_t extendedHeader,
+                                       const uint8_t* data,
+                                       uint32_t size) {
+  if (record.sop >= NUM_SOP_TYPE || (record.flags & messageDamageFlags) != 0) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  bool chunked = CHECK_BIT(extendedHeader, 15);
+  uint8_t chunk = EXTRACT_BIT_RANGE(extendedHeader, 14, 11);
+  bool requestChunk = CHECK_BIT(extendedHeader, 10);
+  uint32_t dataSize =
+      std::min<uint32_t>(EXTRACT_BIT_RANGE(extendedHeader, 8, 0), maxExtendedMsgLen);
+  uint8_t messageType = EXTRACT_BIT_RANGE(record.header, 4, 0);
+
+  if (!chunked) {
+    AddPayload(messageIndex, record, data, std::min(size, dataSize));
+    return true;
+  }
+
+  // Chunk requests come from the other end and carry no data
+  if (requestChunk) {
+    return false;
+  }
+
+  Assembly& assembly = mAssemblies[record.sop * 2 + (CHECK_BIT(record.header, 8) ? 1 : 0)];
+
+  // Chunk 0 starts a new message, and a retry of it starts the same message again
+  if (chunk == 0) {
+    assembly.active = true;
+    assembly.messageType = messageType;
+    assembly.dataSize = (uint16_t)dataSize;
+    assembly.received = 0;
+    assembly.nextChunk = 0;
+  } else if (!assembly.active || assembly.messageType != messageType) {
+    return false;
+  }
+
+  if (chunk != assembly.nextChunk) {
+    // A retry of the previous chunk is ignored, anything else abandons the message
+    if (chunk + 1 != assembly.nextChunk) {
+      assembly.active = false;
+    }
+
+    return false;
+  }
+
+  uint32_t bytes = std::min<uint32_t>(
+      std::min<uint32_t>(size, assembly.dataSize - assembly.received), maxExtendedMsgChunkLen);
+  memcpy(assembly.data + assembly.received, data, bytes);
+  assembly.received += bytes;
+  assembly.nextChunk++;
+
+  if (assembly.received < assembly.dataSize) {
+    return false;
+  }
+
+  assembly.active = false;
+  AddPayload(messageIndex, record, assembly.data, assembly.received);
+  return true;
+}
+
+bool USBPDExtendedMessages::GetPayload(U64 messageIndex, Payload* payload, uint8_t* data) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  auto it = std::lower_bound(
+      mPayloads.begin(), mPayloads.end(), messageIndex, [](const Payload& p, U64 index) {
+        return p.messageIndex < index;
+      });
+
+  if (it == mPayloads.end() || it->messageIndex != messageIndex) {
+    return false;
+  }
+
+  *payload = *it;
+
+  // An empty payload may sit at the end of mData, where there is no byte to take the address of
+  if (it->dataSize == 0) {
+    return true;
+  }
+
+  memcpy(data, &mData[it->offset], it->dataSize);
+  return true;
+}
+
+void USBPDExtendedMessages::SaveValues(std::vector<U64>* values) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  values->push_back(mPayloads.size());
+  values->push_back(mData.size());
+
+  for (const Assembly& assembly : mAssemblies) {
+    values->push_back((U64)assembly.active | ((U64)assembly.messageType << 8) |
+                      ((U64)assembly.dataSize << 16) | ((U64)assembly.received << 32) |
+                      ((U64)assembly.nextChunk << 48));
+    PackBytes(values, assembly.data, maxExtendedMsgLen);
+  }
+
+  for (const Payload& payload : mPayloads) {
+    values->push_back(payload.messageIndex);
+    values->push_back((U64)payload.header | ((U64)payload.sop << 16) |
+                      ((U64)payload.dataSize << 24));
+  }
+
+  PackBytes(values, mData.data(), mData.size());
+}
+
+bool USBPDExtendedMessages::CheckValues(const std::vector<U64>& values) const {
+  if (values.size() < extendedHeaderValues || values[1] > values.size() ||
+      values[2] > values.size() * 8) {
+    return false;
+  }
+
+  size_t payloadsStart = extendedHeaderValues + numAssemblies * extendedAssemblyValues;
+  size_t dataStart = payloadsStart + (size_t)values[1] * extendedPayloadValues;
+
+  if (values.size() != dataStart + (size_t)(values[2] + 7) / 8) {
+    return false;
+  }
+
+  for (U32 i = 0; i < numAssemblies; i++) {
+    U64 state = values[extendedHeaderValues + i * extendedAssemblyValues];
+    U64 dataSize = (state >> 16) & 0xFFFF;
+
+    if (dataSize > maxExtendedMsgLen || ((state >> 32) & 0xFFFF) > dataSize) {
+      return false;
+    }
+  }
+
+  U64 dataBytes = 0;
+
+  for (size_t i = payloadsStart; i < dataStart; i += extendedPayloadValues) {
+    U64 dataSize = (values[i + 1] >> 24) & 0xFFFF;
+
+    if (dataSize > maxExtendedMsgLen || ((values[i + 1] >> 16) & 0xFF) >= NUM_SOP_TYPE ||
+        (i > payloadsStart && values[i] <= values[i - extendedPayloadValues])) {
+      return false;
+    }
+
+    dataBytes += dataSize;
+  }
+
+  return dataBytes == values[2];
+}
+
+void USBPDExtendedMessages::LoadValues(const std::vector<U64>& values) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  const U64* value = &values[extendedHeaderValues];
+
+  for (Assembly& assembly : mAssemblies) {
+    assembly.active = (*value & 0xFF) != 0;
+    assembly.messageType = (uint8_t)(*value >> 8);
+    assembly.dataSize = (uint16_t)(*value >> 16);
+    assembly.received = (uint16_t)(*value >> 32);
+    assembly.nextChunk = (uint8_t)(*value >> 48);
+    value++;
+
+    UnpackBytes(value, assembly.data, maxExtendedMsgLen);
+    value += extendedAssemblyDataValues;
+  }
+
+  mPayloads.resize((size_t)values[1]);
+  U64 offset = 0;
+
+  for (Payload& payload : mPayloads) {
+    payload.messageIndex = *value++;
+    payload.header = (uint16_t)*value;
+    payload.sop = (uint8_t)(*value >> 16);
+    payload.dataSize = (uint16_t)(*value >> 24);
+    payload.offset = offset;
+    offset += payload.dataSize;
+    value++;
+  }
+
+  mData.resize((size_t)values[2]);
+  UnpackBytes(value, mData.data(), mData.size());
+}
@@ -0,0 +1,93 @@
+#ifndef USBPD_EXTENDED_MESSAGES_H
+#define USBPD_EXTENDED_MESSAGES_H
+
+#include <LogicPublicTypes.h>
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "USBPDCacheSection.h"
+#include "USBPDMessageIndex.h"
+#include "USBPDTypes.h"
+
+/**
+ * @brief Payloads of the extended messages in a capture, with chunked messages reassembled.
+ *
+ * Chunks are reassembled in a fixed pool of buffers, one per SOP and end of the link (bit 8 of the
+ * header), as only one chunked message can be in flight in each direction. Each completed payload
+ * is appended to a single byte arena and keyed by the index of the message that completed it, so
+ * the results can find it from any of the message's frames.
+ *
+ * The decoder adds messages from the worker thread while the results are generated from the UI
+ * thread, so all methods are synchronized.
+ */
+class USBPDExtendedMessages : public USBPDCacheSection {
+ public:
+  struct Payload {
+    U64 messageIndex;  // Message carrying the last chunk, or the whole unchunked payload
+    uint16_t header;   // Header of that message
+    uint8_t sop;
+    uint16_t dataSize;  // Bytes reassembled, at most maxExtendedMsgLen
+    U64 offset;         // Of the first byte in the arena
+  };
+
+  USBPDExtendedMessages();
+
+  void Clear();
+
+  /**
+   * @brief Follow an extended message received without errors
+   *
+   * @param extendedHeader the 16-bit extended header
+   * @param data the bytes following the extended header, without padding
+   * @return true if the message completed a payload
+   */
+  bool AddMessage(U64 messageIndex,
+                  const USBPDMessageRecord& record,
+                  uint16_t extendedHeader,
+                  const uint8_t* data,
+                  uint32_t size);
+
+  /**
+   * @brief Copy the payload completed by a message
+   *
+   * @param data buffer of at least maxExtendedMsgLen bytes
+   * @return false if the message did not complete a payload
+   */
+  bool GetPayload(U64 messageIndex, Payload* payload, uint8_t* data);
+
+ protected:
+  /**
+   * @brief Save / restore the payloads and the reassembly buffers, for the decode cache
+   */
+  virtual void SaveValues(std::vector<U64>* values);
+  virtual bool CheckValues(const std::vector<U64>& values) const;
+  virtual void LoadValues(const std::vector<U64>& values);
+
+  // Chunked message being reassembled on one SOP, from one end of the link
+  struct Assembly {
+    bool active;
+    uint8_t messageType;
+    uint16_t dataSize;  // From the extended header of chunk 0
+    uint16_t received;
+    uint8_t nextChunk;
+    uint8_t data[maxExtendedMsgLen];
+  };
+
+  static const U32 numAssemblies = NUM_SOP_TYPE * 2;
+
+  void AddPayload(U64 messageIndex,
+                  const USBPDMessageRecord& record,
+                  const uint8_t* data,
+                  uint32_t size);
+
+  std::mutex mMutex;
+
+  Assembly mAssemblies[numAssemblies];
+
+  std::vector<Payload> mPayloads;  // In message order
+  std::vector<uint8_t> mData;
+};
+
+#endif  // USBPD_EXTENDED_MESSAGES_H
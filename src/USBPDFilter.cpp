@@ -0,0 +1,710 @@
+#include "USBPDFilter.h"
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "USBPDMessages.h"
+#include "USBPDRoleTracker.h"
+
+// Programs are evaluated on a 64 entry bit stack
+static const size_t filterMaxStackDepth = 64;
+
+// Values written by Save(): version, waiting, waiting message, deadline and match count
+static const U64 filterVersion = 1;
+static const size_t filterNumValues = 5;
+
+/**
+ * @brief Compare an identifier against a name from one of the name tables. The comparison ignores
+ * case, and treats '_' and ' ' as equal.
+ */
+static bool FilterNameMatches(const std::string& identifier, const char* name) {
+  size_t i = 0;
+
+  for (; i < identifier.size() && name[i] != '\0'; i++) {
+    char a = (identifier[i] == '_') ? ' ' : (char)tolower((unsigned char)identifier[i]);
+    char b = (name[i] == '_') ? ' ' : (char)tolower((unsigned char)name[i]);
+
+    if (a != b) {
+      return false;
+    }
+  }
+
+  return (i == identifier.size()) && (name[i] == '\0');
+}
+
+static bool FilterFindName(const std::string& identifier,
+                           const char* const* names,
+                           size_t numNames,
+                           const char* prefix,
+                           uint32_t* value) {
+  size_t prefixLength = (prefix != NULL) ? strlen(prefix) : 0;
+
+  for (size_t i = 0; i < numNames; i++) {
+    if (FilterNameMatches(identifier, names[i] + prefixLength)) {
+      *value = (uint32_t)i;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/**
+ * @brief Resolve a message type name to its USBPDMessageIndex::GetMessageTypeValue()
+ */
+static bool FilterFindMessageType(const std::string& identifier, uint32_t* value) {
+  if (FilterNameMatches(identifier, "VDM")) {
+    *value = 32 + DataMessage_Vendor_Defined;
+    return true;
+  }
+
+  if (FilterFindName(
+          identifier, ControlMessageNames, NUM_CONTROL_MESSAGE, "ControlMessage_", value)) {
+    return true;
+  }
+
+  if (FilterFindName(identifier, DataMessageNames, NUM_DATA_MESSAGE, "DataMessage_", value)) {
+    *value += 32;
+    return true;
+  }
+
+  if (FilterFindName(
+          identifier, ExtendedMessageNames, NUM_EXTENDED_MESSAGE, "ExtendedMessage_", value)) {
+    *value += 64;
+    return true;
+  }
+
+  return false;
+}
+
+bool USBPDFilter::FindMessageType(const std::string& name, uint32_t* value) {
+  return FilterFindMessageType(name, value);
+}
+
+bool USBPDFilter::FindSOPType(const std::string& name, uint32_t* value) {
+  return FilterFindName(name, SOPTypeNames, NUM_SOP_TYPE, NULL, value);
+}
+
+/**
+ * @brief Recursive descent parser, emitting postfix programs
+ *
+ * filter   := or [ '->' ['!'] or 'within' NUMBER UNIT ]
+ * or       := and ( '||' and )*
+ * and      := unary ( '&&' unary )*
+ * unary    := '!' unary | '(' or ')' | NAME [ OP value ]
+ */
+class USBPDFilter::Parser {
+ public:
+  Parser(const char* text) : mText(text), mPosition(0) {}
+
+  bool ParseOr(Program* program) {
+    if (!ParseAnd(program)) {
+      return false;
+    }
+
+    while (Accept("||")) {
+      if (!ParseAnd(program)) {
+        return false;
+      }
+
+      Emit(program, Opcode_Or);
+    }
+
+    return true;
+  }
+
+  bool ParseWindow(double* seconds) {
+    std::string word = ReadIdentifier();
+    if (!FilterNameMatches(word, "within")) {
+      return Fail("expected 'within'");
+    }
+
+    SkipSpace();
+    const char* start = mText + mPosition;
+    char* end = NULL;
+    double value = strtod(start, &end);
+
+    if (end == start || value <= 0) {
+      return Fail("expected a time after 'within'");
+    }
+
+    mPosition += end - start;
+
+    std::string unit = ReadIdentifier();
+    if (FilterNameMatches(unit, "s")) {
+      *seconds = value;
+    } else if (FilterNameMatches(unit, "ms")) {
+      *seconds = value / 1000.0;
+    } else if (FilterNameMatches(unit, "us")) {
+      *seconds = value / 1000000.0;
+    } else {
+      return Fail("expected s, ms or us after the time");
+    }
+
+    return true;
+  }
+
+  bool Accept(const char* token) {
+    SkipSpace();
+
+    size_t length = strlen(token);
+    if (strncmp(mText + mPosition, token, length) != 0) {
+      return false;
+    }
+
+    // "!" must not consume the start of "!="
+    if (length == 1 && token[0] == '!' && mText[mPosition + 1] == '=') {
+      return false;
+    }
+
+    mPosition += length;
+    return true;
+  }
+
+  bool AtEnd() {
+    SkipSpace();
+    return mText[mPosition] == '\0';
+  }
+
+  bool Fail(const char* message) {
+    if (mError.empty()) {
+      char position[32];
+      snprintf(position, sizeof(position), " at position %u", (unsigned)mPosition + 1);
+      mError = std::string(message) + position;
+    }
+
+    return false;
+  }
+
+  const std::string& GetError() const { return mError; }
+
+ protected:
+  struct FieldName {
+    const char* name;
+    Field field;
+    bool flag;  // May be used on its own, as <name>!=0
+  };
+
+  bool ParseAnd(Program* program) {
+    if (!ParseUnary(program)) {
+      return false;
+    }
+
+    while (Accept("&&")) {
+      if (!ParseUnary(program)) {
+        return false;
+      }
+
+      Emit(program, Opcode_And);
+    }
+
+    return true;
+  }
+
+  bool ParseUnary(Program* program) {
+    if (Accept("!")) {
+      if (!ParseUnary(program)) {
+        return false;
+      }
+
+      Emit(program, Opcode_Not);
+      return true;
+    }
+
+    if (Accept("(")) {
+      if (!ParseOr(program)) {
+        return false;
+      }
+
+      if (!Accept(")")) {
+        return Fail("expected ')'");
+      }
+
+      return true;
+    }
+
+    return ParseComparison(program);
+  }
+
+  bool ParseComparison(Program* program) {
+    size_t nameStart = mPosition;
+    std::string name = ReadIdentifier();
+
+    if (name.empty()) {
+      return Fail("expected a field or message type");
+    }
+
+    static const FieldName fieldNames[] = {
+        {"sop", Field_SOP, false},
+        {"type", Field_Type, false},
+        {"id", Field_MessageId, false},
+        {"ndo", Field_NumDataObjects, false},
+        {"rev", Field_SpecRevision, false},
+        {"prole", Field_PowerRole, false},
+        {"drole", Field_DataRole, false},
+        {"crc_error", Field_CrcError, true},
+        {"eop_error", Field_EopError, true},
+        {"invalid_symbol", Field_InvalidSymbol, true},
+        {"do0", Field_DataObject, false},
+        {"port", Field_Port, false},
+        {"role_mismatch", Field_RoleMismatch, true},
+        {"vdm.svid", Field_VdmSvid, false},
+        {"vdm.structured", Field_VdmStructured, true},
+        {"vdm.version", Field_VdmVersion, false},
+        {"vdm.pos", Field_VdmObjectPosition, false},
+        {"vdm.cmdtype", Field_VdmCommandType, false},
+        {"vdm.cmd", Field_VdmCommand, false},
+    };
+
+    const FieldName* field = NULL;
+    for (const FieldName& candidate : fieldNames) {
+      if (FilterNameMatches(name, candidate.name)) {
+        field = &candidate;
+        break;
+      }
+    }
+
+    static const struct {
+      const char* token;
+      Comparison comparison;
+    } comparisons[] = {
+        {"==", Comparison_Equal},
+        {"!=", Comparison_NotEqual},
+        {"<=", Comparison_LessOrEqual},
+        {">=", Comparison_GreaterOrEqual},
+        {"<", Comparison_Less},
+        {">", Comparison_Greater},
+    };
+
+    for (const auto& op : comparisons) {
+      if (!Accept(op.token)) {
+        continue;
+      }
+
+      if (field == NULL) {
+        mPosition = nameStart;
+        return Fail("unknown field");
+      }
+
+      uint32_t value;
+      if (!ParseValue(field->field, &value)) {
+        return false;
+      }
+
+      Instruction instruction = {Opcode_Compare, field->field, op.comparison, value};
+      program->push_back(instruction);
+      return true;
+    }
+
+    // A name on its own
+    if (field != NULL && field->flag) {
+      Instruction instruction = {Opcode_Compare, field->field, Comparison_NotEqual, 0};
+      program->push_back(instruction);
+      return true;
+    }
+
+    uint32_t messageType;
+    if (FilterFindMessageType(name, &messageType)) {
+      Instruction instruction = {Opcode_Compare, Field_Type, Comparison_Equal, messageType};
+      program->push_back(instruction);
+      return true;
+    }
+
+    mPosition = nameStart;
+    return Fail(field != NULL ? "expected a comparison after the field" : "unknown name");
+  }
+
+  bool ParseValue(Field field, uint32_t* value) {
+    SkipSpace();
+
+    if (isdigit((unsigned char)mText[mPosition])) {
+      const char* start = mText + mPosition;
+      char* end = NULL;
+      bool hex = (start[0] == '0') && (start[1] == 'x' || start[1] == 'X');
+      *value = (uint32_t)strtoul(start, &end, hex ? 16 : 10);
+      mPosition += end - start;
+      return true;
+    }
+
+    size_t valueStart = mPosition;
+    std::string name = ReadIdentifier();
+    bool found = false;
+
+    switch (field) {
+      case Field_SOP:
+        found = FilterFindName(name, SOPTypeNames, NUM_SOP_TYPE, NULL, value);
+        break;
+
+      case Field_Type:
+        found = FilterFindMessageType(name, value);
+        break;
+
+      case Field_PowerRole: {
+        static const char* const names[NUM_PORT_POWER_ROLE] = {"Sink", "Source"};
+        found = FilterFindName(name, names, NUM_PORT_POWER_ROLE, NULL, value);
+      } break;
+
+      case Field_DataRole: {
+        static const char* const names[NUM_PORT_DATA_ROLE] = {"UFP", "DFP"};
+        found = FilterFindName(name, names, NUM_PORT_DATA_ROLE, NULL, value);
+      } break;
+
+      case Field_Port: {
+        // USBPDRoleTracker::Sender values
+        static const char* const names[] = {"Unknown", "A", "B", "Cable"};
+        found = FilterFindName(name, names, sizeof(names) / sizeof(names[0]), NULL, value);
+      } break;
+
+      case Field_VdmCommandType:
+        found = FilterFindName(
+            name, StructuredVDMCommandTypeNames, NUM_STRUCTURED_VDM_COMMAND_TYPE, NULL, value);
+        break;
+
+      case Field_VdmCommand:
+        found = FilterFindName(
+            name, StructuredVDMCommandNames, NUM_STRUCTURED_VDM_COMMAND, NULL, value);
+        break;
+
+      default:
+        break;
+    }
+
+    if (!found && (FilterNameMatches(name, "true") || FilterNameMatches(name, "false"))) {
+      *value = FilterNameMatches(name, "true") ? 1 : 0;
+      found = true;
+    }
+
+    if (!found) {
+      mPosition = valueStart;
+      return Fail(name.empty() ? "expected a value" : "unknown value");
+    }
+
+    return true;
+  }
+
+  std::string ReadIdentifier() {
+    SkipSpace();
+
+    size_t start = mPosition;
+    if (!isalpha((unsigned char)mText[mPosition]) && mText[mPosition] != '_') {
+      return std::string();
+    }
+
+    // ' and " are allowed after the first character, for SOP' and SOP"
+    while (isalnum((unsigned char)mText[mPosition]) || mText[mPosition] == '_' ||
+           mText[mPosition] == '.' || mText[mPosition] == '\'' || mText[mPosition] == '"') {
+      mPosition++;
+    }
+
+    return std::string(mText + start, mPosition - start);
+  }
+
+  void SkipSpace() {
+    while (isspace((unsigned char)mText[mPosition])) {
+      mPosition++;
+    }
+  }
+
+  static void Emit(Program* program, Opcode opcode) {
+    Instruction instruction = {opcode, NUM_FIELD, Comparison_Equal, 0};
+    program->push_back(instruction);
+  }
+
+  const char* mText;
+  size_t mPosition;
+  std::string mError;
+};
+
+USBPDFilter::USBPDFilter()
+    : USBPDCacheSection(filterVersion),
+      mNegated(false),
+      mWindowSeconds(0),
+      mWindowSamples(0),
+      mWaiting(false),
+      mWaitingMessage(0),
+      mDeadline(0),
+      mMatchCount(0) {}
+
+bool USBPDFilter::Compile(const char* expression, std::string* error) {
+  mTrigger.clear();
+  mFollower.clear();
+  mNegated = false;
+  mWindowSeconds = 0;
+
+  Parser parser(expression);
+
+  if (parser.AtEnd()) {
+    return true;
+  }
+
+  Program trigger;
+  Program follower;
+  bool negated = false;
+  double windowSeconds = 0;
+
+  bool ok = parser.ParseOr(&trigger);
+
+  if (ok && parser.Accept("->")) {
+    negated = parser.Accept("!");
+    ok = parser.ParseOr(&follower) && parser.ParseWindow(&windowSeconds);
+  }
+
+  if (ok && !parser.AtEnd()) {
+    ok = parser.Fail("unexpected text");
+  }
+
+  if (ok && (GetStackDepth(trigger) > filterMaxStackDepth ||
+             GetStackDepth(follower) > filterMaxStackDepth)) {
+    ok = parser.Fail("expression is too deeply nested");
+  }
+
+  if (!ok) {
+    *error = parser.GetError();
+    return false;
+  }
+
+  mTrigger.swap(trigger);
+  mFollower.swap(follower);
+  mNegated = negated;
+  mWindowSeconds = windowSeconds;
+
+  return true;
+}
+
+void USBPDFilter::Reset(U32 sampleRateHz) {
+  mWindowSamples = (U64)(mWindowSeconds * sampleRateHz);
+  mWaiting = false;
+  mWaitingMessage = 0;
+  mDeadline = 0;
+  mMatchCount = 0;
+}
+
+void USBPDFilter::SaveValues(std::vector<U64>* values) {
+  values->push_back(mWaiting);
+  values->push_back(mWaitingMessage);
+  values->push_back(mDeadline);
+  values->push_back(mMatchCount);
+}
+
+bool USBPDFilter::CheckValues(const std::vector<U64>& values) const {
+  return values.size() == filterNumValues && values[1] <= 1;
+}
+
+void USBPDFilter::LoadValues(const std::vector<U64>& values) {
+  mWaiting = values[1] != 0;
+  mWaitingMessage = values[2];
+  mDeadline = values[3];
+  mMatchCount = values[4];
+}
+
+void USBPDFilter::ExtractFields(const USBPDMessageRecord& message,
+                                uint32_t values[NUM_FIELD],
+                                uint32_t* presentMask) {
+  uint16_t header = message.header;
+  uint32_t numDataObjects = EXTRACT_BIT_RANGE(header, 14, 12);
+
+  values[Field_SOP] = message.sop;
+  values[Field_Type] = USBPDMessageIndex::GetMessageTypeValue(header);
+  values[Field_MessageId] = EXTRACT_BIT_RANGE(header, 11, 9);
+  values[Field_NumDataObjects] = numDataObjects;
+  values[Field_SpecRevision] = EXTRACT_BIT_RANGE(header, 7, 6);
+  values[Field_PowerRole] = EXTRACT_BIT_RANGE(header, 8, 8);
+  values[Field_DataRole] = EXTRACT_BIT_RANGE(header, 5, 5);
+  values[Field_CrcError] = (message.flags & MessageFlag_CrcError) ? 1 : 0;
+  values[Field_EopError] = (message.flags & MessageFlag_EopError) ? 1 : 0;
+  values[Field_InvalidSymbol] = (message.flags & MessageFlag_InvalidSymbol) ? 1 : 0;
+  values[Field_DataObject] = message.firstDataObject;
+  values[Field_Port] = message.sender & 0x3;
+  values[Field_RoleMismatch] = (message.sender & USBPDRoleTracker::SenderFlag_RoleMismatch) ? 1 : 0;
+
+  // Every field before the VDM fields applies to all messages, once the sender is known
+  *presentMask = (1u << Field_VdmSvid) - 1;
+
+  if (values[Field_Port] == USBPDRoleTracker::Sender_Unknown) {
+    *presentMask &= ~(1u << Field_Port);
+  }
+
+  if (numDataObjects == 0) {
+    *presentMask &= ~(1u << Field_DataObject);
+    return;
+  }
+
+  if (values[Field_Type] != 32 + DataMessage_Vendor_Defined) {
+    return;
+  }
+
+  USBPDMessages::VDMHeader vdmHeader(message.firstDataObject);
+
+  values[Field_VdmSvid] = vdmHeader.vid;
+  values[Field_VdmStructured] = (vdmHeader.type == VDMType_Structured) ? 1 : 0;
+  *presentMask |= (1u << Field_VdmSvid) | (1u << Field_VdmStructured);
+
+  if (vdmHeader.type == VDMType_Structured) {
+    values[Field_VdmVersion] = vdmHeader.structuredData.version;
+    values[Field_VdmObjectPosition] = vdmHeader.structuredData.objectPosition;
+    values[Field_VdmCommandType] = vdmHeader.structuredData.commandType;
+    values[Field_VdmCommand] = vdmHeader.structuredData.command;
+    *presentMask |= (1u << Field_VdmVersion) | (1u << Field_VdmObjectPosition) |
+                    (1u << Field_VdmCommandType) | (1u << Field_VdmCommand);
+  }
+}
+
+bool USBPDFilter::Run(const Program& program,
+                      const uint32_t values[NUM_FIELD],
+                      uint32_t presentMask) {
+  // Bit 0 is the top of the stack
+  uint64_t stack = 0;
+
+  for (const Instruction& instruction : program) {
+    switch (instruction.opcode) {
+      case Opcode_Compare: {
+        bool result = false;
+
+        if (presentMask & (1u << instruction.field)) {
+          uint32_t value = values[instruction.field];
+
+          switch (instruction.comparison) {
+            case Comparison_Equal:
+              result = (value == instruction.value);
+              break;
+
+            case Comparison_NotEqual:
+              result = (value != instruction.value);
+              break;
+
+            case Comparison_Less:
+              result = (value < instruction.value);
+              break;
+
+            case Comparison_LessOrEqual:
+              result = (value <= instruction.value);
+              break;
+
+            case Comparison_Greater:
+              result = (value > instruction.value);
+              break;
+
+            case Comparison_GreaterOrEqual:
+              result = (value >= instruction.value);
+              break;
+          }
+        }
+
+        stack = (stack << 1) | (result ? 1 : 0);
+      } break;
+
+      case Opcode_And:
+        stack = (stack >> 1) & (stack | ~1ULL);
+        break;
+
+      case Opcode_Or:
+        stack = (stack >> 1) | (stack & 1);
+        break;
+
+      case Opcode_Not:
+        stack ^= 1;
+        break;
+    }
+  }
+
+  return (stack & 1) != 0;
+}
+
+bool USBPDFilter::Evaluate(const USBPDMessageRecord& message,
+                           U64 messageIndex,
+                           U64* matchedMessage) {
+  if (mTrigger.empty()) {
+    return false;
+  }
+
+  uint32_t values[NUM_FIELD];
+  uint32_t presentMask;
+  ExtractFields(message, values, &presentMask);
+
+  bool matched = false;
+
+  if (mFollower.empty()) {
+    matched = Run(mTrigger, values, presentMask);
+    *matchedMessage = messageIndex;
+  } else {
+    // Window expired: a missing response is a match, a late one is not
+    matched = ExpireWindow(message.startingSample - 1, matchedMessage);
+
+    if (mWaiting && Run(mFollower, values, presentMask)) {
+      mWaiting = false;
+
+      if (!mNegated) {
+        matched = true;
+        *matchedMessage = messageIndex;
+      }
+    }
+
+    // A response can only be missed once, so a missing response is timed from the first
+    // unanswered message. Otherwise the window restarts from the latest matching message.
+    if ((!mWaiting || !mNegated) && Run(mTrigger, values, presentMask)) {
+      mWaiting = true;
+      mWaitingMessage = messageIndex;
+      mDeadline = message.endingSample + mWindowSamples;
+    }
+  }
+
+  if (matched) {
+    mMatchCount++;
+  }
+
+  return matched;
+}
+
+bool USBPDFilter::GetResponseDeadline(U64* deadline) const {
+  if (!mWaiting || !mNegated) {
+    return false;
+  }
+
+  *deadline = mDeadline;
+  return true;
+}
+
+bool USBPDFilter::Expire(U64 lastSample, U64* matchedMessage) {
+  if (mFollower.empty() || !ExpireWindow(lastSample, matchedMessage)) {
+    return false;
+  }
+
+  mMatchCount++;
+  return true;
+}
+
+bool USBPDFilter::ExpireWindow(U64 lastSample, U64* matchedMessage) {
+  if (!mWaiting || lastSample < mDeadline) {
+    return false;
+  }
+
+  mWaiting = false;
+
+  if (!mNegated) {
+    return false;
+  }
+
+  *matchedMessage = mWaitingMessage;
+  return true;
+}
+
+size_t USBPDFilter::GetStackDepth(const Program& program) {
+  size_t depth = 0;
+  size_t maxDepth = 0;
+
+  for (const Instruction& instruction : program) {
+    if (instruction.opcode == Opcode_Compare) {
+      depth++;
+    } else if (instruction.opcode != Opcode_Not) {
+      depth--;
+    }
+
+    if (depth > maxDepth) {
+      maxDepth = depth;
+    }
+  }
+
+  return maxDepth;
+}
@@ -0,0 +1,194 @@
+#ifndef USBPD_FILTER_H
+#define USBPD_FILTER_H
+
+#include <LogicPublicTypes.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "USBPDCacheSection.h"
+#include "USBPDMessageIndex.h"
+
+/**
+ * @brief Message filter / trigger, evaluated once per decoded message.
+ *
+ * A filter is either a predicate over the fields of a single message:
+ *
+ *   sop==SOP' && type==VDM && vdm.cmd==DiscoverIdentity && vdm.cmdtype==ACK
+ *
+ * or a sequence of two predicates:
+ *
+ *   Request -> Accept within 30ms     matches every Accept that follows a Request within 30ms
+ *   Request -> !Accept within 30ms    matches every Request that is not followed by an Accept
+ *                                     within 30ms
+ *
+ * Predicates support ==, !=, <, <=, >, >=, &&, ||, ! and parentheses. A bare message type name is
+ * short for type==<name>, and a bare flag name (e.g. crc_error) is short for <flag>!=0. Values are
+ * numbers (decimal or 0x hex) or the names used in the decoded output, with '_' in place of spaces.
+ *
+ * Expressions are compiled into postfix programs over the message's fields, and sequences into a
+ * two-state (idle / waiting for the second predicate) machine, so evaluating a message does not
+ * involve any parsing.
+ */
+class USBPDFilter : public USBPDCacheSection {
+ public:
+  USBPDFilter();
+
+  /**
+   * @brief Compile an expression, replacing the current filter
+   *
+   * @param expression the filter text, an empty string disables the filter
+   * @param error description of the problem if the expression is invalid
+   * @return true on success
+   */
+  bool Compile(const char* expression, std::string* error);
+
+  bool IsEmpty() const { return mTrigger.empty(); }
+
+  /**
+   * @brief Clear the sequence state and the match count
+   *
+   * @param sampleRateHz sample rate of the capture, to convert the sequence window into samples
+   */
+  void Reset(U32 sampleRateHz);
+
+  /**
+   * @brief Evaluate the filter for the next message in the capture
+   *
+   * @param message the message to evaluate
+   * @param messageIndex index of message in the USBPDMessageIndex
+   * @param matchedMessage the index of the message that matched. For sequences looking for a
+   * missing response, this is the earlier message that was not responded to.
+   * @return true if the filter matched
+   */
+  bool Evaluate(const USBPDMessageRecord& message, U64 messageIndex, U64* matchedMessage);
+
+  /**
+   * @brief Deadline of a sequence waiting for a response whose absence is a match
+   *
+   * @return false if the filter is not waiting for such a response
+   */
+  bool GetResponseDeadline(U64* deadline) const;
+
+  /**
+   * @brief End the window of the sequence, if it has passed, when no message starts up to
+   * lastSample. Called when the capture runs out, so that a missing response is matched without
+   * waiting for the next message.
+   *
+   * @param lastSample sample up to which the capture is known to hold no message
+   * @param matchedMessage the index of the message that was not responded to
+   * @return true if the filter matched
+   */
+  bool Expire(U64 lastSample, U64* matchedMessage);
+
+  U64 GetMatchCount() const { return mMatchCount; }
+
+  /**
+   * @brief Resolve a message type name, as accepted in filter expressions, to its
+   * USBPDMessageIndex::GetMessageTypeValue()
+   */
+  static bool FindMessageType(const std::string& name, uint32_t* value);
+
+  /**
+   * @brief Resolve a SOP name, as accepted in filter expressions, to its SOPType
+   */
+  static bool FindSOPType(const std::string& name, uint32_t* value);
+
+ protected:
+  /**
+   * @brief Save / restore the sequence state and the match count, for the decode cache. The
+   * compiled filter is not saved, the cache is keyed by the filter text.
+   */
+  virtual void SaveValues(std::vector<U64>* values);
+  virtual bool CheckValues(const std::vector<U64>& values) const;
+  virtual void LoadValues(const std::vector<U64>& values);
+
+  enum Field {
+    Field_SOP,
+    Field_Type,
+    Field_MessageId,
+    Field_NumDataObjects,
+    Field_SpecRevision,
+    Field_PowerRole,
+    Field_DataRole,
+    Field_CrcError,
+    Field_EopError,
+    Field_InvalidSymbol,
+    Field_DataObject,
+    Field_Port,
+    Field_RoleMismatch,
+    Field_VdmSvid,
+    Field_VdmStructured,
+    Field_VdmVersion,
+    Field_VdmObjectPosition,
+    Field_VdmCommandType,
+    Field_VdmCommand,
+
+    NUM_FIELD
+  };
+
+  enum Opcode {
+    Opcode_Compare,
+    Opcode_And,
+    Opcode_Or,
+    Opcode_Not,
+  };
+
+  enum Comparison {
+    Comparison_Equal,
+    Comparison_NotEqual,
+    Comparison_Less,
+    Comparison_LessOrEqual,
+    Comparison_Greater,
+    Comparison_GreaterOrEqual,
+  };
+
+  struct Instruction {
+    Opcode opcode;
+    Field field;
+    Comparison comparison;
+    uint32_t value;
+  };
+
+  typedef std::vector<Instruction> Program;
+
+  class Parser;
+
+  /**
+   * @brief Decode the fields of a message. Fields that do not apply to the message (e.g. VDM
+   * fields of a non-VDM message) are left out of the present mask, and compare as false.
+   */
+  static void ExtractFields(const USBPDMessageRecord& message,
+                            uint32_t values[NUM_FIELD],
+                            uint32_t* presentMask);
+
+  static bool Run(const Program& program, const uint32_t values[NUM_FIELD], uint32_t presentMask);
+
+  /**
+   * @brief Largest number of values on the stack while running program
+   */
+  static size_t GetStackDepth(const Program& program);
+
+  /**
+   * @brief Stop waiting if the window ended before lastSample. A missing response is a match, the
+   * match is not counted.
+   */
+  bool ExpireWindow(U64 lastSample, U64* matchedMessage);
+
+  Program mTrigger;
+  Program mFollower;  // Second predicate of a sequence, empty for single message filters
+
+  bool mNegated;  // Sequence matches when mFollower does _not_ occur within the window
+  double mWindowSeconds;
+  U64 mWindowSamples;
+
+  // Sequence state
+  bool mWaiting;
+  U64 mWaitingMessage;
+  U64 mDeadline;
+
+  U64 mMatchCount;
+};
+
+#endif  // USBPD_FILTER_H
@@ -0,0 +1,386 @@
+#include "USBPDIdentities.h"
+
+#include <AnalyzerHelpers.h>
+
+#include <cstdio>
+#include <cstring>
+
+#include "USBPDMessages.h"
+
+// Values written by Save(): version and the number of identities, then each identity
+static const U64 identitiesVersion = 1;
+static const size_t identitiesHeaderValues = 2;
+static const size_t identityVdoValues = (maxIdentityVdos + 1) / 2;  // 2 VDOs per value
+static const size_t identityValues = 1 + identityVdoValues + 3;
+
+static const char* vconnPowerNames[NUM_VCONN_POWER] = {
+    "1W",
+    "1.5W",
+    "2W",
+    "3W",
+    "4W",
+    "5W",
+    "6W",
+};
+
+USBPDIdentities::USBPDIdentities() : USBPDCacheSection(identitiesVersion) { Clear(); }
+
+void USBPDIdentities::Clear() {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  mIdentities.clear();
+}
+
+U32 USBPDIdentities::AddResponse(const USBPDMessageRecord& record,
+                                 const uint32_t* vdos,
+                                 uint32_t numVdos) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  if (numVdos > maxIdentityVdos) {
+    numVdos = maxIdentityVdos;
+  }
+
+  // Identities are few, and the latest one is the most likely to be seen again
+  for (size_t i = mIdentities.size(); i-- > 0;) {
+    Identity& identity = mIdentities[i];
+
+    if (identity.sop == record.sop && identity.numVdos == numVdos &&
+        memcmp(identity.vdos, vdos, numVdos * sizeof(uint32_t)) == 0) {
+      identity.lastSample = record.startingSample;
+      identity.responses++;
+      return (U32)i;
+    }
+  }
+
+  Identity identity;
+  memset(&identity, 0, sizeof(identity));
+  identity.sop = record.sop;
+  identity.numVdos = (uint8_t)numVdos;
+  memcpy(identity.vdos, vdos, numVdos * sizeof(uint32_t));
+  identity.firstSample = record.startingSample;
+  identity.lastSample = record.startingSample;
+  identity.responses = 1;
+  mIdentities.push_back(identity);
+
+  return (U32)(mIdentities.size() - 1);
+}
+
+U32 USBPDIdentities::GetNumIdentities() {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  return (U32)mIdentities.size();
+}
+
+bool USBPDIdentities::GetIdentity(U32 identityIndex, Identity* identity) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  if (identityIndex >= mIdentities.size()) {
+    return false;
+  }
+
+  *identity = mIdentities[identityIndex];
+  return true;
+}
+
+IdentityVdoType USBPDIdentities::GetVdoType(uint8_t sop, uint32_t idHeader, uint32_t position) {
+  if (position < IdentityVdo_UFP) {
+    return (IdentityVdoType)position;
+  }
+
+  uint32_t productTypeVdo = position - IdentityVdo_UFP;
+  uint32_t productType = EXTRACT_BIT_RANGE(idHeader, 29, 27);
+
+  if (sop != SOPType_SOP) {
+    switch (productType) {
+      case SOPPrimeProductType_PassiveCable:
+        return (productTypeVdo == 0) ? IdentityVdo_PassiveCable : IdentityVdo_Unknown;
+
+      case SOPPrimeProductType_ActiveCable:
+        return (productTypeVdo == 0)   ? IdentityVdo_ActiveCable1
+               : (productTypeVdo == 1) ? IdentityVdo_ActiveCable2
+                                       : IdentityVdo_Unknown;
+
+      case SOPPrimeProductType_VCONNPoweredDevice:
+        return (productTypeVdo == 0) ? IdentityVdo_VPD : IdentityVdo_Unknown;
+
+      default:
+        return IdentityVdo_Unknown;
+    }
+  }
+
+  uint32_t dfpType = EXTRACT_BIT_RANGE(idHeader, 25, 23);
+  bool hasUfpVdo =
+      productType == SOPProductTypeUfp_PDUSBHub || productType == SOPProductTypeUfp_PDUSBPeripheral;
+  bool hasDfpVdo = dfpType == SOPProductTypeDfp_PDUSBHub ||
+                   dfpType == SOPProductTypeDfp_PDUSBHost ||
+                   dfpType == SOPProductTypeDfp_PowerBrick;
+
+  // A DRD sends its UFP VDO, a pad, then its DFP VDO
+  if (hasUfpVdo) {
+    if (productTypeVdo == 0) {
+      return IdentityVdo_UFP;
+    }
+
+    if (hasDfpVdo && productTypeVdo == 1) {
+      return IdentityVdo_Pad;
+    }
+
+    if (hasDfpVdo && productTypeVdo == 2) {
+      return IdentityVdo_DFP;
+    }
+  } else if (hasDfpVdo && productTypeVdo == 0) {
+    return IdentityVdo_DFP;
+  }
+
+  return IdentityVdo_Unknown;
+}
+
+void USBPDIdentities::DescribeVdo(IdentityVdoType type,
+                                  uint8_t sop,
+                                  uint32_t vdo,
+                                  char* text,
+                                  size_t textSize) {
+  switch (type) {
+    case IdentityVdo_IDHeader: {
+      USBPDMessages::IDHeaderVdo header(sop == SOPType_SOP ? SOPType_SOP : SOPType_SOP_PRIME, vdo);
+      char productType[64];
+
+      if (sop == SOPType_SOP) {
+        snprintf(productType,
+                 sizeof(productType),
+                 "UFP=%s, DFP=%s",
+                 GetSOPProductTypeUfpName(header.sopProductTypeUfp),
+                 GetSOPProductTypeDfpName(header.sopProductTypeDfp));
+      } else {
+        snprintf(productType,
+                 sizeof(productType),
+                 "%s",
+                 GetSOPPrimeProductTypeName(header.sopPrimeProductType));
+      }
+
+      snprintf(text,
+               textSize,
+               "VID=0x%04X, %s%s%s%s, %s",
+               header.vid,
+               productType,
+               header.usbHostCommunicationCapable ? ", USB Host" : "",
+               header.usbDeviceCommunicationCapable ? ", USB Device" : "",
+               header.modalOperationSupported ? ", Modal" : "",
+               GetConnectorTypeName(header.connectorType));
+    } break;
+
+    case IdentityVdo_CertStat:
+      snprintf(text, textSize, "XID=0x%08X", vdo);
+      break;
+
+    case IdentityVdo_Product: {
+      USBPDMessages::ProductVdo product(vdo);
+      snprintf(text, textSize, "PID=0x%04X bcdDevice=0x%04X", product.pid, product.bcdDevice);
+    } break;
+
+    case IdentityVdo_UFP: {
+      USBPDMessages::UFPVdo ufp(vdo);
+      char vconn[32] = "";
+
+      if (ufp.vconnRequired) {
+        snprintf(vconn,
+                 sizeof(vconn),
+                 ", VCONN %s",
+                 ufp.vconnPower < NUM_VCONN_POWER ? vconnPowerNames[ufp.vconnPower] : "Reserved");
+      }
+
+      snprintf(text,
+               textSize,
+               "UFP, %s, Device:%s%s%s%s%s%s%s%s",
+               GetUSBHighestSpeedName(ufp.highestSpeed),
+               ufp.usb2p0DeviceCapable ? " USB 2.0" : "",
+               ufp.usb2p0DeviceCapableBillboard ? " Billboard" : "",
+               ufp.usb3p2DeviceCapable ? " USB 3.2" : "",
+               ufp.usb4p0DeviceCapable ? " USB4" : "",
+               ufp.tbt3AltModeSupport ? ", TBT3" : "",
+               (ufp.pinReconfigureAltModeSupport || ufp.noPinReconfigureAltModeSupport)
+                   ? ", Alt Modes"
+                   : "",
+               vconn,
+               ufp.vbusRequired ? ", VBUS required" : "");
+    } break;
+
+    case IdentityVdo_DFP: {
+      USBPDMessages::DFPVdo dfp(vdo);
+      snprintf(text,
+               textSize,
+               "DFP, Host:%s%s%s, Port %u",
+               dfp.usb2p0HostCapable ? " USB 2.0" : "",
+               dfp.usb3p2HostCapable ? " USB 3.2" : "",
+               dfp.usb4p0HostCapable ? " USB4" : "",
+               dfp.portNumber);
+    } break;
+
+    case IdentityVdo_PassiveCable:
+    case IdentityVdo_ActiveCable1: {
+      USBPDMessages::CableVdo cable(vdo);
+      bool active = (type == IdentityVdo_ActiveCable1);
+
+      snprintf(text,
+               textSize,
+               "%s Cable, %s, %umA, %uV%s%s%s%s, HW %u FW %u",
+               active ? "Active" : "Passive",
+               GetUSBHighestSpeedName(cable.highestSpeed),
+               cable.vbusCurrent_mA,
+               cable.maxVbus_mV / 1000,
+               cable.eprModeCapable ? ", EPR" : "",
+               cable.captivePlug ? ", Captive" : "",
+               (active && cable.sbuSupported) ? ", SBU" : "",
+               (active && cable.sopDoublePrimeController) ? ", SOP''" : "",
+               cable.hwVersion,
+               cable.fwVersion);
+    } break;
+
+    case IdentityVdo_ActiveCable2: {
+      USBPDMessages::ActiveCableVdo2 cable(vdo);
+      snprintf(text,
+               textSize,
+               "%s %s, %s%s%s%s, Gen%u, Shutdown %uC",
+               cable.optical ? "Optical" : "Copper",
+               cable.retimer ? "Retimer" : "Redriver",
+               cable.twoLanes ? "2 lanes" : "1 lane",
+               cable.usb4Supported ? ", USB4" : "",
+               cable.usb3p2Supported ? ", USB 3.2" : "",
+               cable.usb2p0Supported ? ", USB 2.0" : "",
+               cable.usbGen2 ? 2 : 1,
+               cable.shutdownTemp_C);
+    } break;
+
+    case IdentityVdo_VPD: {
+      USBPDMessages::VPDVdo vpd(vdo);
+      snprintf(text,
+               textSize,
+               "VPD, %uV, Charge Through %s %umA, VBUS %umOhm, GND %umOhm, HW %u FW %u",
+               vpd.maxVbus_mV / 1000,
+               vpd.chargeThroughSupported ? "Yes" : "No",
+               vpd.chargeThroughCurrent_mA,
+               vpd.vbusImpedance_mOhm,
+               vpd.groundImpedance_mOhm,
+               vpd.hwVersion,
+               vpd.fwVersion);
+    } break;
+
+    default:
+      snprintf(text, textSize, "VDO=0x%08X", vdo);
+      break;
+  }
+}
+
+void USBPDIdentities::WriteIdentities(std::ostream& stream, U64 triggerSample, U32 sampleRateHz) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  stream << "SOP,VID,PID,XID,bcdDevice,Product type,Product type VDOs,Responses,"
+         << "First seen [s],Last seen [s]" << std::endl;
+
+  for (const Identity& identity : mIdentities) {
+    USBPDMessages::IDHeaderVdo header(
+        identity.sop == SOPType_SOP ? SOPType_SOP : SOPType_SOP_PRIME, identity.vdos[0]);
+    USBPDMessages::ProductVdo product(identity.vdos[IdentityVdo_Product]);
+
+    char ids[64];
+    snprintf(ids,
+             sizeof(ids),
+             "0x%04X,0x%04X,0x%08X,0x%04X",
+             header.vid,
+             product.pid,
+             identity.vdos[IdentityVdo_CertStat],
+             product.bcdDevice);
+
+    stream << SOPTypeNames[identity.sop] << "," << ids << ",";
+
+    if (identity.sop == SOPType_SOP) {
+      stream << GetSOPProductTypeUfpName(header.sopProductTypeUfp) << " / "
+             << GetSOPProductTypeDfpName(header.sopProductTypeDfp);
+    } else {
+      stream << GetSOPPrimeProductTypeName(header.sopPrimeProductType);
+    }
+    stream << ",";
+
+    // The VDO descriptions are separated with commas, so keep them in one quoted field
+    stream << "\"";
+    const char* separator = "";
+    for (uint32_t i = IdentityVdo_UFP; i < identity.numVdos; i++) {
+      IdentityVdoType type = GetVdoType(identity.sop, identity.vdos[0], i);
+      if (type == IdentityVdo_Pad) {
+        continue;
+      }
+
+      char vdo[160];
+      DescribeVdo(type, identity.sop, identity.vdos[i], vdo, sizeof(vdo));
+      stream << separator << vdo;
+      separator = "; ";
+    }
+    stream << "\"," << identity.responses << ",";
+
+    char time_str[128];
+    AnalyzerHelpers::GetTimeString(
+        identity.firstSample, triggerSample, sampleRateHz, time_str, sizeof(time_str));
+    stream << time_str << ",";
+    AnalyzerHelpers::GetTimeString(
+        identity.lastSample, triggerSample, sampleRateHz, time_str, sizeof(time_str));
+    stream << time_str << std::endl;
+  }
+}
+
+void USBPDIdentities::SaveValues(std::vector<U64>* values) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  values->push_back(mIdentities.size());
+
+  for (const Identity& identity : mIdentities) {
+    values->push_back((U64)identity.sop | ((U64)identity.numVdos << 8));
+
+    for (size_t i = 0; i < maxIdentityVdos; i += 2) {
+      values->push_back((U64)identity.vdos[i] | ((U64)identity.vdos[i + 1] << 32));
+    }
+
+    values->push_back(identity.firstSample);
+    values->push_back(identity.lastSample);
+    values->push_back(identity.responses);
+  }
+}
+
+bool USBPDIdentities::CheckValues(const std::vector<U64>& values) const {
+  if (!HasRecords(values, identitiesHeaderValues, 1, identityValues)) {
+    return false;
+  }
+
+  for (size_t i = identitiesHeaderValues; i < values.size(); i += identityValues) {
+    U64 sop = values[i] & 0xFF;
+    U64 numVdos = (values[i] >> 8) & 0xFF;
+
+    if (sop >= NUM_SOP_TYPE || numVdos < IdentityVdo_UFP || numVdos > maxIdentityVdos) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void USBPDIdentities::LoadValues(const std::vector<U64>& values) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  mIdentities.resize((size_t)values[1]);
+  const U64* value = &values[identitiesHeaderValues];
+
+  for (Identity& identity : mIdentities) {
+    identity.sop = (uint8_t)*value;
+    identity.numVdos = (uint8_t)(*value >> 8);
+    value++;
+
+    for (size_t i = 0; i < maxIdentityVdos; i += 2) {
+      identity.vdos[i] = (uint32_t)*value;
+      identity.vdos[i + 1] = (uint32_t)(*value >> 32);
+      value++;
+    }
+
+    identity.firstSample = *value++;
+    identity.lastSample = *value++;
+    identity.responses = *value++;
+  }
+}
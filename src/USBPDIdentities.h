@@ -0,0 +1,88 @@
+#ifndef USBPD_IDENTITIES_H
+#define USBPD_IDENTITIES_H
+
+#include <LogicPublicTypes.h>
+
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "USBPDCacheSection.h"
+#include "USBPDMessageIndex.h"
+#include "USBPDTypes.h"
+
+/**
+ * @brief Identities reported by ACK'd Discover Identity commands: the port partner's on SOP, the
+ * cable plugs' on SOP' and SOP''.
+ *
+ * A device answers Discover Identity with the same VDOs each time it is asked, so each distinct
+ * identity is kept once per SOP, with the number of responses carrying it and when it was first
+ * and last seen. The VDOs are kept raw, and decoded when the identities are exported.
+ *
+ * The decoder adds responses from the worker thread while the identities are exported from the UI
+ * thread, so all methods are synchronized.
+ */
+class USBPDIdentities : public USBPDCacheSection {
+ public:
+  struct Identity {
+    uint8_t sop;
+    uint8_t numVdos;  // 3 to maxIdentityVdos
+    uint32_t vdos[maxIdentityVdos];
+    U64 firstSample;  // Start of the first and last responses
+    U64 lastSample;
+    U64 responses;
+  };
+
+  USBPDIdentities();
+
+  void Clear();
+
+  /**
+   * @brief Follow a Discover Identity ACK received without errors
+   *
+   * @param vdos the VDOs following the VDM Header: ID Header, Cert Stat, Product, then the Product
+   * Type VDOs
+   * @return the index of the identity
+   */
+  U32 AddResponse(const USBPDMessageRecord& record, const uint32_t* vdos, uint32_t numVdos);
+
+  U32 GetNumIdentities();
+  bool GetIdentity(U32 identityIndex, Identity* identity);
+
+  /**
+   * @brief Kind of the VDO at a position of a Discover Identity ACK, 0 being the ID Header. The
+   * Product Type VDOs depend on the SOP and the product types in the ID Header.
+   */
+  static IdentityVdoType GetVdoType(uint8_t sop, uint32_t idHeader, uint32_t position);
+
+  /**
+   * @brief Describe a VDO of a Discover Identity ACK concisely, e.g. "PID=0x1234 bcdDevice=0x0100"
+   */
+  static void DescribeVdo(IdentityVdoType type,
+                          uint8_t sop,
+                          uint32_t vdo,
+                          char* text,
+                          size_t textSize);
+
+  /**
+   * @brief Write the identities as CSV, one line per identity
+   *
+   * @param triggerSample sample the times are relative to
+   */
+  void WriteIdentities(std::ostream& stream, U64 triggerSample, U32 sampleRateHz);
+
+ protected:
+  /**
+   * @brief Save / restore the identities, for the decode cache
+   */
+  virtual void SaveValues(std::vector<U64>* values);
+  virtual bool CheckValues(const std::vector<U64>& values) const;
+  virtual void LoadValues(const std::vector<U64>& values);
+
+  std::mutex mMutex;
+
+  std::vector<Identity> mIdentities;  // In order of first response
+};
+
+#endif  // USBPD_IDENTITIES_H
@@ -0,0 +1,221 @@
+#include "USBPDMessageIndex.h"
+
+#include <algorithm>
+
+USBPDMessageIndex::USBPDMessageIndex() {}
+
+void USBPDMessageIndex::Clear() {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  mMessages.clear();
+
+  for (auto& list : mMessageTypeLists) {
+    list.clear();
+  }
+
+  for (auto& list : mSopLists) {
+    list.clear();
+  }
+
+  for (auto& list : mMessageIdLists) {
+    list.clear();
+  }
+
+  for (auto& list : mFlagLists) {
+    list.clear();
+  }
+
+  mResets.clear();
+  mHardResetList.clear();
+  mCableResetList.clear();
+}
+
+uint32_t USBPDMessageIndex::GetMessageTypeValue(uint16_t header) {
+  uint32_t messageType = EXTRACT_BIT_RANGE(header, 4, 0);
+
+  // Extended messages are told apart by the Extended bit alone, whatever their Number of Data
+  // Objects says
+  if (CHECK_BIT(header, 15)) {
+    return 64 + messageType;
+  }
+
+  bool isDataMessage = EXTRACT_BIT_RANGE(header, 14, 12) > 0;
+
+  return isDataMessage ? (32 + messageType) : messageType;
+}
+
+void USBPDMessageIndex::Add(const USBPDMessageRecord& record) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  U32 messageIndex = (U32)mMessages.size();
+  mMessages.push_back(record);
+
+  if (record.sop < NUM_SOP_TYPE) {
+    mMessageTypeLists[GetMessageTypeValue(record.header)].push_back(messageIndex);
+    mMessageIdLists[EXTRACT_BIT_RANGE(record.header, 11, 9)].push_back(messageIndex);
+  }
+
+  mSopLists[std::min<int>(record.sop, NUM_SOP_TYPE)].push_back(messageIndex);
+
+  for (int i = 0; i < NUM_MESSAGE_FLAG; i++) {
+    if (record.flags & (1 << i)) {
+      mFlagLists[i].push_back(messageIndex);
+    }
+  }
+}
+
+void USBPDMessageIndex::AddReset(const USBPDResetRecord& record) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  U32 resetIndex = (U32)mResets.size();
+  mResets.push_back(record);
+
+  if (record.type == OrderedSet_HardReset) {
+    mHardResetList.push_back(resetIndex);
+  } else if (record.type == OrderedSet_CableReset) {
+    mCableResetList.push_back(resetIndex);
+  }
+}
+
+U64 USBPDMessageIndex::GetNumMessages() {
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mMessages.size();
+}
+
+bool USBPDMessageIndex::GetMessage(U64 messageIndex, USBPDMessageRecord* record) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  if (messageIndex >= mMessages.size()) {
+    return false;
+  }
+
+  *record = mMessages[messageIndex];
+  return true;
+}
+
+U64 USBPDMessageIndex::GetNumResets() {
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mResets.size();
+}
+
+bool USBPDMessageIndex::GetReset(U64 resetIndex, USBPDResetRecord* record) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  if (resetIndex >= mResets.size()) {
+    return false;
+  }
+
+  *record = mResets[resetIndex];
+  return true;
+}
+
+bool USBPDMessageIndex::FindMessageAt(U64 sample, U64* messageIndex) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  // First message starting after sample, the one before it is the only candidate
+  auto it = std::upper_bound(
+      mMessages.begin(),
+      mMessages.end(),
+      sample,
+      [](U64 s, const USBPDMessageRecord& record) { return s < record.startingSample; });
+
+  if (it == mMessages.begin()) {
+    return false;
+  }
+
+  --it;
+  if (sample > it->endingSample) {
+    return false;
+  }
+
+  *messageIndex = it - mMessages.begin();
+  return true;
+}
+
+const std::vector<U32>* USBPDMessageIndex::GetList(Key key, uint32_t value) const {
+  switch (key) {
+    case Key_MessageType:
+      return (value < numMessageTypeValues) ? &mMessageTypeLists[value] : NULL;
+
+    case Key_SOP:
+      return (value <= NUM_SOP_TYPE) ? &mSopLists[value] : NULL;
+
+    case Key_MessageId:
+      return (value < 8) ? &mMessageIdLists[value] : NULL;
+
+    case Key_Flag:
+      for (int i = 0; i < NUM_MESSAGE_FLAG; i++) {
+        if (value == (1u << i)) {
+          return &mFlagLists[i];
+        }
+      }
+      return NULL;
+
+    case Key_Reset:
+      if (value == OrderedSet_HardReset) {
+        return &mHardResetList;
+      }
+      return (value == OrderedSet_CableReset) ? &mCableResetList : NULL;
+
+    default:
+      return NULL;
+  }
+}
+
+std::vector<U32>::const_iterator USBPDMessageIndex::LowerBound(Key key,
+                                                               const std::vector<U32>& list,
+                                                               U64 sample) const {
+  if (key == Key_Reset) {
+    return std::lower_bound(list.begin(), list.end(), sample, [this](U32 resetIndex, U64 s) {
+      return mResets[resetIndex].startingSample < s;
+    });
+  }
+
+  return std::lower_bound(list.begin(), list.end(), sample, [this](U32 messageIndex, U64 s) {
+    return mMessages[messageIndex].startingSample < s;
+  });
+}
+
+bool USBPDMessageIndex::FindNth(Key key, uint32_t value, U64 fromSample, U64 n, U64* index) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  const std::vector<U32>* list = GetList(key, value);
+  if (list == NULL) {
+    return false;
+  }
+
+  auto first = LowerBound(key, *list, fromSample);
+  if ((U64)(list->end() - first) <= n) {
+    return false;
+  }
+
+  *index = *(first + n);
+  return true;
+}
+
+U64 USBPDMessageIndex::Count(Key key, uint32_t value, U64 fromSample, U64 toSample) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  const std::vector<U32>* list = GetList(key, value);
+  if (list == NULL || toSample <= fromSample) {
+    return 0;
+  }
+
+  return LowerBound(key, *list, toSample) - LowerBound(key, *list, fromSample);
+}
+
+U64 USBPDMessageIndex::GetOrdinal(Key key, uint32_t value, U64 messageIndex) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  const std::vector<U32>* list = GetList(key, value);
+  if (list == NULL) {
+    return 0;
+  }
+
+  auto it = std::lower_bound(list->begin(), list->end(), messageIndex);
+  if (it == list->end() || *it != messageIndex) {
+    return 0;
+  }
+
+  return (it - list->begin()) + 1;
+}
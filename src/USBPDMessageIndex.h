@@ -0,0 +1,143 @@
+#ifndef USBPD_MESSAGE_INDEX_H
+#define USBPD_MESSAGE_INDEX_H
+
+#include <LogicPublicTypes.h>
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "USBPDTypes.h"
+
+enum MessageFlag {
+  MessageFlag_CrcError = (1 << 0),
+  MessageFlag_EopError = (1 << 1),
+  MessageFlag_SopError = (1 << 2),
+  MessageFlag_InvalidSymbol = (1 << 3),
+  MessageFlag_ShortIdentity = (1 << 4),  // Discover Identity ACK without its 3 mandatory VDOs
+
+  NUM_MESSAGE_FLAG = 5
+};
+
+// Flags of a message damaged on the way, which the receiver does not acknowledge and the sender
+// retries. The other flags mark messages that arrived intact but break the protocol.
+static const uint8_t messageDamageFlags =
+    MessageFlag_CrcError | MessageFlag_EopError | MessageFlag_SopError | MessageFlag_InvalidSymbol;
+
+/**
+ * @brief Summary of one decoded message (or failed message, if the SOP could not be detected)
+ */
+struct USBPDMessageRecord {
+  U64 startingSample;  // Start of the preamble
+  U64 endingSample;    // End of the EOP
+
+  uint16_t header;
+  uint8_t sop;     // SOPType, NUM_SOP_TYPE if the SOP was not detected
+  uint8_t flags;   // MessageFlag bits
+  uint8_t sender;  // USBPDRoleTracker Sender and SenderFlag bits, from the roles before the message
+
+  uint32_t firstDataObject;  // First data object, 0 if the message has none
+  uint32_t crc;              // Received CRC
+};
+
+/**
+ * @brief A Hard Reset or Cable Reset, which is sent on its own rather than as a message
+ */
+struct USBPDResetRecord {
+  U64 startingSample;  // Start of the preamble
+  U64 endingSample;    // End of the last K-code
+  uint8_t type;        // OrderedSet_HardReset or OrderedSet_CableReset
+};
+
+/**
+ * @brief Index over every message and reset decoded so far.
+ *
+ * For each key (message type, SOP type, message ID, each error flag and each kind of reset) the
+ * index keeps the numbers of the messages, or resets, that match it. They are added in capture
+ * order, so every list is sorted by sample number and can be searched with a binary search: to
+ * find the nth match after a sample, to count the matches in a range, or to number a message in
+ * the search text.
+ *
+ * The decoder adds messages from the worker thread while the results are read from the UI thread,
+ * so all methods are synchronized.
+ */
+class USBPDMessageIndex {
+ public:
+  enum Key {
+    Key_MessageType,  // Value: USBPDMessageIndex::GetMessageTypeValue()
+    Key_SOP,          // Value: SOPType, or NUM_SOP_TYPE for SOP errors
+    Key_MessageId,    // Value: 0..7
+    Key_Flag,         // Value: MessageFlag bit
+    Key_Reset,        // Value: OrderedSet_HardReset or OrderedSet_CableReset, matches resets
+
+    NUM_KEY
+  };
+
+  USBPDMessageIndex();
+
+  void Clear();
+  void Add(const USBPDMessageRecord& record);
+  void AddReset(const USBPDResetRecord& record);
+
+  U64 GetNumMessages();
+  bool GetMessage(U64 messageIndex, USBPDMessageRecord* record);
+
+  U64 GetNumResets();
+  bool GetReset(U64 resetIndex, USBPDResetRecord* record);
+
+  /**
+   * @brief Find the message containing a sample number
+   *
+   * @return true if a message spans sample, and messageIndex was set
+   */
+  bool FindMessageAt(U64 sample, U64* messageIndex);
+
+  /**
+   * @brief Find the nth (counting from 0) message matching key/value that starts at or after
+   * fromSample. For Key_Reset, find the nth reset instead.
+   *
+   * @return true if there is such a message, and index was set to its message (or reset) number
+   */
+  bool FindNth(Key key, uint32_t value, U64 fromSample, U64 n, U64* index);
+
+  /**
+   * @brief Count the messages (or, for Key_Reset, the resets) matching key/value that start in
+   * [fromSample, toSample)
+   */
+  U64 Count(Key key, uint32_t value, U64 fromSample, U64 toSample);
+
+  /**
+   * @brief Position of a message among the messages matching key/value, counting from 1
+   *
+   * @return the position, or 0 if the message does not match key/value
+   */
+  U64 GetOrdinal(Key key, uint32_t value, U64 messageIndex);
+
+  /**
+   * @brief Value identifying the message type in a header, for Key_MessageType
+   *
+   * Control messages map to 0..31, data messages to 32..63 and extended messages to 64..95
+   */
+  static uint32_t GetMessageTypeValue(uint16_t header);
+  static const uint32_t numMessageTypeValues = 96;
+
+ protected:
+  const std::vector<U32>* GetList(Key key, uint32_t value) const;
+  std::vector<U32>::const_iterator LowerBound(Key key,
+                                              const std::vector<U32>& list,
+                                              U64 sample) const;
+
+  std::mutex mMutex;
+
+  std::vector<USBPDMessageRecord> mMessages;
+  std::vector<USBPDResetRecord> mResets;
+
+  std::vector<U32> mMessageTypeLists[numMessageTypeValues];
+  std::vector<U32> mSopLists[NUM_SOP_TYPE + 1];
+  std::vector<U32> mMessageIdLists[8];
+  std::vector<U32> mFlagLists[NUM_MESSAGE_FLAG];
+  std::vector<U32> mHardResetList;
+  std::vector<U32> mCableResetList;
+};
+
+#endif  // USBPD_MESSAGE_INDEX_H
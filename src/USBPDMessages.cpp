@@ -1,5 +1,7 @@
 #include "USBPDMessages.h"
 
+#include <algorithm>
+
 using namespace USBPDMessages;
 
 FixedSupplySourcePDO::FixedSupplySourcePDO(uint32_t val) {
@@ -94,6 +96,14 @@ Header::Header(SOPType detectedSop, uint16_t val) {
   specRev = (PDSpecRevision)EXTRACT_BIT_RANGE(val, 7, 6);      // Bits 7..6 == Spec Revision
   portDataRole = CHECK_BIT(val, 5);            // Bit 5 == Port Data Role (SOP only)
   messageType = EXTRACT_BIT_RANGE(val, 4, 0);  // Bits 4..0 == Message Type
+  extended = CHECK_BIT(val, 15);               // Bit 15 == Extended
+}
+
+ExtendedHeader::ExtendedHeader(uint16_t val) {
+  chunked = CHECK_BIT(val, 15);                  // Bit 15 == Chunked
+  chunkNumber = EXTRACT_BIT_RANGE(val, 14, 11);  // Bits 14..11 == Chunk Number
+  requestChunk = CHECK_BIT(val, 10);             // Bit 10 == Request Chunk
+  dataSize = EXTRACT_BIT_RANGE(val, 8, 0);       // Bits 8..0 == Data Size
 }
 
 FixedSupplyRequest::FixedSupplyRequest(uint32_t val) {
@@ -213,6 +223,58 @@ VDMHeader::VDMHeader(uint32_t val) {
   }
 }
 
+EPRMode::EPRMode(uint32_t val) {
+  action = EXTRACT_BIT_RANGE(val, 31, 24);
+  data = EXTRACT_BIT_RANGE(val, 23, 16);
+}
+
+BatteryStatus::BatteryStatus(uint32_t val) {
+  presentCapacity_100mWh = EXTRACT_BIT_RANGE(val, 31, 16);
+  invalidReference = CHECK_BIT(val, 8);
+  present = CHECK_BIT(val, 9);
+  chargingStatus = EXTRACT_BIT_RANGE(val, 11, 10);
+}
+
+Alert::Alert(uint32_t val) {
+  types = EXTRACT_BIT_RANGE(val, 31, 24);
+  fixedBatteries = EXTRACT_BIT_RANGE(val, 23, 20);
+  hotSwappableBatteries = EXTRACT_BIT_RANGE(val, 19, 16);
+  extendedAlertEvent = EXTRACT_BIT_RANGE(val, 3, 0);
+}
+
+CountryCode::CountryCode(uint32_t val) {
+  code[0] = (char)EXTRACT_BIT_RANGE(val, 31, 24);
+  code[1] = (char)EXTRACT_BIT_RANGE(val, 23, 16);
+  code[2] = 0;
+}
+
+EnterUSB::EnterUSB(uint32_t val) {
+  usbMode = EXTRACT_BIT_RANGE(val, 30, 28);
+  usb4Drd = CHECK_BIT(val, 26);
+  usb3Drd = CHECK_BIT(val, 25);
+  cableSpeed = EXTRACT_BIT_RANGE(val, 23, 21);
+  cableType = EXTRACT_BIT_RANGE(val, 20, 19);
+  cableCurrent = EXTRACT_BIT_RANGE(val, 18, 17);
+  pcieSupport = CHECK_BIT(val, 16);
+  dpSupport = CHECK_BIT(val, 15);
+  tbtSupport = CHECK_BIT(val, 14);
+  hostPresent = CHECK_BIT(val, 13);
+}
+
+SourceInfo::SourceInfo(uint32_t val) {
+  guaranteed = CHECK_BIT(val, 31);
+  maximumPdp_W = EXTRACT_BIT_RANGE(val, 30, 24);
+  presentPdp_W = EXTRACT_BIT_RANGE(val, 23, 16);
+  reportedPdp_W = EXTRACT_BIT_RANGE(val, 15, 8);
+}
+
+Revision::Revision(uint32_t val) {
+  revisionMajor = EXTRACT_BIT_RANGE(val, 31, 28);
+  revisionMinor = EXTRACT_BIT_RANGE(val, 27, 24);
+  versionMajor = EXTRACT_BIT_RANGE(val, 23, 20);
+  versionMinor = EXTRACT_BIT_RANGE(val, 19, 16);
+}
+
 IDHeaderVdo::IDHeaderVdo(SOPType sop, uint32_t val) {
   sopType = sop;
 
@@ -236,4 +298,210 @@ IDHeaderVdo::IDHeaderVdo(SOPType sop, uint32_t val) {
 ProductVdo::ProductVdo(uint32_t val) {
   pid = EXTRACT_BIT_RANGE(val, 31, 16);
   bcdDevice = EXTRACT_BIT_RANGE(val, 15, 0);
-}
\ No newline at end of file
+}
+
+UFPVdo::UFPVdo(uint32_t val) {
+  version = (UFPVDOVersion)EXTRACT_BIT_RANGE(val, 31, 29);
+
+  usb2p0DeviceCapable = CHECK_BIT(val, 24);
+  usb2p0DeviceCapableBillboard = CHECK_BIT(val, 25);
+  usb3p2DeviceCapable = CHECK_BIT(val, 26);
+  usb4p0DeviceCapable = CHECK_BIT(val, 27);
+
+  vconnPower = (VCONNPower)EXTRACT_BIT_RANGE(val, 10, 8);
+  vconnRequired = CHECK_BIT(val, 7);
+  vbusRequired = CHECK_BIT(val, 6);
+
+  tbt3AltModeSupport = CHECK_BIT(val, 3);
+  pinReconfigureAltModeSupport = CHECK_BIT(val, 4);
+  noPinReconfigureAltModeSupport = CHECK_BIT(val, 5);
+
+  highestSpeed = (USBHighestSpeed)EXTRACT_BIT_RANGE(val, 2, 0);
+}
+
+DFPVdo::DFPVdo(uint32_t val) {
+  version = EXTRACT_BIT_RANGE(val, 31, 29);
+
+  usb2p0HostCapable = CHECK_BIT(val, 24);
+  usb3p2HostCapable = CHECK_BIT(val, 25);
+  usb4p0HostCapable = CHECK_BIT(val, 26);
+
+  portNumber = EXTRACT_BIT_RANGE(val, 4, 0);
+}
+
+// Maximum VBUS Voltage field of the cable and VPD VDOs
+static const uint32_t cableMaxVbus_mV[4] = {20000, 30000, 40000, 50000};
+
+CableVdo::CableVdo(uint32_t val) {
+  hwVersion = EXTRACT_BIT_RANGE(val, 31, 28);
+  fwVersion = EXTRACT_BIT_RANGE(val, 27, 24);
+  vdoVersion = EXTRACT_BIT_RANGE(val, 23, 21);
+  captivePlug = EXTRACT_BIT_RANGE(val, 19, 18) == 3;
+  eprModeCapable = CHECK_BIT(val, 17);
+  latency = EXTRACT_BIT_RANGE(val, 16, 13);
+  termination = EXTRACT_BIT_RANGE(val, 12, 11);
+  maxVbus_mV = cableMaxVbus_mV[EXTRACT_BIT_RANGE(val, 10, 9)];
+
+  switch (EXTRACT_BIT_RANGE(val, 6, 5)) {
+    case 1:
+      vbusCurrent_mA = 3000;
+      break;
+
+    case 2:
+      vbusCurrent_mA = 5000;
+      break;
+
+    default:
+      vbusCurrent_mA = 0;
+      break;
+  }
+
+  highestSpeed = (USBHighestSpeed)EXTRACT_BIT_RANGE(val, 2, 0);
+
+  // Active cables only. SBU Supported and VBUS Through Cable are inverted
+  sbuSupported = !CHECK_BIT(val, 8);
+  sbuActive = CHECK_BIT(val, 7);
+  vbusThroughCable = CHECK_BIT(val, 4);
+  sopDoublePrimeController = CHECK_BIT(val, 3);
+}
+
+ActiveCableVdo2::ActiveCableVdo2(uint32_t val) {
+  maxOperatingTemp_C = EXTRACT_BIT_RANGE(val, 31, 24);
+  shutdownTemp_C = EXTRACT_BIT_RANGE(val, 23, 16);
+  optical = CHECK_BIT(val, 10);
+  retimer = CHECK_BIT(val, 9);
+
+  // The USB support bits are set when the cable does not support the USB version
+  usb4Supported = !CHECK_BIT(val, 8);
+  usb2p0Supported = !CHECK_BIT(val, 5);
+  usb3p2Supported = !CHECK_BIT(val, 4);
+  twoLanes = CHECK_BIT(val, 3);
+  usbGen2 = CHECK_BIT(val, 0);
+}
+
+VPDVdo::VPDVdo(uint32_t val) {
+  hwVersion = EXTRACT_BIT_RANGE(val, 31, 28);
+  fwVersion = EXTRACT_BIT_RANGE(val, 27, 24);
+  vdoVersion = EXTRACT_BIT_RANGE(val, 23, 21);
+  maxVbus_mV = cableMaxVbus_mV[EXTRACT_BIT_RANGE(val, 16, 15)];
+  chargeThroughCurrent_mA = CHECK_BIT(val, 14) ? 5000 : 3000;
+  vbusImpedance_mOhm = EXTRACT_BIT_RANGE(val, 12, 7) * 2;
+  groundImpedance_mOhm = EXTRACT_BIT_RANGE(val, 6, 1);
+  chargeThroughSupported = CHECK_BIT(val, 0);
+}
+
+DPCapabilitiesVdo::DPCapabilitiesVdo(uint32_t val) {
+  ufpDCapable = CHECK_BIT(val, 0);
+  dfpDCapable = CHECK_BIT(val, 1);
+  signaling = EXTRACT_BIT_RANGE(val, 5, 2);
+  receptacle = CHECK_BIT(val, 6);
+  usb2p0NotUsed = CHECK_BIT(val, 7);
+  dfpDPinAssignments = EXTRACT_BIT_RANGE(val, 15, 8);
+  ufpDPinAssignments = EXTRACT_BIT_RANGE(val, 23, 16);
+}
+
+DPStatusVdo::DPStatusVdo(uint32_t val) {
+  connection = EXTRACT_BIT_RANGE(val, 1, 0);
+  powerLow = CHECK_BIT(val, 2);
+  enabled = CHECK_BIT(val, 3);
+  multiFunctionPreferred = CHECK_BIT(val, 4);
+  usbConfigurationRequest = CHECK_BIT(val, 5);
+  exitRequest = CHECK_BIT(val, 6);
+  hpdHigh = CHECK_BIT(val, 7);
+  irqHpd = CHECK_BIT(val, 8);
+}
+
+DPConfigureVdo::DPConfigureVdo(uint32_t val) {
+  configuration = EXTRACT_BIT_RANGE(val, 1, 0);
+  signaling = EXTRACT_BIT_RANGE(val, 5, 2);
+  pinAssignment = EXTRACT_BIT_RANGE(val, 15, 8);
+}
+
+/**
+ * @brief Little-endian field of an extended message payload, 0 past the end of the payload
+ */
+static uint32_t GetPayloadField(const uint8_t* data, uint32_t size, uint32_t offset, int bytes) {
+  uint32_t value = 0;
+
+  for (int i = 0; i < bytes && offset + i < size; i++) {
+    value |= (uint32_t)data[offset + i] << (8 * i);
+  }
+
+  return value;
+}
+
+SourceCapabilitiesExtended::SourceCapabilitiesExtended(const uint8_t* data, uint32_t size) {
+  vid = GetPayloadField(data, size, 0, 2);
+  pid = GetPayloadField(data, size, 2, 2);
+  xid = GetPayloadField(data, size, 4, 4);
+  fwVersion = GetPayloadField(data, size, 8, 1);
+  hwVersion = GetPayloadField(data, size, 9, 1);
+  holdupTime_ms = GetPayloadField(data, size, 11, 1);
+  numberOfBatteries = GetPayloadField(data, size, 22, 1);
+  sourcePdp_W = GetPayloadField(data, size, 23, 1);
+  eprSourcePdp_W = GetPayloadField(data, size, 24, 1);
+}
+
+Status::Status(const uint8_t* data, uint32_t size) {
+  internalTemp_C = GetPayloadField(data, size, 0, 1);
+  presentInput = GetPayloadField(data, size, 1, 1);
+  presentBatteryInput = GetPayloadField(data, size, 2, 1);
+  eventFlags = GetPayloadField(data, size, 3, 1);
+  temperatureStatus = EXTRACT_BIT_RANGE(GetPayloadField(data, size, 4, 1), 2, 1);
+  powerStatus = GetPayloadField(data, size, 5, 1);
+}
+
+PPSStatus::PPSStatus(const uint8_t* data, uint32_t size) {
+  uint32_t outputVoltage = GetPayloadField(data, size, 0, 2);
+  uint32_t outputCurrent = GetPayloadField(data, size, 2, 1);
+  uint32_t flags = GetPayloadField(data, size, 3, 1);
+
+  outputVoltageSupported = (outputVoltage != 0xFFFF);
+  outputVoltage_mV = outputVoltage * 20;  // 20mV units
+  outputCurrentSupported = (outputCurrent != 0xFF);
+  outputCurrent_mA = outputCurrent * 50;  // 50mA units
+  temperatureFlag = EXTRACT_BIT_RANGE(flags, 2, 1);
+  currentLimitMode = CHECK_BIT(flags, 3);
+}
+
+ManufacturerInfo::ManufacturerInfo(const uint8_t* data, uint32_t size) {
+  vid = GetPayloadField(data, size, 0, 2);
+  pid = GetPayloadField(data, size, 2, 2);
+
+  uint32_t length = 0;
+  for (uint32_t i = 4; i < size && length < sizeof(string) - 1 && data[i] != 0; i++) {
+    // Keep the string printable, it ends up in the bubble text and CSV export
+    string[length++] = (data[i] >= 0x20 && data[i] < 0x7F && data[i] != ',') ? data[i] : '.';
+  }
+  string[length] = 0;
+}
+
+EPRSourceCapabilities::EPRSourceCapabilities(const uint8_t* data, uint32_t size) {
+  numPdos = std::min<uint32_t>(size / 4, maxEPRSourcePdos);
+
+  for (uint32_t i = 0; i < numPdos; i++) {
+    pdos[i] = GetPayloadField(data, size, i * 4, 4);
+  }
+}
+
+FirmwareUpdateHeader::FirmwareUpdateHeader(const uint8_t* data, uint32_t size) {
+  protocolVersion = GetPayloadField(data, size, 0, 1);
+  messageType = GetPayloadField(data, size, 1, 1);
+  request = (messageType & FirmwareUpdate_Request) != 0;
+
+  uint32_t headerBytes = 2;
+  uint8_t command = messageType & ~FirmwareUpdate_Request;
+
+  if (request && (command == FirmwareUpdate_PDFU_DATA || command == FirmwareUpdate_PDFU_DATA_NR)) {
+    dataBlockIndex = GetPayloadField(data, size, 2, 2);
+    headerBytes = 4;
+  } else if (!request && command == FirmwareUpdate_PDFU_DATA) {
+    // Status, Wait Time and Num Data NR come before the block number
+    dataBlockIndex = GetPayloadField(data, size, 5, 2);
+    headerBytes = 7;
+  } else {
+    dataBlockIndex = 0;
+  }
+
+  payloadBytes = (size > headerBytes) ? size - headerBytes : 0;
+}
@@ -93,6 +93,17 @@ struct Header {
   PDSpecRevision specRev;
   bool portDataRole;
   uint8_t messageType;
+  bool extended;
+};
+
+struct ExtendedHeader {
+  ExtendedHeader() = delete;
+  ExtendedHeader(uint16_t val);
+
+  bool chunked;
+  uint8_t chunkNumber;
+  bool requestChunk;
+  uint16_t dataSize;
 };
 
 struct FixedSupplyRequest {
@@ -198,6 +209,77 @@ struct VDMHeader {
   };
 };
 
+struct EPRMode {
+  EPRMode() = delete;
+  EPRMode(uint32_t val);
+
+  uint8_t action;  // EPRModeAction
+  uint8_t data;    // Sink Operational PDP in W for Enter, the cause for Enter Failed, otherwise 0
+};
+
+struct BatteryStatus {
+  BatteryStatus() = delete;
+  BatteryStatus(uint32_t val);
+
+  uint16_t presentCapacity_100mWh;  // 0xFFFF if unknown
+  bool invalidReference;
+  bool present;
+  uint8_t chargingStatus;  // Valid if present
+};
+
+struct Alert {
+  Alert() = delete;
+  Alert(uint32_t val);
+
+  uint8_t types;  // Type of Alert bit field, bit 1 Battery Status Change to bit 7 Extended Alert
+  uint8_t fixedBatteries;
+  uint8_t hotSwappableBatteries;
+  uint8_t extendedAlertEvent;  // Valid if the Extended Alert type is set
+};
+
+struct CountryCode {
+  CountryCode() = delete;
+  CountryCode(uint32_t val);
+
+  char code[3];  // ISO 3166 alpha-2, NUL terminated
+};
+
+struct EnterUSB {
+  EnterUSB() = delete;
+  EnterUSB(uint32_t val);
+
+  uint8_t usbMode;
+  bool usb4Drd;
+  bool usb3Drd;
+  uint8_t cableSpeed;
+  uint8_t cableType;
+  uint8_t cableCurrent;
+  bool pcieSupport;
+  bool dpSupport;
+  bool tbtSupport;
+  bool hostPresent;
+};
+
+struct SourceInfo {
+  SourceInfo() = delete;
+  SourceInfo(uint32_t val);
+
+  bool guaranteed;  // Managed capability otherwise
+  uint8_t maximumPdp_W;
+  uint8_t presentPdp_W;
+  uint8_t reportedPdp_W;
+};
+
+struct Revision {
+  Revision() = delete;
+  Revision(uint32_t val);
+
+  uint8_t revisionMajor;
+  uint8_t revisionMinor;
+  uint8_t versionMajor;
+  uint8_t versionMinor;
+};
+
 struct IDHeaderVdo {
   IDHeaderVdo() = delete;
   IDHeaderVdo(SOPType sop, uint32_t val);
@@ -247,6 +329,177 @@ struct UFPVdo {
   USBHighestSpeed highestSpeed;
 };
 
+struct DFPVdo {
+  DFPVdo() = delete;
+  DFPVdo(uint32_t val);
+
+  uint8_t version;
+  bool usb2p0HostCapable;
+  bool usb3p2HostCapable;
+  bool usb4p0HostCapable;
+  uint8_t portNumber;
+};
+
+// Passive Cable VDO, and Active Cable VDO 1 which adds the SBU, VBUS Through Cable and SOP''
+// fields (always false for passive cables)
+struct CableVdo {
+  CableVdo() = delete;
+  CableVdo(uint32_t val);
+
+  uint8_t hwVersion;
+  uint8_t fwVersion;
+  uint8_t vdoVersion;
+  bool captivePlug;  // USB Type-C plug at the far end otherwise
+  bool eprModeCapable;
+  uint8_t latency;          // Encoded, 1 is <10ns (~1m) for passive cables
+  uint8_t termination;      // Encoded, VCONN required or not
+  uint32_t maxVbus_mV;      // 20V, 30V, 40V or 50V
+  uint32_t vbusCurrent_mA;  // 0 for an encoding that is not 3A or 5A
+  USBHighestSpeed highestSpeed;
+
+  bool sbuSupported;
+  bool sbuActive;
+  bool vbusThroughCable;
+  bool sopDoublePrimeController;
+};
+
+struct ActiveCableVdo2 {
+  ActiveCableVdo2() = delete;
+  ActiveCableVdo2(uint32_t val);
+
+  uint8_t maxOperatingTemp_C;
+  uint8_t shutdownTemp_C;
+  bool optical;  // Copper otherwise
+  bool retimer;  // Redriver otherwise
+  bool usb4Supported;
+  bool usb3p2Supported;
+  bool usb2p0Supported;
+  bool twoLanes;
+  bool usbGen2;  // Gen1 otherwise
+};
+
+struct VPDVdo {
+  VPDVdo() = delete;
+  VPDVdo(uint32_t val);
+
+  uint8_t hwVersion;
+  uint8_t fwVersion;
+  uint8_t vdoVersion;
+  uint32_t maxVbus_mV;
+  uint32_t chargeThroughCurrent_mA;
+  uint32_t vbusImpedance_mOhm;
+  uint32_t groundImpedance_mOhm;
+  bool chargeThroughSupported;
+};
+
+// DisplayPort Alt Mode VDOs. Pin assignments are bit masks, bit 0 for pin assignment A.
+
+struct DPCapabilitiesVdo {
+  DPCapabilitiesVdo() = delete;
+  DPCapabilitiesVdo(uint32_t val);
+
+  bool ufpDCapable;
+  bool dfpDCapable;
+  uint8_t signaling;  // Bit 0 DP v1.3 rates, bit 1 USB Gen2 rates
+  bool receptacle;    // Plug otherwise
+  bool usb2p0NotUsed;
+  uint8_t dfpDPinAssignments;
+  uint8_t ufpDPinAssignments;
+};
+
+struct DPStatusVdo {
+  DPStatusVdo() = delete;
+  DPStatusVdo(uint32_t val);
+
+  uint8_t connection;  // DisplayPortConnection
+  bool powerLow;
+  bool enabled;
+  bool multiFunctionPreferred;
+  bool usbConfigurationRequest;
+  bool exitRequest;
+  bool hpdHigh;
+  bool irqHpd;
+};
+
+struct DPConfigureVdo {
+  DPConfigureVdo() = delete;
+  DPConfigureVdo(uint32_t val);
+
+  uint8_t configuration;  // DisplayPortConfiguration
+  uint8_t signaling;      // As in DPCapabilitiesVdo
+  uint8_t pinAssignment;  // A single bit
+};
+
+// Extended message payloads are decoded from the reassembled bytes. Fields beyond the end of a
+// short payload read as 0.
+
+struct SourceCapabilitiesExtended {
+  SourceCapabilitiesExtended() = delete;
+  SourceCapabilitiesExtended(const uint8_t* data, uint32_t size);
+
+  uint16_t vid;
+  uint16_t pid;
+  uint32_t xid;
+  uint8_t fwVersion;
+  uint8_t hwVersion;
+  uint8_t holdupTime_ms;
+  uint8_t numberOfBatteries;
+  uint8_t sourcePdp_W;
+  uint8_t eprSourcePdp_W;
+};
+
+struct Status {
+  Status() = delete;
+  Status(const uint8_t* data, uint32_t size);
+
+  uint8_t internalTemp_C;  // 0 if not supported
+  uint8_t presentInput;
+  uint8_t presentBatteryInput;
+  uint8_t eventFlags;
+  uint8_t temperatureStatus;
+  uint8_t powerStatus;
+};
+
+struct PPSStatus {
+  PPSStatus() = delete;
+  PPSStatus(const uint8_t* data, uint32_t size);
+
+  bool outputVoltageSupported;
+  uint32_t outputVoltage_mV;
+  bool outputCurrentSupported;
+  uint32_t outputCurrent_mA;
+  uint8_t temperatureFlag;  // PTF: 0 not supported, 1 normal, 2 warning, 3 over temperature
+  bool currentLimitMode;    // OMF
+};
+
+struct ManufacturerInfo {
+  ManufacturerInfo() = delete;
+  ManufacturerInfo(const uint8_t* data, uint32_t size);
+
+  uint16_t vid;
+  uint16_t pid;
+  char string[maxExtendedMsgChunkLen - 4 + 1];  // Null-terminated
+};
+
+struct EPRSourceCapabilities {
+  EPRSourceCapabilities() = delete;
+  EPRSourceCapabilities(const uint8_t* data, uint32_t size);
+
+  uint8_t numPdos;  // Including the zero PDOs padding the SPR PDOs
+  uint32_t pdos[maxEPRSourcePdos];
+};
+
+struct FirmwareUpdateHeader {
+  FirmwareUpdateHeader() = delete;
+  FirmwareUpdateHeader(const uint8_t* data, uint32_t size);
+
+  uint8_t protocolVersion;
+  uint8_t messageType;  // FirmwareUpdateMessageType
+  bool request;
+  uint32_t dataBlockIndex;  // PDFU_DATA / PDFU_DATA_NR requests and PDFU_DATA responses
+  uint32_t payloadBytes;    // Bytes following the header and block index
+};
+
 };  // namespace USBPDMessages
 
 #endif  // USBPD_MESSAGES_H
@@ -0,0 +1,295 @@
+#include "USBPDProfiler.h"
+
+#ifdef USBPD_PROFILING
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "USBPDDecodeCache.h"
+
+using namespace std;
+
+static const char* profileStageNames[NUM_PROFILE_STAGE] = {
+    "DetectPreamble",
+    "DetectSOP",
+    "DetectHeader",
+    "ReadSourceCapabilities",
+    "ReadRequest",
+    "ReadVendorDefinedMessage",
+    "ReadBist",
+    "SkipBistCarrier",
+    "ReadExtendedMessage",
+    "ReadDataObjects",
+    "DetectCRC32",
+    "DetectEOP",
+    "GenerateBubbleText",
+    "GenerateTabularText",
+    "GenerateExportFile",
+};
+
+// Calls kept per thread for the trace, in a ring holding the latest ones
+static const size_t profileRingEvents = 1 << 16;
+
+/**
+ * @brief A logged call. The fields are atomic as Report() reads the ring of another thread, but
+ * only the owning thread writes them.
+ */
+struct ProfileEvent {
+  atomic<U64> startTicks;
+  atomic<U64> endTicks;
+  atomic<U32> stage;
+};
+
+/**
+ * @brief Counters and call log of one thread, written only by that thread, without locking.
+ * Report() reads them from another thread through relaxed atomics. Reset() cannot clear them from
+ * another thread, so it bumps the registry's generation instead and the owning thread clears its
+ * profile on its next Record().
+ */
+struct ThreadProfile {
+  U32 threadIndex;
+  atomic<U64> generation;  // Generation of the registry the counters were cleared for
+  atomic<U64> calls[NUM_PROFILE_STAGE];
+  atomic<U64> ticks[NUM_PROFILE_STAGE];
+  atomic<U64> maxTicks[NUM_PROFILE_STAGE];
+  unique_ptr<ProfileEvent[]> events;  // profileRingEvents, preallocated
+  atomic<U64> numEvents;              // Calls logged since the clear, including overwritten ones
+
+  ThreadProfile() : threadIndex(0), generation(0), events(new ProfileEvent[profileRingEvents]) {
+    Clear(0);
+  }
+
+  void Clear(U64 newGeneration) {
+    for (U32 i = 0; i < NUM_PROFILE_STAGE; i++) {
+      calls[i].store(0, memory_order_relaxed);
+      ticks[i].store(0, memory_order_relaxed);
+      maxTicks[i].store(0, memory_order_relaxed);
+    }
+
+    numEvents.store(0, memory_order_relaxed);
+    generation.store(newGeneration, memory_order_release);
+  }
+};
+
+/**
+ * @brief Add to a counter of the calling thread's profile. Only the owning thread writes, so a
+ * relaxed load and store is enough, with no read-modify-write.
+ */
+static void AddRelaxed(atomic<U64>& counter, U64 value) {
+  counter.store(counter.load(memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+struct ProfileRegistry {
+  mutex lock;  // Guards threads and the base time, never taken by Record() once registered
+  vector<unique_ptr<ThreadProfile>> threads;
+  atomic<U64> generation;  // Bumped by Reset()
+
+  // Ticks and steady_clock time of the last reset, to convert ticks to time
+  U64 baseTicks;
+  chrono::steady_clock::time_point baseTime;
+
+  ProfileRegistry()
+      : generation(0),
+        baseTicks(USBPDProfiler::ReadTicks()),
+        baseTime(chrono::steady_clock::now()) {}
+};
+
+static ProfileRegistry& GetRegistry() {
+  static ProfileRegistry registry;
+  return registry;
+}
+
+static ThreadProfile* GetThreadProfile() {
+  static thread_local ThreadProfile* profile = NULL;
+
+  if (profile == NULL) {
+    ProfileRegistry& registry = GetRegistry();
+    lock_guard<mutex> guard(registry.lock);
+
+    registry.threads.emplace_back(new ThreadProfile());
+    profile = registry.threads.back().get();
+    profile->threadIndex = (U32)registry.threads.size();
+    profile->Clear(registry.generation.load(memory_order_relaxed));
+  }
+
+  return profile;
+}
+
+void USBPDProfiler::Record(ProfileStage stage, U64 startTicks, U64 endTicks) {
+  ThreadProfile* profile = GetThreadProfile();
+
+  U64 generation = GetRegistry().generation.load(memory_order_relaxed);
+  if (profile->generation.load(memory_order_relaxed) != generation) {
+    profile->Clear(generation);
+  }
+
+  U64 ticks = endTicks - startTicks;
+  AddRelaxed(profile->calls[stage], 1);
+  AddRelaxed(profile->ticks[stage], ticks);
+
+  if (ticks > profile->maxTicks[stage].load(memory_order_relaxed)) {
+    profile->maxTicks[stage].store(ticks, memory_order_relaxed);
+  }
+
+  U64 numEvents = profile->numEvents.load(memory_order_relaxed);
+  ProfileEvent& event = profile->events[numEvents % profileRingEvents];
+  event.startTicks.store(startTicks, memory_order_relaxed);
+  event.endTicks.store(endTicks, memory_order_relaxed);
+  event.stage.store(stage, memory_order_relaxed);
+  profile->numEvents.store(numEvents + 1, memory_order_release);
+}
+
+void USBPDProfiler::Reset() {
+  ProfileRegistry& registry = GetRegistry();
+  lock_guard<mutex> guard(registry.lock);
+
+  registry.generation.fetch_add(1, memory_order_relaxed);
+  registry.baseTicks = ReadTicks();
+  registry.baseTime = chrono::steady_clock::now();
+}
+
+struct ProfileEventCopy {
+  U64 startTicks;
+  U64 endTicks;
+  U32 stage;
+};
+
+/**
+ * @brief Copy the calls of a thread's ring that were not overwritten while being copied
+ *
+ * @return the number of calls logged by the thread, including those overwritten
+ */
+static U64 CopyEvents(const ThreadProfile& profile, vector<ProfileEventCopy>* events) {
+  events->clear();
+
+  U64 end = profile.numEvents.load(memory_order_acquire);
+  U64 begin = (end > profileRingEvents) ? end - profileRingEvents : 0;
+
+  for (U64 i = begin; i < end; i++) {
+    const ProfileEvent& event = profile.events[i % profileRingEvents];
+    ProfileEventCopy copy = {event.startTicks.load(memory_order_relaxed),
+                             event.endTicks.load(memory_order_relaxed),
+                             event.stage.load(memory_order_relaxed)};
+    events->push_back(copy);
+  }
+
+  // The owning thread may have gone on recording: a slot is being overwritten before numEvents
+  // counts the call overwriting it, so the oldest slot still in the ring may be torn as well
+  atomic_thread_fence(memory_order_acquire);
+  U64 newEnd = profile.numEvents.load(memory_order_relaxed);
+  if (newEnd >= profileRingEvents && newEnd - profileRingEvents + 1 > begin) {
+    U64 overwritten = min(newEnd - profileRingEvents + 1 - begin, (U64)events->size());
+    events->erase(events->begin(), events->begin() + overwritten);
+  }
+
+  return end;
+}
+
+void USBPDProfiler::Report() {
+  ProfileRegistry& registry = GetRegistry();
+  lock_guard<mutex> guard(registry.lock);
+
+  // Calibrate the tick rate against steady_clock over the time since the last reset
+  U64 elapsedTicks = ReadTicks() - registry.baseTicks;
+  double elapsed_us =
+      chrono::duration<double, micro>(chrono::steady_clock::now() - registry.baseTime).count();
+  double ticksPerMicrosecond = 1000.0;  // steady_clock nanoseconds
+
+#ifdef USBPD_PROFILER_TSC
+  if (elapsed_us < 1000.0) {
+    cout << "USBPD profile: too short to calibrate the timestamp counter" << endl;
+    return;
+  }
+
+  ticksPerMicrosecond = (double)elapsedTicks / elapsed_us;
+#else
+  (void)elapsedTicks;
+  (void)elapsed_us;
+#endif
+
+  U64 calls[NUM_PROFILE_STAGE] = {};
+  U64 ticks[NUM_PROFILE_STAGE] = {};
+  U64 maxTicks[NUM_PROFILE_STAGE] = {};
+  U64 droppedEvents = 0;
+
+  string tracePath = USBPDDecodeCache::GetTempDirectory() + "/usbpd-analyzer-profile.json";
+  FILE* trace = fopen(tracePath.c_str(), "w");
+  bool firstEvent = true;
+
+  if (trace != NULL) {
+    fprintf(trace, "{\"traceEvents\":[\n");
+  }
+
+  U64 generation = registry.generation.load(memory_order_relaxed);
+  vector<ProfileEventCopy> events;
+
+  for (size_t i = 0; i < registry.threads.size(); i++) {
+    const ThreadProfile* profile = registry.threads[i].get();
+
+    // A thread that has not recorded since the last reset still holds the counts from before it
+    if (profile->generation.load(memory_order_acquire) != generation) {
+      continue;
+    }
+
+    for (U32 stage = 0; stage < NUM_PROFILE_STAGE; stage++) {
+      calls[stage] += profile->calls[stage].load(memory_order_relaxed);
+      ticks[stage] += profile->ticks[stage].load(memory_order_relaxed);
+      maxTicks[stage] = max(maxTicks[stage], profile->maxTicks[stage].load(memory_order_relaxed));
+    }
+
+    if (trace == NULL) {
+      continue;
+    }
+
+    droppedEvents += CopyEvents(*profile, &events) - events.size();
+
+    for (size_t j = 0; j < events.size(); j++) {
+      const ProfileEventCopy& event = events[j];
+      fprintf(trace,
+              "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+              firstEvent ? "" : ",\n", profileStageNames[event.stage], profile->threadIndex,
+              (double)(S64)(event.startTicks - registry.baseTicks) / ticksPerMicrosecond,
+              (double)(event.endTicks - event.startTicks) / ticksPerMicrosecond);
+      firstEvent = false;
+    }
+  }
+
+  cout << "USBPD profile (inclusive times)" << endl;
+  cout << left << setw(26) << "stage" << right << setw(12) << "calls" << setw(14) << "total ms"
+       << setw(12) << "mean us" << setw(12) << "max us" << endl;
+
+  for (U32 stage = 0; stage < NUM_PROFILE_STAGE; stage++) {
+    if (calls[stage] == 0) {
+      continue;
+    }
+
+    double total_us = (double)ticks[stage] / ticksPerMicrosecond;
+
+    cout << left << setw(26) << profileStageNames[stage] << right << setw(12) << calls[stage]
+         << fixed << setprecision(3) << setw(14) << total_us / 1000.0 << setw(12)
+         << total_us / (double)calls[stage] << setw(12)
+         << (double)maxTicks[stage] / ticksPerMicrosecond << endl;
+  }
+
+  cout.unsetf(ios::floatfield);
+
+  if (trace != NULL) {
+    fprintf(trace, "\n],\"displayTimeUnit\":\"ns\"}\n");
+    fclose(trace);
+
+    cout << "Trace written to " << tracePath;
+    if (droppedEvents > 0) {
+      cout << " (" << droppedEvents << " older calls overwritten)";
+    }
+    cout << endl;
+  }
+}
+
+#endif  // USBPD_PROFILING
@@ -0,0 +1,100 @@
+#ifndef USBPD_PROFILER_H
+#define USBPD_PROFILER_H
+
+#include <LogicPublicTypes.h>
+
+/**
+ * @brief Stages of the decoder and results generation timed by USBPD_PROFILE_SCOPE
+ */
+enum ProfileStage {
+  ProfileStage_DetectPreamble,
+  ProfileStage_DetectSOP,
+  ProfileStage_DetectHeader,
+  ProfileStage_ReadSourceCapabilities,
+  ProfileStage_ReadRequest,
+  ProfileStage_ReadVendorDefinedMessage,
+  ProfileStage_ReadBist,
+  ProfileStage_SkipBistCarrier,
+  ProfileStage_ReadExtendedMessage,
+  ProfileStage_ReadDataObjects,  // Data objects of other messages
+  ProfileStage_DetectCRC32,
+  ProfileStage_DetectEOP,
+  ProfileStage_GenerateBubbleText,
+  ProfileStage_GenerateTabularText,
+  ProfileStage_GenerateExportFile,
+
+  NUM_PROFILE_STAGE
+};
+
+#ifdef USBPD_PROFILING
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define USBPD_PROFILER_TSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define USBPD_PROFILER_TSC
+#else
+#include <chrono>
+#endif
+
+/**
+ * @brief Scoped timers for the decoder, compiled in with -DUSBPD_PROFILING=ON.
+ *
+ * Every thread accumulates call counts and times per stage, and logs its latest calls in a fixed
+ * size ring, in its own profile, without taking a lock. Report() merges the profiles of all threads
+ * into a table on cout, and only then turns the logged calls into a Chrome trace (chrome://tracing,
+ * or ui.perfetto.dev) written to the temp directory.
+ * Times are inclusive of everything a stage waits on: DetectPreamble includes the time spent
+ * waiting for more of a capture in progress.
+ */
+class USBPDProfiler {
+ public:
+  /**
+   * @brief Timestamp counter where available (x86), steady_clock nanoseconds otherwise
+   */
+  static U64 ReadTicks() {
+#ifdef USBPD_PROFILER_TSC
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+  }
+
+  static void Record(ProfileStage stage, U64 startTicks, U64 endTicks);
+
+  /**
+   * @brief Clear the profiles of all threads
+   */
+  static void Reset();
+
+  /**
+   * @brief Print the merged profile to cout and write the Chrome trace
+   */
+  static void Report();
+
+  class ScopedTimer {
+   public:
+    explicit ScopedTimer(ProfileStage stage) : mStage(stage), mStartTicks(ReadTicks()) {}
+    ~ScopedTimer() { Record(mStage, mStartTicks, ReadTicks()); }
+
+   protected:
+    ProfileStage mStage;
+    U64 mStartTicks;
+  };
+};
+
+#define USBPD_PROFILE_CONCAT_INNER(a, b) a##b
+#define USBPD_PROFILE_CONCAT(a, b) USBPD_PROFILE_CONCAT_INNER(a, b)
+#define USBPD_PROFILE_SCOPE(stage) \
+  USBPDProfiler::ScopedTimer USBPD_PROFILE_CONCAT(usbpdProfileScope, __LINE__)(stage)
+
+#else
+
+#define USBPD_PROFILE_SCOPE(stage)
+
+#endif  // USBPD_PROFILING
+
+#endif  // USBPD_PROFILER_H
@@ -0,0 +1,430 @@
+#include "USBPDRoleTracker.h"
+
+#include <AnalyzerHelpers.h>
+
+#include <cstdio>
+
+// Values written by Save(): version, sample rate, state, roles and the number of entries, then
+// each entry
+static const U64 roleVersion = 1;
+static const size_t roleHeaderValues = 5;
+static const size_t roleEntryValues = 3 + 1;
+
+static const char* const eventNames[USBPDRoleTracker::NUM_EVENT] = {
+    "Initial",
+    "PR_Swap",
+    "DR_Swap",
+    "VCONN_Swap",
+    "FR_Swap",
+    "Hard Reset",
+    "Resync",
+};
+
+static uint8_t GetOtherPort(uint8_t port) {
+  return (port == USBPDRoleTracker::Port_A) ? USBPDRoleTracker::Port_B : USBPDRoleTracker::Port_A;
+}
+
+static const char* GetPortName(uint8_t port) {
+  return (port == USBPDRoleTracker::Port_A) ? "Port A" : "Port B";
+}
+
+/**
+ * @brief Roles as seen in the header of the first SOP message, Port A being its Source
+ */
+static USBPDRoleTracker::Roles GetInitialRoles(uint16_t header) {
+  uint8_t sender = CHECK_BIT(header, 8) ? USBPDRoleTracker::Port_A : USBPDRoleTracker::Port_B;
+
+  USBPDRoleTracker::Roles roles;
+  roles.source = USBPDRoleTracker::Port_A;
+  roles.dfp = CHECK_BIT(header, 5) ? sender : GetOtherPort(sender);
+  roles.vconnSource = USBPDRoleTracker::Port_A;
+  return roles;
+}
+
+static U64 PackRoles(const USBPDRoleTracker::Roles& roles) {
+  return (U64)roles.source | ((U64)roles.dfp << 8) | ((U64)roles.vconnSource << 16);
+}
+
+static USBPDRoleTracker::Roles UnpackRoles(U64 value) {
+  USBPDRoleTracker::Roles roles;
+  roles.source = (uint8_t)(value & 0x1);
+  roles.dfp = (uint8_t)((value >> 8) & 0x1);
+  roles.vconnSource = (uint8_t)((value >> 16) & 0x1);
+  return roles;
+}
+
+USBPDRoleTracker::USBPDRoleTracker() : USBPDCacheSection(roleVersion) { Clear(1); }
+
+void USBPDRoleTracker::Clear(U32 sampleRateHz) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  mSampleRateHz = sampleRateHz;
+  mState = State_Unknown;
+  mRoles.source = Port_A;
+  mRoles.dfp = Port_A;
+  mRoles.vconnSource = Port_A;
+  mEntries.clear();
+}
+
+uint8_t USBPDRoleTracker::GetSender(uint8_t sop, uint16_t header) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  return GetSenderLocked(sop, header);
+}
+
+uint8_t USBPDRoleTracker::GetSenderLocked(uint8_t sop, uint16_t header) const {
+  if (sop >= NUM_SOP_TYPE) {
+    return Sender_Unknown;
+  }
+
+  // Only the VCONN Source talks to the cable plugs, bit 8 tells the cable plug's messages apart
+  if (sop != SOPType_SOP && CHECK_BIT(header, 8)) {
+    return Sender_CablePlug;
+  }
+
+  if (mState == State_Unknown && sop != SOPType_SOP) {
+    return Sender_Unknown;
+  }
+
+  // The first SOP message shows the roles
+  Roles roles = (mState == State_Unknown) ? GetInitialRoles(header) : mRoles;
+  uint8_t port = roles.vconnSource;
+  bool mismatch = false;
+
+  if (sop == SOPType_SOP) {
+    bool headerSource = CHECK_BIT(header, 8);
+    bool headerDfp = CHECK_BIT(header, 5);
+    uint8_t event = mEntries.empty() ? (uint8_t)Event_Initial : mEntries.back().event;
+
+    if ((mState == State_Accepted || mState == State_SourceOff) &&
+        (event == Event_PR_Swap || event == Event_FR_Swap)) {
+      // The power roles in the headers change during the swap, the data roles do not
+      port = headerDfp ? roles.dfp : GetOtherPort(roles.dfp);
+    } else {
+      port = headerSource ? roles.source : GetOtherPort(roles.source);
+      mismatch = headerDfp != (port == roles.dfp);
+    }
+  }
+
+  uint8_t sender = (port == Port_A) ? Sender_PortA : Sender_PortB;
+  sender |= (port == roles.source) ? SenderFlag_Source : 0;
+  sender |= (port == roles.dfp) ? SenderFlag_DFP : 0;
+  sender |= (port == roles.vconnSource) ? SenderFlag_VconnSource : 0;
+  sender |= mismatch ? SenderFlag_RoleMismatch : 0;
+
+  return sender;
+}
+
+/**
+ * @brief Close the open entry, if there is one, and add an entry for event with the current roles
+ */
+void USBPDRoleTracker::AddEntry(Event event, U64 sample) {
+  EndEntry();
+
+  Entry entry;
+  entry.requestStart = sample;
+  entry.responseStart = noSample;
+  entry.completeStart = noSample;
+  entry.event = event;
+  entry.initiator = Port_A;
+  entry.response = ControlMessage_Reserved;
+  entry.completed = false;
+  entry.open = false;
+  entry.roles = mRoles;
+  mEntries.push_back(entry);
+}
+
+/**
+ * @brief Close the open entry, if there is one. A swap that did not complete leaves the roles
+ * unchanged.
+ */
+void USBPDRoleTracker::EndEntry() {
+  if (!mEntries.empty()) {
+    mEntries.back().open = false;
+  }
+
+  if (mState != State_Unknown) {
+    mState = State_Idle;
+  }
+}
+
+void USBPDRoleTracker::AddMessage(const USBPDMessageRecord& record) {
+  // Roles are only swapped on SOP. Damaged messages are retried by the sender.
+  if (record.sop != SOPType_SOP || (record.flags & messageDamageFlags) != 0) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  if (mState == State_Unknown) {
+    mRoles = GetInitialRoles(record.header);
+    mState = State_Idle;
+
+    AddEntry(Event_Initial, record.startingSample);
+    mEntries.back().completed = true;
+  }
+
+  uint8_t sender = GetSenderLocked(record.sop, record.header);
+  uint8_t port = ((sender & 0x3) == Sender_PortA) ? Port_A : Port_B;
+
+  if (sender & SenderFlag_RoleMismatch) {
+    // A swap was missed, e.g. the capture started during one
+    mRoles.dfp = CHECK_BIT(record.header, 5) ? port : GetOtherPort(port);
+    AddEntry(Event_Resync, record.startingSample);
+    mEntries.back().completed = true;
+  }
+
+  uint8_t numDataObjects = EXTRACT_BIT_RANGE(record.header, 14, 12);
+  uint8_t messageType = EXTRACT_BIT_RANGE(record.header, 4, 0);
+
+  if (CHECK_BIT(record.header, 15) || numDataObjects > 0) {
+    return;
+  }
+
+  switch (messageType) {
+    case ControlMessage_PR_Swap:
+    case ControlMessage_DR_Swap:
+    case ControlMessage_VCONN_Swap:
+    case ControlMessage_FR_Swap: {
+      Event event = (messageType == ControlMessage_PR_Swap)   ? Event_PR_Swap
+                    : (messageType == ControlMessage_DR_Swap) ? Event_DR_Swap
+                    : (messageType == ControlMessage_VCONN_Swap) ? Event_VCONN_Swap
+                                                                 : Event_FR_Swap;
+      AddEntry(event, record.startingSample);
+      mEntries.back().initiator = port;
+      mEntries.back().open = true;
+      mState = State_Requested;
+    } break;
+
+    case ControlMessage_Accept:
+    case ControlMessage_Reject:
+    case ControlMessage_Wait:
+    case ControlMessage_Not_Supported: {
+      if (mState != State_Requested) {
+        break;
+      }
+
+      Entry& entry = mEntries.back();
+      entry.responseStart = record.startingSample;
+      entry.response = messageType;
+
+      if (messageType != ControlMessage_Accept) {
+        EndEntry();
+      } else if (entry.event == Event_DR_Swap) {
+        // The data roles swap as soon as the swap is accepted
+        mRoles.dfp = GetOtherPort(mRoles.dfp);
+        entry.completeStart = record.startingSample;
+        entry.completed = true;
+        entry.roles = mRoles;
+        EndEntry();
+      } else {
+        mState = State_Accepted;
+      }
+    } break;
+
+    case ControlMessage_PS_RDY: {
+      if (mState != State_Accepted && mState != State_SourceOff) {
+        break;
+      }
+
+      Entry& entry = mEntries.back();
+
+      if (mState == State_Accepted && entry.event == Event_VCONN_Swap) {
+        // Sent by the new VCONN Source once VCONN is on
+        mRoles.vconnSource = GetOtherPort(mRoles.vconnSource);
+      } else if (mState == State_Accepted) {
+        // Sent by the initial Source once its supply is off, the new Source's PS_RDY follows
+        mState = State_SourceOff;
+        break;
+      } else {
+        mRoles.source = GetOtherPort(mRoles.source);
+      }
+
+      entry.completeStart = record.startingSample;
+      entry.completed = true;
+      entry.roles = mRoles;
+      EndEntry();
+    } break;
+
+    case ControlMessage_Soft_Reset:
+      EndEntry();
+      break;
+
+    default:
+      break;
+  }
+}
+
+void USBPDRoleTracker::AddHardReset(U64 sample) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  if (mState == State_Unknown) {
+    return;
+  }
+
+  // Any swap in progress is abandoned, the Source becomes the DFP and VCONN Source again
+  EndEntry();
+  mRoles.dfp = mRoles.source;
+  mRoles.vconnSource = mRoles.source;
+
+  AddEntry(Event_HardReset, sample);
+  mEntries.back().completed = true;
+}
+
+void USBPDRoleTracker::DescribeSender(uint8_t sender, char* text, size_t textSize) {
+  switch (sender & 0x3) {
+    case Sender_PortA:
+    case Sender_PortB:
+      snprintf(text,
+               textSize,
+               "%s (%s, %s%s)",
+               ((sender & 0x3) == Sender_PortA) ? "Port A" : "Port B",
+               (sender & SenderFlag_Source) ? "Source" : "Sink",
+               (sender & SenderFlag_DFP) ? "DFP" : "UFP",
+               (sender & SenderFlag_VconnSource) ? ", VCONN Source" : "");
+      break;
+
+    case Sender_CablePlug:
+      snprintf(text, textSize, "Cable Plug");
+      break;
+
+    default:
+      snprintf(text, textSize, "Unknown");
+      break;
+  }
+}
+
+static const char* GetEntryResult(const USBPDRoleTracker::Entry& entry) {
+  switch (entry.event) {
+    case USBPDRoleTracker::Event_Initial:
+      return "";
+
+    case USBPDRoleTracker::Event_HardReset:
+      return "Roles reset";
+
+    case USBPDRoleTracker::Event_Resync:
+      return "Resynchronized";
+
+    default:
+      break;
+  }
+
+  if (entry.completed) {
+    return "Swapped";
+  }
+
+  switch (entry.response) {
+    case ControlMessage_Reject:
+      return "Rejected";
+
+    case ControlMessage_Wait:
+      return "Wait";
+
+    case ControlMessage_Not_Supported:
+      return "Not supported";
+
+    default:
+      break;
+  }
+
+  if (entry.open) {
+    return "Pending";
+  }
+
+  return entry.response == ControlMessage_Accept ? "No PS_RDY" : "No response";
+}
+
+void USBPDRoleTracker::WriteTimeline(std::ostream& stream, U64 triggerSample) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  stream << "Time [s],Event,Initiator,Response,Result,Duration [ms],Source,DFP,VCONN Source"
+         << std::endl;
+
+  for (const Entry& entry : mEntries) {
+    bool swap = entry.event != Event_Initial && entry.event != Event_HardReset &&
+                entry.event != Event_Resync;
+
+    char time_str[128];
+    AnalyzerHelpers::GetTimeString(entry.requestStart, triggerSample, mSampleRateHz, time_str, 128);
+    stream << time_str << "," << eventNames[entry.event] << ",";
+
+    if (swap) {
+      stream << GetPortName(entry.initiator);
+    }
+    stream << ",";
+
+    if (entry.response < NUM_CONTROL_MESSAGE && entry.response != ControlMessage_Reserved) {
+      stream << ControlMessageNames[entry.response] + sizeof("ControlMessage_") - 1;
+    }
+    stream << "," << GetEntryResult(entry) << ",";
+
+    if (swap && entry.completed && entry.completeStart != noSample) {
+      char duration_str[32];
+      snprintf(duration_str,
+               sizeof(duration_str),
+               "%.3f",
+               (double)(entry.completeStart - entry.requestStart) * 1000.0 / mSampleRateHz);
+      stream << duration_str;
+    }
+
+    stream << "," << GetPortName(entry.roles.source) << "," << GetPortName(entry.roles.dfp) << ","
+           << GetPortName(entry.roles.vconnSource) << std::endl;
+  }
+}
+
+void USBPDRoleTracker::SaveValues(std::vector<U64>* values) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  values->push_back(mSampleRateHz);
+  values->push_back(mState);
+  values->push_back(PackRoles(mRoles));
+  values->push_back(mEntries.size());
+
+  for (const Entry& entry : mEntries) {
+    values->push_back(entry.requestStart);
+    values->push_back(entry.responseStart);
+    values->push_back(entry.completeStart);
+    values->push_back((U64)entry.event | ((U64)entry.initiator << 8) |
+                      ((U64)entry.response << 16) | ((U64)entry.completed << 24) |
+                      ((U64)entry.open << 32) | (PackRoles(entry.roles) << 40));
+  }
+}
+
+bool USBPDRoleTracker::CheckValues(const std::vector<U64>& values) const {
+  if (!HasRecords(values, roleHeaderValues, 4, roleEntryValues) || values[1] == 0 ||
+      values[2] > State_SourceOff) {
+    return false;
+  }
+
+  for (size_t i = roleHeaderValues; i < values.size(); i += roleEntryValues) {
+    if ((values[i + 3] & 0xFF) >= NUM_EVENT) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void USBPDRoleTracker::LoadValues(const std::vector<U64>& values) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  mSampleRateHz = (U32)values[1];
+  mState = (State)values[2];
+  mRoles = UnpackRoles(values[3]);
+  mEntries.resize((size_t)values[4]);
+
+  const U64* value = &values[roleHeaderValues];
+
+  for (Entry& entry : mEntries) {
+    entry.requestStart = *value++;
+    entry.responseStart = *value++;
+    entry.completeStart = *value++;
+    entry.event = (uint8_t)(*value & 0xFF);
+    entry.initiator = (uint8_t)((*value >> 8) & 0x1);
+    entry.response = (uint8_t)(*value >> 16);
+    entry.completed = ((*value >> 24) & 0xFF) != 0;
+    entry.open = ((*value >> 32) & 0xFF) != 0;
+    entry.roles = UnpackRoles(*value >> 40);
+    value++;
+  }
+}
@@ -0,0 +1,150 @@
+#ifndef USBPD_ROLE_TRACKER_H
+#define USBPD_ROLE_TRACKER_H
+
+#include <LogicPublicTypes.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "USBPDCacheSection.h"
+#include "USBPDMessageIndex.h"
+
+/**
+ * @brief Follows the power role, data role and VCONN Source of the two ports on SOP through
+ * PR_Swap, DR_Swap, VCONN_Swap and FR_Swap, and tags each message with the port that sent it.
+ *
+ * The ports are told apart as Port A, the port that was the Source when the roles were first
+ * seen, and Port B. The roles are taken from the header of the first SOP message, the VCONN Source
+ * being assumed to be the Source as it is after attach. A swap takes effect once it completes: the
+ * Accept of a DR_Swap, the PS_RDY of a VCONN_Swap, or the second PS_RDY of a PR_Swap or FR_Swap.
+ * A Hard Reset returns the data role and VCONN Source to the Source.
+ *
+ * Each swap, whatever its outcome, and each Hard Reset is one entry of the role timeline. A SOP
+ * message whose data role does not match the tracked roles is flagged, and the roles are
+ * resynchronized from its header.
+ *
+ * The decoder adds messages from the worker thread while the timeline is exported from the UI
+ * thread, so all methods are synchronized.
+ */
+class USBPDRoleTracker : public USBPDCacheSection {
+ public:
+  enum Port {
+    Port_A,
+    Port_B,
+  };
+
+  // Sender of a message, as kept in USBPDMessageRecord::sender: a Sender value in bits 1..0 and
+  // SenderFlag bits, the flags describing the roles of the sending port
+  enum Sender {
+    Sender_Unknown,  // Before the roles are known, or the SOP could not be detected
+    Sender_PortA,
+    Sender_PortB,
+    Sender_CablePlug,
+  };
+
+  enum SenderFlag {
+    SenderFlag_Source = (1 << 2),
+    SenderFlag_DFP = (1 << 3),
+    SenderFlag_VconnSource = (1 << 4),
+    SenderFlag_RoleMismatch = (1 << 5),  // The header's data role does not match the tracked one
+  };
+
+  enum Event {
+    Event_Initial,  // Roles first seen
+    Event_PR_Swap,
+    Event_DR_Swap,
+    Event_VCONN_Swap,
+    Event_FR_Swap,
+    Event_HardReset,
+    Event_Resync,  // Roles taken from a header that did not match them
+
+    NUM_EVENT
+  };
+
+  static const U64 noSample = UINT64_MAX;
+
+  struct Roles {
+    uint8_t source;       // Port
+    uint8_t dfp;          // Port
+    uint8_t vconnSource;  // Port
+  };
+
+  struct Entry {
+    // Start of the swap message (or of the message / reset the event was seen on), of the response
+    // and of the message completing the swap. noSample if the step was not reached.
+    U64 requestStart;
+    U64 responseStart;
+    U64 completeStart;
+
+    uint8_t event;      // Event
+    uint8_t initiator;  // Port sending the swap message
+    uint8_t response;   // ControlMessageTypes, ControlMessage_Reserved if there was none
+    bool completed;     // The roles changed
+    bool open;          // Still waiting for the next step
+    Roles roles;        // Roles after the entry
+  };
+
+  USBPDRoleTracker();
+
+  void Clear(U32 sampleRateHz);
+
+  /**
+   * @brief Sender of a message with this SOP and header, given the roles so far. Called before the
+   * message is added.
+   *
+   * @return a Sender value and SenderFlag bits
+   */
+  uint8_t GetSender(uint8_t sop, uint16_t header);
+
+  /**
+   * @brief Follow a decoded message, or a message abandoned after an invalid SOP
+   */
+  void AddMessage(const USBPDMessageRecord& record);
+
+  void AddHardReset(U64 sample);
+
+  /**
+   * @brief Describe a USBPDMessageRecord::sender, e.g. "Port A (Source, DFP, VCONN Source)"
+   */
+  static void DescribeSender(uint8_t sender, char* text, size_t textSize);
+
+  /**
+   * @brief Write the timeline as CSV, one line per entry
+   *
+   * @param triggerSample sample the times are relative to
+   */
+  void WriteTimeline(std::ostream& stream, U64 triggerSample);
+
+ protected:
+  /**
+   * @brief Save / restore the timeline, for the decode cache
+   */
+  virtual void SaveValues(std::vector<U64>* values);
+  virtual bool CheckValues(const std::vector<U64>& values) const;
+  virtual void LoadValues(const std::vector<U64>& values);
+
+  enum State {
+    State_Unknown,    // No SOP message seen yet
+    State_Idle,
+    State_Requested,  // Swap message sent
+    State_Accepted,
+    State_SourceOff,  // PR_Swap / FR_Swap: the initial Source sent its PS_RDY
+  };
+
+  uint8_t GetSenderLocked(uint8_t sop, uint16_t header) const;
+  void AddEntry(Event event, U64 sample);
+  void EndEntry();
+
+  std::mutex mMutex;
+
+  U32 mSampleRateHz;
+  State mState;
+  Roles mRoles;
+
+  std::vector<Entry> mEntries;
+};
+
+#endif  // USBPD_ROLE_TRACKER_H
@@ -0,0 +1,266 @@
+#include "USBPDScenario.h"
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "USBPDFilter.h"
+
+// Message Type values above these are data messages and extended messages, see
+// USBPDMessageIndex::GetMessageTypeValue()
+static const uint32_t scenarioFirstDataMessage = 32;
+static const uint32_t scenarioFirstExtendedMessage = 64;
+static const size_t scenarioMaxDataObjects = 7;
+
+static bool ScenarioEquals(const std::string& token, const char* name) {
+  if (token.size() != strlen(name)) {
+    return false;
+  }
+
+  for (size_t i = 0; i < token.size(); i++) {
+    if (tolower((unsigned char)token[i]) != tolower((unsigned char)name[i])) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+USBPDScenario::USBPDScenario() : mEndDelay_us(0) {}
+
+bool USBPDScenario::Load(const char* path, std::string* error) {
+  std::ifstream file(path);
+
+  if (!file.is_open()) {
+    *error = std::string("cannot open ") + path;
+    return false;
+  }
+
+  std::stringstream text;
+  text << file.rdbuf();
+
+  return Parse(text.str(), error);
+}
+
+bool USBPDScenario::Parse(const std::string& text, std::string* error) {
+  mMessages.clear();
+  mEndDelay_us = 0;
+
+  std::istringstream lines(text);
+  std::string line;
+  U64 delay_us = 0;
+  int lineNumber = 0;
+
+  while (std::getline(lines, line)) {
+    lineNumber++;
+
+    size_t comment = line.find('#');
+    if (comment != std::string::npos) {
+      line.erase(comment);
+    }
+
+    std::istringstream words(line);
+    std::vector<std::string> tokens;
+    std::string token;
+    while (words >> token) {
+      tokens.push_back(token);
+    }
+
+    if (tokens.empty()) {
+      continue;
+    }
+
+    std::string lineError;
+    if (!ParseLine(tokens, &delay_us, &lineError)) {
+      char prefix[32];
+      snprintf(prefix, sizeof(prefix), "line %d: ", lineNumber);
+      *error = prefix + lineError;
+      mMessages.clear();
+      return false;
+    }
+  }
+
+  if (mMessages.empty()) {
+    *error = "no messages";
+    return false;
+  }
+
+  mEndDelay_us = delay_us;
+
+  return true;
+}
+
+/**
+ * @brief Parse one non-empty line. Delays accumulate in delay_us until the next message.
+ */
+bool USBPDScenario::ParseLine(const std::vector<std::string>& tokens,
+                              U64* delay_us,
+                              std::string* error) {
+  if (ScenarioEquals(tokens[0], "wait")) {
+    // Accept both "30ms" and "30 ms"
+    std::string duration = tokens.size() > 1 ? tokens[1] : "";
+    for (size_t i = 2; i < tokens.size(); i++) {
+      duration += tokens[i];
+    }
+
+    char* unit = NULL;
+    double value = strtod(duration.c_str(), &unit);
+    double scale = 0.0;
+
+    if (unit != duration.c_str() && value >= 0.0) {
+      if (ScenarioEquals(unit, "s")) {
+        scale = 1000000.0;
+      } else if (ScenarioEquals(unit, "ms")) {
+        scale = 1000.0;
+      } else if (ScenarioEquals(unit, "us")) {
+        scale = 1.0;
+      }
+    }
+
+    if (scale == 0.0) {
+      *error = "expected a duration in s, ms or us after wait";
+      return false;
+    }
+
+    *delay_us += (U64)(value * scale);
+    return true;
+  }
+
+  Message message;
+
+  if (ScenarioEquals(tokens[0], "dfp")) {
+    message.sender = Sender_DFP;
+  } else if (ScenarioEquals(tokens[0], "ufp")) {
+    message.sender = Sender_UFP;
+  } else if (ScenarioEquals(tokens[0], "cable")) {
+    message.sender = Sender_CablePlug;
+  } else {
+    *error = "expected wait, dfp, ufp or cable, found " + tokens[0];
+    return false;
+  }
+
+  message.acknowledged = false;
+  message.extended = false;
+  message.chunked = false;
+  message.delayBefore_us = *delay_us;
+  message.reset = NUM_ORDERED_SET;
+
+  if (tokens.size() == 2 && ScenarioEquals(tokens[1], "Hard_Reset")) {
+    if (message.sender == Sender_CablePlug) {
+      *error = "cable plugs do not send Hard Reset";
+      return false;
+    }
+
+    message.sop = SOPType_SOP;
+    message.messageType = 0;
+    message.reset = OrderedSet_HardReset;
+  } else if (tokens.size() == 2 && ScenarioEquals(tokens[1], "Cable_Reset")) {
+    if (message.sender != Sender_DFP) {
+      *error = "only the DFP sends Cable Reset";
+      return false;
+    }
+
+    message.sop = SOPType_SOP_PRIME;
+    message.messageType = 0;
+    message.reset = OrderedSet_CableReset;
+  }
+
+  if (message.reset != NUM_ORDERED_SET) {
+    mMessages.push_back(message);
+    *delay_us = 0;
+    return true;
+  }
+
+  if (tokens.size() < 3) {
+    *error = "expected SOP and message type, Hard_Reset or Cable_Reset";
+    return false;
+  }
+
+  uint32_t sop;
+  if (tokens[1] == "SOP''") {
+    sop = SOPType_SOP_DOUBLE_PRIME;
+  } else if (!USBPDFilter::FindSOPType(tokens[1], &sop)) {
+    *error = "unknown SOP " + tokens[1];
+    return false;
+  }
+
+  if (message.sender == Sender_CablePlug && sop == SOPType_SOP) {
+    *error = "cable plugs do not send SOP messages";
+    return false;
+  }
+
+  uint32_t type;
+  if (!USBPDFilter::FindMessageType(tokens[2], &type)) {
+    *error = "unknown message type " + tokens[2];
+    return false;
+  }
+
+  message.sop = (SOPType)sop;
+  message.messageType = (uint8_t)(type % scenarioFirstDataMessage);
+  message.acknowledged = true;
+  message.extended = (type >= scenarioFirstExtendedMessage);
+  message.chunked = message.extended;
+
+  for (size_t i = 3; i < tokens.size(); i++) {
+    if (ScenarioEquals(tokens[i], "noack")) {
+      message.acknowledged = false;
+      continue;
+    }
+
+    if (message.extended && ScenarioEquals(tokens[i], "unchunked")) {
+      message.chunked = false;
+      continue;
+    }
+
+    const char* start = tokens[i].c_str();
+    char* end = NULL;
+    unsigned long value = strtoul(start, &end, 0);
+
+    if (message.extended) {
+      if (end == start || *end != '\0' || value > 0xFF) {
+        *error = "invalid data byte " + tokens[i];
+        return false;
+      }
+
+      message.extendedData.push_back((uint8_t)value);
+      continue;
+    }
+
+    if (end == start || *end != '\0' || value > 0xFFFFFFFFUL) {
+      *error = "invalid data object " + tokens[i];
+      return false;
+    }
+
+    message.dataObjects.push_back((uint32_t)value);
+  }
+
+  if (message.extended) {
+    if (message.extendedData.size() > maxExtendedMsgLen) {
+      *error = "extended message " + tokens[2] + " takes up to 260 data bytes";
+      return false;
+    }
+
+    mMessages.push_back(message);
+    *delay_us = 0;
+    return true;
+  }
+
+  if (type < scenarioFirstDataMessage && !message.dataObjects.empty()) {
+    *error = "control message " + tokens[2] + " takes no data objects";
+    return false;
+  }
+
+  if (type >= scenarioFirstDataMessage &&
+      (message.dataObjects.empty() || message.dataObjects.size() > scenarioMaxDataObjects)) {
+    *error = "data message " + tokens[2] + " takes 1 to 7 data objects";
+    return false;
+  }
+
+  mMessages.push_back(message);
+  *delay_us = 0;
+
+  return true;
+}
@@ -0,0 +1,97 @@
+#ifndef USBPD_SCENARIO_H
+#define USBPD_SCENARIO_H
+
+#include <LogicPublicTypes.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "USBPDTypes.h"
+
+/**
+ * @brief Message sequence replayed in a loop by the simulation data generator.
+ *
+ * A scenario is a text file with one message or delay per line:
+ *
+ *   # Source offers 5V and 9V, the sink asks for 9V
+ *   dfp SOP Source_Capabilities 0x0A01912C 0x0002D12C
+ *   wait 2ms
+ *   ufp SOP Request 0x2202D12C
+ *   wait 2ms
+ *   dfp SOP Accept
+ *   wait 30ms
+ *   dfp SOP PS_RDY
+ *   cable SOP' Ping noack
+ *   wait 1s
+ *   ufp Hard_Reset
+ *   wait 1s
+ *   dfp SOP Manufacturer_Info 0x34 0x12 0x78 0x56 0x41 0x43 0x4D 0x45
+ *   ufp SOP PPS_Status 0xC2 0x01 0x28 0x02 unchunked
+ *
+ * A message is sent by dfp (the Source), ufp (the Sink) or cable, followed by its SOP, its type
+ * (the names used by the filter) and its data objects, in hex or decimal. Every message is
+ * acknowledged with a GoodCRC unless it ends with noack. Instead of a message, dfp and ufp can send
+ * Hard_Reset, and dfp can send Cable_Reset. wait adds an idle period (s, ms or us) before the next
+ * message, or before the scenario repeats. An acknowledged BIST Carrier Mode message
+ * (BIST 0x50000000) is followed by the carrier from its receiver.
+ *
+ * Extended messages take up to 260 data bytes in place of data objects. They are sent in chunks,
+ * each after a chunk request from the receiver, unless they end with unchunked.
+ */
+class USBPDScenario {
+ public:
+  enum Sender {
+    Sender_DFP,
+    Sender_UFP,
+    Sender_CablePlug,
+
+    NUM_SENDER
+  };
+
+  struct Message {
+    Sender sender;
+    SOPType sop;
+    uint8_t messageType;  // Message Type field of the header
+    std::vector<uint32_t> dataObjects;
+    bool extended;
+    bool chunked;
+    std::vector<uint8_t> extendedData;  // Data bytes of an extended message
+    bool acknowledged;
+    U64 delayBefore_us;
+
+    // OrderedSet_HardReset or OrderedSet_CableReset to send that reset instead of a message,
+    // NUM_ORDERED_SET otherwise
+    OrderedSetType reset;
+  };
+
+  USBPDScenario();
+
+  /**
+   * @brief Read and parse a scenario file, replacing the current scenario
+   *
+   * @param error description of the problem, with its line number, if the file is invalid
+   * @return true on success
+   */
+  bool Load(const char* path, std::string* error);
+
+  /**
+   * @brief Parse a scenario, replacing the current scenario
+   */
+  bool Parse(const std::string& text, std::string* error);
+
+  const std::vector<Message>& GetMessages() const { return mMessages; }
+
+  /**
+   * @brief Idle time after the last message, before the scenario repeats
+   */
+  U64 GetEndDelay_us() const { return mEndDelay_us; }
+
+ protected:
+  bool ParseLine(const std::vector<std::string>& tokens, U64* delay_us, std::string* error);
+
+  std::vector<Message> mMessages;
+  U64 mEndDelay_us;
+};
+
+#endif  // USBPD_SCENARIO_H
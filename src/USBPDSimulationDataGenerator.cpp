@@ -2,13 +2,35 @@
 
 #include <AnalyzerHelpers.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
 #include "USBPDAnalyzerSettings.h"
 #include "USBPDTypes.h"
 #include "crc32.h"
 
 USBPDSimulationDataGenerator::USBPDSimulationDataGenerator()
     : mSerialText("My first analyzer, woo hoo!"),
-      mStringIndex(0) {}
+      mStringIndex(0),
+      mTemplateBitRate(0),
+      mSessionStarted(false),
+      mNextExchangeSample(0),
+      mNextPpsRequestSample(0),
+      mPpsVoltage_mV(9000),
+      mRandomState(0x2545F491),
+      mImpaired(false),
+      mImpairmentRandomState(0x9E3779B9),
+      mEdgeDisplacement(0.0),
+      mSampleCarry(0.0),
+      mDropNextEdge(false),
+      mGlitchCountdown(0),
+      mCorruptByteCountdown(0),
+      mScenarioPosition(0),
+      mScenarioEndIdleSamples(0) {
+  memset(mMessageIds, 0, sizeof(mMessageIds));
+}
 
 USBPDSimulationDataGenerator::~USBPDSimulationDataGenerator() {}
 
@@ -20,6 +42,72 @@ void USBPDSimulationDataGenerator::Initialize(U32 simulation_sample_rate,
   mSerialSimulationData.SetChannel(mSettings->mInputChannel);
   mSerialSimulationData.SetSampleRate(simulation_sample_rate);
   mSerialSimulationData.SetInitialBitState(BIT_HIGH);
+
+  // xorshift has a fixed point at 0, keep both states non-zero for every seed
+  mRandomState = 0x2545F491 ^ (mSettings->mSimulationSeed * 0x9E3779B9);
+  mImpairmentRandomState = 0x9E3779B9 ^ (mSettings->mSimulationSeed * 0x2545F491);
+  if (mRandomState == 0) {
+    mRandomState = 1;
+  }
+  if (mImpairmentRandomState == 0) {
+    mImpairmentRandomState = 1;
+  }
+
+  mImpaired = mSettings->mClockOffset_ppm != 0 || mSettings->mClockDrift_ppm != 0 ||
+              mSettings->mRandomJitter_ns != 0 || mSettings->mDeterministicJitter_ns != 0 ||
+              mSettings->mGlitchRate != 0 || mSettings->mDroppedEdgeRate != 0 ||
+              mSettings->mSymbolErrorRate != 0 || mSettings->mCrcErrorRate != 0;
+
+  if (mSettings->mSimulationTraffic == SimulationTraffic_Scenario) {
+    std::string error;
+    if (!mScenario.Load(mSettings->mScenarioFile.c_str(), &error)) {
+      // The settings check the file, but it may have changed since
+      std::cout << "Simulation scenario " << mSettings->mScenarioFile << ": " << error
+                << ", simulating Pings instead" << std::endl;
+    }
+  }
+
+  BuildTemplates();
+}
+
+/**
+ * @brief Pre-encode the preamble, every ordered set, every K-code and every 4b5b-encoded byte at
+ * the current sample rate and bit rate, so that messages can be generated by splicing templates
+ * instead of encoding every bit.
+ */
+void USBPDSimulationDataGenerator::BuildTemplates() {
+  mTemplateBitRate = mSettings->mBitRate;
+
+  // Always start with transmitting a 0
+  mPreambleTemplate.clear();
+  for (int i = 0; i < 64; i++) {
+    AppendBiphaseMarkCodingBit(&mPreambleTemplate, (i & 0x1) != 0);
+  }
+
+  for (int code = 0; code < NUM_KCODE; code++) {
+    mKCodeTemplates[code].clear();
+    AppendFiveBit(&mKCodeTemplates[code], kcode_map[code]);
+  }
+
+  for (int set = 0; set < NUM_ORDERED_SET; set++) {
+    mOrderedSetTemplates[set].clear();
+
+    for (int i = 0; i < numKcodeInSOP; i++) {
+      const WaveformTemplate& kcode = mKCodeTemplates[ordered_set_map[set][i]];
+      mOrderedSetTemplates[set].insert(mOrderedSetTemplates[set].end(), kcode.begin(), kcode.end());
+    }
+  }
+
+  // A byte is 2x four-bit numbers, transmitted LSB first
+  for (int byte = 0; byte < 256; byte++) {
+    mByteTemplates[byte].clear();
+    AppendFiveBit(&mByteTemplates[byte], FourBitToFiveBitEncoder(byte & 0xF));
+    AppendFiveBit(&mByteTemplates[byte], FourBitToFiveBitEncoder((byte >> 4) & 0xF));
+  }
+
+  if (!mScenario.GetMessages().empty()) {
+    EncodeScenario();
+  }
 }
 
 U32 USBPDSimulationDataGenerator::GenerateSimulationData(
@@ -31,21 +119,19 @@ U32 USBPDSimulationDataGenerator::GenerateSimulationData(
                                                     sample_rate,
                                                     mSimulationSampleRateHz);
 
-  while (mSerialSimulationData.GetCurrentSampleNumber() < (adjusted_largest_sample_requested + 3)) {
-    for (int i = 0; i < NUM_SOP_TYPE; i++) {
-      uint8_t portPowerRoleOrCablePlug = 0;
-
-      if ((SOPType)i == SOPType_SOP) {
-        portPowerRoleOrCablePlug = (uint8_t)PortPowerRole_Source;
-      } else {
-        portPowerRoleOrCablePlug = (uint8_t)CablePlug_MsgSrcPort;
-      }
+  if (mTemplateBitRate != mSettings->mBitRate) {
+    BuildTemplates();
+  }
 
-      CreateUSBPDControlMessageTransaction((SOPType)i,
-                                           ControlMessage_Ping,
-                                           PortDataRole_DFP,
-                                           PDSpecRevision_2P0,
-                                           portPowerRoleOrCablePlug);
+  while (mSerialSimulationData.GetCurrentSampleNumber() < (adjusted_largest_sample_requested + 3)) {
+    if (!mScenarioSteps.empty()) {
+      CreateScenarioStep();
+    } else if (mSettings->mSimulationTraffic == SimulationTraffic_Ping ||
+               mSettings->mSimulationTraffic == SimulationTraffic_Scenario) {
+      // Also the fallback for a scenario that could not be loaded
+      CreatePingTraffic();
+    } else {
+      CreateSessionTraffic();
     }
   }
 
@@ -84,62 +170,137 @@ void USBPDSimulationDataGenerator::CreateSerialByte() {
   mSerialSimulationData.Advance(samples_per_bit);
 }
 
-void USBPDSimulationDataGenerator::CreateBiphaseMarkCodingBit(bool bit) {
-  U32 samples_per_bit = mSimulationSampleRateHz / mSettings->mBitRate;
+void USBPDSimulationDataGenerator::AppendBiphaseMarkCodingBit(WaveformTemplate* waveform,
+                                                              bool bit) {
   U32 samples_per_transition =
       mSimulationSampleRateHz / (mSettings->mBitRate * 2);  // Two transitions per bit
 
-  // All bits start with a transition
-  mSerialSimulationData.Transition();
-
-  // Advance halfway through the bit
-  mSerialSimulationData.Advance(samples_per_transition);
-
-  // If bit is 1, we need to transition 1/2 way through this bit
+  // All bits start with a transition. If bit is 1, we need to transition 1/2 way through this bit
   if (bit) {
-    mSerialSimulationData.Transition();
+    waveform->push_back(samples_per_transition);
+    waveform->push_back(samples_per_transition);
+  } else {
+    waveform->push_back(samples_per_transition * 2);
   }
-
-  mSerialSimulationData.Advance(samples_per_transition);
 }
 
-void USBPDSimulationDataGenerator::CreateFiveBitFromFourBit(uint8_t fourBit) {
-  uint8_t fiveBit = FourBitToFiveBitEncoder(fourBit);
-  for (int i = 0; i < 5; i++) {
+void USBPDSimulationDataGenerator::AppendFiveBit(WaveformTemplate* waveform, uint8_t fiveBit) {
+  for (int i = 0; i < numKcodeBits; i++) {
     // Always transmit LSB first
-    CreateBiphaseMarkCodingBit(fiveBit & 0x1);
+    AppendBiphaseMarkCodingBit(waveform, fiveBit & 0x1);
     fiveBit >>= 1;
   }
 }
 
-void USBPDSimulationDataGenerator::CreateByte(uint8_t byte) {
-  // A byte is 2x four-bit numbers
-  // Transmit LSB first
-  CreateFiveBitFromFourBit(byte & 0xF);
-  CreateFiveBitFromFourBit((byte >> 4) & 0xF);
+void USBPDSimulationDataGenerator::CreateFromTemplate(const WaveformTemplate& waveform) {
+  if (mImpaired) {
+    for (U32 samples : waveform) {
+      CreateImpairedEdge(samples);
+    }
+    return;
+  }
+
+  for (U32 samples : waveform) {
+    mSerialSimulationData.Transition();
+    mSerialSimulationData.Advance(samples);
+  }
 }
 
-void USBPDSimulationDataGenerator::CreatePreamble() {
-  // Always start with transmitting a 0
-  bool bit = false;
+/**
+ * @brief Transition, then hold for samples, as seen through the configured clock error and jitter
+ */
+void USBPDSimulationDataGenerator::CreateImpairedEdge(U32 samples) {
+  if (mDropNextEdge) {
+    // The line stays at its current level, which inverts the rest of the message. BMC does not
+    // depend on the polarity.
+    mDropNextEdge = false;
+  } else {
+    mSerialSimulationData.Transition();
+  }
 
-  for (int i = 0; i < 64; i++) {
-    CreateBiphaseMarkCodingBit(bit);
-    bit = !bit;
+  double seconds =
+      (double)mSerialSimulationData.GetCurrentSampleNumber() / (double)mSimulationSampleRateHz;
+  double clockError =
+      (mSettings->mClockOffset_ppm + mSettings->mClockDrift_ppm * seconds) / 1000000.0;
+  clockError = std::max(-0.5, std::min(0.5, clockError));
+
+  // Jitter moves the edge at the end of this interval. The deterministic part is duty cycle
+  // distortion: rising edges early, falling edges late.
+  double samplesPerNs = mSimulationSampleRateHz / 1000000000.0;
+  double displacement = NextGaussian() * mSettings->mRandomJitter_ns * samplesPerNs;
+  double distortion = mSettings->mDeterministicJitter_ns * samplesPerNs / 2.0;
+  displacement += (mSerialSimulationData.GetCurrentBitState() == BIT_HIGH) ? distortion
+                                                                            : -distortion;
+
+  double duration = samples * (1.0 + clockError) + displacement - mEdgeDisplacement + mSampleCarry;
+  mEdgeDisplacement = displacement;
+
+  if (duration < 1.0) {
+    duration = 1.0;
   }
+
+  U32 whole = (U32)duration;
+  mSampleCarry = duration - whole;
+
+  if (mGlitchCountdown > 0 && --mGlitchCountdown == 0) {
+    // A pulse of a quarter of a half bit, in the middle of the interval
+    U32 glitch = std::max<U32>(1, samples / 8);
+
+    if (whole >= glitch + 2) {
+      U32 before = (whole - glitch) / 2;
+      mSerialSimulationData.Advance(before);
+      mSerialSimulationData.Transition();
+      mSerialSimulationData.Advance(glitch);
+      mSerialSimulationData.Transition();
+      mSerialSimulationData.Advance(whole - before - glitch);
+      return;
+    }
+
+    // Too short to fit a glitch, try the next interval
+    mGlitchCountdown = 1;
+  }
+
+  mSerialSimulationData.Advance(whole);
 }
 
-void USBPDSimulationDataGenerator::CreateSOP(SOPType sop) {
-  if (sop >= NUM_SOP_TYPE) {
+void USBPDSimulationDataGenerator::CreateByte(uint8_t byte) {
+  if (mCorruptByteCountdown > 0 && --mCorruptByteCountdown == 0) {
+    CreateCorruptByte(byte);
     return;
   }
 
-  const KCODEType* kcodesInSop = sop_map[sop];
+  CreateFromTemplate(mByteTemplates[byte]);
+}
+
+/**
+ * @brief Send byte with one of its two 5b symbols replaced by a code that is neither a data
+ * symbol nor a K-code
+ */
+void USBPDSimulationDataGenerator::CreateCorruptByte(uint8_t byte) {
+  static const uint8_t invalidSymbols[] = {
+      0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x08, 0x0C, 0x10, 0x1F};
+
+  U32 random = NextRandom(&mImpairmentRandomState);
+  uint8_t invalid = invalidSymbols[random % sizeof(invalidSymbols)];
+  bool corruptLowNibble = (random >> 16) & 0x1;
+
+  mCorruptByteTemplate.clear();
+  AppendFiveBit(&mCorruptByteTemplate,
+                corruptLowNibble ? invalid : FourBitToFiveBitEncoder(byte & 0xF));
+  AppendFiveBit(&mCorruptByteTemplate,
+                corruptLowNibble ? FourBitToFiveBitEncoder((byte >> 4) & 0xF) : invalid);
+
+  CreateFromTemplate(mCorruptByteTemplate);
+}
+
+void USBPDSimulationDataGenerator::CreatePreamble() { CreateFromTemplate(mPreambleTemplate); }
 
-  for (int i = 0; i < numKcodeInSOP; i++) {
-    KCODEType currentKcode = kcodesInSop[i];
-    CreateKCode(currentKcode);
+void USBPDSimulationDataGenerator::CreateSOP(SOPType sop) {
+  if (sop >= NUM_SOP_TYPE) {
+    return;
   }
+
+  CreateFromTemplate(mOrderedSetTemplates[sop]);
 }
 
 void USBPDSimulationDataGenerator::CreateKCode(KCODEType code) {
@@ -147,11 +308,7 @@ void USBPDSimulationDataGenerator::CreateKCode(KCODEType code) {
     return;
   }
 
-  uint8_t kcode_value = kcode_map[code];
-  for (int i = 0; i < numKcodeBits; i++) {
-    CreateBiphaseMarkCodingBit(kcode_value & 0x1);
-    kcode_value >>= 1;
-  }
+  CreateFromTemplate(mKCodeTemplates[code]);
 }
 
 // Take a 4-bit number as input and produce a 5-bit number as output
@@ -160,7 +317,7 @@ uint8_t USBPDSimulationDataGenerator::FourBitToFiveBitEncoder(uint8_t val) {
   return fourBitToFiveBitLUT[(val & 0x0F)];
 }
 
-uint16_t USBPDSimulationDataGenerator::CreateMessageHeader(uint8_t messageType,
+uint16_t USBPDSimulationDataGenerator::EncodeMessageHeader(uint8_t messageType,
                                                            uint8_t portDataRole,
                                                            uint8_t specificationRevision,
                                                            uint8_t portPowerRoleOrCablePlug,
@@ -168,14 +325,14 @@ uint16_t USBPDSimulationDataGenerator::CreateMessageHeader(uint8_t messageType,
                                                            uint8_t numOfDataObjects) {
   uint16_t nibble0 = 0;  // [3..0: Message Type]
   uint16_t nibble1 = 0;  // [7..6: Specification Revision] [5: Port Data Role if SOP / Reserved, 0
-                         // if SOP' or SOP"] [4: Reserved, 0]
+                         // if SOP' or SOP"] [4: Message Type]
   uint16_t nibble2 =
       0;  // [11..9: Message ID] [8: Port Power Role if SOP / Cable Plug if SOP' or SOP"]
   uint16_t nibble3 = 0;  // [15: Reserved, 0] [14..12: Number of Data Objects]
 
   nibble0 = messageType & 0xF;
 
-  // nibble1 bit 0 is reserved
+  nibble1 |= (messageType >> 4) & 0x1;
   nibble1 |= (portDataRole & 0x1) << 1;
   nibble1 |= (specificationRevision & 0x3) << 2;
 
@@ -184,97 +341,156 @@ uint16_t USBPDSimulationDataGenerator::CreateMessageHeader(uint8_t messageType,
 
   nibble3 |= (numOfDataObjects & 0x7);
 
-  CreateFiveBitFromFourBit((uint8_t)nibble0);
-  CreateFiveBitFromFourBit((uint8_t)nibble1);
-  CreateFiveBitFromFourBit((uint8_t)nibble2);
-  CreateFiveBitFromFourBit((uint8_t)nibble3);
+  uint16_t header = ((nibble3 & 0xF) << 12) | ((nibble2 & 0xF) << 8) | ((nibble1 & 0xF) << 4) |
+                    (nibble0 & 0xF);
 
-  return ((nibble3 & 0xF) << 12) | ((nibble2 & 0xF) << 8) | ((nibble1 & 0xF) << 4) |
-         (nibble0 & 0xF);
+  return header;
 }
 
-uint16_t USBPDSimulationDataGenerator::CreateControlMessageHeader(ControlMessageTypes type,
-                                                                  PortDataRole role,
-                                                                  PDSpecRevision rev,
-                                                                  uint8_t portPowerRoleOrCablePlug,
-                                                                  uint8_t messageId) {
-  return CreateMessageHeader((uint8_t)type,
-                             (uint8_t)role,
-                             (uint8_t)rev,
-                             portPowerRoleOrCablePlug,
+/**
+ * @brief Header of a message from sender, with the roles of the simulated link
+ */
+uint16_t USBPDSimulationDataGenerator::GetMessageHeader(Transmitter sender,
+                                                        SOPType sop,
+                                                        uint8_t messageType,
+                                                        uint8_t messageId,
+                                                        uint8_t numDataObjects) {
+  uint8_t dataRole = 0;
+  uint8_t powerRoleOrCablePlug = 0;
+
+  if (sop == SOPType_SOP) {
+    // The DFP is the Source in the simulated session
+    dataRole = (sender == Transmitter_DFP) ? PortDataRole_DFP : PortDataRole_UFP;
+    powerRoleOrCablePlug = (sender == Transmitter_DFP) ? PortPowerRole_Source : PortPowerRole_Sink;
+  } else {
+    // Port Data Role is reserved for SOP' and SOP" messages
+    powerRoleOrCablePlug =
+        (sender == Transmitter_CablePlug) ? CablePlug_MsgSrcPlug : CablePlug_MsgSrcPort;
+  }
+
+  return EncodeMessageHeader(messageType,
+                             dataRole,
+                             PDSpecRevision_2P0,
+                             powerRoleOrCablePlug,
                              messageId,
-                             0);  // Control messages always have 0 data objects
+                             numDataObjects);
+}
+
+/**
+ * @brief The end of the link that acknowledges a message from sender
+ */
+USBPDSimulationDataGenerator::Transmitter USBPDSimulationDataGenerator::GetReceiver(
+    Transmitter sender, SOPType sop) {
+  if (sop == SOPType_SOP) {
+    return (sender == Transmitter_DFP) ? Transmitter_UFP : Transmitter_DFP;
+  }
+
+  return (sender == Transmitter_CablePlug) ? Transmitter_DFP : Transmitter_CablePlug;
 }
 
-void CreateDataMessageHeader() {}
+void USBPDSimulationDataGenerator::CreateIdle(U64 samples) {
+  // Advance() takes a U32, long idle periods at high sample rates need several steps
+  while (samples > 0) {
+    U32 step = (samples > 0x80000000ULL) ? 0x80000000U : (U32)samples;
+    mSerialSimulationData.Advance(step);
+    samples -= step;
+  }
+}
 
-// Simulate a system with all possible communicators
-// UFP and DFP as well as both cable ends
+U64 USBPDSimulationDataGenerator::MicrosecondsToSamples(U64 us) const {
+  return (us * mSimulationSampleRateHz) / 1000000ULL;
+}
 
-uint8_t ufpMessageId = 0;
-uint8_t dfpMessageId = 0;
-uint8_t sopPrimeCableMessageId = 0;
-uint8_t sopDoublePrimeCableMessageId = 0;
+/**
+ * @brief xorshift32, so that the generated traffic is the same on every run
+ */
+U32 USBPDSimulationDataGenerator::NextRandom(U32* state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
 
-void USBPDSimulationDataGenerator::CreateUSBPDControlMessageTransaction(
-    SOPType sop,
-    ControlMessageTypes messageType,
-    PortDataRole dataRole,
-    PDSpecRevision specRev,
-    uint8_t portPowerRoleOrCablePlug) {
+bool USBPDSimulationDataGenerator::ImpairmentHit(U32 ratePerThousand) {
+  return (NextRandom(&mImpairmentRandomState) % 1000) < ratePerThousand;
+}
+
+/**
+ * @brief Standard normal random number (Box-Muller)
+ */
+double USBPDSimulationDataGenerator::NextGaussian() {
+  double u1 = (NextRandom(&mImpairmentRandomState) + 1.0) / 4294967297.0;
+  double u2 = NextRandom(&mImpairmentRandomState) / 4294967296.0;
+  return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+bool USBPDSimulationDataGenerator::CreateMessage(Transmitter sender,
+                                                 SOPType sop,
+                                                 uint8_t messageType,
+                                                 uint8_t messageId,
+                                                 const uint32_t* dataObjects,
+                                                 uint8_t numDataObjects) {
   U32 samples_per_bit = mSimulationSampleRateHz / mSettings->mBitRate;
 
-  // Ensure we start in the high state
-  // TODO: simulator settings that allow us to start in either the high or low state: either
-  // state is technically valid for Biphase Mark Coding
-  mSerialSimulationData.TransitionIfNeeded(BIT_HIGH);
+  bool damaged = false;
+  bool crcError = false;
 
-  // we're currenty high
-  // let's move forward a little
+  if (mImpaired) {
+    // Header, data objects and CRC
+    U32 numBytes = 2 + 4 * numDataObjects + 4;
+    // Preamble, SOP, bytes and EOP, each bit has at least one edge
+    U32 numBits = 64 + 20 + 10 * numBytes + 5;
+
+    mEdgeDisplacement = 0.0;
+    mDropNextEdge = ImpairmentHit(mSettings->mDroppedEdgeRate);
+
+    mGlitchCountdown = 0;
+    if (ImpairmentHit(mSettings->mGlitchRate)) {
+      mGlitchCountdown = 1 + NextRandom(&mImpairmentRandomState) % numBits;
+      damaged = true;
+    }
+
+    mCorruptByteCountdown = 0;
+    if (ImpairmentHit(mSettings->mSymbolErrorRate)) {
+      mCorruptByteCountdown = 1 + NextRandom(&mImpairmentRandomState) % numBytes;
+      damaged = true;
+    }
+
+    if (ImpairmentHit(mSettings->mCrcErrorRate)) {
+      crcError = true;
+      damaged = true;
+    }
+  }
+
+  // Idle, then a preamble starting with a transition
   mSerialSimulationData.Advance(samples_per_bit * 10);
 
   CreatePreamble();
 
   CreateSOP(sop);
 
-  uint8_t* sendMessageId = NULL;
-  uint8_t* replyMessageId = NULL;
+  uint16_t header = GetMessageHeader(sender, sop, messageType, messageId, numDataObjects);
+  CreateByte(header & 0xFF);
+  CreateByte((header >> 8) & 0xFF);
 
-  if (sop == SOPType_SOP) {
-    // Who is sending this message?
-    if (dataRole == PortDataRole_UFP) {
-      sendMessageId = &ufpMessageId;
-    } else {
-      sendMessageId = &dfpMessageId;
-    }
+  uint32_t crc = crc32(0x00000000, (const uint8_t*)&header, sizeof(uint16_t), usbCrcPolynomial);
 
-  } else {
-    // We are talking to the cable since we are not using SOP
-    // Cables can never initialte a transaction, therefore this must
-    // come from the UFP or the DFP
-    // There's no way to tell who is sending the message to the cable,
-    // So lets just assume it's the DFP
-    sendMessageId = &dfpMessageId;
+  for (int i = 0; i < numDataObjects; i++) {
+    uint32_t dataObject = dataObjects[i];
 
-    // If message type is not a SOP message, then
-    // PortDataRole must be 0
-    dataRole = (PortDataRole)0;
-  }
+    CreateByte(dataObject & 0xFF);
+    CreateByte((dataObject >> 8) & 0xFF);
+    CreateByte((dataObject >> 16) & 0xFF);
+    CreateByte((dataObject >> 24) & 0xFF);
 
-  uint16_t headerBytes = CreateControlMessageHeader(messageType,
-                                                    dataRole,
-                                                    specRev,
-                                                    portPowerRoleOrCablePlug,
-                                                    *sendMessageId);
+    crc = crc32(crc, (const uint8_t*)&dataObject, sizeof(uint32_t), usbCrcPolynomial);
+  }
 
-  *sendMessageId++;
-  if (*sendMessageId > 7) {
-    *sendMessageId = 0;
+  if (crcError) {
+    crc ^= 1u << (NextRandom(&mImpairmentRandomState) % 32);
   }
 
   // Send CRC32
-  uint32_t crc = crc32(0x00000000, (const uint8_t*)&headerBytes, sizeof(uint16_t), usbCrcPolynomial);
-
   CreateByte(crc & 0xFF);
   CreateByte((crc >> 8) & 0xFF);
   CreateByte((crc >> 16) & 0xFF);
@@ -286,62 +502,601 @@ void USBPDSimulationDataGenerator::CreateUSBPDControlMessageTransaction(
   // All Frames end with a final edge transition
   mSerialSimulationData.Transition();
 
-  mSerialSimulationData.Advance(samples_per_bit * 10);
+  return damaged;
+}
 
-  // Reply with a GoodCRC message from the other side
-  CreatePreamble();
+// Retries after a missing GoodCRC
+static const int simRetryCount = 2;            // nRetryCount
+static const U64 simReceiveTimeout_us = 1000;  // tReceive
+
+void USBPDSimulationDataGenerator::CreateTransaction(Transmitter sender,
+                                                     SOPType sop,
+                                                     uint8_t messageType,
+                                                     const uint32_t* dataObjects,
+                                                     uint8_t numDataObjects) {
+  uint8_t& messageId = mMessageIds[sender][sop];
+
+  // The receiver acknowledges with a GoodCRC carrying the same message ID
+  Transmitter receiver = GetReceiver(sender, sop);
+
+  // Damaged messages are not acknowledged, and damaged GoodCRCs are not seen by the sender. Either
+  // way the sender retries with the same message ID.
+  for (int attempt = 0; attempt <= simRetryCount; attempt++) {
+    if (attempt > 0) {
+      CreateIdle(MicrosecondsToSamples(simReceiveTimeout_us));
+    }
 
-  CreateSOP(sop);
+    if (CreateMessage(sender, sop, messageType, messageId, dataObjects, numDataObjects)) {
+      continue;
+    }
 
-  if (sop == SOPType_SOP) {
-    // If we are replying to a SOP message, we should swap port data roles
-    if (dataRole == PortDataRole_UFP) {
-      dataRole = PortDataRole_DFP;
-      replyMessageId = &dfpMessageId;
-    } else {
-      dataRole = PortDataRole_UFP;
-      replyMessageId = &ufpMessageId;
+    if (!CreateMessage(receiver, sop, ControlMessage_GoodCRC, messageId, NULL, 0)) {
+      break;
     }
+  }
 
-    // If we are replying to a SOP message, we should swap port power roles
-    if (portPowerRoleOrCablePlug == PortPowerRole_Sink) {
-      portPowerRoleOrCablePlug = PortPowerRole_Source;
-    } else {
-      portPowerRoleOrCablePlug = PortPowerRole_Sink;
+  messageId = (messageId + 1) & 0x7;
+}
+
+/**
+ * @brief Ping + GoodCRC on every SOP type
+ */
+void USBPDSimulationDataGenerator::CreatePingTraffic() {
+  for (int i = 0; i < NUM_SOP_TYPE; i++) {
+    CreateTransaction(Transmitter_DFP, (SOPType)i, ControlMessage_Ping);
+  }
+}
+
+// Timing of the simulated PD session
+static const U64 simResponseDelay_us = 2000;         // Well inside tSenderResponse
+static const U64 simPowerTransitionDelay_us = 30000;  // Accept to PS_RDY
+static const U64 simPpsRequestInterval_us = 5000000;  // Well inside tPPSRequest
+
+// Relative frequency of each background exchange (in SessionExchange order), for each session
+// traffic setting
+static const U32 simExchangeWeights[NUM_SIMULATION_TRAFFIC][6] = {
+    {0, 0, 0, 0, 0, 0},  // Ping only, not used
+    {4, 1, 2, 1, 1, 1},  // Balanced
+    {1, 0, 1, 3, 3, 3},  // Mostly VDMs
+    {1, 3, 5, 0, 0, 0},  // Mostly power negotiation
+    {0, 0, 0, 0, 0, 0},  // Scenario, not used
+};
+
+// Source capabilities: 5V, 9V, 15V and 20V fixed supplies, and a 3.3-21V PPS
+static const uint32_t simSourceCapabilities[] = {
+    (1u << 26) | (1u << 25) | (100u << 10) | 300u,  // 5V 3A, USB comms, dual-role data
+    (180u << 10) | 300u,                            // 9V 3A
+    (300u << 10) | 300u,                            // 15V 3A
+    (400u << 10) | 325u,                            // 20V 3.25A
+    (3u << 30) | (210u << 17) | (33u << 8) | 60u,   // PPS 3.3-21V 3A
+};
+static const uint32_t simFixedRequestPosition = 2;
+static const uint32_t simPpsRequestPosition = 5;
+
+static const uint16_t simThunderboltSvid = 0x8087;
+static const uint16_t simVid = 0x1234;
+
+static uint32_t SimStructuredVdmHeader(uint16_t svid,
+                                       StructuredVDMCommandType commandType,
+                                       StructuredVDMCommand command) {
+  return ((uint32_t)svid << 16) | (1u << 15) | (StructuredVDMVersion_2P0 << 13) |
+         ((uint32_t)commandType << 6) | (uint32_t)command;
+}
+
+void USBPDSimulationDataGenerator::CreateSessionTraffic() {
+  if (!mSessionStarted) {
+    CreateSessionStart();
+    mSessionStarted = true;
+
+    U64 now = mSerialSimulationData.GetCurrentSampleNumber();
+    mNextExchangeSample = now;
+    mNextPpsRequestSample = now + MicrosecondsToSamples(simPpsRequestInterval_us);
+    return;
+  }
+
+  U64 now = mSerialSimulationData.GetCurrentSampleNumber();
+
+  // A PPS contract must be refreshed periodically, regardless of the other traffic
+  if (now >= mNextPpsRequestSample) {
+    CreateSessionExchange(SessionExchange_PpsRequest);
+    mNextPpsRequestSample = now + MicrosecondsToSamples(simPpsRequestInterval_us);
+    return;
+  }
+
+  U32 rate = mSettings->mSimulationRate;
+  U64 next = mNextPpsRequestSample;
+
+  if (rate > 0) {
+    if (now >= mNextExchangeSample) {
+      const U32* weights = simExchangeWeights[mSettings->mSimulationTraffic];
+
+      U32 totalWeight = 0;
+      for (int i = 0; i < NUM_SESSION_EXCHANGE; i++) {
+        totalWeight += weights[i];
+      }
+
+      U32 pick = NextRandom(&mRandomState) % totalWeight;
+      int exchange = 0;
+      while (pick >= weights[exchange]) {
+        pick -= weights[exchange++];
+      }
+
+      CreateSessionExchange((SessionExchange)exchange);
+
+      // Hold the average rate, but don't try to catch up after a long exchange
+      mNextExchangeSample += mSimulationSampleRateHz / rate;
+      if (mNextExchangeSample < now) {
+        mNextExchangeSample = now;
+      }
+      return;
     }
+
+    next = std::min(next, mNextExchangeSample);
+  }
+
+  CreateIdle(next - now);
+}
+
+/**
+ * @brief Initial contract negotiation and discovery, as after an attach
+ */
+void USBPDSimulationDataGenerator::CreateSessionStart() {
+  uint32_t fixedRequest =
+      (simFixedRequestPosition << 28) | (1u << 25) | (300u << 10) | 300u;  // 9V 3A
+  CreateContractNegotiation(fixedRequest);
+
+  CreateIdle(MicrosecondsToSamples(simResponseDelay_us));
+  CreateDiscoverIdentity(SOPType_SOP_PRIME);
+
+  CreateIdle(MicrosecondsToSamples(simResponseDelay_us));
+  CreateDiscoverIdentity(SOPType_SOP);
+
+  CreateIdle(MicrosecondsToSamples(simResponseDelay_us));
+  CreateDiscoverSvidsAndModes();
+
+  // Move to the PPS supply
+  CreateIdle(MicrosecondsToSamples(simResponseDelay_us));
+  CreateSessionExchange(SessionExchange_PpsRequest);
+}
+
+void USBPDSimulationDataGenerator::CreateSessionExchange(SessionExchange exchange) {
+  switch (exchange) {
+    case SessionExchange_Ping:
+      CreateTransaction(Transmitter_DFP, SOPType_SOP, ControlMessage_Ping);
+      break;
+
+    case SessionExchange_Renegotiate: {
+      CreateTransaction(Transmitter_UFP, SOPType_SOP, ControlMessage_Get_Source_Cap);
+      CreateIdle(MicrosecondsToSamples(simResponseDelay_us));
+
+      uint32_t request = (simPpsRequestPosition << 28) | (1u << 25) |
+                         ((mPpsVoltage_mV / 20) << 9) | 60u;  // 3A
+      CreateContractNegotiation(request);
+    } break;
+
+    case SessionExchange_PpsRequest: {
+      // Step the requested voltage through 5V..11V
+      mPpsVoltage_mV = (mPpsVoltage_mV >= 11000) ? 5000 : (mPpsVoltage_mV + 100);
+
+      uint32_t request = (simPpsRequestPosition << 28) | (1u << 25) |
+                         ((mPpsVoltage_mV / 20) << 9) | 60u;  // 3A
+      CreateTransaction(Transmitter_UFP, SOPType_SOP, DataMessage_Request, &request, 1);
+      CreateIdle(MicrosecondsToSamples(simResponseDelay_us));
+      CreateTransaction(Transmitter_DFP, SOPType_SOP, ControlMessage_Accept);
+      CreateIdle(MicrosecondsToSamples(simResponseDelay_us));
+      CreateTransaction(Transmitter_DFP, SOPType_SOP, ControlMessage_PS_RDY);
+    } break;
+
+    case SessionExchange_DiscoverIdentity:
+      CreateDiscoverIdentity(SOPType_SOP);
+      break;
+
+    case SessionExchange_DiscoverCableIdentity:
+      CreateDiscoverIdentity(SOPType_SOP_PRIME);
+      break;
+
+    case SessionExchange_DiscoverSvidsAndModes:
+      CreateDiscoverSvidsAndModes();
+      break;
+
+    default:
+      break;
+  }
+}
+
+/**
+ * @brief Source_Capabilities, Request, Accept and PS_RDY
+ */
+void USBPDSimulationDataGenerator::CreateContractNegotiation(uint32_t request) {
+  CreateTransaction(Transmitter_DFP,
+                    SOPType_SOP,
+                    DataMessage_Source_Capabilities,
+                    simSourceCapabilities,
+                    sizeof(simSourceCapabilities) / sizeof(simSourceCapabilities[0]));
+  CreateIdle(MicrosecondsToSamples(simResponseDelay_us));
+
+  CreateTransaction(Transmitter_UFP, SOPType_SOP, DataMessage_Request, &request, 1);
+  CreateIdle(MicrosecondsToSamples(simResponseDelay_us));
+
+  CreateTransaction(Transmitter_DFP, SOPType_SOP, ControlMessage_Accept);
+  CreateIdle(MicrosecondsToSamples(simPowerTransitionDelay_us));
+
+  CreateTransaction(Transmitter_DFP, SOPType_SOP, ControlMessage_PS_RDY);
+}
+
+/**
+ * @brief Discover Identity request from the DFP, and the ACK from the port partner (SOP) or the
+ * cable (SOP')
+ */
+void USBPDSimulationDataGenerator::CreateDiscoverIdentity(SOPType sop) {
+  uint32_t request = SimStructuredVdmHeader(
+      pdSid, StructuredVDMCommandType_REQ, StructuredVDMCommand_DiscoverIdentity);
+  CreateTransaction(Transmitter_DFP, sop, DataMessage_Vendor_Defined, &request, 1);
+  CreateIdle(MicrosecondsToSamples(simResponseDelay_us));
+
+  uint32_t response[5];
+  response[0] = SimStructuredVdmHeader(
+      pdSid, StructuredVDMCommandType_ACK, StructuredVDMCommand_DiscoverIdentity);
+
+  if (sop == SOPType_SOP) {
+    // ID Header: USB device, PDUSB peripheral, modal operation, USB-C receptacle
+    response[1] = (1u << 30) | ((uint32_t)SOPProductTypeUfp_PDUSBPeripheral << 27) | (1u << 26) |
+                  ((uint32_t)ConnectorType_USBCReceptable << 21) | simVid;
+    response[2] = 0x00000001;                    // Cert Stat
+    response[3] = (0x5678u << 16) | 0x0100u;     // Product: PID, bcdDevice
+    response[4] = (3u << 29) | (1u << 24) | 1u;  // UFP VDO: version 1.3, USB 2.0 + 3.2 Gen 1
+    CreateTransaction(Transmitter_UFP, sop, DataMessage_Vendor_Defined, response, 5);
   } else {
-    // Replying to a SOP' or SOP" message, dataRole must be 0
-    dataRole = (PortDataRole)0;
+    // ID Header: passive cable, USB-C plug
+    response[1] = ((uint32_t)SOPPrimeProductType_PassiveCable << 27) |
+                  ((uint32_t)ConnectorType_USBCPlug << 21) | simVid;
+    response[2] = 0x00000002;                     // Cert Stat
+    response[3] = (0x9ABCu << 16) | 0x0100u;      // Product: PID, bcdDevice
+    response[4] = (2u << 18) | (1u << 5) | 0x2u;  // Passive cable VDO: USB-C, 3A, Gen 2
+    CreateTransaction(Transmitter_CablePlug, sop, DataMessage_Vendor_Defined, response, 5);
+  }
+}
 
-    // If we are replying to a SOP' or SOP" message, we must be the cable
-    portPowerRoleOrCablePlug = CablePlug_MsgSrcPlug;
+/**
+ * @brief Discover SVIDs and Discover Modes (DisplayPort), each request + ACK
+ */
+void USBPDSimulationDataGenerator::CreateDiscoverSvidsAndModes() {
+  uint32_t request = SimStructuredVdmHeader(
+      pdSid, StructuredVDMCommandType_REQ, StructuredVDMCommand_DiscoverSVIDs);
+  CreateTransaction(Transmitter_DFP, SOPType_SOP, DataMessage_Vendor_Defined, &request, 1);
+  CreateIdle(MicrosecondsToSamples(simResponseDelay_us));
+
+  uint32_t svids[3] = {
+      SimStructuredVdmHeader(
+          pdSid, StructuredVDMCommandType_ACK, StructuredVDMCommand_DiscoverSVIDs),
+      ((uint32_t)displayPortSvid << 16) | simThunderboltSvid,
+      0x00000000,  // Terminates the SVID list
+  };
+  CreateTransaction(Transmitter_UFP, SOPType_SOP, DataMessage_Vendor_Defined, svids, 3);
+  CreateIdle(MicrosecondsToSamples(simResponseDelay_us));
+
+  request = SimStructuredVdmHeader(
+      displayPortSvid, StructuredVDMCommandType_REQ, StructuredVDMCommand_DiscoverModes);
+  CreateTransaction(Transmitter_DFP, SOPType_SOP, DataMessage_Vendor_Defined, &request, 1);
+  CreateIdle(MicrosecondsToSamples(simResponseDelay_us));
+
+  uint32_t modes[2] = {
+      SimStructuredVdmHeader(
+          displayPortSvid, StructuredVDMCommandType_ACK, StructuredVDMCommand_DiscoverModes),
+      0x001C0045,  // DisplayPort: UFP_D, receptacle, pin assignments C, D and E
+  };
+  CreateTransaction(Transmitter_UFP, SOPType_SOP, DataMessage_Vendor_Defined, modes, 2);
+}
 
-    if (sop == SOPType_SOP_PRIME || sop == SOPType_SOP_PRIME_DEBUG) {
-      replyMessageId = &sopPrimeCableMessageId;
-    } else {
-      replyMessageId = &sopDoublePrimeCableMessageId;
+void USBPDSimulationDataGenerator::AppendByte(WaveformTemplate* waveform, uint8_t byte) {
+  waveform->insert(waveform->end(), mByteTemplates[byte].begin(), mByteTemplates[byte].end());
+}
+
+/**
+ * @brief Encode a complete packet, from the first edge of the preamble to the EOP, into waveform.
+ * The final edge is added when the waveform is played.
+ *
+ * @param payload the bytes following the header
+ */
+void USBPDSimulationDataGenerator::AppendPacket(WaveformTemplate* waveform,
+                                                SOPType sop,
+                                                uint16_t header,
+                                                const uint8_t* payload,
+                                                size_t size) {
+  waveform->insert(waveform->end(), mPreambleTemplate.begin(), mPreambleTemplate.end());
+  waveform->insert(
+      waveform->end(), mOrderedSetTemplates[sop].begin(), mOrderedSetTemplates[sop].end());
+
+  AppendByte(waveform, header & 0xFF);
+  AppendByte(waveform, (header >> 8) & 0xFF);
+
+  uint32_t crc = crc32(0x00000000, (const uint8_t*)&header, sizeof(uint16_t), usbCrcPolynomial);
+
+  for (size_t i = 0; i < size; i++) {
+    AppendByte(waveform, payload[i]);
+  }
+
+  if (size > 0) {
+    crc = crc32(crc, payload, size, usbCrcPolynomial);
+  }
+
+  AppendByte(waveform, crc & 0xFF);
+  AppendByte(waveform, (crc >> 8) & 0xFF);
+  AppendByte(waveform, (crc >> 16) & 0xFF);
+  AppendByte(waveform, (crc >> 24) & 0xFF);
+
+  const WaveformTemplate& eop = mKCodeTemplates[KCODEType_EOP];
+  waveform->insert(waveform->end(), eop.begin(), eop.end());
+}
+
+/**
+ * @brief Encode a complete message into waveform, as AppendPacket()
+ */
+void USBPDSimulationDataGenerator::AppendMessage(WaveformTemplate* waveform,
+                                                 Transmitter sender,
+                                                 SOPType sop,
+                                                 uint8_t messageType,
+                                                 uint8_t messageId,
+                                                 const uint32_t* dataObjects,
+                                                 uint8_t numDataObjects) {
+  uint8_t payload[7 * 4];
+
+  for (int i = 0; i < numDataObjects; i++) {
+    payload[i * 4] = dataObjects[i] & 0xFF;
+    payload[i * 4 + 1] = (dataObjects[i] >> 8) & 0xFF;
+    payload[i * 4 + 2] = (dataObjects[i] >> 16) & 0xFF;
+    payload[i * 4 + 3] = (dataObjects[i] >> 24) & 0xFF;
+  }
+
+  AppendPacket(waveform,
+               sop,
+               GetMessageHeader(sender, sop, messageType, messageId, numDataObjects),
+               payload,
+               numDataObjects * 4);
+}
+
+/**
+ * @brief Encode an extended message into waveform, as AppendPacket(). A chunk is padded to a
+ * whole number of data objects, an unchunked message is not and has no data objects.
+ *
+ * @param data the data bytes following the extended header
+ */
+void USBPDSimulationDataGenerator::AppendExtendedMessage(WaveformTemplate* waveform,
+                                                         Transmitter sender,
+                                                         SOPType sop,
+                                                         uint8_t messageType,
+                                                         uint8_t messageId,
+                                                         uint16_t extendedHeader,
+                                                         const uint8_t* data,
+                                                         size_t size) {
+  std::vector<uint8_t> payload;
+  payload.push_back(extendedHeader & 0xFF);
+  payload.push_back((extendedHeader >> 8) & 0xFF);
+  payload.insert(payload.end(), data, data + size);
+
+  bool chunked = CHECK_BIT(extendedHeader, 15);
+  uint8_t numDataObjects = chunked ? (uint8_t)((payload.size() + 3) / 4) : 0;
+  payload.resize(chunked ? numDataObjects * 4 : payload.size(), 0);
+
+  uint16_t header = GetMessageHeader(sender, sop, messageType, messageId, numDataObjects);
+  AppendPacket(waveform, sop, header | 0x8000, &payload[0], payload.size());
+}
+
+/**
+ * @brief Encode a reset ordered set, from the first edge of the preamble to the last K-code
+ */
+void USBPDSimulationDataGenerator::AppendReset(WaveformTemplate* waveform, OrderedSetType reset) {
+  waveform->insert(waveform->end(), mPreambleTemplate.begin(), mPreambleTemplate.end());
+  waveform->insert(
+      waveform->end(), mOrderedSetTemplates[reset].begin(), mOrderedSetTemplates[reset].end());
+}
+
+// Carrier sent after an acknowledged BIST Carrier Mode message, within tBISTContMode
+static const U64 simBistCarrier_us = 45000;
+
+/**
+ * @brief Encode the BIST carrier, alternating 1s and 0s for simBistCarrier_us, into waveform
+ */
+void USBPDSimulationDataGenerator::AppendBistCarrier(WaveformTemplate* waveform) {
+  U64 bits = simBistCarrier_us * mSettings->mBitRate / 1000000;
+
+  for (U64 i = 0; i < bits; i++) {
+    AppendBiphaseMarkCodingBit(waveform, (i & 0x1) != 0);
+  }
+}
+
+/**
+ * @brief Encode every message of the scenario, and its GoodCRC, at the current sample rate and bit
+ * rate. Message IDs are part of the encoding, so every repetition sends the same IDs.
+ */
+void USBPDSimulationDataGenerator::EncodeScenario() {
+  static const Transmitter senders[USBPDScenario::NUM_SENDER] = {
+      Transmitter_DFP, Transmitter_UFP, Transmitter_CablePlug};
+
+  U32 samples_per_bit = mSimulationSampleRateHz / mSettings->mBitRate;
+  uint8_t messageIds[NUM_TRANSMITTER][NUM_SOP_TYPE] = {};
+
+  mScenarioSteps.clear();
+  mScenarioPosition = 0;
+
+  for (const USBPDScenario::Message& message : mScenario.GetMessages()) {
+    Transmitter sender = senders[message.sender];
+    uint8_t& messageId = messageIds[sender][message.sop];
+
+    mScenarioSteps.push_back(ScenarioStep());
+    ScenarioStep& step = mScenarioSteps.back();
+    step.idleSamples = samples_per_bit * 10 + MicrosecondsToSamples(message.delayBefore_us);
+
+    if (message.reset != NUM_ORDERED_SET) {
+      AppendReset(&step.waveform, message.reset);
+
+      // A Hard Reset restarts the message IDs of every SOP, a Cable Reset those of the cable
+      for (int i = 0; i < NUM_TRANSMITTER; i++) {
+        for (int sop = 0; sop < NUM_SOP_TYPE; sop++) {
+          if (message.reset == OrderedSet_HardReset || sop != SOPType_SOP) {
+            messageIds[i][sop] = 0;
+          }
+        }
+      }
+
+      continue;
+    }
+
+    if (message.extended) {
+      EncodeScenarioExtended(message, sender, &step.waveform, messageIds);
+      continue;
+    }
+
+    AppendMessage(&step.waveform,
+                  sender,
+                  message.sop,
+                  message.messageType,
+                  messageId,
+                  message.dataObjects.empty() ? NULL : &message.dataObjects[0],
+                  (uint8_t)message.dataObjects.size());
+
+    if (message.acknowledged) {
+      mScenarioSteps.push_back(ScenarioStep());
+      ScenarioStep& goodCrc = mScenarioSteps.back();
+      goodCrc.idleSamples = samples_per_bit * 10;
+      AppendMessage(&goodCrc.waveform,
+                    GetReceiver(sender, message.sop),
+                    message.sop,
+                    ControlMessage_GoodCRC,
+                    messageId,
+                    NULL,
+                    0);
+
+      // The receiver answers a BIST Carrier Mode message with the carrier
+      if (message.messageType == DataMessage_BIST && !message.dataObjects.empty() &&
+          EXTRACT_BIT_RANGE(message.dataObjects[0], 31, 28) == BISTMode_CarrierMode) {
+        mScenarioSteps.push_back(ScenarioStep());
+        ScenarioStep& carrier = mScenarioSteps.back();
+        carrier.idleSamples = samples_per_bit * 10;
+        AppendBistCarrier(&carrier.waveform);
+      }
     }
+
+    messageId = (messageId + 1) & 0x7;
   }
 
-  headerBytes = CreateControlMessageHeader(ControlMessage_GoodCRC,
-                                           dataRole,
-                                           specRev,
-                                           portPowerRoleOrCablePlug,
-                                           *replyMessageId);
+  mScenarioEndIdleSamples = MicrosecondsToSamples(mScenario.GetEndDelay_us());
+}
+
+/**
+ * @brief Encode an extended message of the scenario into waveform, the step already added for it.
+ * A chunked message is sent chunk by chunk, each chunk after the first requested by the receiver,
+ * with every message acknowledged. The steps for the GoodCRCs and further chunks are added here.
+ */
+void USBPDSimulationDataGenerator::EncodeScenarioExtended(
+    const USBPDScenario::Message& message,
+    Transmitter sender,
+    WaveformTemplate* waveform,
+    uint8_t messageIds[NUM_TRANSMITTER][NUM_SOP_TYPE]) {
+  U32 samples_per_bit = mSimulationSampleRateHz / mSettings->mBitRate;
+  Transmitter receiver = GetReceiver(sender, message.sop);
+  uint8_t& senderId = messageIds[sender][message.sop];
+  uint8_t& receiverId = messageIds[receiver][message.sop];
 
-  *replyMessageId++;
-  if (*replyMessageId > 7) {
-    *replyMessageId = 0;
+  const uint8_t* data = message.extendedData.empty() ? NULL : &message.extendedData[0];
+  size_t size = message.extendedData.size();
+
+  if (!message.chunked) {
+    AppendExtendedMessage(
+        waveform, sender, message.sop, message.messageType, senderId, (uint16_t)size, data, size);
   }
 
-  // Send CRC32
-  crc = crc32(0x00000000, (const uint8_t*)&headerBytes, sizeof(uint16_t), usbCrcPolynomial);
+  // Every chunk but the first needs the previous one acknowledged
+  size_t numChunks =
+      message.chunked
+          ? std::max<size_t>(1, (size + maxExtendedMsgChunkLen - 1) / maxExtendedMsgChunkLen)
+          : 1;
+  if (!message.acknowledged) {
+    numChunks = 1;
+  }
 
-  CreateByte(crc & 0xFF);
-  CreateByte((crc >> 8) & 0xFF);
-  CreateByte((crc >> 16) & 0xFF);
-  CreateByte((crc >> 24) & 0xFF);
+  for (size_t chunk = 0; chunk < numChunks; chunk++) {
+    if (chunk > 0) {
+      mScenarioSteps.push_back(ScenarioStep());
+      mScenarioSteps.back().idleSamples = samples_per_bit * 10;
+      AppendExtendedMessage(&mScenarioSteps.back().waveform,
+                            receiver,
+                            message.sop,
+                            message.messageType,
+                            receiverId,
+                            (uint16_t)(0x8000 | (chunk << 11) | 0x0400),
+                            NULL,
+                            0);
+
+      mScenarioSteps.push_back(ScenarioStep());
+      mScenarioSteps.back().idleSamples = samples_per_bit * 10;
+      AppendMessage(&mScenarioSteps.back().waveform,
+                    sender,
+                    message.sop,
+                    ControlMessage_GoodCRC,
+                    receiverId,
+                    NULL,
+                    0);
+      receiverId = (receiverId + 1) & 0x7;
+
+      // Adding steps may have moved the step waveform pointed to
+      mScenarioSteps.push_back(ScenarioStep());
+      mScenarioSteps.back().idleSamples = samples_per_bit * 10;
+      waveform = &mScenarioSteps.back().waveform;
+    }
 
-  // Send EOP sequence
-  CreateKCode(KCODEType_EOP);
+    if (message.chunked) {
+      size_t offset = chunk * maxExtendedMsgChunkLen;
+      AppendExtendedMessage(waveform,
+                            sender,
+                            message.sop,
+                            message.messageType,
+                            senderId,
+                            (uint16_t)(0x8000 | (chunk << 11) | size),
+                            data + offset,
+                            std::min<size_t>(size - offset, maxExtendedMsgChunkLen));
+    }
+
+    if (message.acknowledged) {
+      mScenarioSteps.push_back(ScenarioStep());
+      mScenarioSteps.back().idleSamples = samples_per_bit * 10;
+      AppendMessage(&mScenarioSteps.back().waveform,
+                    receiver,
+                    message.sop,
+                    ControlMessage_GoodCRC,
+                    senderId,
+                    NULL,
+                    0);
+    }
+
+    senderId = (senderId + 1) & 0x7;
+  }
+}
+
+/**
+ * @brief Play the next pre-encoded message of the scenario
+ */
+void USBPDSimulationDataGenerator::CreateScenarioStep() {
+  const ScenarioStep& step = mScenarioSteps[mScenarioPosition];
+
+  CreateIdle(step.idleSamples);
+
+  // The content of the messages is fixed, only the edge level impairments apply
+  if (mImpaired) {
+    mEdgeDisplacement = 0.0;
+    mDropNextEdge = ImpairmentHit(mSettings->mDroppedEdgeRate);
+    mGlitchCountdown = ImpairmentHit(mSettings->mGlitchRate)
+                           ? 1 + NextRandom(&mImpairmentRandomState) % step.waveform.size()
+                           : 0;
+  }
+
+  CreateFromTemplate(step.waveform);
+
+  // All Frames end with a final edge transition
+  mSerialSimulationData.Transition();
+
+  if (++mScenarioPosition == mScenarioSteps.size()) {
+    mScenarioPosition = 0;
+    CreateIdle(mScenarioEndIdleSamples);
+  }
 }
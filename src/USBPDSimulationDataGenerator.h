@@ -4,7 +4,9 @@
 #include <SimulationChannelDescriptor.h>
 
 #include <string>
+#include <vector>
 
+#include "USBPDScenario.h"
 #include "USBPDTypes.h"
 class USBPDAnalyzerSettings;
 
@@ -28,34 +30,160 @@ class USBPDSimulationDataGenerator {
   U32 mStringIndex;
   SimulationChannelDescriptor mSerialSimulationData;
 
+  // Waveform templates, as the number of samples following each transition. Biphase Mark Coding
+  // only cares about transitions, so a template can be spliced in at either line state.
+  typedef std::vector<U32> WaveformTemplate;
+
+  U32 mTemplateBitRate;  // Bit rate the templates were built for, 0 if not built yet
+  WaveformTemplate mPreambleTemplate;
+  WaveformTemplate mOrderedSetTemplates[NUM_ORDERED_SET];
+  WaveformTemplate mKCodeTemplates[NUM_KCODE];
+  WaveformTemplate mByteTemplates[256];
+
+ protected:
+  // Which end of the link sends a message, each keeps its own message IDs
+  enum Transmitter {
+    Transmitter_DFP,        // Source, and DFP
+    Transmitter_UFP,        // Sink, and UFP
+    Transmitter_CablePlug,  // Responds to SOP' and SOP"
+
+    NUM_TRANSMITTER
+  };
+
+  // Background exchanges of a simulated PD session
+  enum SessionExchange {
+    SessionExchange_Ping,
+    SessionExchange_Renegotiate,
+    SessionExchange_PpsRequest,
+    SessionExchange_DiscoverIdentity,
+    SessionExchange_DiscoverCableIdentity,
+    SessionExchange_DiscoverSvidsAndModes,
+
+    NUM_SESSION_EXCHANGE
+  };
+
+  uint8_t mMessageIds[NUM_TRANSMITTER][NUM_SOP_TYPE];
+
+  // Simulated PD session state
+  bool mSessionStarted;
+  U64 mNextExchangeSample;
+  U64 mNextPpsRequestSample;
+  uint32_t mPpsVoltage_mV;
+  U32 mRandomState;
+
+  // Physical layer impairments, applied while generating each message
+  bool mImpaired;
+  U32 mImpairmentRandomState;  // Separate from mRandomState, so impairments don't change traffic
+  double mEdgeDisplacement;    // Jitter of the last edge, in samples
+  double mSampleCarry;         // Fraction of a sample not yet emitted
+  bool mDropNextEdge;
+  U32 mGlitchCountdown;       // Edges until the glitch in this message, 0 for none
+  U32 mCorruptByteCountdown;  // Bytes until the corrupted byte in this message, 0 for none
+  WaveformTemplate mCorruptByteTemplate;
+
+  // Scenario, pre-encoded one message per step
+  struct ScenarioStep {
+    U64 idleSamples;  // Before the message
+    WaveformTemplate waveform;
+  };
+
+  USBPDScenario mScenario;
+  std::vector<ScenarioStep> mScenarioSteps;
+  size_t mScenarioPosition;
+  U64 mScenarioEndIdleSamples;
+
  protected:
   void CreateSerialByte();
   void CreatePreamble();
 
   void CreateByte(uint8_t byte);
 
-  void CreateFiveBitFromFourBit(uint8_t fourBit);
+  void BuildTemplates();
+  void AppendBiphaseMarkCodingBit(WaveformTemplate* waveform, bool bit);
+  void AppendFiveBit(WaveformTemplate* waveform, uint8_t fiveBit);
+  void CreateFromTemplate(const WaveformTemplate& waveform);
+
+  void CreateIdle(U64 samples);
+  U64 MicrosecondsToSamples(U64 us) const;
+  static U32 NextRandom(U32* state);
+
+  bool ImpairmentHit(U32 ratePerThousand);
+  double NextGaussian();
+  void CreateImpairedEdge(U32 samples);
+  void CreateCorruptByte(uint8_t byte);
+
+  void CreatePingTraffic();
+
+  void CreateSessionTraffic();
+  void CreateSessionStart();
+  void CreateSessionExchange(SessionExchange exchange);
+  void CreateContractNegotiation(uint32_t request);
+  void CreateDiscoverIdentity(SOPType sop);
+  void CreateDiscoverSvidsAndModes();
+
+  /**
+   * @brief Send a message, followed by the GoodCRC from the receiver, and advance the sender's
+   * message ID
+   */
+  void CreateTransaction(Transmitter sender,
+                         SOPType sop,
+                         uint8_t messageType,
+                         const uint32_t* dataObjects = NULL,
+                         uint8_t numDataObjects = 0);
 
-  void CreateBiphaseMarkCodingBit(bool bit);
+  /**
+   * @return true if the message was damaged on the way, and will not be acknowledged
+   */
+  bool CreateMessage(Transmitter sender,
+                     SOPType sop,
+                     uint8_t messageType,
+                     uint8_t messageId,
+                     const uint32_t* dataObjects,
+                     uint8_t numDataObjects);
 
-  void CreateUSBPDControlMessageTransaction(SOPType sop,
-                                            ControlMessageTypes messageType,
-                                            PortDataRole dataRole,
-                                            PDSpecRevision specRev,
-                                            uint8_t portPowerRoleOrCablePlug);
+  void AppendByte(WaveformTemplate* waveform, uint8_t byte);
+  void AppendPacket(WaveformTemplate* waveform,
+                    SOPType sop,
+                    uint16_t header,
+                    const uint8_t* payload,
+                    size_t size);
+  void AppendMessage(WaveformTemplate* waveform,
+                     Transmitter sender,
+                     SOPType sop,
+                     uint8_t messageType,
+                     uint8_t messageId,
+                     const uint32_t* dataObjects,
+                     uint8_t numDataObjects);
+  void AppendExtendedMessage(WaveformTemplate* waveform,
+                             Transmitter sender,
+                             SOPType sop,
+                             uint8_t messageType,
+                             uint8_t messageId,
+                             uint16_t extendedHeader,
+                             const uint8_t* data,
+                             size_t size);
+  void AppendReset(WaveformTemplate* waveform, OrderedSetType reset);
+  void AppendBistCarrier(WaveformTemplate* waveform);
+  void EncodeScenario();
+  void EncodeScenarioExtended(const USBPDScenario::Message& message,
+                              Transmitter sender,
+                              WaveformTemplate* waveform,
+                              uint8_t messageIds[NUM_TRANSMITTER][NUM_SOP_TYPE]);
+  void CreateScenarioStep();
 
-  uint16_t CreateMessageHeader(uint8_t messageType,
-                               uint8_t portDataRole,
-                               uint8_t specificationRevision,
-                               uint8_t portPowerRoleOrCablePlug,
-                               uint8_t messageId,
-                               uint8_t numOfDataObjects);
+  uint16_t GetMessageHeader(Transmitter sender,
+                            SOPType sop,
+                            uint8_t messageType,
+                            uint8_t messageId,
+                            uint8_t numDataObjects);
+  static Transmitter GetReceiver(Transmitter sender, SOPType sop);
 
-  uint16_t CreateControlMessageHeader(ControlMessageTypes type,
-                                      PortDataRole role,
-                                      PDSpecRevision rev,
+  static uint16_t EncodeMessageHeader(uint8_t messageType,
+                                      uint8_t portDataRole,
+                                      uint8_t specificationRevision,
                                       uint8_t portPowerRoleOrCablePlug,
-                                      uint8_t messageId);
+                                      uint8_t messageId,
+                                      uint8_t numOfDataObjects);
 
   void CreateSOP(SOPType sop);
   void CreateKCode(KCODEType code);
@@ -0,0 +1,789 @@
+#include "USBPDStatistics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+
+// Bits from the start of the preamble (as detected, 63 bits) to the end of the EOP, less the
+// data objects: preamble, SOP, header, CRC and EOP
+static const U64 statisticsMessageBits = 63 + 20 + 20 + 40 + 5;
+static const U64 statisticsDataObjectBits = 40;
+static const U64 statisticsByteBits = 10;
+
+// Utilization buckets start out 1 ms wide
+static const U64 statisticsFirstBucket_us = 1000;
+
+static const uint32_t statisticsNoHeader = UINT32_MAX;
+static const U64 statisticsNoMessage = UINT64_MAX;
+
+// Fraction of the intervals at each end of the eye left out of the eye opening
+static const double eyeOutliers = 0.001;
+
+// Values written by Save(): version, then every counter in declaration order
+static const U64 statisticsVersion = 9;
+static const size_t statisticsEdgeHistogramValues =
+    USBPDStatistics::EdgeHistogram::NUM_INTERVAL_TYPE *
+        (USBPDStatistics::EdgeHistogram::numBins + 5) +
+    2;
+static const size_t statisticsLinkValues = 9 + USBPDStatistics::numResponseBins;
+static const size_t statisticsNumValues =
+    1 + 2 + 1 + USBPDMessageIndex::numMessageTypeValues + (NUM_SOP_TYPE + 1) + NUM_MESSAGE_FLAG +
+    6 + NUM_SOP_TYPE * 4 + 4 + 3 +
+    USBPDStatistics::numUtilizationBuckets +
+    USBPDStatistics::numTransmitters * (statisticsEdgeHistogramValues + statisticsLinkValues);
+
+static const char* statisticsFlagNames[NUM_MESSAGE_FLAG] = {
+    "CRC errors",
+    "EOP errors",
+    "SOP errors",
+    "Invalid symbols",
+    "Short Discover Identity ACKs",
+};
+
+static U32 GetTransmitter(U32 sop, uint16_t header) {
+  if (sop >= NUM_SOP_TYPE) {
+    return USBPDStatistics::numTransmitters - 1;
+  }
+
+  return sop * 2 + (CHECK_BIT(header, 8) ? 1 : 0);
+}
+
+static U32 GetTransmitter(const USBPDMessageRecord& record) {
+  return GetTransmitter(record.sop, record.header);
+}
+
+static std::string GetTransmitterName(U32 transmitter) {
+  if (transmitter >= NUM_SOP_TYPE * 2) {
+    return "Other";
+  }
+
+  U32 sop = transmitter / 2;
+  bool bit8 = (transmitter % 2) != 0;
+
+  if (sop == SOPType_SOP) {
+    return std::string(SOPTypeNames[sop]) + (bit8 ? " Source" : " Sink");
+  }
+
+  return std::string(SOPTypeNames[sop]) + (bit8 ? " Cable Plug" : " Port");
+}
+
+/**
+ * @brief Interval, in UI, that a fraction of the intervals of a type are shorter than. Rounded out
+ * to the bin edge: down for fractions below one half, up otherwise.
+ */
+static double GetEdgeQuantile(const USBPDStatistics::EdgeHistogram& edges,
+                              USBPDStatistics::EdgeHistogram::IntervalType type,
+                              double fraction) {
+  typedef USBPDStatistics::EdgeHistogram Edges;
+
+  U64 target = (U64)(fraction * edges.counts[type]);
+  U64 total = 0;
+
+  for (U32 bin = 0; bin < Edges::numBins; bin++) {
+    total += edges.bins[type][bin];
+
+    if (total > target) {
+      return (double)(fraction < 0.5 ? bin : bin + 1) / Edges::binsPerBit;
+    }
+  }
+
+  return (double)Edges::numBins / Edges::binsPerBit;
+}
+
+void USBPDStatistics::EdgeHistogram::Clear() {
+  for (int type = 0; type < NUM_INTERVAL_TYPE; type++) {
+    std::fill(bins[type], bins[type] + numBins, 0);
+    counts[type] = 0;
+    sums[type] = 0;
+    sumSquares[type] = 0;
+    minimums[type] = UINT64_MAX;
+    maximums[type] = 0;
+  }
+
+  glitches = 0;
+  idles = 0;
+}
+
+void USBPDStatistics::EdgeHistogram::Merge(const EdgeHistogram& other) {
+  for (int type = 0; type < NUM_INTERVAL_TYPE; type++) {
+    for (U32 bin = 0; bin < numBins; bin++) {
+      bins[type][bin] += other.bins[type][bin];
+    }
+
+    counts[type] += other.counts[type];
+    sums[type] += other.sums[type];
+    sumSquares[type] += other.sumSquares[type];
+    minimums[type] = std::min(minimums[type], other.minimums[type]);
+    maximums[type] = std::max(maximums[type], other.maximums[type]);
+  }
+
+  glitches += other.glitches;
+  idles += other.idles;
+}
+
+void USBPDStatistics::LinkCounters::Clear() {
+  messages = 0;
+  acknowledged = 0;
+  unacknowledged = 0;
+  retries = 0;
+
+  goodCrcs = 0;
+  unmatchedGoodCrcs = 0;
+  responseSum = 0;
+  responseMin = UINT64_MAX;
+  responseMax = 0;
+  std::fill(responseBins, responseBins + numResponseBins, 0);
+}
+
+USBPDStatistics::USBPDStatistics() : USBPDCacheSection(statisticsVersion) { Clear(1, 1); }
+
+void USBPDStatistics::Clear(U32 sampleRateHz, U32 bitRate) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  mSampleRateHz = sampleRateHz;
+  mBitRate = bitRate;
+
+  mMessages = 0;
+  std::fill(mMessageTypeCounts, mMessageTypeCounts + USBPDMessageIndex::numMessageTypeValues, 0);
+  std::fill(mSopCounts, mSopCounts + NUM_SOP_TYPE + 1, 0);
+  std::fill(mFlagCounts, mFlagCounts + NUM_MESSAGE_FLAG, 0);
+  mHardResets = 0;
+  mCableResets = 0;
+  mBistCarriers = 0;
+  mBistCarrierSamples = 0;
+  mBistTestData = 0;
+  mFilteredPulses = 0;
+
+  for (int i = 0; i < NUM_SOP_TYPE; i++) {
+    mLastMessages[i][0] = statisticsNoMessage;
+    mLastMessages[i][1] = statisticsNoMessage;
+    mAwaitingHeaders[i] = statisticsNoHeader;
+    mAwaitingEnds[i] = 0;
+  }
+
+  mBitRateMessages = 0;
+  mBitRateSum_bps = 0;
+  mMinBitRate_bps = 0;
+  mMaxBitRate_bps = 0;
+
+  mLastSample = 0;
+  mBusySamples = 0;
+  mBucketSamples = std::max<U64>(1, (U64)sampleRateHz * statisticsFirstBucket_us / 1000000);
+  std::fill(mBucketBusySamples, mBucketBusySamples + numUtilizationBuckets, 0);
+
+  for (U32 i = 0; i < numTransmitters; i++) {
+    mEdgeHistograms[i].Clear();
+    mLinks[i].Clear();
+  }
+}
+
+void USBPDStatistics::AddMessage(const USBPDMessageRecord& record, const EdgeHistogram& edges) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  mEdgeHistograms[GetTransmitter(record)].Merge(edges);
+
+  mMessages++;
+  mSopCounts[std::min<int>(record.sop, NUM_SOP_TYPE)]++;
+
+  for (int i = 0; i < NUM_MESSAGE_FLAG; i++) {
+    if (CHECK_BIT(record.flags, i)) {
+      mFlagCounts[i]++;
+    }
+  }
+
+  AddBusTime(record.startingSample, record.endingSample);
+
+  if (record.sop >= NUM_SOP_TYPE) {
+    return;
+  }
+
+  uint32_t messageType = USBPDMessageIndex::GetMessageTypeValue(record.header);
+  mMessageTypeCounts[messageType]++;
+
+  AddLinkMessage(record);
+
+  // The length of a damaged message can't be trusted
+  if ((record.flags & messageDamageFlags) != 0) {
+    return;
+  }
+
+  if (messageType == 32 + DataMessage_BIST &&
+      EXTRACT_BIT_RANGE(record.firstDataObject, 31, 28) == BISTMode_TestData) {
+    mBistTestData++;
+  }
+
+  U64 numDataObjects = EXTRACT_BIT_RANGE(record.header, 14, 12);
+  U64 bits = statisticsMessageBits + numDataObjects * statisticsDataObjectBits;
+
+  // Unchunked extended messages are not padded to whole data objects: the extended header, then
+  // Data Size bytes
+  if (CHECK_BIT(record.header, 15) && !CHECK_BIT(record.firstDataObject, 15)) {
+    U64 dataSize =
+        std::min<U64>(EXTRACT_BIT_RANGE(record.firstDataObject, 8, 0), maxExtendedMsgLen);
+    bits = statisticsMessageBits + (2 + dataSize) * statisticsByteBits;
+  }
+  U64 samples = record.endingSample - record.startingSample;
+
+  if (samples > 0) {
+    U64 bitRate_bps = (bits * mSampleRateHz + samples / 2) / samples;
+
+    if (mBitRateMessages == 0 || bitRate_bps < mMinBitRate_bps) {
+      mMinBitRate_bps = bitRate_bps;
+    }
+
+    if (bitRate_bps > mMaxBitRate_bps) {
+      mMaxBitRate_bps = bitRate_bps;
+    }
+
+    mBitRateMessages++;
+    mBitRateSum_bps += bitRate_bps;
+  }
+}
+
+void USBPDStatistics::AddReset(OrderedSetType reset,
+                               U64 startingSample,
+                               U64 endingSample,
+                               const EdgeHistogram& edges) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  mEdgeHistograms[numTransmitters - 1].Merge(edges);
+
+  if (reset == OrderedSet_HardReset) {
+    mHardResets++;
+  } else {
+    mCableResets++;
+  }
+
+  // MessageIDs start again from 0 after a Hard Reset, and on the cable's SOPs after a Cable Reset
+  for (int i = 0; i < NUM_SOP_TYPE; i++) {
+    if (reset == OrderedSet_HardReset || i != SOPType_SOP) {
+      CloseAwaitingGoodCrc(i);
+      mLastMessages[i][0] = statisticsNoMessage;
+      mLastMessages[i][1] = statisticsNoMessage;
+    }
+  }
+
+  AddBusTime(startingSample, endingSample);
+}
+
+void USBPDStatistics::AddBistCarrier(U64 startingSample, U64 endingSample) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  mBistCarriers++;
+  mBistCarrierSamples += endingSample - startingSample;
+
+  AddBusTime(startingSample, endingSample);
+}
+
+void USBPDStatistics::SetFilteredPulses(U64 filteredPulses) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  mFilteredPulses = filteredPulses;
+}
+
+/**
+ * @brief Pair a message on a valid SOP with the GoodCRC answering it, and detect retries. Must be
+ * called with mMutex held.
+ */
+void USBPDStatistics::AddLinkMessage(const USBPDMessageRecord& record) {
+  LinkCounters& link = mLinks[GetTransmitter(record)];
+
+  // Nothing answers a damaged message, and the message before it is no longer answered either
+  if ((record.flags & messageDamageFlags) != 0) {
+    CloseAwaitingGoodCrc(record.sop);
+    return;
+  }
+
+  uint32_t& awaitingHeader = mAwaitingHeaders[record.sop];
+
+  if (USBPDMessageIndex::GetMessageTypeValue(record.header) == ControlMessage_GoodCRC) {
+    if (awaitingHeader == statisticsNoHeader ||
+        EXTRACT_BIT_RANGE(awaitingHeader, 11, 9) != EXTRACT_BIT_RANGE(record.header, 11, 9)) {
+      link.unmatchedGoodCrcs++;
+      CloseAwaitingGoodCrc(record.sop);
+      return;
+    }
+
+    mLinks[GetTransmitter(record.sop, (uint16_t)awaitingHeader)].acknowledged++;
+    awaitingHeader = statisticsNoHeader;
+
+    U64 end = mAwaitingEnds[record.sop];
+    U64 response = (record.startingSample > end) ? record.startingSample - end : 0;
+    U64 bin = response * 1000000 / ((U64)mSampleRateHz * responseBinWidth_us);
+
+    link.goodCrcs++;
+    link.responseSum += response;
+    link.responseMin = std::min(link.responseMin, response);
+    link.responseMax = std::max(link.responseMax, response);
+    link.responseBins[std::min<U64>(bin, numResponseBins - 1)]++;
+    return;
+  }
+
+  CloseAwaitingGoodCrc(record.sop);
+
+  // A retry repeats the header, including its MessageID, and the payload (so the CRC) of the last
+  // message from the same end. Bit 8 is the Port Power Role on SOP and the Cable Plug bit on SOP' /
+  // SOP''.
+  U64 fingerprint = ((U64)record.header << 32) | record.crc;
+  int end = CHECK_BIT(record.header, 8) ? 1 : 0;
+  U64& lastMessage = mLastMessages[record.sop][end];
+
+  link.messages++;
+  if (lastMessage == fingerprint) {
+    link.retries++;
+  } else if (USBPDMessageIndex::GetMessageTypeValue(record.header) == ControlMessage_Soft_Reset) {
+    // MessageIDs start again from 0 after a Soft Reset, at both ends
+    mLastMessages[record.sop][1 - end] = statisticsNoMessage;
+  }
+
+  lastMessage = fingerprint;
+  awaitingHeader = record.header;
+  mAwaitingEnds[record.sop] = record.endingSample;
+}
+
+/**
+ * @brief Count the message waiting for a GoodCRC on a SOP, if any, as not acknowledged. Must be
+ * called with mMutex held.
+ */
+void USBPDStatistics::CloseAwaitingGoodCrc(U32 sop) {
+  if (mAwaitingHeaders[sop] != statisticsNoHeader) {
+    mLinks[GetTransmitter(sop, (uint16_t)mAwaitingHeaders[sop])].unacknowledged++;
+    mAwaitingHeaders[sop] = statisticsNoHeader;
+  }
+}
+
+/**
+ * @brief Add [startingSample, endingSample] to the utilization. Must be called with mMutex held.
+ */
+void USBPDStatistics::AddBusTime(U64 startingSample, U64 endingSample) {
+  if (endingSample < startingSample) {
+    return;
+  }
+
+  mLastSample = std::max(mLastSample, endingSample);
+  mBusySamples += endingSample - startingSample + 1;
+
+  // Merge pairs of buckets until the end of the message fits
+  while (endingSample / mBucketSamples >= numUtilizationBuckets) {
+    for (U32 i = 0; i < numUtilizationBuckets / 2; i++) {
+      mBucketBusySamples[i] = mBucketBusySamples[2 * i] + mBucketBusySamples[2 * i + 1];
+    }
+
+    std::fill(mBucketBusySamples + numUtilizationBuckets / 2,
+              mBucketBusySamples + numUtilizationBuckets,
+              0);
+    mBucketSamples *= 2;
+  }
+
+  U64 sample = startingSample;
+  while (sample <= endingSample) {
+    U64 bucket = sample / mBucketSamples;
+    U64 endOfBucket = std::min(endingSample, (bucket + 1) * mBucketSamples - 1);
+    mBucketBusySamples[bucket] += endOfBucket - sample + 1;
+    sample = endOfBucket + 1;
+  }
+}
+
+void USBPDStatistics::WriteSummary(std::ostream& stream) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  char line[128];
+  double sampleRate = (double)mSampleRateHz;
+
+  stream << "Messages," << mMessages << std::endl;
+
+  for (int i = 0; i < NUM_SOP_TYPE; i++) {
+    stream << "Messages on " << SOPTypeNames[i] << "," << mSopCounts[i] << std::endl;
+  }
+
+  for (int i = 0; i < NUM_MESSAGE_FLAG; i++) {
+    stream << statisticsFlagNames[i] << "," << mFlagCounts[i] << std::endl;
+  }
+
+  U64 retries = 0;
+  for (U32 i = 0; i < numTransmitters; i++) {
+    retries += mLinks[i].retries;
+  }
+
+  stream << "Retries," << retries << std::endl;
+  stream << "Hard Resets," << mHardResets << std::endl;
+  stream << "Cable Resets," << mCableResets << std::endl;
+  stream << "BIST carriers," << mBistCarriers << std::endl;
+  snprintf(
+      line, sizeof(line), "BIST carrier time [ms],%.3f", 1000.0 * mBistCarrierSamples / sampleRate);
+  stream << line << std::endl;
+  stream << "BIST Test Data messages," << mBistTestData << std::endl;
+  stream << "Pulses removed by the glitch filter," << mFilteredPulses << std::endl;
+
+  if (mBitRateMessages > 0) {
+    stream << "Minimum bit rate [bps]," << mMinBitRate_bps << std::endl;
+    stream << "Average bit rate [bps]," << mBitRateSum_bps / mBitRateMessages << std::endl;
+    stream << "Maximum bit rate [bps]," << mMaxBitRate_bps << std::endl;
+  }
+
+  double utilization = (mLastSample > 0) ? 100.0 * mBusySamples / (mLastSample + 1) : 0.0;
+  snprintf(line, sizeof(line), "Bus utilization [%%],%.3f", utilization);
+  stream << line << std::endl;
+
+  stream << std::endl << "Message type,Count" << std::endl;
+
+  for (uint32_t i = 0; i < USBPDMessageIndex::numMessageTypeValues; i++) {
+    if (mMessageTypeCounts[i] > 0) {
+      stream << GetMessageTypeName(i >= 64, i >= 32 ? 1 : 0, i % 32) << ","
+             << mMessageTypeCounts[i] << std::endl;
+    }
+  }
+
+  stream << std::endl << "Start [s],End [s],Bus utilization [%]" << std::endl;
+
+  U64 usedBuckets = std::min<U64>(mLastSample / mBucketSamples + 1, numUtilizationBuckets);
+
+  for (U64 i = 0; i < usedBuckets; i++) {
+    snprintf(line,
+             sizeof(line),
+             "%.6f,%.6f,%.3f",
+             i * mBucketSamples / sampleRate,
+             (i + 1) * mBucketSamples / sampleRate,
+             100.0 * mBucketBusySamples[i] / mBucketSamples);
+    stream << line << std::endl;
+  }
+
+  WriteLinkSummary(stream);
+  WriteEdgeSummary(stream);
+}
+
+/**
+ * @brief Write the GoodCRC pairing and retry counters, and the GoodCRC response time histograms,
+ * of every transmitter that was seen. Must be called with mMutex held.
+ */
+void USBPDStatistics::WriteLinkSummary(std::ostream& stream) {
+  char line[256];
+  double usPerSample = 1e6 / mSampleRateHz;
+
+  std::vector<U32> transmitters;
+  std::vector<U32> responders;
+  for (U32 i = 0; i < numTransmitters; i++) {
+    const LinkCounters& link = mLinks[i];
+    if (link.messages + link.unacknowledged + link.goodCrcs + link.unmatchedGoodCrcs > 0) {
+      transmitters.push_back(i);
+    }
+
+    if (link.goodCrcs > 0) {
+      responders.push_back(i);
+    }
+  }
+
+  stream << std::endl
+         << "Transmitter,Messages,Acknowledged,Not acknowledged,Retries,Retry rate [%],"
+            "GoodCRCs,Unmatched GoodCRCs,Mean response [us],Min response [us],Max response [us]"
+         << std::endl;
+
+  for (U32 transmitter : transmitters) {
+    const LinkCounters& link = mLinks[transmitter];
+
+    snprintf(line,
+             sizeof(line),
+             ",%llu,%llu,%llu,%llu,%.3f,%llu,%llu",
+             (unsigned long long)link.messages,
+             (unsigned long long)link.acknowledged,
+             (unsigned long long)link.unacknowledged,
+             (unsigned long long)link.retries,
+             (link.messages > 0) ? 100.0 * link.retries / link.messages : 0.0,
+             (unsigned long long)link.goodCrcs,
+             (unsigned long long)link.unmatchedGoodCrcs);
+    stream << GetTransmitterName(transmitter) << line;
+
+    if (link.goodCrcs > 0) {
+      snprintf(line,
+               sizeof(line),
+               ",%.1f,%.1f,%.1f",
+               (double)link.responseSum / link.goodCrcs * usPerSample,
+               link.responseMin * usPerSample,
+               link.responseMax * usPerSample);
+      stream << line;
+    } else {
+      stream << ",,,";
+    }
+
+    stream << std::endl;
+  }
+
+  if (responders.empty()) {
+    return;
+  }
+
+  stream << std::endl << "GoodCRC response [us]";
+  for (U32 transmitter : responders) {
+    stream << "," << GetTransmitterName(transmitter);
+  }
+  stream << std::endl;
+
+  for (U32 bin = 0; bin < numResponseBins; bin++) {
+    bool used = false;
+    for (U32 transmitter : responders) {
+      used |= mLinks[transmitter].responseBins[bin] > 0;
+    }
+
+    if (!used) {
+      continue;
+    }
+
+    stream << bin * responseBinWidth_us;
+    if (bin == numResponseBins - 1) {
+      stream << "+";
+    }
+
+    for (U32 transmitter : responders) {
+      stream << "," << mLinks[transmitter].responseBins[bin];
+    }
+
+    stream << std::endl;
+  }
+}
+
+/**
+ * @brief Write the edge interval metrics and histograms of every transmitter that was seen. Must
+ * be called with mMutex held.
+ */
+void USBPDStatistics::WriteEdgeSummary(std::ostream& stream) {
+  typedef EdgeHistogram Edges;
+
+  char line[256];
+  double nsPerSample = 1e9 / mSampleRateHz;
+
+  std::vector<U32> transmitters;
+  for (U32 i = 0; i < numTransmitters; i++) {
+    const Edges& edges = mEdgeHistograms[i];
+    if (edges.counts[Edges::Interval_HalfBit] + edges.counts[Edges::Interval_FullBit] > 0) {
+      transmitters.push_back(i);
+    }
+  }
+
+  stream << std::endl
+         << "Transmitter,Half-bit intervals,Mean [ns],RMS jitter [ns],Min [ns],Max [ns],"
+            "Full-bit intervals,Mean [ns],RMS jitter [ns],Min [ns],Max [ns],Glitches,"
+            "Idle intervals,Eye opening [UI]"
+         << std::endl;
+
+  for (U32 transmitter : transmitters) {
+    const Edges& edges = mEdgeHistograms[transmitter];
+    stream << GetTransmitterName(transmitter);
+
+    for (int type = 0; type < Edges::NUM_INTERVAL_TYPE; type++) {
+      if (edges.counts[type] == 0) {
+        stream << ",0,,,,";
+        continue;
+      }
+
+      double mean = (double)edges.sums[type] / edges.counts[type];
+      double variance = (double)edges.sumSquares[type] / edges.counts[type] - mean * mean;
+
+      snprintf(line,
+               sizeof(line),
+               ",%llu,%.1f,%.1f,%.1f,%.1f",
+               (unsigned long long)edges.counts[type],
+               mean * nsPerSample,
+               sqrt(std::max(variance, 0.0)) * nsPerSample,
+               edges.minimums[type] * nsPerSample,
+               edges.maximums[type] * nsPerSample);
+      stream << line;
+    }
+
+    stream << "," << edges.glitches << "," << edges.idles << ",";
+
+    // Gap between the longest half-bit and the shortest full-bit intervals, 0.5 UI less a bin for
+    // a clean signal. The outliers are left out so that a single glitch doesn't close the eye.
+    if (edges.counts[Edges::Interval_HalfBit] > 0 && edges.counts[Edges::Interval_FullBit] > 0) {
+      double longestHalfBit = GetEdgeQuantile(edges, Edges::Interval_HalfBit, 1.0 - eyeOutliers);
+      double shortestFullBit = GetEdgeQuantile(edges, Edges::Interval_FullBit, eyeOutliers);
+      snprintf(line, sizeof(line), "%.3f", shortestFullBit - longestHalfBit);
+      stream << line;
+    }
+
+    stream << std::endl;
+  }
+
+  if (transmitters.empty()) {
+    return;
+  }
+
+  stream << std::endl << "Interval [UI]";
+  for (U32 transmitter : transmitters) {
+    std::string name = GetTransmitterName(transmitter);
+    stream << "," << name << " half-bit," << name << " full-bit";
+  }
+  stream << std::endl;
+
+  for (U32 bin = 0; bin < Edges::numBins; bin++) {
+    bool used = false;
+    for (U32 transmitter : transmitters) {
+      const Edges& edges = mEdgeHistograms[transmitter];
+      used |= (edges.bins[Edges::Interval_HalfBit][bin] > 0) ||
+              (edges.bins[Edges::Interval_FullBit][bin] > 0);
+    }
+
+    if (!used) {
+      continue;
+    }
+
+    snprintf(line, sizeof(line), "%.3f", (double)bin / Edges::binsPerBit);
+    stream << line;
+
+    for (U32 transmitter : transmitters) {
+      const Edges& edges = mEdgeHistograms[transmitter];
+      stream << "," << edges.bins[Edges::Interval_HalfBit][bin] << ","
+             << edges.bins[Edges::Interval_FullBit][bin];
+    }
+
+    stream << std::endl;
+  }
+}
+
+void USBPDStatistics::SaveValues(std::vector<U64>* values) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  values->push_back(mSampleRateHz);
+  values->push_back(mBitRate);
+  values->push_back(mMessages);
+  values->insert(values->end(),
+                 mMessageTypeCounts,
+                 mMessageTypeCounts + USBPDMessageIndex::numMessageTypeValues);
+  values->insert(values->end(), mSopCounts, mSopCounts + NUM_SOP_TYPE + 1);
+  values->insert(values->end(), mFlagCounts, mFlagCounts + NUM_MESSAGE_FLAG);
+  values->push_back(mHardResets);
+  values->push_back(mCableResets);
+  values->push_back(mBistCarriers);
+  values->push_back(mBistCarrierSamples);
+  values->push_back(mBistTestData);
+  values->push_back(mFilteredPulses);
+
+  for (int i = 0; i < NUM_SOP_TYPE; i++) {
+    values->push_back(mLastMessages[i][0]);
+    values->push_back(mLastMessages[i][1]);
+    values->push_back(mAwaitingHeaders[i]);
+    values->push_back(mAwaitingEnds[i]);
+  }
+
+  values->push_back(mBitRateMessages);
+  values->push_back(mBitRateSum_bps);
+  values->push_back(mMinBitRate_bps);
+  values->push_back(mMaxBitRate_bps);
+  values->push_back(mLastSample);
+  values->push_back(mBusySamples);
+  values->push_back(mBucketSamples);
+  values->insert(values->end(), mBucketBusySamples, mBucketBusySamples + numUtilizationBuckets);
+
+  for (U32 i = 0; i < numTransmitters; i++) {
+    const EdgeHistogram& edges = mEdgeHistograms[i];
+
+    for (int type = 0; type < EdgeHistogram::NUM_INTERVAL_TYPE; type++) {
+      values->insert(values->end(), edges.bins[type], edges.bins[type] + EdgeHistogram::numBins);
+      values->push_back(edges.counts[type]);
+      values->push_back(edges.sums[type]);
+      values->push_back(edges.sumSquares[type]);
+      values->push_back(edges.minimums[type]);
+      values->push_back(edges.maximums[type]);
+    }
+
+    values->push_back(edges.glitches);
+    values->push_back(edges.idles);
+  }
+
+  for (U32 i = 0; i < numTransmitters; i++) {
+    const LinkCounters& link = mLinks[i];
+
+    values->push_back(link.messages);
+    values->push_back(link.acknowledged);
+    values->push_back(link.unacknowledged);
+    values->push_back(link.retries);
+    values->push_back(link.goodCrcs);
+    values->push_back(link.unmatchedGoodCrcs);
+    values->push_back(link.responseSum);
+    values->push_back(link.responseMin);
+    values->push_back(link.responseMax);
+    values->insert(values->end(), link.responseBins, link.responseBins + numResponseBins);
+  }
+}
+
+bool USBPDStatistics::CheckValues(const std::vector<U64>& values) const {
+  // The sample rate, bit rate and bucket width are never 0
+  size_t bucketSamplesIndex =
+      statisticsNumValues -
+      numTransmitters * (statisticsEdgeHistogramValues + statisticsLinkValues) -
+      numUtilizationBuckets - 1;
+  return values.size() == statisticsNumValues && values[1] != 0 && values[2] != 0 &&
+         values[bucketSamplesIndex] != 0;
+}
+
+void USBPDStatistics::LoadValues(const std::vector<U64>& values) {
+  std::lock_guard<std::mutex> lock(mMutex);
+
+  const U64* value = &values[1];
+
+  mSampleRateHz = (U32)*value++;
+  mBitRate = (U32)*value++;
+  mMessages = *value++;
+  std::copy(value, value + USBPDMessageIndex::numMessageTypeValues, mMessageTypeCounts);
+  value += USBPDMessageIndex::numMessageTypeValues;
+  std::copy(value, value + NUM_SOP_TYPE + 1, mSopCounts);
+  value += NUM_SOP_TYPE + 1;
+  std::copy(value, value + NUM_MESSAGE_FLAG, mFlagCounts);
+  value += NUM_MESSAGE_FLAG;
+  mHardResets = *value++;
+  mCableResets = *value++;
+  mBistCarriers = *value++;
+  mBistCarrierSamples = *value++;
+  mBistTestData = *value++;
+  mFilteredPulses = *value++;
+
+  for (int i = 0; i < NUM_SOP_TYPE; i++) {
+    mLastMessages[i][0] = *value++;
+    mLastMessages[i][1] = *value++;
+    mAwaitingHeaders[i] = (uint32_t)*value++;
+    mAwaitingEnds[i] = *value++;
+  }
+
+  mBitRateMessages = *value++;
+  mBitRateSum_bps = *value++;
+  mMinBitRate_bps = *value++;
+  mMaxBitRate_bps = *value++;
+  mLastSample = *value++;
+  mBusySamples = *value++;
+  mBucketSamples = *value++;
+  std::copy(value, value + numUtilizationBuckets, mBucketBusySamples);
+  value += numUtilizationBuckets;
+
+  for (U32 i = 0; i < numTransmitters; i++) {
+    EdgeHistogram& edges = mEdgeHistograms[i];
+
+    for (int type = 0; type < EdgeHistogram::NUM_INTERVAL_TYPE; type++) {
+      std::copy(value, value + EdgeHistogram::numBins, edges.bins[type]);
+      value += EdgeHistogram::numBins;
+      edges.counts[type] = *value++;
+      edges.sums[type] = *value++;
+      edges.sumSquares[type] = *value++;
+      edges.minimums[type] = *value++;
+      edges.maximums[type] = *value++;
+    }
+
+    edges.glitches = *value++;
+    edges.idles = *value++;
+  }
+
+  for (U32 i = 0; i < numTransmitters; i++) {
+    LinkCounters& link = mLinks[i];
+
+    link.messages = *value++;
+    link.acknowledged = *value++;
+    link.unacknowledged = *value++;
+    link.retries = *value++;
+    link.goodCrcs = *value++;
+    link.unmatchedGoodCrcs = *value++;
+    link.responseSum = *value++;
+    link.responseMin = *value++;
+    link.responseMax = *value++;
+    std::copy(value, value + numResponseBins, link.responseBins);
+    value += numResponseBins;
+  }
+}
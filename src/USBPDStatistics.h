@@ -0,0 +1,208 @@
+#ifndef USBPD_STATISTICS_H
+#define USBPD_STATISTICS_H
+
+#include <LogicPublicTypes.h>
+
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "USBPDCacheSection.h"
+#include "USBPDMessageIndex.h"
+
+/**
+ * @brief Summary of a capture, accumulated in fixed-size counters as messages are decoded.
+ *
+ * Edge intervals are kept in fixed-bin histograms per transmitter, for jitter and eye opening
+ * estimates. Each message is paired with the GoodCRC acknowledging it, and the GoodCRC response
+ * times and retries are kept per transmitter too. Bus utilization is kept in a fixed number of
+ * buckets over time. When the capture outgrows the buckets, neighbouring buckets are merged and
+ * the bucket width doubles, so the memory used does not depend on the length of the capture.
+ *
+ * The decoder adds messages from the worker thread while the summary is exported from the UI
+ * thread, so all methods are synchronized.
+ */
+class USBPDStatistics : public USBPDCacheSection {
+ public:
+  static const U32 numUtilizationBuckets = 64;
+
+  /**
+   * @brief Histogram of the intervals between edges, split by how the decoder read them: half-bit
+   * intervals (the two halves of a 1) and full-bit intervals (a 0). Glitches and intervals too long
+   * to be a bit are only counted, so that they don't skew the histograms.
+   *
+   * The decoder fills one histogram per message and adds it to the histogram of the message's
+   * transmitter once the header shows who sent it.
+   */
+  struct EdgeHistogram {
+    enum IntervalType {
+      Interval_HalfBit,
+      Interval_FullBit,
+
+      NUM_INTERVAL_TYPE
+    };
+
+    static const U32 binsPerBit = 40;
+    static const U32 numBins = 2 * binsPerBit;  // Longer intervals are idle time
+
+    U64 bins[NUM_INTERVAL_TYPE][numBins];
+    U64 counts[NUM_INTERVAL_TYPE];
+    U64 sums[NUM_INTERVAL_TYPE];        // Samples
+    U64 sumSquares[NUM_INTERVAL_TYPE];  // Samples^2
+    U64 minimums[NUM_INTERVAL_TYPE];
+    U64 maximums[NUM_INTERVAL_TYPE];
+    U64 glitches;  // Intervals of up to a tenth of a bit
+    U64 idles;     // Intervals of numBins or longer, before a preamble or after a lost edge
+
+    void Clear();
+    void Merge(const EdgeHistogram& other);
+
+    /**
+     * @brief Add an interval the decoder read as type, or count it as a glitch or idle time
+     */
+    void Add(IntervalType type, U64 interval, U32 samplesPerBit) {
+      if (interval * 10 <= samplesPerBit) {
+        glitches++;
+        return;
+      }
+
+      U64 bin = interval * binsPerBit / samplesPerBit;
+      if (bin >= numBins) {
+        idles++;
+        return;
+      }
+
+      bins[type][bin]++;
+      counts[type]++;
+      sums[type] += interval;
+      sumSquares[type] += interval * interval;
+
+      if (interval < minimums[type]) {
+        minimums[type] = interval;
+      }
+
+      if (interval > maximums[type]) {
+        maximums[type] = interval;
+      }
+    }
+  };
+
+  /**
+   * @brief Transmitters the edge histograms are kept for: each SOP, split by bit 8 of the header
+   * (Port Power Role on SOP, Cable Plug on SOP' / SOP''), and one for everything else
+   */
+  static const U32 numTransmitters = NUM_SOP_TYPE * 2 + 1;
+
+  static const U32 responseBinWidth_us = 10;
+  static const U32 numResponseBins = 50;  // The last bin also counts longer response times
+
+  /**
+   * @brief Link-level counters of one transmitter: the messages it sent, and the GoodCRCs it sent
+   * in answer to the other end's messages
+   */
+  struct LinkCounters {
+    U64 messages;        // Messages other than GoodCRC received without errors
+    U64 acknowledged;    // Messages answered by a GoodCRC with the same MessageID
+    U64 unacknowledged;  // Messages followed by anything else
+    U64 retries;         // Messages repeating the header and CRC of the previous one
+
+    U64 goodCrcs;           // GoodCRCs answering a message, and their response times below
+    U64 unmatchedGoodCrcs;  // GoodCRCs with no message, or a different MessageID, to answer
+    U64 responseSum;        // Samples from the EOP of the message to the GoodCRC preamble
+    U64 responseMin;
+    U64 responseMax;
+    U64 responseBins[numResponseBins];
+
+    void Clear();
+  };
+
+  USBPDStatistics();
+
+  void Clear(U32 sampleRateHz, U32 bitRate);
+
+  /**
+   * @brief Count a decoded message, or a message abandoned after an invalid SOP
+   *
+   * @param edges the edge intervals read for the message
+   */
+  void AddMessage(const USBPDMessageRecord& record, const EdgeHistogram& edges);
+
+  /**
+   * @brief Count a Hard Reset or Cable Reset ordered set, spanning from the start of its preamble
+   * to its end
+   */
+  void AddReset(OrderedSetType reset,
+                U64 startingSample,
+                U64 endingSample,
+                const EdgeHistogram& edges);
+
+  /**
+   * @brief Count the carrier sent after a BIST Carrier Mode message, from its first to last edge
+   */
+  void AddBistCarrier(U64 startingSample, U64 endingSample);
+
+  /**
+   * @brief Number of pulses removed by the glitch filter so far
+   */
+  void SetFilteredPulses(U64 filteredPulses);
+
+  /**
+   * @brief Write the summary as text
+   */
+  void WriteSummary(std::ostream& stream);
+
+ protected:
+  /**
+   * @brief Save / restore the counters, for the decode cache
+   */
+  virtual void SaveValues(std::vector<U64>* values);
+  virtual bool CheckValues(const std::vector<U64>& values) const;
+  virtual void LoadValues(const std::vector<U64>& values);
+
+  void AddBusTime(U64 startingSample, U64 endingSample);
+  void AddLinkMessage(const USBPDMessageRecord& record);
+  void CloseAwaitingGoodCrc(U32 sop);
+  void WriteEdgeSummary(std::ostream& stream);
+  void WriteLinkSummary(std::ostream& stream);
+
+  std::mutex mMutex;
+
+  U32 mSampleRateHz;
+  U32 mBitRate;
+
+  U64 mMessages;
+  // Indexed by USBPDMessageIndex::GetMessageTypeValue()
+  U64 mMessageTypeCounts[USBPDMessageIndex::numMessageTypeValues];
+  U64 mSopCounts[NUM_SOP_TYPE + 1];   // NUM_SOP_TYPE for SOP errors
+  U64 mFlagCounts[NUM_MESSAGE_FLAG];  // Indexed by MessageFlag bit
+  U64 mHardResets;
+  U64 mCableResets;
+  U64 mBistCarriers;
+  U64 mBistCarrierSamples;
+  U64 mBistTestData;  // BIST Test Data messages received without errors
+  U64 mFilteredPulses;
+
+  // Header and CRC of the last message from each end of each SOP, to detect retries
+  U64 mLastMessages[NUM_SOP_TYPE][2];
+
+  // Header and EOP of the message on each SOP waiting for its GoodCRC
+  uint32_t mAwaitingHeaders[NUM_SOP_TYPE];
+  U64 mAwaitingEnds[NUM_SOP_TYPE];
+
+  // Bit rate measured over each message received without errors
+  U64 mBitRateMessages;
+  U64 mBitRateSum_bps;
+  U64 mMinBitRate_bps;
+  U64 mMaxBitRate_bps;
+
+  U64 mLastSample;
+  U64 mBusySamples;
+  U64 mBucketSamples;
+  U64 mBucketBusySamples[numUtilizationBuckets];
+
+  EdgeHistogram mEdgeHistograms[numTransmitters];
+  LinkCounters mLinks[numTransmitters];
+};
+
+#endif  // USBPD_STATISTICS_H
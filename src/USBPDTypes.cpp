@@ -0,0 +1,85 @@
+#include "USBPDTypes.h"
+
+// Name tables that are indexed directly, or searched by the filter, rather than only through an
+// inline accessor in the header. Defined once here so that translation units which do not use
+// them do not each get an unused copy.
+
+const char* const SOPTypeNames[NUM_SOP_TYPE] = {
+    "SOP",
+    "SOP'",
+    "SOP\"",
+    "SOP' Debug",
+    "SOP\" Debug",
+};
+
+const char* const StructuredVDMCommandTypeNames[NUM_STRUCTURED_VDM_COMMAND_TYPE] = {
+    "REQ",
+    "ACK",
+    "NAK",
+    "BUSY",
+};
+
+const char* const StructuredVDMCommandNames[NUM_STRUCTURED_VDM_COMMAND] = {
+    "Reserved",
+    "DiscoverIdentity",
+    "DiscoverSVIDs",
+    "DiscoverModes",
+    "EnterMode",
+    "ExitMode",
+    "Attention",
+    "Reserved7",
+    "Reserved8",
+    "Reserved9",
+    "Reserved10",
+    "Reserved11",
+    "Reserved12",
+    "Reserved13",
+    "Reserved14",
+    "Reserved15",
+    "SVID16",
+    "SVID17",
+    "SVID18",
+    "SVID19",
+    "SVID20",
+    "SVID21",
+    "SVID22",
+    "SVID23",
+    "SVID24",
+    "SVID25",
+    "SVID26",
+    "SVID27",
+    "SVID28",
+    "SVID29",
+    "SVID30",
+    "SVID31",
+};
+
+const char* const IdentityVdoTypeNames[NUM_IDENTITY_VDO_TYPE] = {
+    "ID Header",
+    "Cert Stat",
+    "Product",
+    "UFP VDO",
+    "DFP VDO",
+    "Pad",
+    "Passive Cable VDO",
+    "Active Cable VDO 1",
+    "Active Cable VDO 2",
+    "VPD VDO",
+    "VDO",
+};
+
+const char* const VdmVdoTypeNames[NUM_VDM_VDO_TYPE] = {
+    "Identity",
+    "SVIDs",
+    "Mode",
+    "DP Capabilities",
+    "DP Status",
+    "DP Configure",
+};
+
+const char* const DisplayPortConnectionNames[NUM_DISPLAY_PORT_CONNECTION] = {
+    "Not connected",
+    "DFP_D connected",
+    "UFP_D connected",
+    "DFP_D and UFP_D connected",
+};
@@ -1,7 +1,9 @@
 #ifndef USBPD_TYPES_H
 #define USBPD_TYPES_H
 
-#define CHECK_BIT(val, bit) (((val) & (1 << (bit))) != 0)
+#include <cstdint>
+
+#define CHECK_BIT(val, bit) (((val) & (1u << (bit))) != 0)
 #define EXTRACT_BIT_RANGE(val, msb, lsb) \
   ((((val) & ((0xFFFFFFFF >> (32 - (msb + 1))) & (0xFFFFFFFF << (lsb))))) >> (lsb))
 
@@ -31,6 +33,24 @@ enum FrameType {
 
   FRAME_TYPE_VDM_HEADER,
 
+  FRAME_TYPE_FILTER_MATCH,
+
+  FRAME_TYPE_HARD_RESET,
+  FRAME_TYPE_CABLE_RESET,
+
+  FRAME_TYPE_BIST_DATA_OBJECT,
+  FRAME_TYPE_BIST_TEST_DATA,
+  FRAME_TYPE_BIST_CARRIER,
+
+  FRAME_TYPE_EXTENDED_HEADER,
+  FRAME_TYPE_EXTENDED_DATA,
+
+  FRAME_TYPE_EPR_MODE_DATA_OBJECT,
+
+  FRAME_TYPE_IDENTITY_VDO,
+  FRAME_TYPE_VDM_DATA_OBJECT,
+  FRAME_TYPE_DATA_OBJECT,  // Data object of a data message decoded from the message type alone
+
   NUM_FRAME_TYPE
 };
 
@@ -65,13 +85,31 @@ enum SOPType {
   NUM_SOP_TYPE
 };
 
+extern const char* const SOPTypeNames[NUM_SOP_TYPE];
+
+// Every ordered set: the SOP* that start a message (with the same values as SOPType), and the
+// resets that are sent on their own
+enum OrderedSetType {
+  OrderedSet_SOP,
+  OrderedSet_SOP_PRIME,
+  OrderedSet_SOP_DOUBLE_PRIME,
+  OrderedSet_SOP_PRIME_DEBUG,
+  OrderedSet_SOP_DOUBLE_PRIME_DEBUG,
+  OrderedSet_HardReset,
+  OrderedSet_CableReset,
+
+  NUM_ORDERED_SET
+};
+
 const int numKcodeInSOP = 4;
-static const KCODEType sop_map[NUM_SOP_TYPE][numKcodeInSOP] = {
+static const KCODEType ordered_set_map[NUM_ORDERED_SET][numKcodeInSOP] = {
     {KCODEType_SYNC_1, KCODEType_SYNC_1, KCODEType_SYNC_1, KCODEType_SYNC_2}, // SOP
     {KCODEType_SYNC_1, KCODEType_SYNC_1, KCODEType_SYNC_3, KCODEType_SYNC_3}, // SOP'
     {KCODEType_SYNC_1, KCODEType_SYNC_3, KCODEType_SYNC_1, KCODEType_SYNC_3}, // SOP"
     {KCODEType_SYNC_1, KCODEType_RST_2,  KCODEType_RST_2,  KCODEType_SYNC_3}, // SOP' Debug
     {KCODEType_SYNC_1, KCODEType_RST_2,  KCODEType_SYNC_3, KCODEType_SYNC_2}, // SOP" Debug
+    {KCODEType_RST_1,  KCODEType_RST_1,  KCODEType_RST_1,  KCODEType_RST_2},  // Hard Reset
+    {KCODEType_RST_1,  KCODEType_SYNC_1, KCODEType_RST_1,  KCODEType_SYNC_3}, // Cable Reset
 };
 
 static const uint8_t fourBitToFiveBitLUT[16] = {
@@ -222,6 +260,302 @@ static const char* DataMessageNames[NUM_DATA_MESSAGE] = {
     "DataMessage_Vendor_Defined",
 };
 
+enum ExtendedMessageTypes {
+    ExtendedMessage_Reserved,
+    ExtendedMessage_Source_Capabilities_Extended,
+    ExtendedMessage_Status,
+    ExtendedMessage_Get_Battery_Cap,
+    ExtendedMessage_Get_Battery_Status,
+    ExtendedMessage_Battery_Capabilities,
+    ExtendedMessage_Get_Manufacturer_Info,
+    ExtendedMessage_Manufacturer_Info,
+    ExtendedMessage_Security_Request,
+    ExtendedMessage_Security_Response,
+    ExtendedMessage_Firmware_Update_Request,
+    ExtendedMessage_Firmware_Update_Response,
+    ExtendedMessage_PPS_Status,
+    ExtendedMessage_Country_Info,
+    ExtendedMessage_Country_Codes,
+    ExtendedMessage_Sink_Capabilities_Extended,
+    ExtendedMessage_Extended_Control,
+    ExtendedMessage_EPR_Source_Capabilities,
+    ExtendedMessage_EPR_Sink_Capabilities,
+    ExtendedMessage_Reserved19,
+    ExtendedMessage_Reserved20,
+    ExtendedMessage_Reserved21,
+    ExtendedMessage_Reserved22,
+    ExtendedMessage_Reserved23,
+    ExtendedMessage_Reserved24,
+    ExtendedMessage_Reserved25,
+    ExtendedMessage_Reserved26,
+    ExtendedMessage_Reserved27,
+    ExtendedMessage_Reserved28,
+    ExtendedMessage_Reserved29,
+    ExtendedMessage_Vendor_Defined_Extended,
+    ExtendedMessage_Reserved31,
+
+    NUM_EXTENDED_MESSAGE
+};
+
+static const char* ExtendedMessageNames[NUM_EXTENDED_MESSAGE] = {
+    "ExtendedMessage_Reserved",
+    "ExtendedMessage_Source_Capabilities_Extended",
+    "ExtendedMessage_Status",
+    "ExtendedMessage_Get_Battery_Cap",
+    "ExtendedMessage_Get_Battery_Status",
+    "ExtendedMessage_Battery_Capabilities",
+    "ExtendedMessage_Get_Manufacturer_Info",
+    "ExtendedMessage_Manufacturer_Info",
+    "ExtendedMessage_Security_Request",
+    "ExtendedMessage_Security_Response",
+    "ExtendedMessage_Firmware_Update_Request",
+    "ExtendedMessage_Firmware_Update_Response",
+    "ExtendedMessage_PPS_Status",
+    "ExtendedMessage_Country_Info",
+    "ExtendedMessage_Country_Codes",
+    "ExtendedMessage_Sink_Capabilities_Extended",
+    "ExtendedMessage_Extended_Control",
+    "ExtendedMessage_EPR_Source_Capabilities",
+    "ExtendedMessage_EPR_Sink_Capabilities",
+    "ExtendedMessage_Reserved19",
+    "ExtendedMessage_Reserved20",
+    "ExtendedMessage_Reserved21",
+    "ExtendedMessage_Reserved22",
+    "ExtendedMessage_Reserved23",
+    "ExtendedMessage_Reserved24",
+    "ExtendedMessage_Reserved25",
+    "ExtendedMessage_Reserved26",
+    "ExtendedMessage_Reserved27",
+    "ExtendedMessage_Reserved28",
+    "ExtendedMessage_Reserved29",
+    "ExtendedMessage_Vendor_Defined_Extended",
+    "ExtendedMessage_Reserved31",
+};
+
+// Extended messages carry at most MaxExtendedMsgLen bytes, in chunks of MaxExtendedMsgChunkLen
+static const uint32_t maxExtendedMsgLen = 260;
+static const uint32_t maxExtendedMsgChunkLen = 26;
+
+// EPR_Source_Capabilities lists the SPR PDOs in object positions 1..7, padded with zero PDOs, then
+// the EPR PDOs from position 8, for at most 11 PDOs
+static const uint32_t maxEPRSourcePdos = 11;
+static const uint32_t firstEPRObjectPosition = 8;
+
+// The header's Message Type field is 5 bits wide, but only some of the values are defined. Use
+// this rather than indexing the name tables with a field read from the bus.
+static inline const char* GetMessageTypeName(bool extended,
+                                             uint32_t numberOfDataObjects,
+                                             uint32_t messageType) {
+  if (extended) {
+    return ExtendedMessageNames[messageType & 0x1F];
+  }
+
+  if (numberOfDataObjects == 0) {
+    return (messageType < NUM_CONTROL_MESSAGE) ? ControlMessageNames[messageType]
+                                               : ControlMessageNames[ControlMessage_Reserved];
+  }
+
+  return (messageType < NUM_DATA_MESSAGE) ? DataMessageNames[messageType]
+                                          : DataMessageNames[DataMessage_Reserved];
+}
+
+// BIST Mode field, bits 31..28 of a BIST Data Object. Other values are reserved.
+enum BISTMode {
+  BISTMode_CarrierMode = 0x5,
+  BISTMode_TestData = 0x8,
+  BISTMode_SharedTestModeEntry = 0x9,
+  BISTMode_SharedTestModeExit = 0xA,
+};
+
+static inline const char* GetBISTModeName(uint32_t mode) {
+  switch (mode) {
+    case BISTMode_CarrierMode:
+      return "Carrier Mode";
+    case BISTMode_TestData:
+      return "Test Data";
+    case BISTMode_SharedTestModeEntry:
+      return "Shared Test Mode Entry";
+    case BISTMode_SharedTestModeExit:
+      return "Shared Test Mode Exit";
+    default:
+      return "Reserved";
+  }
+}
+
+// Action field, bits 31..24 of an EPR Mode Data Object. Other values are reserved.
+enum EPRModeAction {
+  EPRModeAction_Enter = 0x1,
+  EPRModeAction_EnterAcknowledged = 0x2,
+  EPRModeAction_EnterSucceeded = 0x3,
+  EPRModeAction_EnterFailed = 0x4,
+  EPRModeAction_Exit = 0x5,
+};
+
+static inline const char* GetEPRModeActionName(uint32_t action) {
+  switch (action) {
+    case EPRModeAction_Enter:
+      return "Enter";
+    case EPRModeAction_EnterAcknowledged:
+      return "Enter Acknowledged";
+    case EPRModeAction_EnterSucceeded:
+      return "Enter Succeeded";
+    case EPRModeAction_EnterFailed:
+      return "Enter Failed";
+    case EPRModeAction_Exit:
+      return "Exit";
+    default:
+      return "Reserved";
+  }
+}
+
+// Data field of an EPR Mode Data Object with the Enter Failed action
+static inline const char* GetEPRModeFailureName(uint32_t data) {
+  switch (data) {
+    case 0x0:
+      return "Unknown cause";
+    case 0x1:
+      return "Cable not EPR capable";
+    case 0x2:
+      return "Source failed to become VCONN Source";
+    case 0x3:
+      return "EPR Capable bit not set in RDO";
+    case 0x4:
+      return "Source unable to enter EPR Mode";
+    case 0x5:
+      return "EPR Capable bit not set in PDO";
+    default:
+      return "Reserved";
+  }
+}
+
+// Charging Status field, bits 11..10 of a Battery Status Data Object
+static inline const char* GetBatteryChargingStatusName(uint32_t status) {
+  switch (status) {
+    case 0x0:
+      return "Charging";
+    case 0x1:
+      return "Discharging";
+    case 0x2:
+      return "Idle";
+    default:
+      return "Reserved";
+  }
+}
+
+// Extended Alert Event Type field, bits 3..0 of an Alert Data Object
+static inline const char* GetExtendedAlertEventName(uint32_t event) {
+  switch (event) {
+    case 0x1:
+      return "Power State Change";
+    case 0x2:
+      return "Power Button Press";
+    case 0x3:
+      return "Power Button Release";
+    case 0x4:
+      return "Controller Initiated Wake";
+    default:
+      return "Reserved";
+  }
+}
+
+// USB Mode field, bits 30..28 of an Enter_USB Data Object
+static inline const char* GetEnterUSBModeName(uint32_t mode) {
+  switch (mode) {
+    case 0x0:
+      return "USB 2.0";
+    case 0x1:
+      return "USB 3.2";
+    case 0x2:
+      return "USB4";
+    default:
+      return "Reserved";
+  }
+}
+
+// Cable Speed field, bits 23..21 of an Enter_USB Data Object
+static inline const char* GetEnterUSBCableSpeedName(uint32_t speed) {
+  switch (speed) {
+    case 0x0:
+      return "USB 2.0";
+    case 0x1:
+      return "Gen1";
+    case 0x2:
+      return "Gen2";
+    case 0x3:
+      return "Gen3";
+    case 0x4:
+      return "Gen4";
+    default:
+      return "Reserved";
+  }
+}
+
+// Cable Type field, bits 20..19 of an Enter_USB Data Object
+static inline const char* GetEnterUSBCableTypeName(uint32_t type) {
+  switch (type) {
+    case 0x0:
+      return "Passive";
+    case 0x1:
+      return "Active Re-timer";
+    case 0x2:
+      return "Active Re-driver";
+    default:
+      return "Optically Isolated";
+  }
+}
+
+// Cable Current field, bits 18..17 of an Enter_USB Data Object
+static inline const char* GetEnterUSBCableCurrentName(uint32_t current) {
+  switch (current) {
+    case 0x0:
+      return "VBUS not supported";
+    case 0x2:
+      return "3A";
+    case 0x3:
+      return "5A";
+    default:
+      return "Reserved";
+  }
+}
+
+// Message Type byte of a Firmware_Update_Request / Firmware_Update_Response (USB PD Firmware Update
+// specification). Requests have bit 7 set, and their response the same value with bit 7 cleared.
+enum FirmwareUpdateMessageType {
+  FirmwareUpdate_GET_FW_ID = 0x01,
+  FirmwareUpdate_PDFU_INITIATE = 0x02,
+  FirmwareUpdate_PDFU_DATA = 0x03,
+  FirmwareUpdate_PDFU_DATA_NR = 0x04,
+  FirmwareUpdate_PDFU_VALIDATE = 0x05,
+  FirmwareUpdate_PDFU_ABORT = 0x06,
+  FirmwareUpdate_PDFU_DATA_PAUSE = 0x07,
+  FirmwareUpdate_VENDOR_SPECIFIC = 0x7F,
+
+  FirmwareUpdate_Request = 0x80,
+};
+
+static inline const char* GetFirmwareUpdateMessageName(uint32_t messageType) {
+  switch (messageType & ~FirmwareUpdate_Request) {
+    case FirmwareUpdate_GET_FW_ID:
+      return "GET_FW_ID";
+    case FirmwareUpdate_PDFU_INITIATE:
+      return "PDFU_INITIATE";
+    case FirmwareUpdate_PDFU_DATA:
+      return "PDFU_DATA";
+    case FirmwareUpdate_PDFU_DATA_NR:
+      return "PDFU_DATA_NR";
+    case FirmwareUpdate_PDFU_VALIDATE:
+      return "PDFU_VALIDATE";
+    case FirmwareUpdate_PDFU_ABORT:
+      return "PDFU_ABORT";
+    case FirmwareUpdate_PDFU_DATA_PAUSE:
+      return "PDFU_DATA_PAUSE";
+    case FirmwareUpdate_VENDOR_SPECIFIC:
+      return "VENDOR_SPECIFIC";
+    default:
+      return "Reserved";
+  }
+}
+
 enum PDSpecRevision {
     PDSpecRevision_1P0,
     PDSpecRevision_2P0,
@@ -288,6 +622,11 @@ static const char*StructuredVDMVersionNames[NUM_STRUCTURED_VDM_VERSION] = {
     "2.0",
 };
 
+// The version field is 2 bits wide
+static inline const char* GetStructuredVDMVersionName(uint32_t version) {
+  return (version < NUM_STRUCTURED_VDM_VERSION) ? StructuredVDMVersionNames[version] : "Reserved";
+}
+
 enum StructuredVDMCommandType {
     StructuredVDMCommandType_REQ,
     StructuredVDMCommandType_ACK,
@@ -297,12 +636,7 @@ enum StructuredVDMCommandType {
     NUM_STRUCTURED_VDM_COMMAND_TYPE
 };
 
-static const char* StructuredVDMCommandTypeNames[NUM_STRUCTURED_VDM_COMMAND_TYPE] = {
-    "REQ",
-    "ACK",
-    "NAK",
-    "BUSY",
-};
+extern const char* const StructuredVDMCommandTypeNames[NUM_STRUCTURED_VDM_COMMAND_TYPE];
 
 enum StructuredVDMCommand {
     StructuredVDMCommand_Reserved,
@@ -341,40 +675,7 @@ enum StructuredVDMCommand {
     NUM_STRUCTURED_VDM_COMMAND
 };
 
-static const char* StructuredVDMCommandNames[NUM_STRUCTURED_VDM_COMMAND] = {
-    "Reserved",
-    "DiscoverIdentity",
-    "DiscoverSVIDs",
-    "DiscoverModes",
-    "EnterMode",
-    "ExitMode",
-    "Attention",
-    "Reserved7",
-    "Reserved8",
-    "Reserved9",
-    "Reserved10",
-    "Reserved11",
-    "Reserved12",
-    "Reserved13",
-    "Reserved14",
-    "Reserved15",
-    "SVID16",
-    "SVID17",
-    "SVID18",
-    "SVID19",
-    "SVID20",
-    "SVID21",
-    "SVID22",
-    "SVID23",
-    "SVID24",
-    "SVID25",
-    "SVID26",
-    "SVID27",
-    "SVID28",
-    "SVID29",
-    "SVID30",
-    "SVID31",
-};
+extern const char* const StructuredVDMCommandNames[NUM_STRUCTURED_VDM_COMMAND];
 
 enum SOPProductTypeUfp {
   SOPProductTypeUfp_NotUFP,
@@ -386,12 +687,12 @@ enum SOPProductTypeUfp {
 };
 
 enum SOPProductTypeDfp {
-  SOPProductTypeUfp_NotDFP,
-  SOPProductTypeUfp_PDUSBHub,
-  SOPProductTypeUfp_PDUSBHost,
-  SOPProductTypeUfp_PowerBrick,
+  SOPProductTypeDfp_NotDFP,
+  SOPProductTypeDfp_PDUSBHub,
+  SOPProductTypeDfp_PDUSBHost,
+  SOPProductTypeDfp_PowerBrick,
 
-  NUM_SOP_PRODUCT_TYPE_UFP
+  NUM_SOP_PRODUCT_TYPE_DFP
 };
 
 enum SOPPrimeProductType {
@@ -441,10 +742,150 @@ enum USBHighestSpeed {
   USBHighestSpeed_3P2_Gen1,
   USBHighestSpeed_3P2_4P0_Gen2,
   USBHighestSpeed_4P0_Gen3,
+  USBHighestSpeed_4P0_Gen4,  // Cables only
 
   NUM_USB_HIGHEST_SPEED
 };
 
+// VDOs of a Discover Identity ACK, in the order they are sent. Which Product Type VDOs follow the
+// Product VDO depends on the product types in the ID Header.
+enum IdentityVdoType {
+  IdentityVdo_IDHeader,
+  IdentityVdo_CertStat,
+  IdentityVdo_Product,
+  IdentityVdo_UFP,
+  IdentityVdo_DFP,
+  IdentityVdo_Pad,  // Between the UFP and DFP VDOs of a DRD
+  IdentityVdo_PassiveCable,
+  IdentityVdo_ActiveCable1,
+  IdentityVdo_ActiveCable2,
+  IdentityVdo_VPD,
+  IdentityVdo_Unknown,  // Beyond the VDOs the product types call for
+
+  NUM_IDENTITY_VDO_TYPE
+};
+
+extern const char* const IdentityVdoTypeNames[NUM_IDENTITY_VDO_TYPE];
+
+// ID Header, Cert Stat and Product VDOs, then up to 3 Product Type VDOs
+static const uint32_t maxIdentityVdos = 6;
+
+// Standard and Vendor IDs of structured VDMs
+static const uint16_t pdSid = 0xFF00;
+static const uint16_t displayPortSvid = 0xFF01;
+
+// SVID specific commands of the DisplayPort Alt Mode
+enum DisplayPortCommand {
+  DisplayPortCommand_StatusUpdate = StructuredVDMCommand_SVID16,
+  DisplayPortCommand_Configure = StructuredVDMCommand_SVID17,
+};
+
+// Kinds of the VDOs following a structured VDM Header, by SVID and command
+enum VdmVdoType {
+  VdmVdo_Identity,  // Discover Identity ACK, see IdentityVdoType
+  VdmVdo_SVIDs,
+  VdmVdo_Mode,
+  VdmVdo_DPCapabilities,  // DisplayPort Mode VDO
+  VdmVdo_DPStatus,
+  VdmVdo_DPConfigure,
+
+  NUM_VDM_VDO_TYPE
+};
+
+extern const char* const VdmVdoTypeNames[NUM_VDM_VDO_TYPE];
+
+enum DisplayPortConnection {
+  DisplayPortConnection_None,
+  DisplayPortConnection_DFP_D,
+  DisplayPortConnection_UFP_D,
+  DisplayPortConnection_Both,
+
+  NUM_DISPLAY_PORT_CONNECTION
+};
+
+extern const char* const DisplayPortConnectionNames[NUM_DISPLAY_PORT_CONNECTION];
+
+enum DisplayPortConfiguration {
+  DisplayPortConfiguration_USB,
+  DisplayPortConfiguration_DFP_D,  // UFP_U as DFP_D
+  DisplayPortConfiguration_UFP_D,  // UFP_U as UFP_D
+
+  NUM_DISPLAY_PORT_CONFIGURATION
+};
+
+static inline const char* GetSOPProductTypeUfpName(uint32_t type) {
+  switch (type) {
+    case SOPProductTypeUfp_NotUFP:
+      return "Not a UFP";
+    case SOPProductTypeUfp_PDUSBHub:
+      return "PDUSB Hub";
+    case SOPProductTypeUfp_PDUSBPeripheral:
+      return "PDUSB Peripheral";
+    case SOPProductTypeUfp_PSD:
+      return "PSD";
+    default:
+      return "Reserved";
+  }
+}
+
+static inline const char* GetSOPProductTypeDfpName(uint32_t type) {
+  switch (type) {
+    case SOPProductTypeDfp_NotDFP:
+      return "Not a DFP";
+    case SOPProductTypeDfp_PDUSBHub:
+      return "PDUSB Hub";
+    case SOPProductTypeDfp_PDUSBHost:
+      return "PDUSB Host";
+    case SOPProductTypeDfp_PowerBrick:
+      return "Power Brick";
+    default:
+      return "Reserved";
+  }
+}
+
+static inline const char* GetSOPPrimeProductTypeName(uint32_t type) {
+  switch (type) {
+    case SOPPrimeProductType_NotCablePlug_VPD:
+      return "Not a Cable Plug / VPD";
+    case SOPPrimeProductType_PassiveCable:
+      return "Passive Cable";
+    case SOPPrimeProductType_ActiveCable:
+      return "Active Cable";
+    case SOPPrimeProductType_VCONNPoweredDevice:
+      return "VPD";
+    default:
+      return "Reserved";
+  }
+}
+
+static inline const char* GetConnectorTypeName(uint32_t type) {
+  switch (type) {
+    case ConnectorType_USBCReceptable:
+      return "USB-C Receptacle";
+    case ConnectorType_USBCPlug:
+      return "USB-C Plug";
+    default:
+      return "Connector n/a";
+  }
+}
+
+static inline const char* GetUSBHighestSpeedName(uint32_t speed) {
+  switch (speed) {
+    case USBHighestSpeed_2P0:
+      return "USB 2.0";
+    case USBHighestSpeed_3P2_Gen1:
+      return "USB 3.2 Gen1";
+    case USBHighestSpeed_3P2_4P0_Gen2:
+      return "USB 3.2 / USB4 Gen2";
+    case USBHighestSpeed_4P0_Gen3:
+      return "USB4 Gen3";
+    case USBHighestSpeed_4P0_Gen4:
+      return "USB4 Gen4";
+    default:
+      return "Reserved";
+  }
+}
+
 // Constants for PDOs
 static const int usbPdoMilivoltPerStep = 50;
 static const int usbPdoMiliampPerStep = 10;
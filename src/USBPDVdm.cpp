@@ -0,0 +1,180 @@
+#include "USBPDVdm.h"
+
+#include <cstdio>
+
+#include "USBPDMessages.h"
+
+// Command types carrying the VDOs
+static const uint8_t vdmReq = 1 << StructuredVDMCommandType_REQ;
+static const uint8_t vdmAck = 1 << StructuredVDMCommandType_ACK;
+
+// Data objects after the VDM Header
+static const uint8_t maxVdmVdos = 6;
+
+// Rows for an exact SVID come before the anySvid rows for the same command
+static const USBPDVdm::Decoder vdmDecoders[] = {
+    {pdSid, StructuredVDMCommand_DiscoverIdentity, vdmAck, maxIdentityVdos, VdmVdo_Identity, NULL},
+    {pdSid, StructuredVDMCommand_DiscoverSVIDs, vdmAck, maxVdmVdos, VdmVdo_SVIDs, NULL},
+    {displayPortSvid,
+     StructuredVDMCommand_DiscoverModes,
+     vdmAck,
+     maxVdmVdos,
+     VdmVdo_DPCapabilities,
+     NULL},
+    {USBPDVdm::anySvid, StructuredVDMCommand_DiscoverModes, vdmAck, maxVdmVdos, VdmVdo_Mode, NULL},
+    {displayPortSvid, StructuredVDMCommand_Attention, vdmReq, 1, VdmVdo_DPStatus, NULL},
+    {displayPortSvid,
+     DisplayPortCommand_StatusUpdate,
+     vdmReq | vdmAck,
+     1,
+     VdmVdo_DPStatus,
+     "DP Status Update"},
+    {displayPortSvid, DisplayPortCommand_Configure, vdmReq, 1, VdmVdo_DPConfigure, "DP Configure"},
+};
+
+static const size_t numVdmDecoders = sizeof(vdmDecoders) / sizeof(vdmDecoders[0]);
+
+const USBPDVdm::Decoder* USBPDVdm::FindDecoder(uint16_t svid, uint8_t command) {
+  for (size_t i = 0; i < numVdmDecoders; i++) {
+    const Decoder& decoder = vdmDecoders[i];
+
+    if (decoder.command == command && (decoder.svid == svid || decoder.svid == anySvid)) {
+      return &decoder;
+    }
+  }
+
+  return NULL;
+}
+
+const char* USBPDVdm::GetCommandName(uint16_t svid, uint8_t command) {
+  const Decoder* decoder = FindDecoder(svid, command);
+
+  if (decoder != NULL && decoder->name != NULL) {
+    return decoder->name;
+  }
+
+  return (command < NUM_STRUCTURED_VDM_COMMAND) ? StructuredVDMCommandNames[command] : "Reserved";
+}
+
+/**
+ * @brief Pin assignments as letters, e.g. "CDE" for bits 2, 3 and 4
+ */
+static void GetPinAssignmentsText(uint8_t pins, char* text, size_t textSize) {
+  size_t length = 0;
+
+  for (int i = 0; i < 8 && length + 1 < textSize; i++) {
+    if (CHECK_BIT(pins, i)) {
+      text[length++] = 'A' + i;
+    }
+  }
+
+  text[length] = 0;
+}
+
+static const char* GetSignalingName(uint8_t signaling) {
+  switch (signaling) {
+    case 0:
+      return "No signaling";
+    case 1:
+      return "DP v1.3";
+    case 2:
+      return "USB Gen2";
+    case 3:
+      return "DP v1.3 and USB Gen2";
+    default:
+      return "Reserved signaling";
+  }
+}
+
+void USBPDVdm::DescribeVdo(VdmVdoType type,
+                           uint16_t svid,
+                           uint32_t position,
+                           uint32_t vdo,
+                           char* text,
+                           size_t textSize) {
+  switch (type) {
+    case VdmVdo_SVIDs: {
+      // Two SVIDs per VDO, the list ends with a zero SVID
+      uint16_t first = EXTRACT_BIT_RANGE(vdo, 31, 16);
+      uint16_t second = EXTRACT_BIT_RANGE(vdo, 15, 0);
+
+      if (first == 0) {
+        snprintf(text, textSize, "SVIDs end");
+      } else if (second == 0) {
+        snprintf(text, textSize, "SVIDs 0x%04X, end", first);
+      } else {
+        snprintf(text, textSize, "SVIDs 0x%04X 0x%04X", first, second);
+      }
+    } break;
+
+    case VdmVdo_Mode:
+      snprintf(text, textSize, "SVID 0x%04X Mode %u: 0x%08X", svid, position, vdo);
+      break;
+
+    case VdmVdo_DPCapabilities: {
+      USBPDMessages::DPCapabilitiesVdo capabilities(vdo);
+      char dfpPins[9];
+      char ufpPins[9];
+      GetPinAssignmentsText(capabilities.dfpDPinAssignments, dfpPins, sizeof(dfpPins));
+      GetPinAssignmentsText(capabilities.ufpDPinAssignments, ufpPins, sizeof(ufpPins));
+
+      snprintf(text,
+               textSize,
+               "DP Mode %u: %s, %s, DFP_D pins %s, UFP_D pins %s, %s%s",
+               position,
+               capabilities.dfpDCapable
+                   ? (capabilities.ufpDCapable ? "DFP_D and UFP_D" : "DFP_D")
+                   : (capabilities.ufpDCapable ? "UFP_D" : "Reserved"),
+               capabilities.receptacle ? "Receptacle" : "Plug",
+               dfpPins[0] ? dfpPins : "-",
+               ufpPins[0] ? ufpPins : "-",
+               GetSignalingName(capabilities.signaling),
+               capabilities.usb2p0NotUsed ? ", No USB 2.0" : "");
+    } break;
+
+    case VdmVdo_DPStatus: {
+      USBPDMessages::DPStatusVdo status(vdo);
+      snprintf(text,
+               textSize,
+               "DP Status: %s%s%s%s%s%s, HPD %s%s",
+               DisplayPortConnectionNames[status.connection],
+               status.enabled ? ", Enabled" : "",
+               status.powerLow ? ", Power Low" : "",
+               status.multiFunctionPreferred ? ", Multi-function" : "",
+               status.usbConfigurationRequest ? ", USB Request" : "",
+               status.exitRequest ? ", Exit Request" : "",
+               status.hpdHigh ? "High" : "Low",
+               status.irqHpd ? ", IRQ_HPD" : "");
+    } break;
+
+    case VdmVdo_DPConfigure: {
+      USBPDMessages::DPConfigureVdo configure(vdo);
+      char pins[9];
+      GetPinAssignmentsText(configure.pinAssignment, pins, sizeof(pins));
+
+      switch (configure.configuration) {
+        case DisplayPortConfiguration_USB:
+          snprintf(text, textSize, "DP Configure: USB");
+          break;
+
+        case DisplayPortConfiguration_DFP_D:
+        case DisplayPortConfiguration_UFP_D:
+          snprintf(text,
+                   textSize,
+                   "DP Configure: UFP_U as %s, Pin %s, %s",
+                   configure.configuration == DisplayPortConfiguration_DFP_D ? "DFP_D" : "UFP_D",
+                   pins[0] ? pins : "-",
+                   GetSignalingName(configure.signaling));
+          break;
+
+        default:
+          snprintf(text, textSize, "DP Configure: Reserved 0x%08X", vdo);
+          break;
+      }
+    } break;
+
+    default:
+      snprintf(text, textSize, "VDO=0x%08X", vdo);
+      break;
+  }
+}
@@ -0,0 +1,56 @@
+#ifndef USBPD_VDM_H
+#define USBPD_VDM_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "USBPDTypes.h"
+
+/**
+ * @brief Decoding of the VDOs following a structured VDM Header.
+ *
+ * Which VDOs follow the header depends on the SVID and the command, and SVIDs define commands of
+ * their own from 16 up. A table keyed by (SVID, command) gives the kind of the VDOs, and the name
+ * of SVID specific commands, so an SVID is supported by adding its rows and describing its VDOs.
+ */
+class USBPDVdm {
+ public:
+  struct Decoder {
+    uint16_t svid;         // anySvid for commands decoded the same whatever the SVID
+    uint8_t command;       // StructuredVDMCommand
+    uint8_t commandTypes;  // Bit per StructuredVDMCommandType carrying the VDOs
+    uint8_t maxVdos;       // VDOs beyond these are left as generic data objects
+    VdmVdoType vdoType;
+    const char* name;  // Name of an SVID specific command, NULL for the standard ones
+  };
+
+  static const uint16_t anySvid = 0;
+
+  /**
+   * @brief Row for svid and command, a row for the exact SVID taking precedence over an anySvid
+   * one
+   *
+   * @return NULL if the command carries no VDOs the table knows of
+   */
+  static const Decoder* FindDecoder(uint16_t svid, uint8_t command);
+
+  /**
+   * @brief Name of a command, e.g. "DiscoverModes", or "DP Configure" for the DisplayPort SVID
+   */
+  static const char* GetCommandName(uint16_t svid, uint8_t command);
+
+  /**
+   * @brief Describe a VDO concisely, e.g. "SVIDs 0xFF01 0x8087"
+   *
+   * @param position object position of the VDO in the message, 1 for the first VDO after the VDM
+   * Header
+   */
+  static void DescribeVdo(VdmVdoType type,
+                          uint16_t svid,
+                          uint32_t position,
+                          uint32_t vdo,
+                          char* text,
+                          size_t textSize);
+};
+
+#endif  // USBPD_VDM_H
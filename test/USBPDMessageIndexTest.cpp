@@ -0,0 +1,135 @@
+// Message index queries over a decoded capture: Requests and Accepts are encoded with Hard Resets
+// and Cable Resets between them, decoded by USBPDAnalyzer, and the index must find the 500th
+// Request after the third Hard Reset, and count the Requests and resets between two samples.
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "USBPDTestHarness.h"
+
+static const U32 sampleRateHz = 12000000;
+static const U32 bitRate = 300000;
+
+static const U64 idleSamples = (sampleRateHz / 1000000) * 100;
+
+// Requests sent before the first Hard Reset and after each one, with a Cable Reset half way
+static const int numHardResets = 4;
+static const U32 requestsPerSegment = 600;
+
+// Sink, UFP, revision 3.0
+static const uint16_t requestHeader = (1 << 12) | (2 << 6) | DataMessage_Request;
+// Source, DFP, revision 3.0
+static const uint16_t acceptHeader = (1 << 8) | (2 << 6) | (1 << 5) | ControlMessage_Accept;
+
+/**
+ * @brief Encode a segment of Request + Accept exchanges. The data object of each Request is its
+ * number, counting every Request sent.
+ */
+static void AddRequests(USBPDTestGenerator* generator, U32 firstRequest, uint8_t* messageId) {
+  for (U32 i = 0; i < requestsPerSegment; i++) {
+    uint32_t request = firstRequest + i;
+
+    if (i == requestsPerSegment / 2) {
+      generator->AddReset(OrderedSet_CableReset, idleSamples);
+    }
+
+    generator->AddPacket(SOPType_SOP, requestHeader | (*messageId << 9), &request, 1, idleSamples);
+    generator->AddPacket(SOPType_SOP, acceptHeader | (*messageId << 9), NULL, 0, idleSamples);
+    *messageId = (*messageId + 1) & 7;
+  }
+}
+
+static bool Check(bool condition, const char* description) {
+  if (!condition) {
+    fprintf(stderr, "%s\n", description);
+  }
+
+  return condition;
+}
+
+int main() {
+  USBPDTestAnalyzer analyzer(sampleRateHz, bitRate);
+
+  USBPDTestGenerator generator;
+  generator.Initialize(sampleRateHz, analyzer.GetSettings());
+
+  uint8_t messageId = 0;
+  for (int segment = 0; segment <= numHardResets; segment++) {
+    if (segment > 0) {
+      generator.AddReset(OrderedSet_HardReset, idleSamples);
+      messageId = 0;
+    }
+
+    AddRequests(&generator, segment * requestsPerSegment, &messageId);
+  }
+  generator.AddIdle(sampleRateHz / 1000);
+
+  SimulationChannelDescriptor& channel = generator.GetChannel();
+  analyzer.Decode(channel.GetInitialBitState(), channel.GetEdges());
+
+  USBPDMessageIndex& index = analyzer.GetMessageIndex();
+  uint32_t requestType = USBPDMessageIndex::GetMessageTypeValue(requestHeader);
+
+  bool passed = true;
+
+  passed &= Check(index.GetNumMessages() == 2 * (numHardResets + 1) * requestsPerSegment,
+                  "Not every message was decoded");
+  passed &= Check(index.GetNumResets() == 2 * numHardResets + 1, "Not every reset was decoded");
+
+  // The 500th Request after the third Hard Reset
+  U64 thirdHardReset;
+  U64 foundRequest;
+  USBPDResetRecord reset = USBPDResetRecord();
+  USBPDMessageRecord request = USBPDMessageRecord();
+
+  if (!index.FindNth(USBPDMessageIndex::Key_Reset, OrderedSet_HardReset, 0, 2, &thirdHardReset) ||
+      !index.GetReset(thirdHardReset, &reset) ||
+      !index.FindNth(USBPDMessageIndex::Key_MessageType,
+                     requestType,
+                     reset.startingSample,
+                     499,
+                     &foundRequest) ||
+      !index.GetMessage(foundRequest, &request)) {
+    fprintf(stderr, "The 500th Request after the third Hard Reset was not found\n");
+    passed = false;
+  } else {
+    passed &= Check(reset.type == OrderedSet_HardReset, "The third Hard Reset is not one");
+    passed &= Check(request.startingSample > reset.endingSample,
+                    "The Request found starts before the third Hard Reset");
+    passed &= Check(request.firstDataObject == 3 * requestsPerSegment + 499,
+                    "The Request found is not the 500th after the third Hard Reset");
+  }
+
+  // Between the third and fourth Hard Resets
+  U64 fourthHardReset;
+  USBPDResetRecord nextReset = USBPDResetRecord();
+
+  if (!index.FindNth(USBPDMessageIndex::Key_Reset, OrderedSet_HardReset, 0, 3, &fourthHardReset) ||
+      !index.GetReset(fourthHardReset, &nextReset)) {
+    fprintf(stderr, "The fourth Hard Reset was not found\n");
+    passed = false;
+  } else {
+    passed &= Check(index.Count(USBPDMessageIndex::Key_MessageType,
+                                requestType,
+                                reset.startingSample,
+                                nextReset.startingSample) == requestsPerSegment,
+                    "Wrong number of Requests between the third and fourth Hard Resets");
+    passed &= Check(index.Count(USBPDMessageIndex::Key_Reset,
+                                OrderedSet_CableReset,
+                                reset.startingSample,
+                                nextReset.startingSample) == 1,
+                    "Wrong number of Cable Resets between the third and fourth Hard Resets");
+  }
+
+  // There are no more than numHardResets Hard Resets
+  U64 noReset;
+  passed &= Check(!index.FindNth(USBPDMessageIndex::Key_Reset,
+                                 OrderedSet_HardReset,
+                                 0,
+                                 numHardResets,
+                                 &noReset),
+                  "Found a Hard Reset that was not sent");
+
+  printf("%s\n", passed ? "PASSED" : "FAILED");
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
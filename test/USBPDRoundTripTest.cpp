@@ -0,0 +1,209 @@
+// Round trip through the simulator's encoder and the decoder: randomized messages are encoded
+// into an in-memory channel, decoded by USBPDAnalyzer, and every decoded header, data object and
+// CRC must match what was sent. The decoder must also keep up a minimum number of messages per
+// second, to catch accidental quadratic behavior or per-bit allocations.
+//
+// Usage: USBPDRoundTripTest [messages] [minimum messages/s] [seed]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "USBPDTestHarness.h"
+#include "crc32.h"
+
+static const U32 sampleRateHz = 12000000;
+static const U32 bitRate = 300000;
+
+static const int maxReportedMismatches = 10;
+
+struct TestMessage {
+  SOPType sop;
+  uint16_t header;
+  uint32_t dataObjects[7];
+  uint8_t numDataObjects;
+  uint32_t crc;
+};
+
+static U32 NextRandom(U32* state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+/**
+ * @brief A random message that the decoder reads as one header, its data objects and a CRC.
+ * BIST messages are left out, as BIST Carrier Mode and Test Data are not decoded as data objects.
+ */
+static TestMessage RandomMessage(U32* state) {
+  TestMessage message;
+  message.sop = (SOPType)(NextRandom(state) % (SOPType_SOP_DOUBLE_PRIME + 1));
+  message.numDataObjects = NextRandom(state) % 8;
+
+  uint16_t messageType;
+  do {
+    messageType = NextRandom(state) & 0x1F;
+  } while (message.numDataObjects > 0 && messageType == DataMessage_BIST);
+
+  // Random Message ID, roles and revision, not extended
+  message.header = (NextRandom(state) & 0x0FE0) | (message.numDataObjects << 12) | messageType;
+
+  for (int i = 0; i < message.numDataObjects; i++) {
+    message.dataObjects[i] = NextRandom(state);
+  }
+
+  message.crc = crc32(0x00000000, (const uint8_t*)&message.header, 2, usbCrcPolynomial);
+  for (int i = 0; i < message.numDataObjects; i++) {
+    message.crc =
+        crc32(message.crc, (const uint8_t*)&message.dataObjects[i], 4, usbCrcPolynomial);
+  }
+
+  return message;
+}
+
+static bool IsDataObjectFrame(U8 type) {
+  switch (type) {
+    case FRAME_TYPE_GENERIC_DATA_OBJECT:
+    case FRAME_TYPE_SOURCE_POWER_DATA_OBJECT:
+    case FRAME_TYPE_REQUEST_DATA_OBJECT:
+    case FRAME_TYPE_VDM_HEADER:
+    case FRAME_TYPE_BIST_DATA_OBJECT:
+    case FRAME_TYPE_EPR_MODE_DATA_OBJECT:
+    case FRAME_TYPE_IDENTITY_VDO:
+    case FRAME_TYPE_VDM_DATA_OBJECT:
+    case FRAME_TYPE_DATA_OBJECT:
+      return true;
+    default:
+      return false;
+  }
+}
+
+/**
+ * @brief Collect the decoded messages from the frames: a header frame, the data object frames
+ * (which carry the data object in the low 32 bits of mData1) and a CRC frame
+ */
+static std::vector<TestMessage> GetDecodedMessages(USBPDAnalyzerResults* results) {
+  std::vector<TestMessage> messages;
+  TestMessage message = TestMessage();
+  bool inMessage = false;
+
+  for (U64 i = 0; i < results->GetNumFrames(); i++) {
+    Frame frame = results->GetFrame(i);
+
+    if (frame.mType == FRAME_TYPE_HEADER) {
+      message = TestMessage();
+      message.sop = (SOPType)(frame.mData2 & 0xFF);
+      message.header = frame.mData1;
+      inMessage = true;
+    } else if (inMessage && IsDataObjectFrame(frame.mType) && message.numDataObjects < 7) {
+      message.dataObjects[message.numDataObjects++] = frame.mData1 & 0xFFFFFFFF;
+    } else if (inMessage && frame.mType == FRAME_TYPE_CRC32) {
+      message.crc = frame.mData1;
+      messages.push_back(message);
+      inMessage = false;
+    }
+  }
+
+  return messages;
+}
+
+static bool MessagesMatch(const TestMessage& sent, const TestMessage& decoded) {
+  if (sent.sop != decoded.sop || sent.header != decoded.header || sent.crc != decoded.crc ||
+      sent.numDataObjects != decoded.numDataObjects) {
+    return false;
+  }
+
+  for (int i = 0; i < sent.numDataObjects; i++) {
+    if (sent.dataObjects[i] != decoded.dataObjects[i]) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static void PrintMessage(const char* label, const TestMessage& message) {
+  fprintf(stderr, "  %s: SOP %d, header 0x%04X,", label, message.sop, message.header);
+  for (int i = 0; i < message.numDataObjects; i++) {
+    fprintf(stderr, " 0x%08X", message.dataObjects[i]);
+  }
+  fprintf(stderr, ", CRC 0x%08X\n", message.crc);
+}
+
+int main(int argc, char** argv) {
+  size_t numMessages = (argc > 1) ? strtoul(argv[1], NULL, 0) : 20000;
+  double minimumMessagesPerSecond = (argc > 2) ? strtod(argv[2], NULL) : 2000.0;
+  U32 randomState = (argc > 3) ? strtoul(argv[3], NULL, 0) : 0x2545F491;
+  if (randomState == 0) {
+    randomState = 1;
+  }
+
+  USBPDTestAnalyzer analyzer(sampleRateHz, bitRate);
+
+  // Encode, with random idle between messages
+  USBPDTestGenerator generator;
+  generator.Initialize(sampleRateHz, analyzer.GetSettings());
+
+  std::vector<TestMessage> sent;
+  sent.reserve(numMessages);
+  for (size_t i = 0; i < numMessages; i++) {
+    sent.push_back(RandomMessage(&randomState));
+    const TestMessage& message = sent.back();
+    U64 idleSamples = (sampleRateHz / 1000000) * (30 + NextRandom(&randomState) % 500);
+    generator.AddPacket(
+        message.sop, message.header, message.dataObjects, message.numDataObjects, idleSamples);
+  }
+  generator.AddIdle(sampleRateHz / 1000);
+
+  SimulationChannelDescriptor& channel = generator.GetChannel();
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  analyzer.Decode(channel.GetInitialBitState(), channel.GetEdges());
+  double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  std::vector<TestMessage> decoded = GetDecodedMessages(analyzer.GetResults());
+
+  int mismatches = 0;
+  for (size_t i = 0; i < sent.size() && i < decoded.size(); i++) {
+    if (!MessagesMatch(sent[i], decoded[i])) {
+      if (mismatches < maxReportedMismatches) {
+        fprintf(stderr, "Message %zu does not match\n", i);
+        PrintMessage("sent", sent[i]);
+        PrintMessage("decoded", decoded[i]);
+      }
+      mismatches++;
+    }
+  }
+
+  bool passed = true;
+
+  if (decoded.size() != sent.size()) {
+    fprintf(stderr, "Sent %zu messages, decoded %zu\n", sent.size(), decoded.size());
+    passed = false;
+  }
+
+  if (mismatches > 0) {
+    fprintf(stderr, "%d messages do not match\n", mismatches);
+    passed = false;
+  }
+
+  double messagesPerSecond = decoded.size() / seconds;
+  printf("Decoded %zu messages (%zu edges) in %.3f s, %.0f messages/s\n",
+         decoded.size(),
+         channel.GetEdges().size(),
+         seconds,
+         messagesPerSecond);
+
+  if (messagesPerSecond < minimumMessagesPerSecond) {
+    fprintf(stderr,
+            "Below the minimum of %.0f messages/s\n",
+            minimumMessagesPerSecond);
+    passed = false;
+  }
+
+  printf("%s\n", passed ? "PASSED" : "FAILED");
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,103 @@
+#ifndef USBPD_TEST_HARNESS_H
+#define USBPD_TEST_HARNESS_H
+
+#include <cstdint>
+#include <vector>
+
+#include "USBPDAnalyzer.h"
+#include "USBPDAnalyzerResults.h"
+#include "USBPDAnalyzerSettings.h"
+#include "USBPDSimulationDataGenerator.h"
+
+/**
+ * @brief Simulator encoding packets chosen by a test, instead of simulated traffic
+ */
+class USBPDTestGenerator : public USBPDSimulationDataGenerator {
+ public:
+  /**
+   * @brief Encode a packet after idleSamples of idle, as the simulator encodes its traffic. The
+   * data objects are sent as they are, whatever the header says.
+   */
+  void AddPacket(SOPType sop,
+                 uint16_t header,
+                 const uint32_t* dataObjects,
+                 uint8_t numDataObjects,
+                 U64 idleSamples) {
+    mPayload.resize(numDataObjects * 4);
+    for (int i = 0; i < numDataObjects; i++) {
+      mPayload[i * 4] = dataObjects[i] & 0xFF;
+      mPayload[i * 4 + 1] = (dataObjects[i] >> 8) & 0xFF;
+      mPayload[i * 4 + 2] = (dataObjects[i] >> 16) & 0xFF;
+      mPayload[i * 4 + 3] = (dataObjects[i] >> 24) & 0xFF;
+    }
+
+    mWaveform.clear();
+    AppendPacket(&mWaveform, sop, header, mPayload.data(), mPayload.size());
+
+    CreateIdle(idleSamples);
+    CreateFromTemplate(mWaveform);
+    mSerialSimulationData.Transition();
+  }
+
+  /**
+   * @brief Encode a Hard Reset or Cable Reset after idleSamples of idle
+   */
+  void AddReset(OrderedSetType reset, U64 idleSamples) {
+    mWaveform.clear();
+    AppendReset(&mWaveform, reset);
+
+    CreateIdle(idleSamples);
+    CreateFromTemplate(mWaveform);
+    mSerialSimulationData.Transition();
+  }
+
+  void AddIdle(U64 samples) { CreateIdle(samples); }
+
+  SimulationChannelDescriptor& GetChannel() { return mSerialSimulationData; }
+
+ protected:
+  std::vector<uint8_t> mPayload;
+  WaveformTemplate mWaveform;
+};
+
+/**
+ * @brief Analyzer run by a test over a channel held in memory
+ */
+class USBPDTestAnalyzer : public USBPDAnalyzer {
+ public:
+  USBPDTestAnalyzer(U32 sampleRateHz, U32 bitRate) {
+    mSettings->mInputChannel = Channel(0, 0, DIGITAL_CHANNEL);
+    mSettings->mBitRate = bitRate;
+    SetSampleRate(sampleRateHz);
+    SetupResults();
+  }
+
+  USBPDAnalyzerSettings* GetSettings() { return mSettings.get(); }
+  USBPDAnalyzerResults* GetResults() { return mResults.get(); }
+
+  /**
+   * @brief Decode edges until they run out
+   */
+  void Decode(BitState initialBitState, const std::vector<U64>& edges) {
+    GetChannelData().SetEdges(initialBitState, edges);
+    try {
+      WorkerThread();
+    } catch (EndOfChannelData&) {
+    }
+  }
+
+  /**
+   * @brief Generate the bubble and tabular text of every frame and packet, as the UI would
+   */
+  void GenerateText() {
+    for (U64 i = 0; i < mResults->GetNumFrames(); i++) {
+      mResults->GenerateBubbleText(i, mSettings->mInputChannel, Hexadecimal);
+      mResults->GenerateFrameTabularText(i, Hexadecimal);
+    }
+    for (U64 i = 0; i < mResults->GetNumPackets(); i++) {
+      mResults->GeneratePacketTabularText(i, Hexadecimal);
+    }
+  }
+};
+
+#endif  // USBPD_TEST_HARNESS_H
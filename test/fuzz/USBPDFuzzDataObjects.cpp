@@ -0,0 +1,54 @@
+// Fuzz the message parsers with raw data objects. Each message is encoded with a valid CRC, so that
+// whatever the header and data objects say reaches ReadDataObjects(), ReadVendorDefinedMessage(),
+// ReadExtendedMessage() and the other readers, and from there the trackers and the results.
+//
+// Input: a settings byte selecting a filter, then messages, each a SOP byte, a 16-bit header and
+// as many 32-bit data objects as the header's Number of Data Objects, all little-endian. A
+// truncated last message is sent with the data objects it has.
+
+#include "USBPDFuzzTarget.h"
+
+// Idle before each message
+static const U64 idleSamples = 1200;
+
+static uint32_t ReadLittleEndian(const uint8_t* data, size_t size) {
+  uint32_t value = 0;
+  for (size_t i = 0; i < size; i++) {
+    value |= (uint32_t)data[i] << (i * 8);
+  }
+  return value;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  if (size < 1) {
+    return 0;
+  }
+
+  USBPDTestAnalyzer analyzer(fuzzSampleRateHz, fuzzBitRate);
+  analyzer.GetSettings()->mFilter = fuzzFilters[data[0] % numFuzzFilters];
+
+  USBPDTestGenerator generator;
+  generator.Initialize(fuzzSampleRateHz, analyzer.GetSettings());
+
+  size_t position = 1;
+  while (position + 3 <= size) {
+    SOPType sop = (SOPType)(data[position] % NUM_SOP_TYPE);
+    uint16_t header = ReadLittleEndian(&data[position + 1], 2);
+    position += 3;
+
+    uint32_t dataObjects[7];
+    uint8_t numDataObjects = 0;
+    while (numDataObjects < ((header >> 12) & 0x7) && position < size) {
+      size_t objectSize = (size - position < 4) ? size - position : 4;
+      dataObjects[numDataObjects++] = ReadLittleEndian(&data[position], objectSize);
+      position += objectSize;
+    }
+
+    generator.AddPacket(sop, header, dataObjects, numDataObjects, idleSamples);
+  }
+  generator.AddIdle(idleSamples);
+
+  SimulationChannelDescriptor& channel = generator.GetChannel();
+  FuzzDecode(&analyzer, channel.GetInitialBitState(), channel.GetEdges());
+  return 0;
+}
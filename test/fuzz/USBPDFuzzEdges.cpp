@@ -0,0 +1,36 @@
+// Fuzz the decoder with raw edge streams, through USBPDEdgeReader and ReadBiphaseMarkCodeBit() up
+// to the message parsers.
+//
+// Input: a settings byte, then the interval to each edge in samples, one byte per edge, 0 standing
+// for a long idle. At 40 samples per bit, a half bit is 20 samples and a whole bit 40.
+//
+// Settings byte: bits 1..0 select a filter, bit 2 enables the glitch filter, bit 3 sets the
+// initial line state.
+
+#include "USBPDFuzzTarget.h"
+
+// Interval of an edge byte of 0, long enough to end a message
+static const U64 idleSamples = 4000;
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  if (size < 1) {
+    return 0;
+  }
+
+  USBPDTestAnalyzer analyzer(fuzzSampleRateHz, fuzzBitRate);
+  USBPDAnalyzerSettings* settings = analyzer.GetSettings();
+  settings->mFilter = fuzzFilters[data[0] % numFuzzFilters];
+  settings->mGlitchFilter_ns = (data[0] & 0x04) ? 500 : 0;
+  BitState initialBitState = (data[0] & 0x08) ? BIT_HIGH : BIT_LOW;
+
+  std::vector<U64> edges;
+  edges.reserve(size - 1);
+  U64 sample = 0;
+  for (size_t i = 1; i < size; i++) {
+    sample += data[i] ? data[i] : idleSamples;
+    edges.push_back(sample);
+  }
+
+  FuzzDecode(&analyzer, initialBitState, edges);
+  return 0;
+}
@@ -0,0 +1,101 @@
+// Driver for the fuzz targets where libFuzzer is not available: runs each input file given on the
+// command line, or without any, a number of pseudo-random inputs. An input taking more than the
+// per-edge time budget (fuzzEdgeBudgetSeconds) fails the run, and so does one taking longer than
+// the timeout, as with libFuzzer's -timeout.
+//
+// Usage: USBPDFuzz... [-timeout=<seconds>] [-runs=<random inputs>] [input file]...
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include "USBPDFuzzTarget.h"
+
+// xorshift32, so that every run tries the same inputs
+static uint32_t NextRandom(uint32_t* state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+static bool RunInput(const std::vector<uint8_t>& input, double timeout, const char* name) {
+  FuzzDecodedEdges() = 0;
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  LLVMFuzzerTestOneInput(input.data(), input.size());
+  double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  U64 edges = FuzzDecodedEdges();
+  if (FuzzOverEdgeBudget(seconds, edges)) {
+    fprintf(stderr,
+            "%s: %zu bytes (%llu edges) took %.3f s, over the budget of %.0f us per edge\n",
+            name,
+            input.size(),
+            (unsigned long long)edges,
+            seconds,
+            fuzzEdgeBudgetSeconds * 1e6);
+    return false;
+  }
+
+  // Backstop for an input that hangs before it counts its edges
+  if (seconds > timeout) {
+    fprintf(stderr,
+            "%s: %zu bytes took %.3f s, over the %.3f s timeout\n",
+            name,
+            input.size(),
+            seconds,
+            timeout);
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  double timeout = 1.0;
+  unsigned long runs = 1000;
+  std::vector<const char*> files;
+
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "-timeout=", 9) == 0) {
+      timeout = strtod(argv[i] + 9, NULL);
+    } else if (strncmp(argv[i], "-runs=", 6) == 0) {
+      runs = strtoul(argv[i] + 6, NULL, 0);
+    } else if (argv[i][0] != '-') {
+      files.push_back(argv[i]);
+    }
+  }
+
+  bool passed = true;
+
+  for (const char* file : files) {
+    std::ifstream stream(file, std::ios::binary);
+    if (!stream) {
+      fprintf(stderr, "Cannot read %s\n", file);
+      return EXIT_FAILURE;
+    }
+    std::vector<uint8_t> input((std::istreambuf_iterator<char>(stream)),
+                               std::istreambuf_iterator<char>());
+    passed = RunInput(input, timeout, file) && passed;
+  }
+
+  if (files.empty()) {
+    uint32_t state = 0x2545F491;
+    std::vector<uint8_t> input;
+    for (unsigned long run = 0; run < runs; run++) {
+      input.resize(NextRandom(&state) % 4096);
+      for (uint8_t& byte : input) {
+        byte = NextRandom(&state);
+      }
+      passed = RunInput(input, timeout, "random input") && passed;
+    }
+    printf("Ran %lu random inputs\n", runs);
+  }
+
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,85 @@
+#ifndef USBPD_FUZZ_TARGET_H
+#define USBPD_FUZZ_TARGET_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "USBPDTestHarness.h"
+
+// Capture the fuzz targets decode at, 40 samples per bit
+static const U32 fuzzSampleRateHz = 12000000;
+static const U32 fuzzBitRate = 300000;
+
+// Filters a fuzz input can select, so that filter evaluation is fuzzed along with the decoder
+static const char* const fuzzFilters[] = {
+    "",
+    "Request -> !Accept within 1ms",
+    "sop==SOP' && type==VDM && vdm.cmd==DiscoverIdentity",
+    "port==B && PR_Swap",
+};
+static const size_t numFuzzFilters = sizeof(fuzzFilters) / sizeof(fuzzFilters[0]);
+
+// Time an input may take per edge, orders of magnitude above the usual cost. An input is charged
+// for at least fuzzBudgetMinimumEdges edges, which covers the setup and exports every input pays
+// for however short it is.
+static const double fuzzEdgeBudgetSeconds = 100e-6;
+static const U64 fuzzBudgetMinimumEdges = 2000;
+
+/**
+ * @brief Number of edges the last input decoded
+ */
+inline U64& FuzzDecodedEdges() {
+  static U64 edges = 0;
+  return edges;
+}
+
+/**
+ * @brief Whether an input that decoded edges in seconds went over the per-edge time budget
+ */
+static inline bool FuzzOverEdgeBudget(double seconds, U64 edges) {
+  U64 chargedEdges = (edges > fuzzBudgetMinimumEdges) ? edges : fuzzBudgetMinimumEdges;
+  return seconds > fuzzEdgeBudgetSeconds * chargedEdges;
+}
+
+/**
+ * @brief Decode edges, then run everything that runs on decoded messages once the decoder is done:
+ * the text of every frame and packet, and every export.
+ *
+ * libFuzzer only has an absolute -timeout, so with libFuzzer an input over the per-edge time
+ * budget is reported here, as a crash. The plain driver checks the budget itself.
+ */
+static inline void FuzzDecode(USBPDTestAnalyzer* analyzer,
+                              BitState initialBitState,
+                              const std::vector<U64>& edges) {
+  FuzzDecodedEdges() = edges.size();
+#ifdef USBPD_LIBFUZZER
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+#endif
+
+  analyzer->Decode(initialBitState, edges);
+  analyzer->GenerateText();
+  for (U32 exportType = 0; exportType <= 4; exportType++) {
+    analyzer->GetResults()->GenerateExportFile("/dev/null", Hexadecimal, exportType);
+  }
+
+#ifdef USBPD_LIBFUZZER
+  double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  if (FuzzOverEdgeBudget(seconds, edges.size())) {
+    fprintf(stderr,
+            "%zu edges took %.3f s, over the budget of %.0f us per edge\n",
+            edges.size(),
+            seconds,
+            fuzzEdgeBudgetSeconds * 1e6);
+    abort();
+  }
+#endif
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+#endif  // USBPD_FUZZ_TARGET_H
@@ -0,0 +1,56 @@
+#ifndef ANALYZER_H
+#define ANALYZER_H
+
+#include "AnalyzerChannelData.h"
+#include "AnalyzerResults.h"
+#include "AnalyzerSettings.h"
+#include "LogicPublicTypes.h"
+#include "SimulationChannelDescriptor.h"
+
+/**
+ * @brief Analyzer running on the caller's thread, over a channel held in memory. WorkerThread()
+ * ends with EndOfChannelData once the channel has been read.
+ */
+class Analyzer {
+ public:
+  Analyzer() : mSampleRateHz(0), mSimulationSampleRateHz(0) {}
+  virtual ~Analyzer() {}
+
+  virtual void WorkerThread() = 0;
+  virtual U32 GenerateSimulationData(U64 newest_sample_requested,
+                                     U32 sample_rate,
+                                     SimulationChannelDescriptor** simulation_channels) = 0;
+  virtual U32 GetMinimumSampleRateHz() = 0;
+  virtual const char* GetAnalyzerName() const = 0;
+  virtual bool NeedsRerun() = 0;
+
+  void SetAnalyzerSettings(AnalyzerSettings* settings) {}
+  void SetAnalyzerResults(AnalyzerResults* results) {}
+  void KillThread() {}
+
+  U64 GetTriggerSample() { return 0; }
+  U32 GetSampleRate() { return mSampleRateHz; }
+  U32 GetSimulationSampleRate() { return mSimulationSampleRateHz; }
+  AnalyzerChannelData* GetAnalyzerChannelData(Channel& channel) { return &mChannelData; }
+  void ReportProgress(U64 sample_number) {}
+  void CheckIfThreadShouldExit() {}
+
+  // Not part of the SDK: the capture the analyzer runs on
+  void SetSampleRate(U32 sample_rate_hz) {
+    mSampleRateHz = sample_rate_hz;
+    mSimulationSampleRateHz = sample_rate_hz;
+  }
+  AnalyzerChannelData& GetChannelData() { return mChannelData; }
+
+ protected:
+  U32 mSampleRateHz;
+  U32 mSimulationSampleRateHz;
+  AnalyzerChannelData mChannelData;
+};
+
+class Analyzer2 : public Analyzer {
+ public:
+  virtual void SetupResults() {}
+};
+
+#endif  // ANALYZER_H
@@ -0,0 +1,83 @@
+#ifndef ANALYZER_CHANNEL_DATA_H
+#define ANALYZER_CHANNEL_DATA_H
+
+#include "LogicPublicTypes.h"
+
+/**
+ * @brief Thrown when the decoder reads past the last edge. Logic 2 would block the worker thread
+ * until more data is captured, the stub ends the decode instead.
+ */
+struct EndOfChannelData {};
+
+/**
+ * @brief Channel played back from a list of edges held in memory
+ */
+class AnalyzerChannelData {
+ public:
+  AnalyzerChannelData() : mInitialBitState(BIT_HIGH), mNextEdge(0), mSampleNumber(0) {}
+
+  /**
+   * @brief Replace the channel contents and rewind to sample 0
+   *
+   * @param edges sample numbers of the transitions, in increasing order
+   */
+  void SetEdges(BitState initialBitState, const std::vector<U64>& edges) {
+    mInitialBitState = initialBitState;
+    mEdges = edges;
+    mNextEdge = 0;
+    mSampleNumber = 0;
+  }
+
+  U64 GetSampleNumber() { return mSampleNumber; }
+  BitState GetBitState() { return (mNextEdge & 1) ? Invert(mInitialBitState) : mInitialBitState; }
+
+  U32 Advance(U32 num_samples) { return AdvanceToAbsPosition(mSampleNumber + num_samples); }
+
+  U32 AdvanceToAbsPosition(U64 sample_number) {
+    U32 transitions = 0;
+    while (mNextEdge < mEdges.size() && mEdges[mNextEdge] <= sample_number) {
+      mNextEdge++;
+      transitions++;
+    }
+    if (mNextEdge == mEdges.size() && (mEdges.empty() || sample_number > mEdges.back())) {
+      throw EndOfChannelData();
+    }
+    mSampleNumber = sample_number;
+    return transitions;
+  }
+
+  void AdvanceToNextEdge() {
+    if (mNextEdge == mEdges.size()) {
+      throw EndOfChannelData();
+    }
+    mSampleNumber = mEdges[mNextEdge++];
+  }
+
+  U64 GetSampleOfNextEdge() {
+    if (mNextEdge == mEdges.size()) {
+      throw EndOfChannelData();
+    }
+    return mEdges[mNextEdge];
+  }
+
+  bool WouldAdvancingCauseTransition(U32 num_samples) {
+    return WouldAdvancingToAbsPositionCauseTransition(mSampleNumber + num_samples);
+  }
+
+  bool WouldAdvancingToAbsPositionCauseTransition(U64 sample_number) {
+    return mNextEdge < mEdges.size() && mEdges[mNextEdge] <= sample_number;
+  }
+
+  void TrackMinimumPulseWidth() {}
+  U64 GetMinimumPulseWidthSoFar() { return 0; }
+
+  bool DoMoreTransitionsExistInCurrentData() { return mNextEdge < mEdges.size(); }
+
+ protected:
+  BitState mInitialBitState;
+  std::vector<U64> mEdges;
+  size_t mNextEdge;
+  U64 mSampleNumber;
+};
+
+#endif  // ANALYZER_CHANNEL_DATA_H
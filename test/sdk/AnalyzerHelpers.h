@@ -0,0 +1,89 @@
+#ifndef ANALYZER_HELPERS_H
+#define ANALYZER_HELPERS_H
+
+#include <sstream>
+
+#include "LogicPublicTypes.h"
+
+class AnalyzerHelpers {
+ public:
+  static void GetNumberString(U64 number,
+                              DisplayBase display_base,
+                              U32 num_data_bits,
+                              char* result_string,
+                              U32 result_string_max_length) {
+    snprintf(result_string,
+             result_string_max_length,
+             (display_base == Decimal) ? "%llu" : "0x%llX",
+             number);
+  }
+
+  static void GetTimeString(U64 sample,
+                            U64 trigger_sample,
+                            U32 sample_rate_hz,
+                            char* result_string,
+                            U32 result_string_max_length) {
+    snprintf(result_string,
+             result_string_max_length,
+             "%.9f",
+             ((double)sample - (double)trigger_sample) / sample_rate_hz);
+  }
+
+  static U64 AdjustSimulationTargetSample(U64 target_sample,
+                                          U32 sample_rate,
+                                          U32 simulation_sample_rate) {
+    if (sample_rate == simulation_sample_rate) {
+      return target_sample;
+    }
+    return (U64)((double)target_sample * simulation_sample_rate / sample_rate);
+  }
+
+  static void Assert(const char* message) { throw std::runtime_error(message); }
+};
+
+/**
+ * @brief Whitespace separated text archive, which is all the settings need
+ */
+class SimpleArchive {
+ public:
+  void SetString(const char* archive_string) {
+    mInput.str(archive_string);
+    mInput.clear();
+  }
+
+  const char* GetString() {
+    mString = mOutput.str();
+    return mString.c_str();
+  }
+
+  template <typename T>
+  bool operator<<(T data) {
+    mOutput << data << " ";
+    return true;
+  }
+
+  bool operator<<(Channel& data) { return *this << data.mChannelIndex; }
+
+  template <typename T>
+  bool operator>>(T& data) {
+    return (bool)(mInput >> data);
+  }
+
+  bool operator>>(char const** data) {
+    if (!(mInput >> mToken)) {
+      return false;
+    }
+    *data = mToken.c_str();
+    return true;
+  }
+
+  bool operator>>(Channel& data) { return *this >> data.mChannelIndex; }
+
+ protected:
+  std::ostringstream mOutput;
+  std::istringstream mInput;
+  std::string mString;
+  std::string mToken;
+};
+
+#endif  // ANALYZER_HELPERS_H
@@ -0,0 +1,159 @@
+#ifndef ANALYZER_RESULTS_H
+#define ANALYZER_RESULTS_H
+
+#include <utility>
+
+#include "LogicPublicTypes.h"
+
+#define DISPLAY_AS_ERROR_FLAG (1 << 7)
+#define DISPLAY_AS_WARNING_FLAG (1 << 6)
+
+#define INVALID_RESULT_INDEX 0xFFFFFFFFFFFFFFFFull
+
+#define SUPPORTS_PROTOCOL_SEARCH
+
+class Frame {
+ public:
+  Frame()
+      : mStartingSampleInclusive(0),
+        mEndingSampleInclusive(0),
+        mData1(0),
+        mData2(0),
+        mType(0),
+        mFlags(0) {}
+
+  bool HasFlag(U8 flag) { return (mFlags & flag) != 0; }
+
+  S64 mStartingSampleInclusive;
+  S64 mEndingSampleInclusive;
+  U64 mData1;
+  U64 mData2;
+  U8 mType;
+  U8 mFlags;
+};
+
+/**
+ * @brief Frames, packets and markers kept in memory, and the strings last generated for them
+ */
+class AnalyzerResults {
+ public:
+  enum MarkerType { Dot, ErrorDot, Square, ErrorSquare, UpArrow, DownArrow, X, ErrorX, Start, Stop,
+                    One, Zero };
+
+  AnalyzerResults() : mPacketStartFrame(0) {}
+  virtual ~AnalyzerResults() {}
+
+  virtual void GenerateBubbleText(U64 frame_index, Channel& channel, DisplayBase display_base) = 0;
+  virtual void GenerateExportFile(const char* file,
+                                  DisplayBase display_base,
+                                  U32 export_type_user_id) = 0;
+  virtual void GenerateFrameTabularText(U64 frame_index, DisplayBase display_base) = 0;
+  virtual void GeneratePacketTabularText(U64 packet_id, DisplayBase display_base) = 0;
+  virtual void GenerateTransactionTabularText(U64 transaction_id, DisplayBase display_base) = 0;
+
+  void AddMarker(U64 sample_number, MarkerType marker_type, Channel& channel) {
+    mMarkers.push_back(std::make_pair(sample_number, marker_type));
+  }
+
+  U64 AddFrame(const Frame& frame) {
+    mFrames.push_back(frame);
+    return mFrames.size() - 1;
+  }
+
+  U64 CommitPacketAndStartNewPacket() {
+    if (mPacketStartFrame >= mFrames.size()) {
+      return INVALID_RESULT_INDEX;
+    }
+    mPackets.push_back(std::make_pair(mPacketStartFrame, (U64)mFrames.size() - 1));
+    mPacketStartFrame = mFrames.size();
+    return mPackets.size() - 1;
+  }
+
+  void CancelPacketAndStartNewPacket() { mPacketStartFrame = mFrames.size(); }
+  void AddPacketToTransaction(U64 transaction_id, U64 packet_id) {}
+  void AddChannelBubblesWillAppearOn(const Channel& channel) {}
+  void CommitResults() {}
+
+  U64 GetNumFrames() { return mFrames.size(); }
+  U64 GetNumPackets() { return mPackets.size(); }
+  Frame GetFrame(U64 frame_id) { return mFrames.at(frame_id); }
+
+  U64 GetPacketContainingFrame(U64 frame_id) {
+    for (size_t i = 0; i < mPackets.size(); i++) {
+      if (mPackets[i].first <= frame_id && frame_id <= mPackets[i].second) {
+        return i;
+      }
+    }
+    return INVALID_RESULT_INDEX;
+  }
+
+  U64 GetPacketContainingFrameSequential(U64 frame_id) { return GetPacketContainingFrame(frame_id); }
+
+  void GetFramesContainedInPacket(U64 packet_id, U64* first_frame_id, U64* last_frame_id) {
+    *first_frame_id = mPackets.at(packet_id).first;
+    *last_frame_id = mPackets.at(packet_id).second;
+  }
+
+  U32 GetTransactionContainingPacket(U64 packet_id) { return 0; }
+  void GetPacketsContainedInTransaction(U64 transaction_id, U64** packet_id_array, U64* count) {}
+
+  U64 GetNumMarkers(Channel& channel) { return mMarkers.size(); }
+  void GetMarker(Channel& channel, U64 marker_index, MarkerType* marker_type, U64* marker_sample) {
+    *marker_type = mMarkers.at(marker_index).second;
+    *marker_sample = mMarkers.at(marker_index).first;
+  }
+
+  void ClearResultStrings() { mResultStrings.clear(); }
+  void AddResultString(const char* str1,
+                       const char* str2 = NULL,
+                       const char* str3 = NULL,
+                       const char* str4 = NULL,
+                       const char* str5 = NULL,
+                       const char* str6 = NULL) {
+    mResultStrings.push_back(Concatenate(str1, str2, str3, str4, str5, str6));
+  }
+
+  void ClearTabularText() { mTabularText.clear(); }
+  void AddTabularText(const char* str1,
+                      const char* str2 = NULL,
+                      const char* str3 = NULL,
+                      const char* str4 = NULL,
+                      const char* str5 = NULL,
+                      const char* str6 = NULL) {
+    mTabularText.push_back(Concatenate(str1, str2, str3, str4, str5, str6));
+  }
+
+  // Not part of the SDK: the strings generated by the latest Generate...Text() call
+  const std::vector<std::string>& GetResultStrings() const { return mResultStrings; }
+  const std::vector<std::string>& GetTabularText() const { return mTabularText; }
+
+ protected:
+  bool UpdateExportProgressAndCheckForCancel(U64 completed_frames, U64 total_frames) {
+    return false;
+  }
+
+  static std::string Concatenate(const char* str1,
+                                 const char* str2,
+                                 const char* str3,
+                                 const char* str4,
+                                 const char* str5,
+                                 const char* str6) {
+    std::string result = str1;
+    const char* rest[] = {str2, str3, str4, str5, str6};
+    for (const char* str : rest) {
+      if (str != NULL) {
+        result += str;
+      }
+    }
+    return result;
+  }
+
+  std::vector<Frame> mFrames;
+  std::vector<std::pair<U64, U64> > mPackets;  // First and last frame of each packet
+  U64 mPacketStartFrame;
+  std::vector<std::pair<U64, MarkerType> > mMarkers;
+  std::vector<std::string> mResultStrings;
+  std::vector<std::string> mTabularText;
+};
+
+#endif  // ANALYZER_RESULTS_H
@@ -0,0 +1,80 @@
+#ifndef ANALYZER_SETTING_INTERFACE_H
+#define ANALYZER_SETTING_INTERFACE_H
+
+#include "LogicPublicTypes.h"
+
+class AnalyzerSettingInterface {
+ public:
+  virtual ~AnalyzerSettingInterface() {}
+
+  void SetTitleAndTooltip(const char* title, const char* tooltip) {
+    mTitle = title;
+    mTooltip = tooltip;
+  }
+
+ protected:
+  std::string mTitle;
+  std::string mTooltip;
+};
+
+class AnalyzerSettingInterfaceChannel : public AnalyzerSettingInterface {
+ public:
+  Channel GetChannel() { return mChannel; }
+  void SetChannel(const Channel& channel) { mChannel = channel; }
+  void SetSelectionOfNoneIsAllowed(bool is_allowed) {}
+
+ protected:
+  Channel mChannel;
+};
+
+class AnalyzerSettingInterfaceNumberList : public AnalyzerSettingInterface {
+ public:
+  AnalyzerSettingInterfaceNumberList() : mNumber(0) {}
+
+  double GetNumber() { return mNumber; }
+  void SetNumber(double number) { mNumber = number; }
+  void AddNumber(double number, const char* str, const char* tooltip) {}
+  void ClearNumbers() {}
+
+ protected:
+  double mNumber;
+};
+
+class AnalyzerSettingInterfaceInteger : public AnalyzerSettingInterface {
+ public:
+  AnalyzerSettingInterfaceInteger() : mInteger(0) {}
+
+  int GetInteger() { return mInteger; }
+  void SetInteger(int integer) { mInteger = integer; }
+  void SetMax(int max) {}
+  void SetMin(int min) {}
+
+ protected:
+  int mInteger;
+};
+
+class AnalyzerSettingInterfaceText : public AnalyzerSettingInterface {
+ public:
+  enum TextType { NormalText, FilePath, FolderPath };
+
+  const char* GetText() { return mText.c_str(); }
+  void SetText(const char* text) { mText = text; }
+  void SetTextType(TextType text_type) {}
+
+ protected:
+  std::string mText;
+};
+
+class AnalyzerSettingInterfaceBool : public AnalyzerSettingInterface {
+ public:
+  AnalyzerSettingInterfaceBool() : mValue(false) {}
+
+  bool GetValue() { return mValue; }
+  void SetValue(bool value) { mValue = value; }
+  void SetCheckBoxText(const char* text) {}
+
+ protected:
+  bool mValue;
+};
+
+#endif  // ANALYZER_SETTING_INTERFACE_H
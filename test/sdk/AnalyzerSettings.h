@@ -0,0 +1,34 @@
+#ifndef ANALYZER_SETTINGS_H
+#define ANALYZER_SETTINGS_H
+
+#include "AnalyzerSettingInterface.h"
+#include "LogicPublicTypes.h"
+
+class AnalyzerSettings {
+ public:
+  AnalyzerSettings() {}
+  virtual ~AnalyzerSettings() {}
+
+  virtual bool SetSettingsFromInterfaces() = 0;
+  virtual void LoadSettings(const char* settings) = 0;
+  virtual const char* SaveSettings() = 0;
+
+ protected:
+  void ClearChannels() {}
+  void AddChannel(Channel& channel, const char* channel_label, bool is_used) {}
+  void SetErrorText(const char* error_text) { mErrorText = error_text; }
+  void AddInterface(AnalyzerSettingInterface* analyzer_setting_interface) {}
+  void ClearInterfaces() {}
+  void AddExportOption(U32 user_id, const char* menu_text) {}
+  void AddExportExtension(U32 user_id, const char* extension_description, const char* extension) {}
+
+  const char* SetReturnString(const char* str) {
+    mReturnString = str;
+    return mReturnString.c_str();
+  }
+
+  std::string mErrorText;
+  std::string mReturnString;
+};
+
+#endif  // ANALYZER_SETTINGS_H
@@ -0,0 +1,6 @@
+#ifndef ANALYZER_TYPES_H
+#define ANALYZER_TYPES_H
+
+#include "LogicPublicTypes.h"
+
+#endif  // ANALYZER_TYPES_H
@@ -0,0 +1,57 @@
+#ifndef LOGIC_PUBLIC_TYPES_H
+#define LOGIC_PUBLIC_TYPES_H
+
+// Stub of the Analyzer SDK, enough of it to run the decoder in memory without Logic 2. Only what
+// the plugin uses is declared, with the same names and signatures as the SDK.
+
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+typedef int8_t S8;
+typedef int16_t S16;
+typedef int32_t S32;
+typedef long long int S64;
+
+typedef uint8_t U8;
+typedef uint16_t U16;
+typedef uint32_t U32;
+typedef unsigned long long int U64;
+
+#define LOGICAPI
+#define ANALYZER_EXPORT
+#ifndef __cdecl
+#define __cdecl
+#endif
+
+enum DisplayBase { Binary, Decimal, Hexadecimal, ASCII, AsciiHex };
+
+enum BitState { BIT_LOW, BIT_HIGH };
+
+#define Toggle(x) (x == BIT_LOW ? BIT_HIGH : BIT_LOW)
+#define Invert(x) (x == BIT_LOW ? BIT_HIGH : BIT_LOW)
+
+enum ChannelDataType { ANALOG_CHANNEL, DIGITAL_CHANNEL };
+
+class Channel {
+ public:
+  Channel() : mDeviceId(0), mChannelIndex(0xFFFFFFFF), mDataType(DIGITAL_CHANNEL) {}
+  Channel(U64 device_id, U32 channel_index, ChannelDataType data_type)
+      : mDeviceId(device_id), mChannelIndex(channel_index), mDataType(data_type) {}
+
+  bool operator==(const Channel& channel) const { return mChannelIndex == channel.mChannelIndex; }
+  bool operator!=(const Channel& channel) const { return !(*this == channel); }
+  bool operator<(const Channel& channel) const { return mChannelIndex < channel.mChannelIndex; }
+
+  U64 mDeviceId;
+  U32 mChannelIndex;
+  ChannelDataType mDataType;
+};
+
+static Channel UNDEFINED_CHANNEL;
+
+#endif  // LOGIC_PUBLIC_TYPES_H
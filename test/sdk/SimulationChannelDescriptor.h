@@ -0,0 +1,54 @@
+#ifndef SIMULATION_CHANNEL_DESCRIPTOR_H
+#define SIMULATION_CHANNEL_DESCRIPTOR_H
+
+#include "LogicPublicTypes.h"
+
+/**
+ * @brief Simulated channel, recording the sample number of each transition
+ */
+class SimulationChannelDescriptor {
+ public:
+  SimulationChannelDescriptor()
+      : mSampleRate(0), mInitialBitState(BIT_LOW), mBitState(BIT_LOW), mSampleNumber(0) {}
+
+  void Transition() {
+    mEdges.push_back(mSampleNumber);
+    mBitState = Invert(mBitState);
+  }
+
+  void TransitionIfNeeded(BitState bit_state) {
+    if (bit_state != mBitState) {
+      Transition();
+    }
+  }
+
+  void Advance(U32 num_samples_to_advance) { mSampleNumber += num_samples_to_advance; }
+
+  BitState GetCurrentBitState() { return mBitState; }
+  U64 GetCurrentSampleNumber() { return mSampleNumber; }
+
+  void SetChannel(Channel& channel) { mChannel = channel; }
+  void SetSampleRate(U32 sample_rate_hz) { mSampleRate = sample_rate_hz; }
+  void SetInitialBitState(BitState initial_bit_state) {
+    mInitialBitState = initial_bit_state;
+    mBitState = initial_bit_state;
+  }
+
+  Channel GetChannel() { return mChannel; }
+  U32 GetSampleRate() { return mSampleRate; }
+  BitState GetInitialBitState() { return mInitialBitState; }
+
+  const std::vector<U64>& GetEdges() const { return mEdges; }
+
+ protected:
+  Channel mChannel;
+  U32 mSampleRate;
+  BitState mInitialBitState;
+  BitState mBitState;
+  U64 mSampleNumber;
+  std::vector<U64> mEdges;
+};
+
+class SimulationChannelDescriptorGroup {};
+
+#endif  // SIMULATION_CHANNEL_DESCRIPTOR_H